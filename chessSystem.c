@@ -10,6 +10,9 @@
 struct chess_system_t {
     Map tournament_map;
     Map player_map;
+    MapAllocator allocator; // the system and its maps take their memory from it
+    int expected_games_per_tournament; // the room made in the maps of every new tournament
+    int expected_players_per_tournament;
 };
 
 /*************************************************************/
@@ -125,6 +128,24 @@ static ChessResult chessResultToPlayerResult(PlayerResult result) {
     assert(result == PLAYER_SUCCESS);
     return CHESS_SUCCESS;
 }
+/**
+ * chessResultToMapResult - convert the MapResult of saving or loading a map to ChessResult equivalent
+ * @param result - MapResult
+ * @return
+ *  ChessResult equivalent, CHESS_SAVE_FAILURE for any other failure
+ */
+static ChessResult chessResultToMapResult(MapResult result) {
+    if (result == MAP_OUT_OF_MEMORY) {
+        return CHESS_OUT_OF_MEMORY;
+    }
+    else if (result == MAP_NULL_ARGUMENT) {
+        return CHESS_NULL_ARGUMENT;
+    }
+    else if (result != MAP_SUCCESS) {
+        return CHESS_SAVE_FAILURE;
+    }
+    return CHESS_SUCCESS;
+}
 /**
  * checkValidityForAddGame - check the validity of AddGame request
  * @param chess - the chess check it's validity
@@ -132,6 +153,7 @@ static ChessResult chessResultToPlayerResult(PlayerResult result) {
  * @param first_player - the first players id
  * @param second_player - the second players id
  * @param play_time - play time
+ * @param tournament_data - pointer to store the tournament's data in, found once for the whole request
  * @return
  *     CHESS_NULL_ARGUMENT - if chess is NULL.
  *     CHESS_INVALID_ID - if the tournament ID number, either the players or the winner is invalid or both players
@@ -141,11 +163,11 @@ static ChessResult chessResultToPlayerResult(PlayerResult result) {
  *     CHESS_GAME_ALREADY_EXISTS - if there is already a game in the tournament with the same two players
  *                                  (both were not removed).
  *     CHESS_INVALID_PLAY_TIME - if the play time is negative.
- *     CHESS_EXCEEDED_GAMES - if one of the players played the maximum number of games allowed
- *     CHESS_SUCCESS - if game was added successfully.
+ *     CHESS_SUCCESS - otherwise. An existing game is then reported by gameAdd, and players who played the
+ *                     maximum number of games allowed by playerAddDuelResult.
  */
 static ChessResult checkValidityForAddGame(ChessSystem chess, int tournament_id, int first_player,
-    int second_player, int play_time) {
+    int second_player, int play_time, TournamentData* tournament_data) {
     if (!chess) {
         return CHESS_NULL_ARGUMENT;
     }
@@ -153,78 +175,155 @@ static ChessResult checkValidityForAddGame(ChessSystem chess, int tournament_id,
         !playerIdIsValid(second_player) || first_player == second_player) {
         return CHESS_INVALID_ID;
     }
-    Map tournament_map = chess->tournament_map;
-    assert(tournament_map);
-    Map tournament_player_map = tournamentGetPlayerMap(tournament_map, tournament_id);
-    Map tournament_game_map = tournamentGetGameMap(tournament_map, tournament_id);
-
-    if (!tournament_game_map) {
+    assert(chess->tournament_map);
+    *tournament_data = tournamentGet(chess->tournament_map, tournament_id);
+    if (!*tournament_data) {
         return CHESS_TOURNAMENT_NOT_EXIST;
     }
-    if (tournamentEnded(tournament_map, tournament_id)) {
+    if (tournamentDataEnded(*tournament_data)) {
         return CHESS_TOURNAMENT_ENDED;
     }
-
-    if (gameExists(tournament_game_map, first_player, second_player)) {
-        return CHESS_GAME_ALREADY_EXISTS;
-    }
+    //an existing game is reported first, it is only looked up here when the game won't be added,
+    //otherwise gameAdd finds it while inserting
     if (!playTimeIsValid(play_time)) {
+        if (gameExists(tournamentDataGetGameMap(*tournament_data), first_player, second_player)) {
+            return CHESS_GAME_ALREADY_EXISTS;
+        }
         return CHESS_INVALID_PLAY_TIME;
     }
-    int max_games = 0;
-    tournamentGetMaxGamesPerPlayer(tournament_map, tournament_id, &max_games);
-    if (playerExceededGames(tournament_player_map, first_player, max_games) ||
-        playerExceededGames(tournament_player_map, second_player, max_games)) {
-
-        return CHESS_EXCEEDED_GAMES;
-    }
-
     return CHESS_SUCCESS;
 }
 /**
- * addAndUpdatePlayersData - add players if nesescary and update their statistics
- * @param player_map - the map player to add to and update
+ * undoPlayersData - take a game out of the results of its two players, removing a player left with no games
+ * @param player_map - the player map of the game's tournament
  * @param player1_id - the first player's id
- * @param player2_id - the secinde player's id
- * @param winner - the deafault winner
+ * @param player2_id - the second player's id
+ * @param winner - the winner of the game
  * @param play_time - play time
  * @return
- *  CHESS_OUT_OF_MEMORY - if allocation failed
- *  CHESS_SUCCESS - otherwise
+ *  The number of players removed.
  */
-static ChessResult addAndUpdatePlayersData(Map player_map, PlayerId player1_id,
-    PlayerId player2_id, Winner winner, int play_time) {
-    assert(player_map);
-    assert(playerIdIsValid(player1_id) && playerIdIsValid(player2_id));
+static int undoPlayersData(Map player_map, PlayerId player1_id, PlayerId player2_id, Winner winner,
+    int play_time) {
+    playerUpdateDuelResult(player_map, player1_id, player2_id, play_time, winner, UNDO);
+    //a player left with no games didn't play in the tournament
+    int removed_players = 0;
+    PlayerId players[] = { player1_id, player2_id };
+    for (int i = 0; i < 2; i++) {
+        if (playerGetNumOfGames(player_map, players[i]) == 0 &&
+            playerRemove(player_map, players[i]) == PLAYER_SUCCESS) {
+            removed_players++;
+        }
+    }
+    return removed_players;
+}
 
-    if (playerAdd(player_map, player1_id) != PLAYER_SUCCESS) {
-        return CHESS_OUT_OF_MEMORY;
+/**
+ * checkValidityForGameHandle - check the validity of a request on an existing game, and find it
+ * @param chess - the chess system
+ * @param game - the handle of the game
+ * @param winner - pointer to store the winner of the game in, FIRST_PLAYER being the handle's first player
+ * @param play_time - pointer to store the play time of the game in
+ * @return
+ *     CHESS_NULL_ARGUMENT - if chess is NULL.
+ *     CHESS_INVALID_ID - if the tournament ID number or either of the players is invalid, or both
+ *                        players have the same ID number.
+ *     CHESS_TOURNAMENT_NOT_EXIST - if the tournament does not exist in the system.
+ *     CHESS_TOURNAMENT_ENDED - if the tournament already ended
+ *     CHESS_GAME_NOT_EXIST - if there is no game of the two players in the tournament
+ *     CHESS_SUCCESS - otherwise
+ */
+static ChessResult checkValidityForGameHandle(ChessSystem chess, GameHandle game, Winner* winner,
+    int* play_time) {
+    if (!chess) {
+        return CHESS_NULL_ARGUMENT;
     }
-    if (playerAdd(player_map, player2_id) != PLAYER_SUCCESS) {
-        playerRemove(player_map, player1_id);
-        return CHESS_OUT_OF_MEMORY;
+    if (!tournamentIdIsValid(game.tournament_id) || !playerIdIsValid(game.first_player) ||
+        !playerIdIsValid(game.second_player) || game.first_player == game.second_player) {
+        return CHESS_INVALID_ID;
+    }
+    GameMap tournament_game_map = tournamentGetGameMap(chess->tournament_map, game.tournament_id);
+    if (!tournament_game_map) {
+        return CHESS_TOURNAMENT_NOT_EXIST;
+    }
+    if (tournamentEnded(chess->tournament_map, game.tournament_id)) {
+        return CHESS_TOURNAMENT_ENDED;
+    }
+    if (!gameGet(tournament_game_map, game.first_player, game.second_player, winner, play_time)) {
+        return CHESS_GAME_NOT_EXIST;
     }
-
-    playerUpdateDuelResult(player_map, player1_id, player2_id, play_time, winner, ADD);
     return CHESS_SUCCESS;
 }
 
+/**
+ * chooseExpectedCount - bounds an expected count given in the options of a chess system
+ * @param count - the count given
+ * @param limit - the largest count that makes sense, 0 for none
+ * @return
+ *  count, between 0 and CHESS_MAX_EXPECTED and at most limit
+ */
+static int chooseExpectedCount(int count, int limit) {
+    if (count < 0) {
+        return 0;
+    }
+    if (count > CHESS_MAX_EXPECTED) {
+        count = CHESS_MAX_EXPECTED;
+    }
+    return limit > 0 && count > limit ? limit : count;
+}
+
 /*************************************************************/
 /********************* Public Functions *********************/
 /***********************************************************/
 
 ChessSystem chessCreate() {
-    ChessSystem chess_system = malloc(sizeof(*chess_system));
-    if (!chess_system) {
+    return chessCreateWithAllocator(NULL);
+}
+
+ChessSystem chessCreateWithAllocator(const MapAllocator* allocator) {
+    ChessOptions options = {0};
+    options.allocator = allocator;
+    return chessCreateWithOptions(&options);
+}
+
+ChessSystem chessCreateWithOptions(const ChessOptions* options) {
+    //the counts are bounded in a copy, the caller's options stay as given
+    ChessOptions chosen = {0};
+    if (options) {
+        chosen = *options;
+    }
+    chosen.expected_players = chooseExpectedCount(chosen.expected_players, 0);
+    chosen.expected_tournaments = chooseExpectedCount(chosen.expected_tournaments, 0);
+    chosen.expected_games_per_tournament = chooseExpectedCount(chosen.expected_games_per_tournament, 0);
+    //a tournament has no more players than the system, and every game brings at most two new ones
+    int players_limit = chosen.expected_players;
+    int games = chosen.expected_games_per_tournament;
+    if (games > 0 && (players_limit == 0 || 2 * games < players_limit)) {
+        players_limit = 2 * games;
+    }
+    if (chosen.expected_players_per_tournament <= 0) {
+        chosen.expected_players_per_tournament = players_limit;
+    }
+    chosen.expected_players_per_tournament =
+        chooseExpectedCount(chosen.expected_players_per_tournament, players_limit);
+
+    //the player map is made first, so the system's struct can come from its allocator
+    const MapAllocator* allocator = chosen.allocator;
+    Map player_map = playerCreateMapWithCapacity(allocator, chosen.expected_players);
+    if (!player_map) {
         return NULL;
     }
-
-    chess_system->player_map = playerCreateMap();
-    if (!chess_system->player_map) {
-        chessDestroy(chess_system);
+    allocator = mapGetAllocator(player_map);
+    ChessSystem chess_system = allocator->allocate(allocator->context, sizeof(*chess_system));
+    if (!chess_system) {
+        playerDestroyMap(player_map);
         return NULL;
     }
-    chess_system->tournament_map = tournamentCreate();
+    chess_system->allocator = *allocator;
+    chess_system->player_map = player_map;
+    chess_system->expected_games_per_tournament = chosen.expected_games_per_tournament;
+    chess_system->expected_players_per_tournament = chosen.expected_players_per_tournament;
+    chess_system->tournament_map = tournamentCreateWithCapacity(allocator, chosen.expected_tournaments);
     if (!chess_system->tournament_map) {
         chessDestroy(chess_system);
         return NULL;
@@ -239,7 +338,8 @@ void chessDestroy(ChessSystem chess) {
     }
     playerDestroyMap(chess->player_map);
     tournamentDestroy(chess->tournament_map);
-    free(chess);
+    MapAllocator allocator = chess->allocator;
+    allocator.deallocate(allocator.context, chess, sizeof(*chess));
 }
 
 ChessResult chessAddTournament(ChessSystem chess, int tournament_id,
@@ -261,8 +361,9 @@ ChessResult chessAddTournament(ChessSystem chess, int tournament_id,
         return CHESS_INVALID_MAX_GAMES;
     }
 
-    TournamentResult result = tournamentAdd(chess->tournament_map,
-        tournament_id, max_games_per_player, tournament_location);
+    TournamentResult result = tournamentAddWithCapacity(chess->tournament_map,
+        tournament_id, max_games_per_player, tournament_location,
+        chess->expected_games_per_tournament, chess->expected_players_per_tournament);
 
     return chessResultToTournamentResult(result);
 
@@ -270,36 +371,95 @@ ChessResult chessAddTournament(ChessSystem chess, int tournament_id,
 
 ChessResult chessAddGame(ChessSystem chess, int tournament_id, int first_player,
     int second_player, Winner winner, int play_time) {
+    return chessAddGameEx(chess, tournament_id, first_player, second_player, winner, play_time, NULL);
+}
+
+ChessResult chessAddGameEx(ChessSystem chess, int tournament_id, int first_player,
+    int second_player, Winner winner, int play_time, GameHandle* game) {
+    TournamentData tournament_data = NULL;
     ChessResult validity_check = checkValidityForAddGame(chess, tournament_id, first_player, second_player,
-        play_time);
+        play_time, &tournament_data);
     if (validity_check != CHESS_SUCCESS) {
         return validity_check;
     }
-    //no checks from here since all the conditions were already checked
-    Map tournament_map = chess->tournament_map;
-    Map tournament_player_map = tournamentGetPlayerMap(tournament_map, tournament_id);
-    Map tournament_game_map = tournamentGetGameMap(chess->tournament_map, tournament_id);
-
+    //the tournament was found once, and each player map looks every player up once
+    Map tournament_player_map = tournamentDataGetPlayerMap(tournament_data);
+    GameMap tournament_game_map = tournamentDataGetGameMap(tournament_data);
 
     GameResult result = gameAdd(tournament_game_map, play_time, winner, first_player, second_player);
+    if (result == GAME_ALREADY_EXISTS) {
+        return CHESS_GAME_ALREADY_EXISTS;
+    }
     if (result != GAME_SUCCESS) {
         return CHESS_OUT_OF_MEMORY;
     }
+    //the games limit is checked on the tournament's players as they are found or added
     int new_players = 0;
-    new_players += !playerExists(tournament_player_map, first_player);
-    new_players += !playerExists(tournament_player_map, second_player);
-
-    if (addAndUpdatePlayersData(chess->player_map, first_player, second_player, winner, play_time) != CHESS_SUCCESS) {
+    PlayerResult player_result = playerAddDuelResult(tournament_player_map, first_player, second_player, play_time,
+        winner, tournamentDataGetMaxGamesPerPlayer(tournament_data), &new_players);
+    if (player_result != PLAYER_SUCCESS) {
         gameRemove(tournament_game_map, first_player, second_player);
-        return CHESS_OUT_OF_MEMORY;
+        return player_result == PLAYER_EXCEEDED_GAMES ? CHESS_EXCEEDED_GAMES : CHESS_OUT_OF_MEMORY;
     }
-    if (addAndUpdatePlayersData(tournament_player_map, first_player, second_player, winner, play_time)
-        != CHESS_SUCCESS) {
-        playerUpdateDuelResult(chess->player_map, first_player, second_player, play_time, winner, UNDO);
+    if (playerAddDuelResult(chess->player_map, first_player, second_player, play_time, winner, 0, NULL)
+        != PLAYER_SUCCESS) {
+        undoPlayersData(tournament_player_map, first_player, second_player, winner, play_time);
         gameRemove(tournament_game_map, first_player, second_player);
         return CHESS_OUT_OF_MEMORY;
     }
-    tournamentUpdateStatistics(tournament_map, tournament_id, play_time, new_players);
+    tournamentDataUpdateStatistics(tournament_data, play_time, new_players);
+    if (game) {
+        game->tournament_id = tournament_id;
+        game->first_player = first_player;
+        game->second_player = second_player;
+    }
+    return CHESS_SUCCESS;
+}
+
+ChessResult chessUpdateGameResult(ChessSystem chess, GameHandle game, Winner winner, int play_time) {
+    Winner old_winner;
+    int old_play_time;
+    ChessResult validity_check = checkValidityForGameHandle(chess, game, &old_winner, &old_play_time);
+    if (validity_check != CHESS_SUCCESS) {
+        return validity_check;
+    }
+    if (!playTimeIsValid(play_time)) {
+        return CHESS_INVALID_PLAY_TIME;
+    }
+    //the game and both players are found by their keys, and nothing is allocated from here
+    Map tournament_map = chess->tournament_map;
+    Map tournament_player_map = tournamentGetPlayerMap(tournament_map, game.tournament_id);
+    GameMap tournament_game_map = tournamentGetGameMap(tournament_map, game.tournament_id);
+    gameUpdate(tournament_game_map, game.first_player, game.second_player, winner, play_time);
+    Map player_maps[] = { chess->player_map, tournament_player_map };
+    for (int i = 0; i < 2; i++) {
+        playerUpdateDuelResult(player_maps[i], game.first_player, game.second_player, old_play_time, old_winner,
+            UNDO);
+        playerUpdateDuelResult(player_maps[i], game.first_player, game.second_player, play_time, winner, ADD);
+    }
+    tournamentUndoStatistics(tournament_map, game.tournament_id, old_play_time, 0);
+    tournamentUpdateStatistics(tournament_map, game.tournament_id, play_time, 0);
+    return CHESS_SUCCESS;
+}
+
+ChessResult chessRemoveGame(ChessSystem chess, GameHandle game) {
+    Winner winner;
+    int play_time;
+    ChessResult validity_check = checkValidityForGameHandle(chess, game, &winner, &play_time);
+    if (validity_check != CHESS_SUCCESS) {
+        return validity_check;
+    }
+    Map tournament_map = chess->tournament_map;
+    Map tournament_player_map = tournamentGetPlayerMap(tournament_map, game.tournament_id);
+    GameMap tournament_game_map = tournamentGetGameMap(tournament_map, game.tournament_id);
+    if (gameRemove(tournament_game_map, game.first_player, game.second_player) != GAME_SUCCESS) {
+        return CHESS_OUT_OF_MEMORY;
+    }
+    playerUpdateDuelResult(chess->player_map, game.first_player, game.second_player, play_time, winner, UNDO);
+    //the system keeps a player left with no games in the tournament, with its other games
+    int removed_players = undoPlayersData(tournament_player_map, game.first_player, game.second_player, winner,
+        play_time);
+    tournamentUndoStatistics(tournament_map, game.tournament_id, play_time, removed_players);
     return CHESS_SUCCESS;
 }
 
@@ -337,8 +497,8 @@ ChessResult chessRemovePlayer(ChessSystem chess, int player_id) {
 
     ///iterate over all tournaments that have not ended
     /// and remove the player from the map and all games he played in
-    tournamentPlayerRemove(chess->tournament_map, chess->player_map, player_id);
-    return CHESS_SUCCESS;
+    TournamentResult tournament_result = tournamentPlayerRemove(chess->tournament_map, chess->player_map, player_id);
+    return chessResultToTournamentResult(tournament_result);
 }
 
 ChessResult chessEndTournament(ChessSystem chess, int tournament_id) {
@@ -389,7 +549,19 @@ ChessResult chessSavePlayersLevels(ChessSystem chess, FILE* file) {
         return CHESS_NULL_ARGUMENT;
     }
 
-    Map player_map_copy = playerMapCopy(chess->player_map);
+    //the levels are pulled out of a copy living in an arena, which is dropped at once at the end
+    MapArena arena = mapArenaCreate(0);
+    if (!arena) {
+        return CHESS_OUT_OF_MEMORY;
+    }
+    MapAllocator arena_allocator = mapArenaAllocator(arena);
+    Map player_map_copy = playerMapCopyWithAllocator(chess->player_map, &arena_allocator);
+    if (!player_map_copy) {
+        mapArenaDestroy(arena);
+        return CHESS_OUT_OF_MEMORY;
+    }
+    //players without games have no level, dropping them first keeps them out of every search
+    playerRemoveWithoutGames(player_map_copy);
     double max_level = 0;
     PlayerId player_id = playerGetMaxLevelAndId(player_map_copy, &max_level, true);
 
@@ -400,6 +572,7 @@ ChessResult chessSavePlayersLevels(ChessSystem chess, FILE* file) {
         player_id = playerGetMaxLevelAndId(player_map_copy, &max_level, true);
     }
     playerDestroyMap(player_map_copy);
+    mapArenaDestroy(arena);
     return CHESS_SUCCESS;
 }
 
@@ -412,3 +585,71 @@ ChessResult chessSaveTournamentStatistics(ChessSystem chess, char* path_file) {
 
     return chessResultToTournamentResult(result);
 }
+
+ChessResult chessGetMapStats(ChessSystem chess, ChessMapStats* stats) {
+    if (!chess || !stats) {
+        return CHESS_NULL_ARGUMENT;
+    }
+
+    //read first, so that the cursor summing the tournaments' maps is not counted
+    mapGetStats(chess->tournament_map, &stats->tournaments);
+    mapGetStats(chess->player_map, &stats->players);
+    TournamentResult result = tournamentGetMapStats(chess->tournament_map, &stats->tournament_games,
+                                                    &stats->tournament_players);
+    return chessResultToTournamentResult(result);
+}
+
+ChessResult chessResetMapStats(ChessSystem chess) {
+    if (!chess) {
+        return CHESS_NULL_ARGUMENT;
+    }
+
+    TournamentResult result = tournamentResetMapStats(chess->tournament_map);
+    if (result != TOURNAMENT_SUCCESS) {
+        return chessResultToTournamentResult(result);
+    }
+    mapResetStats(chess->player_map);
+    mapResetStats(chess->tournament_map);
+    return CHESS_SUCCESS;
+}
+
+ChessResult chessSaveSystem(ChessSystem chess, FILE* file) {
+    if (!chess || !file) {
+        return CHESS_NULL_ARGUMENT;
+    }
+
+    MapResult result = mapSerializeToFile(chess->player_map, file);
+    if (result == MAP_SUCCESS) {
+        result = mapSerializeToFile(chess->tournament_map, file);
+    }
+    return chessResultToMapResult(result);
+}
+
+ChessSystem chessLoadSystem(FILE* file, ChessResult* chess_result) {
+    ChessResult result = CHESS_NULL_ARGUMENT;
+    ChessSystem chess = NULL;
+    if (file) {
+        chess = chessCreate();
+        result = chess ? CHESS_SUCCESS : CHESS_OUT_OF_MEMORY;
+    }
+    if (chess) {
+        MapResult map_result = mapDeserializeFromFile(chess->player_map, file);
+        if (map_result == MAP_SUCCESS) {
+            map_result = mapDeserializeFromFile(chess->tournament_map, file);
+        }
+        result = chessResultToMapResult(map_result);
+    }
+    //the tournaments were checked while decoded, the players are checked against them
+    if (result == CHESS_SUCCESS) {
+        result = chessResultToTournamentResult(tournamentValidatePlayerStatistics(chess->tournament_map,
+            chess->player_map));
+    }
+    if (result != CHESS_SUCCESS) {
+        chessDestroy(chess);
+        chess = NULL;
+    }
+    if (chess_result) {
+        *chess_result = result;
+    }
+    return chess;
+}
@@ -2,6 +2,7 @@
 #define _CHESSSYSTEM_H
 
 #include <stdio.h>
+#include "map_types.h"
 
 
 
@@ -21,6 +22,7 @@ typedef enum {
     CHESS_NO_TOURNAMENTS_ENDED,
     CHESS_NO_GAMES,
     CHESS_SAVE_FAILURE,
+    CHESS_GAME_NOT_EXIST,
     CHESS_SUCCESS
 } ChessResult ;
 
@@ -33,6 +35,45 @@ typedef enum {
     DRAW
 } Winner;
 
+/**
+    Handle of a game added by chessAddGameEx, for correcting or removing it later.
+    It names the game by its tournament and players, so it stays valid while other games
+    are added and removed, and refers to no game once this one is removed.
+*/
+typedef struct GameHandle_t {
+    int tournament_id;
+    int first_player; // the winner of the game is given as seen by this player
+    int second_player;
+} GameHandle;
+
+/**
+    Counters of the maps of a chess system, per role (see mapGetStats).
+    The maps of all the tournaments are summed together.
+*/
+typedef struct ChessMapStats_t {
+    MapStats players;
+    MapStats tournaments;
+    MapStats tournament_games;
+    MapStats tournament_players;
+} ChessMapStats;
+
+/** The largest expected count a chess system makes room for, see chessCreateWithOptions */
+#define CHESS_MAX_EXPECTED 1000000
+
+/**
+    Settings of a chess system, see chessCreateWithOptions.
+    The expected counts are hints: a system makes room for them up front, so adding up to
+    that many players, tournaments and games grows no hash index or memory pool, and holds
+    any number beyond them just as well. A count left as 0 makes no room ahead.
+*/
+typedef struct ChessOptions_t {
+    const MapAllocator* allocator; // where the system takes its memory from, NULL for malloc
+    int expected_players;
+    int expected_tournaments;
+    int expected_games_per_tournament;
+    int expected_players_per_tournament;
+} ChessOptions;
+
 /** Type for representing a chess system that organizes chess tournaments */
 typedef struct chess_system_t *ChessSystem;
 
@@ -44,6 +85,31 @@ typedef struct chess_system_t *ChessSystem;
  */
 ChessSystem chessCreate();
 
+/**
+ * chessCreateWithAllocator: create an empty chess system taking all the memory of the system
+ * and of its maps from an allocator instead of malloc (see mapCreateWithAllocator).
+ *
+ * @param allocator - the allocator, copied into the system. NULL for malloc.
+ *     Its context must outlive the system.
+ * @return A new chess system in case of success, and NULL otherwise (e.g.
+ *     in case of an allocation error)
+ */
+ChessSystem chessCreateWithAllocator(const MapAllocator* allocator);
+
+/**
+ * chessCreateWithOptions: create an empty chess system sized for the expected counts of
+ * its options.
+ *
+ * @param options - the settings of the system, left unchanged. NULL is the same as calling
+ *     chessCreate. The room made follows the expected counts, bounded: negative counts
+ *     make none, counts above CHESS_MAX_EXPECTED make room for CHESS_MAX_EXPECTED, and
+ *     the players per tournament are at most the players of the system and twice the
+ *     games per tournament, when these are given, and default to that bound otherwise.
+ * @return A new chess system in case of success, and NULL otherwise (e.g.
+ *     in case of an allocation error)
+ */
+ChessSystem chessCreateWithOptions(const ChessOptions* options);
+
 /**
  * chessDestroy: free a chess system, and all its contents, from
  * memory.
@@ -93,13 +159,65 @@ ChessResult chessAddTournament (ChessSystem chess, int tournament_id,
  *     CHESS_TOURNAMENT_ENDED - if the tournament already ended
  *     CHESS_GAME_ALREADY_EXISTS - if there is already a game in the tournament with the same two players
  *                                  (both were not removed).
- *     CHESS_INVALID_PLAY_TIME - if the play time is negative.
+ *     CHESS_INVALID_PLAY_TIME - if the play time is negative or above 2^30 - 1.
  *     CHESS_EXCEEDED_GAMES - if one of the players played the maximum number of games allowed
  *     CHESS_SUCCESS - if game was added successfully.
  */
 ChessResult chessAddGame(ChessSystem chess, int tournament_id, int first_player,
                          int second_player, Winner winner, int play_time);
 
+/**
+ * chessAddGameEx: add a new match to a chess tournament, as chessAddGame, and give a handle to it.
+ *
+ * @param game - pointer to store the handle of the new game in, when it was added. May be NULL.
+ *
+ * @return
+ *     As chessAddGame.
+ */
+ChessResult chessAddGameEx(ChessSystem chess, int tournament_id, int first_player,
+                           int second_player, Winner winner, int play_time, GameHandle* game);
+
+/**
+ * chessUpdateGameResult: corrects the winner and the play time of a game, and the statistics
+ *                        of its players and tournament, without searching the games.
+ *
+ * @param chess - chess system that contains the game. Must be non-NULL.
+ * @param game - the handle of the game, given by chessAddGameEx.
+ * @param winner - the new winner, FIRST_PLAYER being the first player of the handle.
+ * @param play_time - the new play time. Must be non-negative and at most 2^30 - 1.
+ *
+ * @return
+ *     CHESS_NULL_ARGUMENT - if chess is NULL.
+ *     CHESS_INVALID_ID - if the tournament ID number or either of the players is invalid,
+ *                        or both players have the same ID number.
+ *     CHESS_TOURNAMENT_NOT_EXIST - if the tournament does not exist in the system.
+ *     CHESS_TOURNAMENT_ENDED - if the tournament already ended, its winner is then kept.
+ *     CHESS_GAME_NOT_EXIST - if the game was removed.
+ *     CHESS_INVALID_PLAY_TIME - if the play time is negative or above 2^30 - 1.
+ *     CHESS_SUCCESS - if the game was corrected successfully.
+ */
+ChessResult chessUpdateGameResult(ChessSystem chess, GameHandle game, Winner winner, int play_time);
+
+/**
+ * chessRemoveGame: removes a game from its tournament and takes it out of the statistics of its
+ *                  players and tournament, as if it was never played. A player left with no
+ *                  games in the tournament is removed from it.
+ *
+ * @param chess - chess system that contains the game. Must be non-NULL.
+ * @param game - the handle of the game, given by chessAddGameEx.
+ *
+ * @return
+ *     CHESS_NULL_ARGUMENT - if chess is NULL.
+ *     CHESS_INVALID_ID - if the tournament ID number or either of the players is invalid,
+ *                        or both players have the same ID number.
+ *     CHESS_TOURNAMENT_NOT_EXIST - if the tournament does not exist in the system.
+ *     CHESS_TOURNAMENT_ENDED - if the tournament already ended.
+ *     CHESS_GAME_NOT_EXIST - if the game was already removed.
+ *     CHESS_OUT_OF_MEMORY - if an allocation failed, the game is then kept.
+ *     CHESS_SUCCESS - if the game was removed successfully.
+ */
+ChessResult chessRemoveGame(ChessSystem chess, GameHandle game);
+
 /**
  * chessRemoveTournament: removes the tournament and all the games played in it from the chess system
  *                        updates all players statistics (wins, losses, draws, average play time).
@@ -128,6 +246,7 @@ ChessResult chessRemoveTournament (ChessSystem chess, int tournament_id);
  *     CHESS_NULL_ARGUMENT - if chess is NULL.
  *     CHESS_INVALID_ID - if the player ID number is invalid.
  *     CHESS_PLAYER_NOT_EXIST - if the player does not exist in the system.
+ *     CHESS_OUT_OF_MEMORY - if an allocation failed, the player is then kept.
  *     CHESS_SUCCESS - if player was removed successfully.
  */
 ChessResult chessRemovePlayer(ChessSystem chess, int player_id);
@@ -197,4 +316,58 @@ ChessResult chessSavePlayersLevels (ChessSystem chess, FILE* file);
  */
 ChessResult chessSaveTournamentStatistics (ChessSystem chess, char* path_file);
 
+/**
+ * chessSaveSystem: writes the whole contents of a chess system to a file, in a binary
+ * form chessLoadSystem reads back.
+ *
+ * @param chess - a chess system. Must be non-NULL.
+ * @param file - an open, writable binary stream.
+ * @return
+ *     CHESS_NULL_ARGUMENT - if chess or file are NULL.
+ *     CHESS_OUT_OF_MEMORY - if an allocation failed.
+ *     CHESS_SAVE_FAILURE - if an error occurred while writing.
+ *     CHESS_SUCCESS - otherwise.
+ */
+ChessResult chessSaveSystem (ChessSystem chess, FILE* file);
+
+/**
+ * chessLoadSystem: creates a chess system holding the contents written by chessSaveSystem.
+ *
+ * @param file - an open, readable binary stream.
+ * @param chess_result - where the result is stored, may be NULL:
+ *     CHESS_NULL_ARGUMENT - if file is NULL.
+ *     CHESS_OUT_OF_MEMORY - if an allocation failed.
+ *     CHESS_SAVE_FAILURE - if reading failed or the file doesn't hold a saved system, including a
+ *                          saved system whose games, players or tournaments don't add up: a game
+ *                          without its mirrored entry, an invalid id or counter, or player results
+ *                          that are not those of the games.
+ *     CHESS_SUCCESS - otherwise.
+ * @return The new chess system, NULL on failure.
+ */
+ChessSystem chessLoadSystem (FILE* file, ChessResult* chess_result);
+
+/**
+ * chessGetMapStats: reads the operation and cost counters of the maps of a chess system.
+ * The counters are only kept in builds made with -DMAP_STATS, stats->players.enabled tells.
+ *
+ * @param chess - a chess system. Must be non-NULL.
+ * @param stats - where the counters are written. Must be non-NULL.
+ * @return
+ *     CHESS_NULL_ARGUMENT - if chess or stats are NULL.
+ *     CHESS_OUT_OF_MEMORY - if an allocation failed.
+ *     CHESS_SUCCESS - otherwise.
+ */
+ChessResult chessGetMapStats (ChessSystem chess, ChessMapStats* stats);
+
+/**
+ * chessResetMapStats: sets the counters of all the maps of a chess system back to 0.
+ *
+ * @param chess - a chess system. Must be non-NULL.
+ * @return
+ *     CHESS_NULL_ARGUMENT - if chess is NULL.
+ *     CHESS_OUT_OF_MEMORY - if an allocation failed.
+ *     CHESS_SUCCESS - otherwise.
+ */
+ChessResult chessResetMapStats (ChessSystem chess);
+
 #endif //HW1_CHESSSYSTEM_H
@@ -1,21 +1,58 @@
 #include "game_map.h"
+#include "game_pairs.h"
 #include <assert.h>
 #include <stdlib.h>
+#include <limits.h>
+#include <stdint.h>
+#include <string.h>
 
-#define PLAYER_NOT_PARTICIPATES 0
+/*
+ * The key of a game packs two player ids into one 64 bit integer, the smaller id in the
+ * high half and the larger one in the low half. Ids are positive, so the keys are ordered
+ * by the smaller id and then by the larger one, and the map compares them as integers
+ * (MAP_KEY_UINT64) without calling a compare function.
+ *
+ * A game is held once, in the entry of its key, with the result as seen by the player of
+ * the smaller id. The games a player is the smaller id of are adjacent in the map and are
+ * walked by a cursor; the others are found through the player's opponents, which the
+ * pairing index keeps sorted by id. A player's games are thus found in O(log n) each at
+ * worst, without a scan over the games of the tournament.
+ *
+ * The map holds the keys in its entries (MAP_KEY_UINT64), and the result of a game, a play
+ * time and a winner, fits in the entry's data field, where the map keeps it inline
+ * (MapOptions.inlineData). The entries are held by a B+tree (MAP_ENGINE_BPTREE), whose
+ * leaves are arrays of them linked in key order. A tournament's games are thus stored as
+ * contiguous runs of (key, result) records, with no node or block of their own, and are
+ * walked leaf by leaf, and a game is found by a descent of the tree in O(log n).
+ *
+ * Next to the map, the pairing index of the game map keeps the players' local indices
+ * and, once the tournament is dense, a bit per pair of them (see game_pairs.h). Every
+ * game added to or removed from the map is added to or removed from the index, and
+ * the index switches its bit matrix on or off as the density crosses its thresholds.
+ * gameExists then tests a bit instead of descending the map.
+ */
+typedef uint64_t* GameKey;
 
-typedef struct game_key* GameKey;
-
-struct game_key{
-    PlayerId player1_id;
-    PlayerId player2_id;
-};
+/* Packs the ids of a game into its key, the smaller id first, and unpacks them */
+#define GAME_KEY(first_player, second_player) \
+    (((uint64_t)(uint32_t)(first_player) << 32) | (uint32_t)(second_player))
+#define GAME_PAIR_KEY(player1, player2) \
+    ((player1) < (player2) ? GAME_KEY(player1, player2) : GAME_KEY(player2, player1))
+#define GAME_KEY_FIRST(game_key) ((PlayerId)((game_key) >> 32))
+#define GAME_KEY_SECOND(game_key) ((PlayerId)((game_key) & UINT32_MAX))
 
+/* The result of a game. Inline in an entry it lives in the bytes of a MapDataElement field,
+ * so it is only copied in and out with memcpy (see gameDataLoad), never accessed in place */
 struct game_data{
     int play_time;
     Winner winner;
 };
 
+struct game_map_t{
+    Map games; // one entry per game, see above
+    GamePairs pairs;
+};
+
 /***************************************************************/
 /********************* static functions *********************/
 /* documentaion below */
@@ -23,15 +60,21 @@ static void freeGameData(MapDataElement game_data);
 static void freeGameKey(MapKeyElement game_key);
 static MapDataElement copyGameData(MapDataElement game_data);
 static MapKeyElement copyGameKey(MapKeyElement game_key);
-static int compareGameKey(MapKeyElement game1_key, MapKeyElement game2_key);
 
-static GameKey createGameKey(PlayerId player1_id, PlayerId player2_id);
+static GameKey createGameKey(uint64_t key);
 static GameData createGameData(int play_time, Winner winner);
 static bool playerIdIsValid(PlayerId player_id);
-static bool reorderPlayers(PlayerId* id1, PlayerId* id2);
 static Winner switchWinner(Winner winner);
-static PlayerId playerParticipatesInGame(GameKey game_key, PlayerId player_id);
-static Winner playerGameResult(GameKey game_key, GameData game_data, PlayerId first_player);
+static struct game_data gameDataLoad(MapDataElement data);
+static void gameDataStore(MapDataElement data, struct game_data game_data);
+static GameResult gameForEachInRange(GameMap game_map, PlayerId player_id, PlayerId from_opponent,
+                                     gameVisitFunction visit, void* context);
+static bool gameUnlink(GameMap game_map, PlayerId first_player, PlayerId second_player);
+static bool gameLoad(GameMap game_map, PlayerId player_id, PlayerId opponent, struct game_data* game_data);
+static GameMap gameMapCreateFrom(Map games, GamePairs pairs);
+static bool gameEntriesAreValid(GameMap game_map);
+static bool gameIndexPairs(GameMap game_map);
+static void gameUpdateDensity(GameMap game_map);
 
 
 
@@ -90,54 +133,28 @@ static MapKeyElement copyGameKey(MapKeyElement game_key){
     if (!game_key){
         return NULL;
     }
-    GameKey key_copy = createGameKey(((GameKey)game_key)->player1_id,
-                                     ((GameKey)game_key)->player2_id);
+    GameKey key_copy = createGameKey(*(GameKey)game_key);
     if (!key_copy){
         return NULL;
     }
     
     return key_copy;
 }
-/**
-    * compareGameKey: identifies equal key elements.
-    *
-    *@param game1_key - first key to be compared.
-    *@param game2_key - second key to be compared.
-    *
-    * @return-
-    * 		A positive integer if the first key is greater;
-    * 		0 if they're equal;
-    *		A negative integer if the second key is greater.
-*/
-static int compareGameKey(MapKeyElement game1_key, MapKeyElement game2_key){
-    assert(game1_key && game2_key);
-    
-    if (((GameKey)game1_key)->player1_id == ((GameKey)game2_key)->player1_id){
-        if (((GameKey)game1_key)->player2_id == ((GameKey)game2_key)->player2_id){
-            return 0;
-        }
-        return (((GameKey)game1_key)->player2_id - ((GameKey)game2_key)->player2_id);
-    }
-    return (((GameKey)game1_key)->player1_id - ((GameKey)game2_key)->player1_id);
-}
 /**
 * createGameKey: Allocates a new key.
 *
-* @param player1_id1 - the first Player's id to be set in the key.
-* @param player1_id2 - the second Player's id to be set in the key.
+* @param key - the packed ids to be set in the key.
 *
 * @return
 * 	NULL - if allocations failed.
 * 	A new GameKey in case of success.
 */
-static GameKey createGameKey(PlayerId player1_id, PlayerId player2_id){
-    reorderPlayers(&player1_id, &player2_id);
+static GameKey createGameKey(uint64_t key){
     GameKey game_key = malloc(sizeof(*game_key));
     if (!game_key){
         return NULL;
     }
-    game_key->player1_id = player1_id;
-    game_key->player2_id = player2_id;
+    *game_key = key;
     return game_key;
 }
 /**
@@ -176,28 +193,6 @@ static bool playerIdIsValid(PlayerId player_id){
     }
     return false;
 }
-/**
-    * reorderPlayers: reorder two players.
-                     given valid id's and play_time pointers, the id's will be reordered
-                     such that id1 < id2 and winner will be set accordingly
-    *
-    * @param id1 - a pointer to store the id2 in- must not be NULL.
-    * @param id2 - a pointer to store the id1 in- must not be NULL.
-    *
-    * @return
-    * 	true - if the exchanging values succeeds.
-    *  false - if the given id's were already in the correct order.
-*/
-static bool reorderPlayers(PlayerId* id1, PlayerId* id2){
-    if (*id1 > *id2){
-        PlayerId tmp = *id1;
-        *id1 = *id2;
-        *id2 = tmp;
-        
-        return true;
-    }
-    return false;
-}
 /**
     * switchWinner: switches the winner.
     *
@@ -213,58 +208,273 @@ static Winner switchWinner(Winner winner){
     return DRAW;
 }
 /**
-    * playerParticipatesInGame: returns the second player id.
+    * gameDataLoad: reads the result of a game held by the map.
     *
-    * @param game_key - The game_key to look into- must not be NULL.
-    * @param player_id - the first player id.
+    * @param data - the data as returned by the map, pointing into an entry.
     *
     * @return
-    *   0 - if the player_id does not exist in game_key.
-    * 	PlayerId - the id if the second player in game_key otherwise.
-*
+    * 	A copy of the result.
+*/
+static struct game_data gameDataLoad(MapDataElement data){
+    struct game_data game_data;
+    memcpy(&game_data, data, sizeof(game_data));
+    return game_data;
+}
+/**
+    * gameDataStore: overwrites the result of a game held by the map.
+    *
+    * @param data - the data as returned by the map, pointing into an entry.
+    * @param game_data - the new result.
 */
-static PlayerId playerParticipatesInGame(GameKey game_key, PlayerId player_id){
-    assert(game_key);
-    if (game_key->player1_id == player_id){
-        return game_key->player2_id;
+static void gameDataStore(MapDataElement data, struct game_data game_data){
+    memcpy(data, &game_data, sizeof(game_data));
+}
+
+/**
+    * gameForEachInRange: calls a function for the games of a player against opponents
+    * from a given id on, in ascending order of the opponent's id. The games against
+    * smaller ids are looked up one by one, those against larger ids are walked in the map.
+    *
+    * @param game_map - the games map to look into.
+    * @param player_id - the player's id.
+    * @param from_opponent - the smallest opponent id visited.
+    * @param visit - called for every game, see gameForEachOfPlayer.
+    * @param context - passed as is to visit.
+    *
+    * @return
+    * 	GAME_OUT_OF_MEMORY - if creating the cursor failed, no game was visited.
+    * 	GAME_SUCCESS - otherwise.
+*/
+static GameResult gameForEachInRange(GameMap game_map, PlayerId player_id, PlayerId from_opponent,
+                                     gameVisitFunction visit, void* context){
+    //the entries keyed by the player first hold its games against larger ids, between these two keys
+    MapCursor cursor = NULL;
+    if (player_id < INT_MAX){
+        uint64_t from_key = GAME_KEY(player_id, from_opponent > player_id ? from_opponent : player_id + 1);
+        uint64_t to_key = GAME_KEY(player_id, INT_MAX);
+        cursor = mapCursorCreateRange(game_map->games, &from_key, &to_key);
+        if (!cursor){
+            return GAME_OUT_OF_MEMORY;
+        }
+    }
+    int count = 0;
+    const PlayerId* opponents = pairsGetOpponents(game_map->pairs, player_id, &count);
+    for (int i = 0; i < count && opponents[i] < player_id; i++){
+        struct game_data game_data;
+        if (opponents[i] >= from_opponent && gameLoad(game_map, player_id, opponents[i], &game_data)){
+            visit(opponents[i], game_data.winner, game_data.play_time, context);
+        }
     }
-    if (game_key->player2_id == player_id){
-        return game_key->player1_id;
+    while (cursor && mapCursorNext(cursor)){
+        GameKey game_key = mapCursorGetKey(cursor);
+        struct game_data game_data = gameDataLoad(mapCursorGetData(cursor));
+        visit(GAME_KEY_SECOND(*game_key), game_data.winner, game_data.play_time, context);
     }
-    return PLAYER_NOT_PARTICIPATES;
+    mapCursorDestroy(cursor);
+    return GAME_SUCCESS;
 }
+
 /**
-    * playerGameResult: returns the winner.
+    * gameLoad: reads the game of two players.
     *
-    * @param game_key - The game_key to look into.
-    * @param game_data - the game_data to get it's winner from.
-    * @param first_player - the first player id.
+    * @param game_map - the games map to look into.
+    * @param player_id - the id of one player of the game.
+    * @param opponent - the id of the other player.
+    * @param game_data - pointer to store the game's data in, as seen by player_id.
     *
     * @return
-    * 	Winner - the winner.
-    *
+    * 	false - if the players didn't play each other.
+    * 	true - otherwise.
 */
-static Winner playerGameResult(GameKey game_key, GameData game_data, PlayerId first_player){
-    assert(!game_key || !game_data);
-    if (first_player == game_key->player2_id){
+static bool gameLoad(GameMap game_map, PlayerId player_id, PlayerId opponent, struct game_data* game_data){
+    uint64_t game_key = GAME_PAIR_KEY(player_id, opponent);
+    MapDataElement data = mapGet(game_map->games, &game_key);
+    if (!data){
+        return false;
+    }
+    *game_data = gameDataLoad(data);
+    if (player_id > opponent){
         game_data->winner = switchWinner(game_data->winner);
     }
-    return game_data->winner;
+    return true;
+}
+
+/**
+    * gameUnlink: removes the entry of a game.
+    *
+    * @param game_map - the games map to remove from.
+    * @param first_player - the id of one player of the game.
+    * @param second_player - the id of the other player.
+    *
+    * @return
+    * 	false - if the map shares games with a snapshot and copying one failed, the game
+    * 	        is then still in the map.
+    * 	true - otherwise, also if there is no such game.
+*/
+static bool gameUnlink(GameMap game_map, PlayerId first_player, PlayerId second_player){
+    uint64_t game_key = GAME_PAIR_KEY(first_player, second_player);
+    MapResult result = mapRemove(game_map->games, &game_key);
+    if (result == MAP_ITEM_DOES_NOT_EXIST){
+        return true;
+    }
+    if (result != MAP_SUCCESS){
+        return false;
+    }
+    pairsRemove(game_map->pairs, first_player, second_player);
+    gameUpdateDensity(game_map);
+    return true;
+}
+
+/**
+    * gameMapCreateFrom: makes a game map out of its map and its pairing index.
+    *
+    * @param games - the map holding the games, taken over by the game map.
+    * @param pairs - the pairing index of the games, taken over by the game map.
+    *
+    * @return
+    * 	NULL - if one of the parameters is NULL or allocation failed, games and pairs
+    * 	       are then destroyed.
+    * 	A new GameMap in case of success.
+*/
+static GameMap gameMapCreateFrom(Map games, GamePairs pairs){
+    GameMap game_map = NULL;
+    if (games && pairs){
+        const MapAllocator* allocator = mapGetAllocator(games);
+        game_map = allocator->allocate(allocator->context, sizeof(*game_map));
+    }
+    if (!game_map){
+        pairsDestroy(pairs);
+        mapDestroy(games);
+        return NULL;
+    }
+    game_map->games = games;
+    game_map->pairs = pairs;
+    return game_map;
+}
+
+/**
+    * gameEntriesAreValid: checks the entries of a decoded game map: both ids of every entry
+    * are positive, the first is the smaller, its play time is not negative and its winner
+    * is one of the three.
+    *
+    * @param game_map - the game map.
+    *
+    * @return
+    * 	false - if an entry is not valid.
+    * 	true - otherwise.
+*/
+static bool gameEntriesAreValid(GameMap game_map){
+    MapCursor cursor = mapCursorCreate(game_map->games);
+    if (!cursor){
+        return false;
+    }
+    bool valid = true;
+    while (valid && mapCursorNext(cursor)){
+        uint64_t game_key = *(GameKey)mapCursorGetKey(cursor);
+        PlayerId first_player = GAME_KEY_FIRST(game_key), second_player = GAME_KEY_SECOND(game_key);
+        struct game_data game_data = gameDataLoad(mapCursorGetData(cursor));
+        valid = first_player > 0 && first_player < second_player &&
+                playTimeIsValid(game_data.play_time) && (game_data.winner == FIRST_PLAYER || game_data.winner == SECOND_PLAYER ||
+                 game_data.winner == DRAW);
+    }
+    mapCursorDestroy(cursor);
+    return valid;
+}
+
+/**
+    * gameIndexPairs: records all the games of a game map in its empty pairing index.
+    *
+    * @param game_map - the game map.
+    *
+    * @return
+    * 	false - if an allocation failed, the index is then empty.
+    * 	true - otherwise.
+*/
+static bool gameIndexPairs(GameMap game_map){
+    MapCursor cursor = mapCursorCreate(game_map->games);
+    if (!cursor){
+        return false;
+    }
+    bool indexed = true;
+    while (indexed && mapCursorNext(cursor)){
+        uint64_t game_key = *(GameKey)mapCursorGetKey(cursor);
+        indexed = pairsAdd(game_map->pairs, GAME_KEY_FIRST(game_key), GAME_KEY_SECOND(game_key));
+    }
+    mapCursorDestroy(cursor);
+    if (!indexed){
+        pairsClear(game_map->pairs);
+        return false;
+    }
+    gameUpdateDensity(game_map);
+    return true;
+}
+
+/**
+    * gameUpdateDensity: switches the bit matrix of a game map's pairing index on or off
+    * if the density of the games crossed its threshold. Making the index dense sets the
+    * bits of all the games, in O(n) once. If that fails the index stays sparse, and is
+    * made dense by a later change.
+    *
+    * @param game_map - the game map.
+*/
+static void gameUpdateDensity(GameMap game_map){
+    GamePairs pairs = game_map->pairs;
+    if (!pairsShouldSwitch(pairs)){
+        return;
+    }
+    if (pairsIsDense(pairs)){
+        pairsMakeSparse(pairs);
+        return;
+    }
+    MapCursor cursor = mapCursorCreate(game_map->games);
+    if (!cursor || !pairsMakeDense(pairs)){
+        mapCursorDestroy(cursor);
+        return;
+    }
+    while (mapCursorNext(cursor)){
+        uint64_t game_key = *(GameKey)mapCursorGetKey(cursor);
+        pairsSetPlayed(pairs, GAME_KEY_FIRST(game_key), GAME_KEY_SECOND(game_key));
+    }
+    mapCursorDestroy(cursor);
 }
 
 /********************* Public functions *********************/
 
-Map gameCreateMap(){
-    return mapCreate(copyGameData, copyGameKey, freeGameData, freeGameKey, compareGameKey);
+GameMap gameCreateMap(){
+    return gameCreateMapWithAllocator(NULL);
+}
+
+GameMap gameCreateMapWithAllocator(const MapAllocator* allocator){
+    return gameCreateMapWithCapacity(allocator, 0);
 }
 
-void gameDestroyMap(Map game_map){
-    mapDestroy(game_map);
+GameMap gameCreateMapWithCapacity(const MapAllocator* allocator, int capacity){
+    MapOptions options = {0};
+    options.capacity = capacity;
+    options.engine = MAP_ENGINE_BPTREE;
+    //keys and data are plain values saved as they are, in the entries themselves
+    options.keyType = MAP_KEY_UINT64;
+    options.dataSize = sizeof(struct game_data);
+    options.inlineData = sizeof(struct game_data) <= sizeof(MapDataElement);
+    Map games = mapCreateWithAllocator(copyGameData, copyGameKey, freeGameData, freeGameKey, NULL, &options,
+                                       allocator);
+    return gameMapCreateFrom(games, games ? pairsCreate(mapGetAllocator(games)) : NULL);
 }
 
-Map gameMapCopy(Map game_map) {
+void gameDestroyMap(GameMap game_map){
+    if (!game_map){
+        return;
+    }
+    MapAllocator allocator = *mapGetAllocator(game_map->games);
+    pairsDestroy(game_map->pairs);
+    mapDestroy(game_map->games);
+    allocator.deallocate(allocator.context, game_map, sizeof(*game_map));
+}
+
+GameMap gameMapCopy(GameMap game_map) {
     assert(game_map);
-    return mapCopy(game_map);
+    Map games = mapCopy(game_map->games);
+    return gameMapCreateFrom(games, games ? pairsCopy(game_map->pairs) : NULL);
 }
 
 bool playTimeIsValid(int play_time){
@@ -274,21 +484,19 @@ bool playTimeIsValid(int play_time){
     return false;
 }
 
-bool gameExists(Map game_map, PlayerId player1_id, PlayerId player2_id){
+bool gameExists(GameMap game_map, PlayerId player1_id, PlayerId player2_id){
     assert(game_map);
     if (!playerIdIsValid(player1_id) || !playerIdIsValid(player2_id)){
         return false;
     }
-    GameKey game_key = createGameKey(player1_id, player2_id);
-    if (!game_key || !mapContains(game_map, game_key)){
-        freeGameKey(game_key);
-        return false;
+    if (pairsIsDense(game_map->pairs)){
+        return pairsContains(game_map->pairs, player1_id, player2_id);
     }
-    freeGameKey(game_key);
-    return true;
+    uint64_t game_key = GAME_PAIR_KEY(player1_id, player2_id);
+    return mapContains(game_map->games, &game_key);
 }
 
-GameResult gameAdd(Map game_map, int play_time, Winner winner,
+GameResult gameAdd(GameMap game_map, int play_time, Winner winner,
                    PlayerId player1_id, PlayerId player2_id){
     if (!game_map){
         return GAME_NULL_ARGUMENT;
@@ -297,87 +505,190 @@ GameResult gameAdd(Map game_map, int play_time, Winner winner,
         player1_id == player2_id){
         return GAME_INVALID_ID;
     }
-    if (gameExists(game_map, player1_id, player2_id)){
-        return GAME_ALREADY_EXISTS;
-    }
     if (!playTimeIsValid(play_time)){
-        return GAME_INVALID_PLAY_TIME;
+        //an existing game is reported first
+        return gameExists(game_map, player1_id, player2_id) ? GAME_ALREADY_EXISTS : GAME_INVALID_PLAY_TIME;
     }
-    if (reorderPlayers(&player1_id, &player2_id)){
-        winner = switchWinner(winner);
+    //a dense pairing index turns an existing game down without a lookup in the map
+    if (pairsIsDense(game_map->pairs) && pairsContains(game_map->pairs, player1_id, player2_id)){
+        return GAME_ALREADY_EXISTS;
     }
-    GameKey game_key = createGameKey(player1_id, player2_id);
-    if (!game_key){
+    //key and data are copied into the map only if the game is new, found in the same lookup
+    uint64_t game_key = GAME_PAIR_KEY(player1_id, player2_id);
+    struct game_data game_data = { play_time, player1_id < player2_id ? winner : switchWinner(winner) };
+    bool inserted = false;
+    if (!mapGetOrInsert(game_map->games, &game_key, &game_data, &inserted)){
         return GAME_OUT_OF_MEMORY;
     }
-    GameData game_data = createGameData(play_time, winner);
-    if (!game_data){
-        freeGameKey(game_key);
-        return GAME_OUT_OF_MEMORY;
+    if (!inserted){
+        return GAME_ALREADY_EXISTS;
     }
-    
-    if (mapPut(game_map, game_key, game_data) != MAP_SUCCESS){
-        freeGameKey(game_key);
-        freeGameData(game_data);
+    if (!pairsAdd(game_map->pairs, player1_id, player2_id)){
+        //the entry was just put in the map, which shares it with no snapshot, so removing it allocates nothing
+        MapResult result = mapRemove(game_map->games, &game_key);
+        assert(result == MAP_SUCCESS);
+        (void)result;
         return GAME_OUT_OF_MEMORY;
     }
-    freeGameKey(game_key);
-    freeGameData(game_data);
+    gameUpdateDensity(game_map);
     return GAME_SUCCESS;
 }
 
-GameResult gameRemove(Map game_map, PlayerId player1_id, PlayerId player2_id){
+GameResult gameRemove(GameMap game_map, PlayerId player1_id, PlayerId player2_id){
     if (!playerIdIsValid(player1_id) || !playerIdIsValid(player2_id) ||
         player1_id == player2_id){
         return GAME_INVALID_ID;
     }
-    GameKey game_key = createGameKey(player1_id, player2_id);
-    if (!game_key){
-        return GAME_OUT_OF_MEMORY;
+    // a missing game is a success as well
+    return gameUnlink(game_map, player1_id, player2_id) ? GAME_SUCCESS : GAME_OUT_OF_MEMORY;
+}
+
+bool gameGet(GameMap game_map, PlayerId player1_id, PlayerId player2_id, Winner* winner, int* play_time){
+    assert(game_map && winner && play_time);
+    if (!playerIdIsValid(player1_id) || !playerIdIsValid(player2_id)){
+        return false;
     }
-    
-    // game_map and game_key != NULL
-    // so mapRemove will return NOT_EXIST or SUCCESS
-    // we should return SUCCESS in both cases
-    mapRemove(game_map, game_key);
-    freeGameKey(game_key);
-    return GAME_SUCCESS;
+    struct game_data result;
+    if (!gameLoad(game_map, player1_id, player2_id, &result)){
+        return false;
+    }
+    *winner = result.winner;
+    *play_time = result.play_time;
+    return true;
+}
+
+bool gameUpdate(GameMap game_map, PlayerId player1_id, PlayerId player2_id, Winner winner, int play_time){
+    assert(game_map && playTimeIsValid(play_time));
+    if (!playerIdIsValid(player1_id) || !playerIdIsValid(player2_id)){
+        return false;
+    }
+    //game maps share no entries with their snapshots, so the entry is written where it is
+    uint64_t game_key = GAME_PAIR_KEY(player1_id, player2_id);
+    MapDataElement game_data = mapGet(game_map->games, &game_key);
+    if (!game_data){
+        return false;
+    }
+    struct game_data result = { play_time, player1_id < player2_id ? winner : switchWinner(winner) };
+    gameDataStore(game_data, result);
+    return true;
 }
 
-bool gameGetDataByPlayerId(Map game_map, PlayerId first_player, PlayerId* second_player,
+bool gameGetDataByPlayerId(GameMap game_map, PlayerId first_player, PlayerId* second_player,
                                  int* winner, int* play_time, bool remove){
     assert(game_map);
     
-    MAP_FOREACH(GameKey, game_key, game_map){
-        *second_player = playerParticipatesInGame(game_key, first_player);
-        if (*second_player != PLAYER_NOT_PARTICIPATES){
-            GameData game_data = mapGet(game_map, game_key);
-            assert(game_data);
-            if (!game_data){
-                freeGameKey(game_key);
-                continue;
-            }
-            *winner = playerGameResult(game_key, game_data, first_player);
-            *play_time = game_data->play_time;
-            
-            if (remove){
-                gameRemove(game_map, game_key->player1_id, game_key->player2_id);
-            }
-            freeGameKey(game_key);
-            return true;
+    int count = 0;
+    const PlayerId* opponents = pairsGetOpponents(game_map->pairs, first_player, &count);
+    struct game_data game_data;
+    if (count == 0 || !gameLoad(game_map, first_player, opponents[0], &game_data)){
+        return false;
+    }
+    *second_player = opponents[0];
+    *winner = game_data.winner;
+    *play_time = game_data.play_time;
+    return !remove || gameUnlink(game_map, first_player, *second_player);
+}
+
+GameResult gameRemovePlayerParticipated(GameMap game_map, PlayerId player_id, gameRemovedFunction on_removed,
+                                        void* context){
+    assert(game_map);
+    
+    //the player's games are taken from its last opponent back, each one removed on its own
+    //and forgotten by the pairing index, so a failure leaves the remaining games whole
+    GameResult result = GAME_SUCCESS;
+    int count = 0;
+    const PlayerId* opponents = pairsGetOpponents(game_map->pairs, player_id, &count);
+    while (count > 0){
+        PlayerId second_player = opponents[count - 1];
+        struct game_data game_data;
+        bool found = gameLoad(game_map, player_id, second_player, &game_data);
+        assert(found);
+        (void)found;
+        uint64_t game_key = GAME_PAIR_KEY(player_id, second_player);
+        if (mapRemove(game_map->games, &game_key) != MAP_SUCCESS){
+            result = GAME_OUT_OF_MEMORY;
+            break;
         }
-        freeGameKey(game_key);
+        pairsRemove(game_map->pairs, player_id, second_player);
+        if (on_removed){
+            on_removed(second_player, game_data.winner, game_data.play_time, context);
+        }
+        opponents = pairsGetOpponents(game_map->pairs, player_id, &count);
     }
-    return false;
+    gameUpdateDensity(game_map);
+    return result;
 }
 
-int gameGetNumOfGames(Map game_map){
+int gameGetNumOfGames(GameMap game_map){
     if (!game_map){
         return 0;
     }
-    return mapGetSize(game_map);
+    return mapGetSize(game_map->games);
+}
+
+int gameGetNumOfGamesOfPlayer(GameMap game_map, PlayerId player_id){
+    assert(game_map);
+    return pairsGetNumOfGames(game_map->pairs, player_id);
+}
+
+int gameGetLongestPlayTime(GameMap game_map){
+    assert(game_map);
+    MapCursor cursor = mapCursorCreate(game_map->games);
+    if (!cursor){
+        return 0;
+    }
+    int longest = 0;
+    while (mapCursorNext(cursor)){
+        struct game_data game_data = gameDataLoad(mapCursorGetData(cursor));
+        if (game_data.play_time > longest){
+            longest = game_data.play_time;
+        }
+    }
+    mapCursorDestroy(cursor);
+    return longest;
 }
 
+GameResult gameForEachAsFirstPlayer(GameMap game_map, PlayerId player_id, gameVisitFunction visit, void* context){
+    assert(game_map && visit);
+    if (player_id == INT_MAX){
+        return GAME_SUCCESS;//no opponent has a larger id
+    }
+    return gameForEachInRange(game_map, player_id, player_id + 1, visit, context);
+}
 
+GameResult gameForEachOfPlayer(GameMap game_map, PlayerId player_id, gameVisitFunction visit, void* context){
+    assert(game_map && visit);
+    return gameForEachInRange(game_map, player_id, 1, visit, context);
+}
 
+MapResult gameMapSerialize(GameMap game_map, unsigned char* buffer, size_t size, size_t* length){
+    assert(game_map);
+    return mapSerialize(game_map->games, buffer, size, length);
+}
 
+MapResult gameMapDeserialize(GameMap game_map, const unsigned char* buffer, size_t size, size_t* length){
+    assert(game_map);
+    MapResult result = mapDeserialize(game_map->games, buffer, size, length);
+    if (result != MAP_SUCCESS){
+        return result;
+    }
+    if (!gameEntriesAreValid(game_map)){
+        mapClear(game_map->games);
+        return MAP_ERROR;
+    }
+    if (!gameIndexPairs(game_map)){
+        mapClear(game_map->games);
+        return MAP_OUT_OF_MEMORY;
+    }
+    return MAP_SUCCESS;
+}
+
+MapResult gameMapGetStats(GameMap game_map, MapStats* stats){
+    assert(game_map);
+    return mapGetStats(game_map->games, stats);
+}
+
+void gameMapResetStats(GameMap game_map){
+    assert(game_map);
+    mapResetStats(game_map->games);
+}
@@ -45,14 +45,42 @@ typedef int PlayerId;
 /** Data element data type for game map container */
 typedef struct game_data* GameData;
 
+/**
+* Type for defining the game map of a tournament: its games, kept in a Map, and the
+* pairing index telling which players played each other (see game_pairs.h).
+*/
+typedef struct game_map_t* GameMap;
+
 /**
 * gameCreateMap: Allocates a new empty game map.
 *
 * @return
 * 	NULL - if one of the parameters is NULL or allocations failed.
-* 	A new Map in case of success.
+* 	A new GameMap in case of success.
+*/
+GameMap gameCreateMap();
+/**
+* gameCreateMapWithAllocator: Allocates a new empty game map taking its memory from
+* an allocator (see mapCreateWithAllocator).
+*
+* @param allocator - the allocator, NULL for malloc.
+* @return
+* 	NULL - if allocations failed.
+* 	A new GameMap in case of success.
+*/
+GameMap gameCreateMapWithAllocator(const MapAllocator* allocator);
+/**
+* gameCreateMapWithCapacity: Allocates a new empty game map taking its memory from
+* an allocator, with room for a number of games (see mapReserve). Every game takes
+* one entry of the map.
+*
+* @param allocator - the allocator, NULL for malloc.
+* @param capacity - the number of games the map is expected to hold, 0 for none.
+* @return
+* 	NULL - if allocations failed.
+* 	A new GameMap in case of success.
 */
-Map gameCreateMap();
+GameMap gameCreateMapWithCapacity(const MapAllocator* allocator, int capacity);
 /**
 * playerDestroyMap: Deallocates an existing game map. Clears all elements by using the
 * stored free functions.
@@ -60,7 +88,7 @@ Map gameCreateMap();
 * @param game_map - Target game_map to be deallocated. If game_map is NULL nothing will be
 * 		done
 */
-void gameDestroyMap(Map game_map);
+void gameDestroyMap(GameMap game_map);
 /**
 * gameMapCopy: Creates a copy of game_map.
 * Iterator values for both game_map is undefined after this operation.
@@ -68,11 +96,12 @@ void gameDestroyMap(Map game_map);
 * @param game_map - Target game_map - Must not be NULL
 * @return
 * 	NULL if a NULL was sent or a memory allocation failed.
-* 	A Map containing the same elements as game_map otherwise.
+* 	A GameMap containing the same games as game_map otherwise.
 */
-Map gameMapCopy(Map game_map);
+GameMap gameMapCopy(GameMap game_map);
 /**
-* gameExists: checks if a game exists in a given games map.
+* gameExists: checks if a game exists in a given games map: in O(1) by a bit test
+* once most pairs of the tournament's players played, in O(log n) by the map otherwise.
 *
 * @param game_map -  the games map to search in- must not be NULL.
 * @param player1_id -  the first player id associated with the first player- must be valid.
@@ -81,13 +110,13 @@ Map gameMapCopy(Map game_map);
 * 	true - if a game exist in the game_map.
 * 	false - if not or if allocation fails.
 */
-bool gameExists(Map game_map, PlayerId player1_id, PlayerId player2_id);
+bool gameExists(GameMap game_map, PlayerId player1_id, PlayerId player2_id);
 /**
 * playTimeIsValid: checks if a given play time is valid.
 *
 * @param play_time -  the play time.
 * @return
-* 	true - if play_time>=0.
+* 	true - if play_time is non-negative.
 * 	false - otherwise.
 */
 bool playTimeIsValid(int play_time);
@@ -108,7 +137,7 @@ bool playTimeIsValid(int play_time);
  *      GAME_OUT_OF_MEMORY - allocation failed
  *      GAME_SUCCESS - otherwise
  */
-GameResult gameAdd(Map game_map, int play_time, Winner winner,
+GameResult gameAdd(GameMap game_map, int play_time, Winner winner,
                    PlayerId player1_id, PlayerId player2_id);
 /**
  * gameRemove: removes a game from a given game map.
@@ -119,21 +148,74 @@ GameResult gameAdd(Map game_map, int play_time, Winner winner,
  * @return GameResult
  *      GAME_INVALID_ID - one of the players id is invalid, or the same id was given
  *                        for both players.
- *      GAME_OUT_OF_MEMORY - if key allocation failed.
- *      GAME_SUCCESS - otherwise
+ *      GAME_OUT_OF_MEMORY - if the map shares games with a snapshot and copying one failed,
+ *                           the game is then still in the map.
+ *      GAME_SUCCESS - otherwise, also if there is no such game.
+ */
+GameResult gameRemove(GameMap game_map, PlayerId player1_id, PlayerId player2_id);
+/**
+ * gameGet: finds the game of two players.
+ *
+ * @param game_map - the games map to look into - must not be NULL.
+ * @param player1_id - the first player's id.
+ * @param player2_id - the second player's id.
+ * @param winner - pointer to store the winner in, FIRST_PLAYER being player1_id.
+ * @param play_time - pointer to store the play time in.
+ * @return
+ *      false - if the players didn't play each other.
+ *      true - otherwise.
+ */
+bool gameGet(GameMap game_map, PlayerId player1_id, PlayerId player2_id, Winner* winner, int* play_time);
+/**
+ * gameUpdate: sets the winner and the play time of an existing game, in place.
+ *
+ * @param game_map - the games map to update - must not be NULL.
+ * @param player1_id - the first player's id.
+ * @param player2_id - the second player's id.
+ * @param winner - the new winner, FIRST_PLAYER being player1_id.
+ * @param play_time - the new play time, valid (see playTimeIsValid).
+ * @return
+ *      false - if the players didn't play each other, nothing is then changed.
+ *      true - otherwise.
  */
-GameResult gameRemove(Map game_map, PlayerId player1_id, PlayerId player2_id);
+bool gameUpdate(GameMap game_map, PlayerId player1_id, PlayerId player2_id, Winner winner, int play_time);
+/**
+ * gameGetDataByPlayerId: finds the game of a player against the opponent with the smallest id,
+ * in O(log n). The player's opponents are kept sorted, so the opponent is known in O(1).
+ *
+ * @param game_map - the games map to look into - must not be NULL.
+ * @param first_player - the player's id.
+ * @param second_player - pointer to store the opponent's id in.
+ * @param winner - pointer to store the winner in, FIRST_PLAYER being first_player.
+ * @param play_time - pointer to store the play time in.
+ * @param remove - if true the game is removed from the map.
+ * @return
+ *      false - if the player has no games, or an allocation or the removal failed.
+ *      true - otherwise.
+ */
+bool gameGetDataByPlayerId(GameMap game_map, PlayerId first_player, PlayerId* second_player,
+                           int* winner, int* play_time, bool remove);
+
+/** Type of function called by gameRemovePlayerParticipated for every removed game */
+typedef void (*gameRemovedFunction)(PlayerId second_player, Winner winner, int play_time, void* context);
+
 /**
- * gameRemovePlayerParticipated: remove all games that a player participates in.
+ * gameRemovePlayerParticipated: remove all games that a player participates in,
+ * in O(log n) per removed game. The player's games are found through its opponents,
+ * and the other games are not visited.
  *
  * @param game_map - the games map to remove from - must not be NULL.
  * @param player_id - the player's id that is asscoiated with all games to remove from the map.
+ * @param on_removed - if not NULL, called for every removed game with the opponent's id,
+ *                     the winner (FIRST_PLAYER being player_id) and the play time.
+ * @param context - passed as is to on_removed.
  * @return
- *      GAME_OUT_OF_MEMORY - if an allocation failed.
+ *      GAME_OUT_OF_MEMORY - if the map shares games with a snapshot and copying one failed.
+ *                           The games not reported to on_removed were not removed.
  *      GAME_SUCCESS- otherwise.
  */
-bool gameGetDataByPlayerId(Map game_map, PlayerId first_player, PlayerId* second_player,
-                           int* winner, int* play_time, bool remove);
+GameResult gameRemovePlayerParticipated(GameMap game_map, PlayerId player_id, gameRemovedFunction on_removed,
+                                        void* context);
 /**
 * gameGetNumOfGames: returns the num of games in a given tournament.
 *
@@ -144,8 +226,114 @@ bool gameGetDataByPlayerId(Map game_map, PlayerId first_player, PlayerId* second
 * 	int - the num of games otherwise.
 *
 */
-int gameGetNumOfGames(Map game_map);
+int gameGetNumOfGames(GameMap game_map);
+/**
+* gameGetNumOfGamesOfPlayer: returns the num of games of a player in a given tournament,
+* in expected O(1).
+*
+* @param game_map - The game_map to look into - must not be NULL.
+* @param player_id - The player's id.
+*
+* @return
+* 	int - the num of games of the player, 0 if he has none.
+*/
+int gameGetNumOfGamesOfPlayer(GameMap game_map, PlayerId player_id);
+/**
+* gameGetLongestPlayTime: returns the longest play time of the games, in one pass over them.
+*
+* @param game_map - The game_map to look into - must not be NULL.
+*
+* @return
+*   0 - if the map has no games, or an allocation failed.
+* 	int - the longest play time otherwise.
+*/
+int gameGetLongestPlayTime(GameMap game_map);
+
+/** Type of function called by gameForEachAsFirstPlayer and gameForEachOfPlayer for every visited game */
+typedef void (*gameVisitFunction)(PlayerId second_player, Winner winner, int play_time, void* context);
+
+/**
+ * gameForEachAsFirstPlayer: calls a function for every game in which a player is player1,
+ * the player with the smaller id of the two, in ascending order of the opponent's id.
+ * This costs O(log n + k) for k games, see gameForEachOfPlayer.
+ * The function must not add or remove games.
+ *
+ * @param game_map - the games map to look into - must not be NULL.
+ * @param player_id - the player's id.
+ * @param visit - called for every game with the opponent's id, the winner (FIRST_PLAYER
+ *                being player_id) and the play time.
+ * @param context - passed as is to visit.
+ * @return
+ *      GAME_OUT_OF_MEMORY - if an allocation failed, no game was visited.
+ *      GAME_SUCCESS- otherwise.
+ */
+GameResult gameForEachAsFirstPlayer(GameMap game_map, PlayerId player_id, gameVisitFunction visit, void* context);
 
+/**
+ * gameForEachOfPlayer: calls a function for every game a player participates in, in
+ * ascending order of the opponent's id. The games against larger ids are adjacent in
+ * the map and the opponents with smaller ids are kept by the map, so this costs
+ * O(log n) per game at most instead of a walk over all the games.
+ * The function must not add or remove games.
+ *
+ * @param game_map - the games map to look into - must not be NULL.
+ * @param player_id - the player's id.
+ * @param visit - called for every game with the opponent's id, the winner (FIRST_PLAYER
+ *                being player_id) and the play time.
+ * @param context - passed as is to visit.
+ * @return
+ *      GAME_OUT_OF_MEMORY - if an allocation failed, no game was visited.
+ *      GAME_SUCCESS- otherwise.
+ */
+GameResult gameForEachOfPlayer(GameMap game_map, PlayerId player_id, gameVisitFunction visit, void* context);
 
 
+/**
+ * gameMapSerialize: writes the games of a game map into a buffer (see mapSerialize).
+ *
+ * @param game_map - the games map to write - must not be NULL.
+ * @param buffer - where to write, may be NULL if size is 0.
+ * @param size - the size of buffer.
+ * @param length - pointer to store the length of the encoding in.
+ * @return
+ *      MAP_SUCCESS- the buffer holds the encoding only if *length <= size, call with a size
+ *                   of 0 to learn the length to allocate.
+ */
+MapResult gameMapSerialize(GameMap game_map, unsigned char* buffer, size_t size, size_t* length);
+
+/**
+ * gameMapDeserialize: fills an empty game map from a buffer written by gameMapSerialize,
+ * and indexes its games (see mapDeserialize).
+ *
+ * @param game_map - the empty games map to fill - must not be NULL.
+ * @param buffer - the encoding.
+ * @param size - the size of buffer.
+ * @param length - pointer to store the length of the encoding read in.
+ * @return
+ *      MAP_ERROR - if the game map is not empty or buffer is not a valid encoding, or one
+ *                  of the games is not valid: an id not positive, a player against himself,
+ *                  a negative play time, an unknown winner, or a key whose first id is not the smaller.
+ *      MAP_OUT_OF_MEMORY - if an allocation failed.
+ *      The game map is then still empty in both cases.
+ *      MAP_SUCCESS- otherwise.
+ */
+MapResult gameMapDeserialize(GameMap game_map, const unsigned char* buffer, size_t size, size_t* length);
+
+/**
+ * gameMapGetStats: returns the counters of the map holding the games (see mapGetStats).
+ *
+ * @param game_map - the games map - must not be NULL.
+ * @param stats - pointer to store the counters in.
+ * @return
+ *      the result of mapGetStats.
+ */
+MapResult gameMapGetStats(GameMap game_map, MapStats* stats);
+
+/**
+ * gameMapResetStats: sets the counters of the map holding the games back to 0.
+ *
+ * @param game_map - the games map - must not be NULL.
+ */
+void gameMapResetStats(GameMap game_map);
+
 #endif //CHESS_GAME_MAP_H
@@ -0,0 +1,645 @@
+#include "game_pairs.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+/*
+ * The local index of a player is found through a map keyed by the player's id, an
+ * int keyed map (MAP_KEY_INT) with a hash index, so that a lookup is expected O(1).
+ * Local indices of players left with no games are reused, so the indices stay about
+ * as many as the players.
+ *
+ * Every local index has the opponents of its player, an array sorted by id which grows
+ * by doubling and is released with the index. The game map keeps a single record per
+ * game, so a player's opponents are how it finds the games it is not first in.
+ *
+ * The bit matrix keeps the bit of the pair of local indices i < j at position
+ * j * (j - 1) / 2 + i, so the bits of a new index are appended after all the others
+ * and the matrix grows without moving a bit. A dense tournament of n players takes
+ * n * n / 16 bytes, against tens of bytes per game in the game map's hash index.
+ */
+
+/* Local indices a new index makes room for */
+#define PAIRS_INITIAL_INDICES 8
+/* A tournament is dense once its players played 1 / PAIRS_DENSE_DENOMINATOR of their pairs,
+ * and sparse again under 1 / PAIRS_SPARSE_DENOMINATOR of them, so it doesn't switch back
+ * and forth around one threshold */
+#define PAIRS_DENSE_DENOMINATOR 4
+#define PAIRS_SPARSE_DENOMINATOR 16
+/* Tournaments with fewer players stay sparse, their games are few anyway */
+#define PAIRS_DENSE_MIN_PLAYERS 16
+#define PAIRS_WORD_BITS 64
+/* Room a player's opponents array is first given */
+#define PAIRS_INITIAL_OPPONENTS 4
+
+/* The opponents of the player of a local index, sorted by id */
+typedef struct pairs_opponents_t {
+    PlayerId* ids; // NULL while the player has no room
+    int count; // the player's games, 0 for a free index
+    int capacity;
+} *PairsOpponents;
+
+struct game_pairs_t {
+    Map ids; // the local index of every player with games, by id
+    int num_of_games;
+    PairsOpponents opponents; // the opponents of the player of every local index
+    int* free_indices; // local indices given back, reused first
+    int free_count;
+    int indices; // local indices handed out so far, free ones included
+    int indices_capacity; // room in opponents and free_indices
+    uint64_t* bits; // the bit matrix, NULL while the index is sparse
+    size_t words; // room in bits
+    MapAllocator allocator;
+};
+
+/* declaring functions */
+static MapKeyElement pairsCopyKey(MapKeyElement key);
+static void pairsFreeKey(MapKeyElement key);
+static unsigned int pairsHashKey(MapKeyElement key);
+static Map pairsCreateIds(const MapAllocator* allocator);
+static int pairsIndexOf(GamePairs pairs, PlayerId id);
+static bool pairsGrowIndices(GamePairs pairs, int indices);
+static bool pairsGrowBits(GamePairs pairs, int indices);
+static size_t pairsWords(int indices);
+static size_t pairsBit(int index1, int index2);
+static bool pairsReserve(GamePairs pairs, int new_players);
+static bool pairsGrowOpponents(GamePairs pairs, PairsOpponents opponents);
+static int pairsOpponentPosition(PairsOpponents opponents, PlayerId id);
+static void pairsLink(PairsOpponents opponents, PlayerId id);
+static void pairsUnlink(PairsOpponents opponents, PlayerId id);
+static int pairsIntern(GamePairs pairs, PlayerId id, bool* interned);
+static void pairsRelease(GamePairs pairs, PlayerId id, int index);
+static void pairsDeallocate(GamePairs pairs, void* pointer, size_t size);
+static void pairsFreeOpponents(GamePairs pairs);
+static void pairsFreeArrays(GamePairs pairs);
+
+
+/**
+ * pairsCopyKey: copies a player id of the id map, for the keys the map hands out.
+ *
+ * @param key - the id.
+ * @return
+ * NULL if a NULL was sent or a memory allocation failed, a copy of the id otherwise.
+ */
+static MapKeyElement pairsCopyKey(MapKeyElement key) {
+    if (!key) {
+        return NULL;
+    }
+    PlayerId* key_copy = malloc(sizeof(*key_copy));
+    if (!key_copy) {
+        return NULL;
+    }
+    *key_copy = *(PlayerId*)key;
+    return key_copy;
+}
+
+/**
+ * pairsFreeKey: frees a player id copied by pairsCopyKey.
+ *
+ * @param key - the id, NULL is ignored.
+ */
+static void pairsFreeKey(MapKeyElement key) {
+    free(key);
+}
+
+/**
+ * pairsHashKey: hashes a player id for the id map's hash index.
+ *
+ * @param key - the id.
+ * @return
+ * The id itself, the map mixes it.
+ */
+static unsigned int pairsHashKey(MapKeyElement key) {
+    return (unsigned int)*(PlayerId*)key;
+}
+
+/**
+ * pairsCreateIds: creates the empty id map of an index.
+ *
+ * @param allocator - where the map takes its memory from.
+ * @return
+ * NULL if allocations failed, the map otherwise.
+ */
+static Map pairsCreateIds(const MapAllocator* allocator) {
+    MapOptions options = {0};
+    options.hashKeyElement = pairsHashKey;
+    options.engine = MAP_ENGINE_ADAPTIVE;
+    options.keyType = MAP_KEY_INT;
+    options.dataSize = sizeof(int);//the local index, copied into the map's pool
+    return mapCreateWithAllocator(NULL, pairsCopyKey, NULL, pairsFreeKey, NULL, &options, allocator);
+}
+
+/**
+ * pairsIndexOf: returns the local index of a player.
+ *
+ * @param pairs - the index.
+ * @param id - the player's id.
+ * @return
+ * The player's local index, or -1 if the player has none.
+ */
+static int pairsIndexOf(GamePairs pairs, PlayerId id) {
+    int* index = mapGet(pairs->ids, &id);
+    return index ? *index : -1;
+}
+
+/**
+ * pairsGrowIndices: makes room for a number of local indices.
+ *
+ * @param pairs - the index.
+ * @param indices - the number of local indices to make room for.
+ * @return
+ * false - if allocation failed, the index is left unchanged.
+ * true - otherwise.
+ */
+static bool pairsGrowIndices(GamePairs pairs, int indices) {
+    if (indices <= pairs->indices_capacity) {
+        return true;
+    }
+    int capacity = pairs->indices_capacity;
+    while (capacity < indices) {
+        capacity *= 2;
+    }
+    const MapAllocator* allocator = &pairs->allocator;
+    PairsOpponents opponents = allocator->allocate(allocator->context, capacity * sizeof(*opponents));
+    int* free_indices = allocator->allocate(allocator->context, capacity * sizeof(*free_indices));
+    if (!opponents || !free_indices) {
+        pairsDeallocate(pairs, opponents, capacity * sizeof(*opponents));
+        pairsDeallocate(pairs, free_indices, capacity * sizeof(*free_indices));
+        return false;
+    }
+    memcpy(opponents, pairs->opponents, pairs->indices * sizeof(*opponents));
+    memcpy(free_indices, pairs->free_indices, pairs->free_count * sizeof(*free_indices));
+    pairsDeallocate(pairs, pairs->opponents, pairs->indices_capacity * sizeof(*opponents));
+    pairsDeallocate(pairs, pairs->free_indices, pairs->indices_capacity * sizeof(*free_indices));
+    pairs->opponents = opponents;
+    pairs->free_indices = free_indices;
+    pairs->indices_capacity = capacity;
+    return true;
+}
+
+/**
+ * pairsWords: returns the words the bit matrix of a number of local indices takes.
+ *
+ * @param indices - the number of local indices.
+ */
+static size_t pairsWords(int indices) {
+    size_t bits = (size_t)indices * (indices > 0 ? indices - 1 : 0) / 2;
+    return (bits + PAIRS_WORD_BITS - 1) / PAIRS_WORD_BITS;
+}
+
+/**
+ * pairsGrowBits: makes room in the bit matrix for a number of local indices,
+ * the bits of the new ones not set.
+ *
+ * @param pairs - a dense index.
+ * @param indices - the number of local indices to make room for.
+ * @return
+ * false - if allocation failed, the index is left unchanged.
+ * true - otherwise.
+ */
+static bool pairsGrowBits(GamePairs pairs, int indices) {
+    size_t words = pairsWords(indices);
+    if (words <= pairs->words) {
+        return true;
+    }
+    //the matrix grows by half at least, so adding players one by one doesn't copy it every time
+    if (words < pairs->words + pairs->words / 2) {
+        words = pairs->words + pairs->words / 2;
+    }
+    uint64_t* bits = pairs->allocator.allocate(pairs->allocator.context, words * sizeof(*bits));
+    if (!bits) {
+        return false;
+    }
+    memcpy(bits, pairs->bits, pairs->words * sizeof(*bits));
+    memset(bits + pairs->words, 0, (words - pairs->words) * sizeof(*bits));
+    pairsDeallocate(pairs, pairs->bits, pairs->words * sizeof(*bits));
+    pairs->bits = bits;
+    pairs->words = words;
+    return true;
+}
+
+/**
+ * pairsBit: returns the position in the bit matrix of a pair of local indices.
+ *
+ * @param index1 - one local index.
+ * @param index2 - another local index.
+ */
+static size_t pairsBit(int index1, int index2) {
+    assert(index1 != index2);
+    int low = index1 < index2 ? index1 : index2;
+    int high = index1 < index2 ? index2 : index1;
+    return (size_t)high * (high - 1) / 2 + low;
+}
+
+/**
+ * pairsReserve: makes room in the arrays for a number of new players, so that interning
+ * them can only fail in the id map.
+ *
+ * @param pairs - the index.
+ * @param new_players - the number of players that may be given a local index.
+ * @return
+ * false - if allocation failed, the players and games of the index are then unchanged.
+ * true - otherwise.
+ */
+static bool pairsReserve(GamePairs pairs, int new_players) {
+    int reused = pairs->free_count < new_players ? pairs->free_count : new_players;
+    int indices = pairs->indices + new_players - reused;
+    if (!pairsGrowIndices(pairs, indices)) {
+        return false;
+    }
+    return !pairs->bits || pairsGrowBits(pairs, indices);
+}
+
+/**
+ * pairsGrowOpponents: makes room in a player's opponents for one more.
+ *
+ * @param pairs - the index.
+ * @param opponents - the player's opponents.
+ * @return
+ * false - if allocation failed, the opponents are left unchanged.
+ * true - otherwise.
+ */
+static bool pairsGrowOpponents(GamePairs pairs, PairsOpponents opponents) {
+    if (opponents->count < opponents->capacity) {
+        return true;
+    }
+    int capacity = opponents->capacity > 0 ? 2 * opponents->capacity : PAIRS_INITIAL_OPPONENTS;
+    PlayerId* ids = pairs->allocator.allocate(pairs->allocator.context, capacity * sizeof(*ids));
+    if (!ids) {
+        return false;
+    }
+    if (opponents->ids) {
+        memcpy(ids, opponents->ids, opponents->count * sizeof(*ids));
+    }
+    pairsDeallocate(pairs, opponents->ids, opponents->capacity * sizeof(*ids));
+    opponents->ids = ids;
+    opponents->capacity = capacity;
+    return true;
+}
+
+/**
+ * pairsOpponentPosition: binary search for the first opponent whose id is not smaller than id.
+ *
+ * @param opponents - a player's opponents.
+ * @param id - the id to look for.
+ * @return
+ * The position of that opponent, opponents->count if all the ids are smaller.
+ */
+static int pairsOpponentPosition(PairsOpponents opponents, PlayerId id) {
+    int low = 0;
+    int high = opponents->count;
+    while (low < high) {
+        int middle = (low + high) / 2;
+        if (opponents->ids[middle] < id) {
+            low = middle + 1;
+        }
+        else {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+/**
+ * pairsLink: adds an opponent to a player's opponents, which have room for it.
+ * Opponents added in ascending order are appended without moving the others.
+ *
+ * @param opponents - the player's opponents.
+ * @param id - the opponent's id, not among them yet.
+ */
+static void pairsLink(PairsOpponents opponents, PlayerId id) {
+    assert(opponents->count < opponents->capacity);
+    int position = opponents->count;
+    if (position > 0 && opponents->ids[position - 1] > id) {
+        position = pairsOpponentPosition(opponents, id);
+        memmove(&opponents->ids[position + 1], &opponents->ids[position],
+                (opponents->count - position) * sizeof(*opponents->ids));
+    }
+    opponents->ids[position] = id;
+    opponents->count++;
+}
+
+/**
+ * pairsUnlink: takes an opponent out of a player's opponents.
+ *
+ * @param opponents - the player's opponents.
+ * @param id - the opponent's id, among them.
+ */
+static void pairsUnlink(PairsOpponents opponents, PlayerId id) {
+    int position = pairsOpponentPosition(opponents, id);
+    assert(position < opponents->count && opponents->ids[position] == id);
+    opponents->count--;
+    memmove(&opponents->ids[position], &opponents->ids[position + 1],
+            (opponents->count - position) * sizeof(*opponents->ids));
+}
+
+/**
+ * pairsIntern: returns the local index of a player, giving it one if it has none.
+ * Room must have been made with pairsReserve.
+ *
+ * @param pairs - the index.
+ * @param id - the player's id.
+ * @param interned - set to true if the player was given a local index, false otherwise.
+ * @return
+ * The player's local index, or -1 if an allocation failed, the index is then unchanged.
+ */
+static int pairsIntern(GamePairs pairs, PlayerId id, bool* interned) {
+    int index = pairs->free_count > 0 ? pairs->free_indices[pairs->free_count - 1] : pairs->indices;
+    int* stored = mapGetOrInsert(pairs->ids, &id, &index, interned);
+    if (!stored) {
+        return -1;
+    }
+    if (*interned) {
+        if (pairs->free_count > 0) {
+            pairs->free_count--;
+        }
+        else {
+            pairs->indices++;
+        }
+        assert(index < pairs->indices_capacity);
+        pairs->opponents[index].ids = NULL;
+        pairs->opponents[index].count = 0;
+        pairs->opponents[index].capacity = 0;
+    }
+    return *stored;
+}
+
+/**
+ * pairsRelease: takes back the local index of a player left with no games, and releases
+ * its opponents. Its bits are all clear, as all its games were removed.
+ *
+ * @param pairs - the index.
+ * @param id - the player's id.
+ * @param index - the player's local index.
+ */
+static void pairsRelease(GamePairs pairs, PlayerId id, int index) {
+    PairsOpponents opponents = &pairs->opponents[index];
+    assert(opponents->count == 0);
+    pairsDeallocate(pairs, opponents->ids, opponents->capacity * sizeof(*opponents->ids));
+    opponents->ids = NULL;
+    opponents->capacity = 0;
+    pairs->free_indices[pairs->free_count++] = index;
+    //removing a plain int key and data allocates nothing
+    MapResult result = mapRemove(pairs->ids, &id);
+    assert(result == MAP_SUCCESS);
+    (void)result;
+}
+
+/**
+ * pairsDeallocate: gives a block back to the allocator of an index.
+ *
+ * @param pairs - the index.
+ * @param pointer - the block, NULL is ignored.
+ * @param size - the size it was allocated with.
+ */
+static void pairsDeallocate(GamePairs pairs, void* pointer, size_t size) {
+    if (pointer) {
+        pairs->allocator.deallocate(pairs->allocator.context, pointer, size);
+    }
+}
+
+/**
+ * pairsFreeOpponents: releases the opponents of every local index handed out.
+ *
+ * @param pairs - the index.
+ */
+static void pairsFreeOpponents(GamePairs pairs) {
+    if (!pairs->opponents) {
+        return;
+    }
+    for (int index = 0; index < pairs->indices; index++) {
+        PairsOpponents opponents = &pairs->opponents[index];
+        pairsDeallocate(pairs, opponents->ids, opponents->capacity * sizeof(*opponents->ids));
+    }
+}
+
+/**
+ * pairsFreeArrays: releases the arrays of an index.
+ *
+ * @param pairs - the index.
+ */
+static void pairsFreeArrays(GamePairs pairs) {
+    mapDestroy(pairs->ids);
+    pairsFreeOpponents(pairs);
+    pairsDeallocate(pairs, pairs->opponents, pairs->indices_capacity * sizeof(*pairs->opponents));
+    pairsDeallocate(pairs, pairs->free_indices, pairs->indices_capacity * sizeof(*pairs->free_indices));
+    pairsDeallocate(pairs, pairs->bits, pairs->words * sizeof(*pairs->bits));
+}
+
+/********************* Public functions *********************/
+
+GamePairs pairsCreate(const MapAllocator* allocator) {
+    assert(allocator);
+    GamePairs pairs = allocator->allocate(allocator->context, sizeof(*pairs));
+    if (!pairs) {
+        return NULL;
+    }
+    pairs->allocator = *allocator;
+    pairs->ids = pairsCreateIds(allocator);
+    pairs->opponents = allocator->allocate(allocator->context,
+                                           PAIRS_INITIAL_INDICES * sizeof(*pairs->opponents));
+    pairs->free_indices = allocator->allocate(allocator->context,
+                                              PAIRS_INITIAL_INDICES * sizeof(*pairs->free_indices));
+    pairs->indices = 0;
+    pairs->indices_capacity = PAIRS_INITIAL_INDICES;
+    pairs->bits = NULL;
+    pairs->words = 0;
+    if (!pairs->ids || !pairs->opponents || !pairs->free_indices) {
+        pairsDestroy(pairs);
+        return NULL;
+    }
+    pairsClear(pairs);
+    return pairs;
+}
+
+void pairsDestroy(GamePairs pairs) {
+    if (!pairs) {
+        return;
+    }
+    MapAllocator allocator = pairs->allocator;
+    pairsFreeArrays(pairs);
+    allocator.deallocate(allocator.context, pairs, sizeof(*pairs));
+}
+
+GamePairs pairsCopy(GamePairs pairs) {
+    assert(pairs);
+    const MapAllocator* allocator = &pairs->allocator;
+    GamePairs copy = allocator->allocate(allocator->context, sizeof(*copy));
+    if (!copy) {
+        return NULL;
+    }
+    *copy = *pairs;
+    copy->ids = mapCopy(pairs->ids);
+    copy->opponents = allocator->allocate(allocator->context,
+                                          copy->indices_capacity * sizeof(*copy->opponents));
+    copy->free_indices = allocator->allocate(allocator->context,
+                                             copy->indices_capacity * sizeof(*copy->free_indices));
+    copy->bits = pairs->bits ? allocator->allocate(allocator->context, copy->words * sizeof(*copy->bits)) : NULL;
+    if (!copy->ids || !copy->opponents || !copy->free_indices || (pairs->bits && !copy->bits)) {
+        copy->indices = 0;
+        pairsDestroy(copy);
+        return NULL;
+    }
+    for (int index = 0; index < pairs->indices; index++) {
+        PairsOpponents opponents = &copy->opponents[index];
+        *opponents = pairs->opponents[index];
+        if (!opponents->ids) {
+            continue;
+        }
+        opponents->ids = allocator->allocate(allocator->context, opponents->capacity * sizeof(*opponents->ids));
+        if (!opponents->ids) {
+            //only the opponents copied so far are released
+            copy->indices = index;
+            pairsDestroy(copy);
+            return NULL;
+        }
+        memcpy(opponents->ids, pairs->opponents[index].ids, opponents->count * sizeof(*opponents->ids));
+    }
+    memcpy(copy->free_indices, pairs->free_indices, copy->free_count * sizeof(*copy->free_indices));
+    if (copy->bits) {
+        memcpy(copy->bits, pairs->bits, copy->words * sizeof(*copy->bits));
+    }
+    return copy;
+}
+
+void pairsClear(GamePairs pairs) {
+    assert(pairs);
+    mapClear(pairs->ids);
+    pairsFreeOpponents(pairs);
+    pairs->num_of_games = 0;
+    pairs->free_count = 0;
+    pairs->indices = 0;
+    pairsMakeSparse(pairs);
+}
+
+bool pairsAdd(GamePairs pairs, PlayerId player1_id, PlayerId player2_id) {
+    assert(pairs && player1_id != player2_id);
+    if (!pairsReserve(pairs, 2)) {
+        return false;
+    }
+    bool interned1, interned2;
+    int index1 = pairsIntern(pairs, player1_id, &interned1);
+    if (index1 < 0) {
+        return false;
+    }
+    int index2 = pairsIntern(pairs, player2_id, &interned2);
+    if (index2 < 0) {
+        if (interned1) {
+            pairsRelease(pairs, player1_id, index1);
+        }
+        return false;
+    }
+    PairsOpponents opponents1 = &pairs->opponents[index1];
+    PairsOpponents opponents2 = &pairs->opponents[index2];
+    if (!pairsGrowOpponents(pairs, opponents1) || !pairsGrowOpponents(pairs, opponents2)) {
+        //a player given its index here has no opponents, releasing it frees their room
+        if (interned1) {
+            pairsRelease(pairs, player1_id, index1);
+        }
+        if (interned2) {
+            pairsRelease(pairs, player2_id, index2);
+        }
+        return false;
+    }
+    pairsLink(opponents1, player2_id);
+    pairsLink(opponents2, player1_id);
+    pairs->num_of_games++;
+    if (pairs->bits) {
+        size_t bit = pairsBit(index1, index2);
+        pairs->bits[bit / PAIRS_WORD_BITS] |= (uint64_t)1 << (bit % PAIRS_WORD_BITS);
+    }
+    return true;
+}
+
+void pairsRemove(GamePairs pairs, PlayerId player1_id, PlayerId player2_id) {
+    assert(pairs);
+    int index1 = pairsIndexOf(pairs, player1_id);
+    int index2 = pairsIndexOf(pairs, player2_id);
+    assert(index1 >= 0 && index2 >= 0);
+    if (pairs->bits) {
+        size_t bit = pairsBit(index1, index2);
+        pairs->bits[bit / PAIRS_WORD_BITS] &= ~((uint64_t)1 << (bit % PAIRS_WORD_BITS));
+    }
+    pairs->num_of_games--;
+    pairsUnlink(&pairs->opponents[index1], player2_id);
+    pairsUnlink(&pairs->opponents[index2], player1_id);
+    if (pairs->opponents[index1].count == 0) {
+        pairsRelease(pairs, player1_id, index1);
+    }
+    if (pairs->opponents[index2].count == 0) {
+        pairsRelease(pairs, player2_id, index2);
+    }
+}
+
+bool pairsContains(GamePairs pairs, PlayerId player1_id, PlayerId player2_id) {
+    assert(pairs && pairs->bits);
+    int index1 = pairsIndexOf(pairs, player1_id);
+    int index2 = pairsIndexOf(pairs, player2_id);
+    if (index1 < 0 || index2 < 0 || index1 == index2) {
+        return false;
+    }
+    size_t bit = pairsBit(index1, index2);
+    return (pairs->bits[bit / PAIRS_WORD_BITS] >> (bit % PAIRS_WORD_BITS)) & 1;
+}
+
+int pairsGetNumOfGames(GamePairs pairs, PlayerId player_id) {
+    assert(pairs);
+    int index = pairsIndexOf(pairs, player_id);
+    return index >= 0 ? pairs->opponents[index].count : 0;
+}
+
+const PlayerId* pairsGetOpponents(GamePairs pairs, PlayerId player_id, int* count) {
+    assert(pairs && count);
+    int index = pairsIndexOf(pairs, player_id);
+    if (index < 0) {
+        *count = 0;
+        return NULL;
+    }
+    *count = pairs->opponents[index].count;
+    return pairs->opponents[index].ids;
+}
+
+bool pairsIsDense(GamePairs pairs) {
+    assert(pairs);
+    return pairs->bits != NULL;
+}
+
+bool pairsShouldSwitch(GamePairs pairs) {
+    assert(pairs);
+    int players = mapGetSize(pairs->ids);
+    uint64_t all_pairs = (uint64_t)players * (players > 0 ? players - 1 : 0) / 2;
+    uint64_t games = (uint64_t)pairs->num_of_games;
+    if (pairs->bits) {
+        return games * PAIRS_SPARSE_DENOMINATOR < all_pairs;
+    }
+    return players >= PAIRS_DENSE_MIN_PLAYERS && games * PAIRS_DENSE_DENOMINATOR >= all_pairs;
+}
+
+bool pairsMakeDense(GamePairs pairs) {
+    assert(pairs && !pairs->bits);
+    size_t words = pairsWords(pairs->indices);
+    pairs->bits = pairs->allocator.allocate(pairs->allocator.context, words * sizeof(*pairs->bits));
+    if (!pairs->bits) {
+        return false;
+    }
+    memset(pairs->bits, 0, words * sizeof(*pairs->bits));
+    pairs->words = words;
+    return true;
+}
+
+void pairsMakeSparse(GamePairs pairs) {
+    assert(pairs);
+    pairsDeallocate(pairs, pairs->bits, pairs->words * sizeof(*pairs->bits));
+    pairs->bits = NULL;
+    pairs->words = 0;
+}
+
+void pairsSetPlayed(GamePairs pairs, PlayerId player1_id, PlayerId player2_id) {
+    assert(pairs && pairs->bits);
+    int index1 = pairsIndexOf(pairs, player1_id);
+    int index2 = pairsIndexOf(pairs, player2_id);
+    assert(index1 >= 0 && index2 >= 0);
+    size_t bit = pairsBit(index1, index2);
+    pairs->bits[bit / PAIRS_WORD_BITS] |= (uint64_t)1 << (bit % PAIRS_WORD_BITS);
+}
@@ -0,0 +1,173 @@
+#ifndef CHESS_GAME_PAIRS_H
+#define CHESS_GAME_PAIRS_H
+#include "game_map.h"
+
+/**
+* Pairing index of a game map
+*
+* Records which pairs of players played each other in a tournament, next to the
+* tournament's game map. Every player of the tournament is given a small local index
+* while it has games, and the index keeps the opponents of every player, sorted by id.
+* Once the tournament is dense, that is its players played a large part of all the
+* pairs they could, the index also keeps a triangular bit matrix over the local
+* indices, one bit per pair, and telling whether two players played is a single bit
+* test. The game map switches the matrix on and off as the density changes, see
+* pairsShouldSwitch.
+*
+* The following functions are available:
+*   pairsCreate		- Creates an empty index
+*   pairsDestroy	- Deletes an index
+*   pairsCopy		- Copies an index
+*   pairsClear		- Forgets all the players and games
+*   pairsAdd		- Records a game
+*   pairsRemove		- Forgets a game
+*   pairsContains	- Tells whether two players played, in a dense index
+*   pairsGetNumOfGames - Returns the number of games of a player
+*   pairsGetOpponents - Returns the opponents of a player
+*   pairsIsDense	- Tells whether the index keeps its bit matrix
+*   pairsShouldSwitch - Tells whether the index should switch its bit matrix on or off
+*   pairsMakeDense	- Switches the bit matrix on, empty
+*   pairsMakeSparse - Switches the bit matrix off
+*   pairsSetPlayed	- Sets the bit of a recorded game, while filling a new matrix
+*/
+
+/** Type for defining the pairing index */
+typedef struct game_pairs_t* GamePairs;
+
+/**
+* pairsCreate: Allocates a new empty, sparse index.
+*
+* @param allocator - where the index takes its memory from, not NULL.
+* @return
+* 	NULL - if allocations failed.
+* 	A new GamePairs in case of success.
+*/
+GamePairs pairsCreate(const MapAllocator* allocator);
+
+/**
+* pairsDestroy: Deallocates an index.
+*
+* @param pairs - the index. If pairs is NULL nothing will be done.
+*/
+void pairsDestroy(GamePairs pairs);
+
+/**
+* pairsCopy: Creates a copy of an index, with the same local indices and matrix.
+*
+* @param pairs - the index to copy, not NULL.
+* @return
+* 	NULL - if allocations failed.
+* 	The copy otherwise.
+*/
+GamePairs pairsCopy(GamePairs pairs);
+
+/**
+* pairsClear: Forgets all the players and games of an index, which becomes sparse.
+*
+* @param pairs - the index, not NULL.
+*/
+void pairsClear(GamePairs pairs);
+
+/**
+* pairsAdd: Records a new game, giving its players local indices if they have none,
+* and setting its bit in a dense index.
+*
+* @param pairs - the index, not NULL.
+* @param player1_id - one player of the game.
+* @param player2_id - the other player, not player1_id.
+* @return
+* 	false - if an allocation failed, the index is then unchanged.
+* 	true - otherwise.
+*/
+bool pairsAdd(GamePairs pairs, PlayerId player1_id, PlayerId player2_id);
+
+/**
+* pairsRemove: Forgets a game recorded by pairsAdd. A player left with no games
+* gives its local index back, to be reused by the next new player.
+*
+* @param pairs - the index, not NULL.
+* @param player1_id - one player of the game.
+* @param player2_id - the other player.
+*/
+void pairsRemove(GamePairs pairs, PlayerId player1_id, PlayerId player2_id);
+
+/**
+* pairsContains: Tells whether two players played each other, in O(1).
+*
+* @param pairs - a dense index.
+* @param player1_id - one player.
+* @param player2_id - the other player.
+* @return
+* 	true - if a game of the two players is recorded.
+* 	false - otherwise.
+*/
+bool pairsContains(GamePairs pairs, PlayerId player1_id, PlayerId player2_id);
+
+/**
+* pairsGetNumOfGames: Returns the number of recorded games of a player, in O(1).
+*
+* @param pairs - the index, not NULL.
+* @param player_id - the player.
+* @return
+* 	0 - if the player has no games.
+* 	The number of its games otherwise.
+*/
+int pairsGetNumOfGames(GamePairs pairs, PlayerId player_id);
+
+/**
+* pairsGetOpponents: Returns the players a player played, in ascending order of id, in O(1).
+*
+* @param pairs - the index, not NULL.
+* @param player_id - the player.
+* @param count - set to the number of opponents, not NULL.
+* @return
+* 	NULL - if the player has no games.
+* 	The opponents otherwise, valid until the index is changed.
+*/
+const PlayerId* pairsGetOpponents(GamePairs pairs, PlayerId player_id, int* count);
+
+/**
+* pairsIsDense: Tells whether an index keeps its bit matrix, so pairsContains may be used.
+*
+* @param pairs - the index, not NULL.
+*/
+bool pairsIsDense(GamePairs pairs);
+
+/**
+* pairsShouldSwitch: Tells whether the density of the recorded games crossed the
+* threshold of the index's state: a sparse index should be made dense once its
+* players played a quarter of their pairs, a dense one sparse once they played less
+* than a sixteenth of them. Small tournaments stay sparse.
+*
+* @param pairs - the index, not NULL.
+*/
+bool pairsShouldSwitch(GamePairs pairs);
+
+/**
+* pairsMakeDense: Switches the bit matrix of a sparse index on, with no bit set.
+* The caller then sets the bits of all the recorded games with pairsSetPlayed.
+*
+* @param pairs - a sparse index.
+* @return
+* 	false - if allocation failed, the index then stays sparse.
+* 	true - otherwise.
+*/
+bool pairsMakeDense(GamePairs pairs);
+
+/**
+* pairsMakeSparse: Switches the bit matrix of an index off.
+*
+* @param pairs - the index, not NULL.
+*/
+void pairsMakeSparse(GamePairs pairs);
+
+/**
+* pairsSetPlayed: Sets the bit of a game recorded by pairsAdd.
+*
+* @param pairs - a dense index.
+* @param player1_id - one player of the game.
+* @param player2_id - the other player.
+*/
+void pairsSetPlayed(GamePairs pairs, PlayerId player1_id, PlayerId player2_id);
+
+#endif //CHESS_GAME_PAIRS_H
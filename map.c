@@ -1,332 +1,951 @@
 #include "map.h"
+#include "map_engine.h"
 #include <stdlib.h>
 #include <assert.h>
 #include <stdio.h>
-//notmine
-/* Type for definning the list */
-typedef struct node {
-    MapKeyElement key;
-    MapDataElement data;
-    struct node* next;
-}*Node;
-
-/* Type for definning the map which is imlpemented as a list with the first node as deme */
-struct Map_t {
-    Node head;
-    Node iterator; // initialized to head at first
-    int size;
-    copyMapDataElements copyDataElements;
-    copyMapKeyElements copyKeyElements;
-    freeMapDataElements freeDataElements;
-    freeMapKeyElements freeKeyElements;
-    compareMapKeyElements compareKeyElements;
-};
+#include <string.h>
 
+/* Engine used for MAP_ENGINE_DEFAULT. Build with -DMAP_LIST_ENGINE to fall back to the sorted linked list */
+#ifdef MAP_LIST_ENGINE
+#define MAP_DEFAULT_ENGINE (&map_list_engine)
+#else
+#define MAP_DEFAULT_ENGINE (&map_array_engine)
+#endif
 
+/** An external cursor, see mapCursorCreate */
+struct MapCursor_t {
+    Map map;
+    struct map_iterator_t iterator;
+    MapEntry entry; // the current pair, NULL before the first one and after the last one
+    MapEntry successor; // after mapCursorRemove, the pair the next step moves to
+    bool started;
+    bool removed; // the current pair was removed, entry is NULL and successor is next
+    unsigned int version; // the map's version when the cursor was created or last removed a pair
+    MapKeyValue key_value; // the value of the current key of a map holding keys by value, handed out by address
+    MapKeyElement from; // the smallest key of a range cursor, as stored in an entry
+    MapKeyElement to; // the largest key of a range cursor, as stored in an entry
+    bool has_from;
+    bool has_to;
+};
 
 /* declaring functions */
-static Node nodeAllocate();
-static Node nodeCreate(Map map, MapKeyElement key, MapDataElement data);
-static void nodeDestroy(Map map, Node node);
-static Node nodeCopy(Map map, MapKeyElement key, MapDataElement data);
-static Node mapContainsKey(Map map, MapKeyElement key);
+static MapResult mapInsert(Map map, MapKeyElement keyElement, MapDataElement dataElement, bool take,
+                           bool hint);
+static void mapGetOptions(Map map, MapOptions* options);
+static const MapEngineOps* mapEngineOps(MapEngine engine);
+static MapKeyElement mapKeyIn(Map map, MapKeyElement keyElement);
+static MapKeyElement mapKeyOut(Map map, MapKeyElement key);
+static bool mapElementsNeedFree(Map map);
+static MapResult mapUnlink(Map map, MapKeyElement key, MapEntry removed);
+static bool mapHashReady(Map map);
+static bool mapUnshare(Map map);
+static MapResult mapLoadCopies(Map map, MapEntry entries, int count);
+static bool mapMatches(Map map, MapEntry entry, matchMapElements match, void* context);
+static bool mapUnlinkMatch(Map map, MapEntry entry, void* context);
+static void* mallocAllocate(void* context, size_t size);
+static void mallocDeallocate(void* context, void* pointer, size_t size);
+static bool mapCursorCopyBound(Map map, MapKeyElement keyElement, MapKeyElement* bound);
+static void mapCursorFreeBound(Map map, MapKeyElement bound);
+
+/** The allocator of maps made without one */
+static const MapAllocator map_malloc_allocator = { mallocAllocate, mallocDeallocate, NULL };
+
+/** The predicate of a mapRemoveIf, handed to the engine's remove_if */
+struct map_match_t {
+    matchMapElements match;
+    void* context;
+};
 
 
 /**
- * nodeAllocate: Allocates a new empty node. 
+ * mallocAllocate: the allocate function of map_malloc_allocator.
  *
- * @param - None.
+ * @param context - unused.
+ * @param size - size of the block in bytes.
  * @return
- * NULL - If allocation failed.
- * node_ptr - Pointer for the new node to be assigned to in case of succsses.
+ * NULL if malloc failed, the block otherwise.
  */
-static Node nodeAllocate() {
-    Node node_ptr = malloc(sizeof(*node_ptr));
-    if (!node_ptr) {
-        return NULL;
+static void* mallocAllocate(void* context, size_t size) {
+    (void)context;
+    return malloc(size);
+}
+
+/**
+ * mallocDeallocate: the deallocate function of map_malloc_allocator.
+ *
+ * @param context - unused.
+ * @param pointer - the block.
+ * @param size - unused.
+ */
+static void mallocDeallocate(void* context, void* pointer, size_t size) {
+    (void)context;
+    (void)size;
+    free(pointer);
+}
+
+void* mapAllocate(Map map, size_t size) {
+    assert(map);
+    MAP_COUNT(map, allocations, 1);
+    MAP_COUNT(map, bytesAllocated, size);
+    return mapPoolAllocate(map->pool, size);
+}
+
+void mapDeallocate(Map map, void* pointer, size_t size) {
+    assert(map);
+    mapPoolDeallocate(map->pool, pointer, size);
+}
+
+bool mapCopyKey(Map map, MapKeyElement key, MapKeyElement* copy) {
+    assert(map && copy);
+    if (mapKeysByValue(map)) {
+        *copy = key;
+        return true;
+    }
+    if (map->key_size) {
+        *copy = mapAllocate(map, map->key_size);
+        if (*copy) {
+            memcpy(*copy, key, map->key_size);
+        }
+    }
+    else {
+        MAP_COUNT(map, keyCopies, 1);
+        *copy = map->copyKeyElements(key);
+    }
+    return *copy != NULL;
+}
+
+bool mapEntryKey(Map map, MapKeyElement key, MapKeyElement* entry_key) {
+    if (map->take_key) {
+        *entry_key = key;
+        return true;
+    }
+    return mapCopyKey(map, key, entry_key);
+}
+
+void mapFreeKey(Map map, MapKeyElement key) {
+    assert(map);
+    if (mapKeysByValue(map) || !key) {
+        return;
+    }
+    if (map->key_size) {
+        mapDeallocate(map, key, map->key_size);
+    }
+    else {
+        map->freeKeyElements(key);
     }
-    
-    node_ptr->key = NULL;
-    node_ptr->data = NULL;
-    node_ptr->next = NULL;
-    return node_ptr;
+}
+
+bool mapCopyData(Map map, MapDataElement data, MapDataElement* copy) {
+    assert(map && data && copy);
+    if (map->inline_data) {
+        MapDataElement value = NULL;
+        memcpy(&value, data, map->data_size);
+        *copy = value;
+        return true;
+    }
+    if (!map->data_size) {
+        MAP_COUNT(map, dataCopies, 1);
+        *copy = map->copyDataElements(data);
+    }
+    else {
+        *copy = mapAllocate(map, map->data_size);
+        if (*copy) {
+            memcpy(*copy, data, map->data_size);
+        }
+    }
+    return *copy != NULL;
+}
+
+MapDataElement mapEntryData(Map map, MapEntry entry) {
+    return map->inline_data ? (MapDataElement)&entry->data : entry->data;
+}
+
+void mapFreeData(Map map, MapDataElement data) {
+    assert(map);
+    if (!data || map->inline_data) {
+        return;
+    }
+    if (map->data_size) {
+        mapDeallocate(map, data, map->data_size);
+    }
+    else {
+        map->freeDataElements(data);
+    }
+}
+
+void mapFreeEntry(Map map, MapEntry entry) {
+    assert(map && entry);
+    mapFreeData(map, entry->data);
+    mapFreeKey(map, entry->key);
+    entry->data = NULL;
+    entry->key = NULL;
 }
 
 /**
- * nodeCreate: create a new node holding a key-data pair 
- * using nodeCopy function in case it's not the deme node
- * pointer to next node is set to NULL by default
- * @param node_ptr - pointer for the new node to be assigned to 
- * @param key - the key element to assign
- * @param data - the data element to assign
+ * mapElementsNeedFree: checks whether destroying a map must free its elements one by one.
  *
+ * @param map - the map to check.
  * @return
- * NULL- If NULL pointer was sent to it or in case allocation memory failed
- * node_ptr- Pointer for the new node to be assigned to in case of succsses.
+ * false - if the keys and the data all live in the map's pool (or in the entries),
+ *      so releasing the pool frees them.
+ * true - otherwise.
  */
-static Node nodeCreate(Map map, MapKeyElement key, MapDataElement data) {
-    if (!map) {
-        return NULL;
+static bool mapElementsNeedFree(Map map) {
+    return !(mapKeysByValue(map) || map->key_size) || !map->data_size;
+}
+
+void mapStructureChanged(Map map) {
+    map->iterator_valid = false;
+    map->version++;
+}
+
+/**
+ * mapUnlink: removes a key from the engine and the hash index without freeing its elements.
+ *
+ * @param map - the map to remove from.
+ * @param key - the key to remove, as stored in entries.
+ * @param removed - pointer to store the removed entry in, to be freed with mapFreeEntry.
+ * @return
+ * MAP_ITEM_DOES_NOT_EXIST - if key is not in the map.
+ * MAP_OUT_OF_MEMORY - if the engine failed to copy nodes shared with a snapshot,
+ *      the map is unchanged.
+ * MAP_SUCCESS - otherwise.
+ */
+static MapResult mapUnlink(Map map, MapKeyElement key, MapEntry removed) {
+    MapResult result = map->engine->remove(map, key, removed);
+    if (result != MAP_SUCCESS) {
+        return result;
     }
-    //for the deme one we send nodeCreate(map,NULL,NULL)
-    if (!data && !key) {
-        //if it's not empty then it's not the deme one and NULL should be returned
-        if (map->size != 0) {
-            return NULL;
+    if (map->hash) {
+        mapHashRemove(map, removed->key);
+    }
+    map->size--;
+    MAP_COUNT(map, removes, 1);
+    mapStructureChanged(map);
+    return MAP_SUCCESS;
+}
+
+/**
+ * mapMatches: calls a mapRemoveIf predicate with an entry's key and data as the user sees them.
+ *
+ * @param map - the map the entry belongs to.
+ * @param entry - the entry to check.
+ * @param match - the predicate.
+ * @param context - passed as is to match.
+ * @return
+ * the predicate's answer.
+ */
+static bool mapMatches(Map map, MapEntry entry, matchMapElements match, void* context) {
+    MapKeyValue key_value;
+    return match(mapKeyView(map, entry->key, &key_value), mapEntryData(map, entry), context);
+}
+
+/**
+ * mapUnlinkMatch: the unlink callback of the engines' remove_if. Takes a matching entry
+ * out of the hash index and frees its elements, the engine then unlinks it.
+ *
+ * @param map - the map the entry belongs to.
+ * @param entry - the entry to check.
+ * @param context - the struct map_match_t of the mapRemoveIf.
+ * @return
+ * true - if the entry matches and its elements were freed.
+ * false - otherwise.
+ */
+static bool mapUnlinkMatch(Map map, MapEntry entry, void* context) {
+    struct map_match_t* match = context;
+    if (!mapMatches(map, entry, match->match, match->context)) {
+        return false;
+    }
+    if (map->hash) {
+        mapHashRemove(map, entry->key);
+    }
+    mapFreeEntry(map, entry);
+    return true;
+}
+
+/**
+ * mapHashReady: makes sure a map with a hash function has its hash index. A snapshot
+ * builds its index on its first point lookup, so taking it stays O(1).
+ *
+ * @param map - the map to check.
+ * @return
+ * false - if the map has no hash function, is held by the array engine, or building
+ *      its index failed. Lookups then go to the engine.
+ * true - if the map's hash index can answer lookups.
+ */
+static bool mapHashReady(Map map) {
+    if (map->hash || !map->hashKeyElements || map->engine == &map_array_engine) {
+        return map->hash != NULL;
+    }
+    if (!mapHashCreate(map)) {
+        return false;
+    }
+    if (!mapHashReserve(map, map->size)) {
+        mapHashDestroy(map);
+        return false;
+    }
+    struct map_iterator_t iterator;
+    for (MapEntry entry = map->engine->first(map, &iterator); entry; entry = map->engine->next(map, &iterator)) {
+        mapHashPut(map, entry->key, entry->data);
+    }
+    return true;
+}
+
+/**
+ * mapUnshare: replaces the structure a map shares with snapshots by a copy of its own,
+ * with copies of the elements, so that changing its data in place leaves them as they are.
+ *
+ * @param map - the map to unshare.
+ * @return
+ * false - if a copy failed, the map is then unchanged.
+ * true - otherwise, also if the map shares nothing.
+ */
+static bool mapUnshare(Map map) {
+    if (!map->shared) {
+        return true;
+    }
+    Map map_copy = mapCopyWithAllocator(map, &map->allocator);
+    if (!map_copy) {
+        return false;
+    }
+    //the map takes the copy's structure, and the copy's struct takes the shared one away
+    struct Map_t own = *map_copy;
+    *map_copy = *map;
+    own.iterator_valid = false;
+    own.version = map->version + 1;
+    own.stats = map->stats;
+    *map = own;
+    mapDestroy(map_copy);
+    return true;
+}
+
+/**
+ * mapKeyIn: converts a key element given by the user to the form stored in entries.
+ *
+ * @param map - the map the key is looked up in.
+ * @param keyElement - the user's key element, not NULL.
+ * @return
+ * The value of the key for a map holding keys by value (see mapKeysByValue), keyElement
+ * itself otherwise.
+ */
+static MapKeyElement mapKeyIn(Map map, MapKeyElement keyElement) {
+    if (map->key_type == MAP_KEY_INT) {
+        return MAP_INT_TO_KEY(*(int*)keyElement);
+    }
+    if (map->key_type == MAP_KEY_UINT64 && MAP_UINT64_KEYS_INLINE) {
+        return MAP_UINT64_TO_KEY(*(uint64_t*)keyElement);
+    }
+    return keyElement;
+}
+
+/**
+ * mapKeyOut: makes a copy of a key stored in an entry to hand to the user.
+ *
+ * @param map - the map the key belongs to.
+ * @param key - the key, as stored in an entry.
+ * @return
+ * NULL if the copy failed, a key element made by the map's copy function otherwise.
+ */
+static MapKeyElement mapKeyOut(Map map, MapKeyElement key) {
+    MAP_COUNT(map, keyCopies, 1);
+    MapKeyValue key_value;
+    return map->copyKeyElements(mapKeyView(map, key, &key_value));
+}
+
+/**
+ * mapInsert: gives a key a data element, inserting the key if it isn't in the map yet.
+ * Replaced data is freed.
+ *
+ * @param map - the map to insert into.
+ * @param keyElement - the key element, as stored in entries (see mapKeyIn).
+ * @param dataElement - the data element.
+ * @param take - false to insert copies of the elements, true to hand over the ones
+ *      the map stores by pointer (see mapPutTake). A handed over key that is already
+ *      in the map is freed.
+ * @param hint - true if the key likely follows the last inserted key (see mapPutHint).
+ * @return
+ * MAP_OUT_OF_MEMORY - if an allocation or a copy function failed, the map is unchanged
+ *      and the elements are still the caller's.
+ * MAP_SUCCESS - otherwise.
+ */
+static MapResult mapInsert(Map map, MapKeyElement keyElement, MapDataElement dataElement, bool take,
+                           bool hint) {
+    //make room in the index first so that indexing a new key can't fail
+    if (map->hash && !mapHashReserve(map, map->size + 1)) {
+        return MAP_OUT_OF_MEMORY;
+    }
+    bool take_data = take && !map->data_size;
+    MapDataElement data = dataElement;
+    if (!take_data && !mapCopyData(map, dataElement, &data)) {
+        return MAP_OUT_OF_MEMORY;
+    }
+    bool created = false;
+    bool take_key = take && !mapKeysByValue(map) && !map->key_size;
+    map->take_key = take_key;
+    MapEntry entry = hint && map->engine->insert_hint ?
+                     map->engine->insert_hint(map, keyElement, &created) :
+                     map->engine->insert(map, keyElement, &created);
+    map->take_key = false;
+    if (!entry) {
+        if (!take_data) {
+            mapFreeData(map, data);
         }
-        //else it's the deme one and needs to be allocated
-        Node node_ptr = nodeAllocate();
+        return MAP_OUT_OF_MEMORY;
+    }
+    if (created) {
+        mapStructureChanged(map);
         map->size++;
-        return node_ptr;
+        MAP_COUNT(map, inserts, 1);
+    }
+    else {
+        mapFreeData(map, entry->data);
+        if (take_key) {
+            map->freeKeyElements(keyElement);//the entry keeps its own key
+        }
+    }
+    entry->data = data;
+    if (map->hash) {
+        mapHashPut(map, entry->key, data);
     }
+    return MAP_SUCCESS;
+}
 
-    //if we arrive here then only one of them is NULL and it's not the deme node
-    if (!data || !key) {
-        return NULL;
+/**
+ * mapLoadCopies: fills an empty map with copies of sorted pairs in linear time, without
+ * searching for the place of each key.
+ *
+ * @param map - the empty map to fill.
+ * @param entries - the pairs to copy, keys as stored in entries (see mapKeyIn) and data as
+ *      the user sees it (see mapEntryData), sorted by strictly increasing key. Each one is
+ *      overwritten with the map's copy of it.
+ * @param count - the number of pairs.
+ * @return
+ * MAP_OUT_OF_MEMORY - if an allocation or a copy function failed, the map is then still empty.
+ * MAP_SUCCESS - otherwise.
+ */
+static MapResult mapLoadCopies(Map map, MapEntry entries, int count) {
+    assert(map->size == 0);
+    int copied = 0;
+    for (; copied < count; copied++) {
+        MapDataElement data_copy = NULL;
+        if (!mapCopyData(map, entries[copied].data, &data_copy)) {
+            break;
+        }
+        if (!mapCopyKey(map, entries[copied].key, &entries[copied].key)) {
+            mapFreeData(map, data_copy);
+            break;
+        }
+        entries[copied].data = data_copy;
     }
+    if (copied < count || mapLoadEntries(map, entries, count) != MAP_SUCCESS) {
+        for (int i = 0; i < copied; i++) {
+            mapFreeEntry(map, &entries[i]);
+        }
+        return MAP_OUT_OF_MEMORY;
+    }
+    return MAP_SUCCESS;
+}
 
-    //if data and key aren't NULL and size isn't 0 then it's a new node and we must create a copy 
-    //of it before inserting it
-    Node node_ptr = nodeCopy(map, key, data);
-    if (!node_ptr) {
-        return NULL;
+MapResult mapLoadEntries(Map map, MapEntry entries, int count) {
+    assert(map->size == 0);
+    if (map->hash && !mapHashReserve(map, count)) {
+        return MAP_OUT_OF_MEMORY;
     }
+    if (!map->engine->load(map, entries, count)) {
+        return MAP_OUT_OF_MEMORY;
+    }
+    if (map->hash) {
+        for (int i = 0; i < count; i++) {
+            mapHashPut(map, entries[i].key, entries[i].data);
+        }
+    }
+    map->size = count;
+    MAP_COUNT(map, inserts, count);
+    mapStructureChanged(map);
+    return MAP_SUCCESS;
+}
 
+MapResult mapAppendEntry(Map map, MapEntry entry) {
+    if (map->hash && !mapHashReserve(map, map->size + 1)) {
+        return MAP_OUT_OF_MEMORY;
+    }
+    bool created = false;
+    map->take_key = true;
+    MapEntry appended = map->engine->insert_hint(map, entry->key, &created);
+    map->take_key = false;
+    if (!appended) {
+        return MAP_OUT_OF_MEMORY;
+    }
+    assert(created);
+    appended->data = entry->data;
+    if (map->hash) {
+        mapHashPut(map, appended->key, appended->data);
+    }
     map->size++;
-    return node_ptr;
+    MAP_COUNT(map, inserts, 1);
+    mapStructureChanged(map);
+    return MAP_SUCCESS;
 }
 
 /**
- * nodeCopy: create a new node holding a copied key-data pair
- * pointer to next node is set to NULL by default
- * @param node_ptr - pointer for the new copied node to be assigned to
- * @param key - the key element to copy and assign
- * @param data - the data element to copy and assign
+ * mapEngineOps: returns the engine implementing a MapEngine choice.
  *
+ * @param engine - the engine chosen in the map options.
  * @return
- * NULL- If NULL pointer was sent to it or in case allocation memory failed
- * node_ptr- Pointer for the new copied node to be assigned to in case of succsses.
+ * NULL if engine is not a known engine, the engine's operations otherwise.
  */
-static Node nodeCopy(Map map, MapKeyElement key, MapDataElement data) {
-    
-    Node node_ptr = nodeAllocate();
-    if (!node_ptr) {
-       return NULL;
+static const MapEngineOps* mapEngineOps(MapEngine engine) {
+    switch (engine) {
+        case MAP_ENGINE_DEFAULT:
+            return MAP_DEFAULT_ENGINE;
+        case MAP_ENGINE_LIST:
+            return &map_list_engine;
+        case MAP_ENGINE_TREE:
+            return &map_tree_engine;
+        case MAP_ENGINE_BPTREE:
+            return &map_bptree_engine;
+        case MAP_ENGINE_ADAPTIVE:
+            return &map_array_engine;
     }
-    //copy key
-    MapKeyElement key_copy = map->copyKeyElements(key);
-    if (!key_copy) {
-        nodeDestroy(map, node_ptr);
-        return NULL;
-    }
-    //copy data
-    MapDataElement data_copy = map->copyDataElements(data);
-    if (!data_copy) {
-        //free what has alrady been allocated
-        nodeDestroy(map, node_ptr);
-        map->freeKeyElements(key_copy);
-        return NULL;
-    }
-    //inser copies to the new node
-    node_ptr->key = key_copy;
-    node_ptr->data = data_copy;
-    node_ptr->next = NULL;
-    return node_ptr;
+    return NULL;
 }
 
-  
+
 Map mapCreate(copyMapDataElements copyDataElement,
     copyMapKeyElements copyKeyElement,
     freeMapDataElements freeDataElement,
     freeMapKeyElements freeKeyElement,
     compareMapKeyElements compareKeyElements) {
+    return mapCreateWithOptions(copyDataElement, copyKeyElement, freeDataElement, freeKeyElement,
+        compareKeyElements, NULL);
+}
 
-    if (!(copyDataElement) || !(copyKeyElement) ||
-        !(freeDataElement) || !(freeKeyElement) ||
-        !(compareKeyElements)) {
+Map mapCreateWithOptions(copyMapDataElements copyDataElement,
+    copyMapKeyElements copyKeyElement,
+    freeMapDataElements freeDataElement,
+    freeMapKeyElements freeKeyElement,
+    compareMapKeyElements compareKeyElements,
+    const MapOptions* options) {
+    return mapCreateWithAllocator(copyDataElement, copyKeyElement, freeDataElement, freeKeyElement,
+        compareKeyElements, options, NULL);
+}
+
+Map mapCreateWithAllocator(copyMapDataElements copyDataElement,
+    copyMapKeyElements copyKeyElement,
+    freeMapDataElements freeDataElement,
+    freeMapKeyElements freeKeyElement,
+    compareMapKeyElements compareKeyElements,
+    const MapOptions* options,
+    const MapAllocator* allocator) {
+
+    if (!allocator) {
+        allocator = &map_malloc_allocator;
+    }
+    if (!allocator->allocate || !allocator->deallocate) {
         return NULL;
     }
-
-    Map map = malloc(sizeof(*map));
-    //allocation failed
-    if (!(map)) {
+    bool int_keys = options && options->keyType == MAP_KEY_INT;
+    bool uint64_keys = options && options->keyType == MAP_KEY_UINT64;
+    bool plain_data = options && options->dataSize;
+    if (!(copyKeyElement) || !(freeKeyElement) ||
+        ((!(copyDataElement) || !(freeDataElement)) && !plain_data) ||
+        (!(compareKeyElements) && !int_keys && !uint64_keys)) {
+        return NULL;
+    }
+    if (options && ((options->keyType != MAP_KEY_POINTER && !int_keys && !uint64_keys) || options->capacity < 0)) {
+        return NULL;
+    }
+    //inline data is held in the data field of the entries, so it must fit in it
+    bool inline_data = options && options->inlineData;
+    if (inline_data && (!plain_data || options->dataSize > sizeof(MapDataElement))) {
+        return NULL;
+    }
+    const MapEngineOps* engine = mapEngineOps(options ? options->engine : MAP_ENGINE_DEFAULT);
+    if (!engine) {
         return NULL;
     }
 
-    map->size = 0;//map is empty at first and it was put it here because nodeCreate addresses the size
-    
-    map->head = nodeCreate(map,NULL,NULL);
+    Map map = allocator->allocate(allocator->context, sizeof(*map));
     //allocation failed
-    if (!(map->head)) {
-        free(map);//free what has already been allocated
+    if (!(map)) {
         return NULL;
     }
+    map->allocator = *allocator;
 
-    map->iterator = map->head; //head and iterator, at first, point to the head of the list which is the map
-   
+    map->size = 0;
+    map->iterator_valid = false;
+    map->version = 0;
     map->copyDataElements = copyDataElement;
     map->copyKeyElements = copyKeyElement;
     map->freeDataElements = freeDataElement;
     map->freeKeyElements = freeKeyElement;
     map->compareKeyElements = compareKeyElements;
+    map->hashKeyElements = options ? options->hashKeyElement : NULL;
+    map->encodeKeyElements = options ? options->encodeKeyElement : NULL;
+    map->decodeKeyElements = options ? options->decodeKeyElement : NULL;
+    map->encodeDataElements = options ? options->encodeDataElement : NULL;
+    map->decodeDataElements = options ? options->decodeDataElement : NULL;
+    map->hash = NULL;
+    map->shared = false;
+    map->key_type = options ? options->keyType : MAP_KEY_POINTER;
+    map->key_size = uint64_keys ? (MAP_UINT64_KEYS_INLINE ? 0 : sizeof(uint64_t)) :
+                    options && !int_keys ? options->keySize : 0;
+    map->data_size = options ? options->dataSize : 0;
+    map->inline_data = inline_data;
+    map->take_key = false;
+    mapResetStats(map);
 
+    map->pool = mapPoolCreate(&map->allocator);
+    if (!map->pool) {
+        allocator->deallocate(allocator->context, map, sizeof(*map));
+        return NULL;
+    }
+    map->engine_kind = options ? options->engine : MAP_ENGINE_DEFAULT;
+    map->engine = engine;
+    //a map held by the array engine builds its hash index once promoted, see mapHashReady
+    if (!map->engine->create(map) ||
+        (map->hashKeyElements && map->engine != &map_array_engine && !mapHashCreate(map))) {
+        mapPoolDestroy(map->pool);//frees what has already been allocated
+        allocator->deallocate(allocator->context, map, sizeof(*map));
+        return NULL;
+    }
+    if (options && options->capacity > 0 && mapReserve(map, options->capacity) != MAP_SUCCESS) {
+        mapDestroy(map);
+        return NULL;
+    }
     return map;
 }
 
+/**
+ * mapGetOptions: fills the options a map was created with.
+ *
+ * @param map - the map whose options are read.
+ * @param options - pointer to the options to fill.
+ */
+static void mapGetOptions(Map map, MapOptions* options) {
+    options->hashKeyElement = map->hashKeyElements;
+    options->engine = map->engine_kind;
+    options->keyType = map->key_type;
+    options->keySize = map->key_size;
+    options->dataSize = map->data_size;
+    options->inlineData = map->inline_data;
+    options->encodeKeyElement = map->encodeKeyElements;
+    options->decodeKeyElement = map->decodeKeyElements;
+    options->encodeDataElement = map->encodeDataElements;
+    options->decodeDataElement = map->decodeDataElements;
+    options->capacity = 0;//a copy makes room for the pairs it is loaded with
+}
+
 void mapDestroy(Map map) {
     if (!map) {
         return;
     }
-    mapClear(map);//certainly it doesn't return MAP_NULL_ARGUMENT  because NULL has already been checked above
-    nodeDestroy(map, map->head);//destroy deme
-    free(map);
+    //the pool holds the engine and the index, only elements with memory of their own need a walk,
+    //as do nodes shared with snapshots, which must be unlinked from them
+    if (mapElementsNeedFree(map) || mapPoolIsShared(map->pool)) {
+        map->engine->destroy(map);
+    }
+    mapPoolDestroy(map->pool);
+    MapAllocator allocator = map->allocator;
+    allocator.deallocate(allocator.context, map, sizeof(*map));
 }
 
 Map mapCopy(Map map) {
     if (!map) {
         return NULL;
     }
-    Map map_copy = mapCreate(map->copyDataElements, map->copyKeyElements, map->freeDataElements,
-        map->freeKeyElements, map->compareKeyElements);
-    if (!map_copy) {
+    return mapCopyWithAllocator(map, &map->allocator);
+}
+
+Map mapCopyWithAllocator(Map map, const MapAllocator* allocator) {
+    if (!map) {
         return NULL;
     }
+    MapOptions options;
+    mapGetOptions(map, &options);
+    Map map_copy = mapCreateWithAllocator(map->copyDataElements, map->copyKeyElements, map->freeDataElements,
+        map->freeKeyElements, map->compareKeyElements, &options, allocator);
+    if (!map_copy || map->size == 0) {
+        return map_copy;
+    }
 
-    Node current = map->head->next;//we need the loop to start copying from the actual first node and not from 
-                                   //the deme because the deme node is created along with map_copy
-
-    while (current) {
-        MapResult result = mapPut(map_copy, current->key, current->data);//start copy 
-        if (result != MAP_SUCCESS) {
-            mapDestroy(map_copy);
-            return NULL;
-        }
-        current = current->next;
+    //the pairs come out of the engine in order, so the copy is loaded without a search per key
+    size_t entries_size = map->size * sizeof(struct map_entry_t);
+    MapEntry entries = map_copy->allocator.allocate(map_copy->allocator.context, entries_size);
+    if (!entries) {
+        mapDestroy(map_copy);
+        return NULL;
+    }
+    int count = 0;
+    struct map_iterator_t iterator;//a local iterator, the internal one is left untouched
+    for (MapEntry entry = map->engine->first(map, &iterator); entry; entry = map->engine->next(map, &iterator)) {
+        entries[count].key = entry->key;
+        entries[count++].data = mapEntryData(map, entry);
+    }
+    MapResult result = mapLoadCopies(map_copy, entries, count);
+    map_copy->allocator.deallocate(map_copy->allocator.context, entries, entries_size);
+    if (result != MAP_SUCCESS) {
+        mapDestroy(map_copy);
+        return NULL;
     }
     return map_copy;
 }
 
-int mapGetSize(Map map) {
+Map mapSnapshot(Map map) {
     if (!map) {
-        return -1;
+        return NULL;
+    }
+    if (!map->engine->share) {
+        return mapCopy(map);
     }
+    Map snapshot = map->allocator.allocate(map->allocator.context, sizeof(*snapshot));
+    if (!snapshot) {
+        return NULL;
+    }
+    *snapshot = *map;
+    snapshot->iterator_valid = false;
+    snapshot->version = 0;
+    snapshot->engine_data = NULL;
+    snapshot->hash = NULL;//built by the first lookup, see mapHashReady
+    mapResetStats(snapshot);
+    if (!map->engine->share(map, snapshot)) {
+        map->allocator.deallocate(map->allocator.context, snapshot, sizeof(*snapshot));
+        return NULL;
+    }
+    mapPoolShare(map->pool);
+    map->shared = true;
+    snapshot->shared = true;
+    return snapshot;
+}
 
-    return map->size-1;
+MapResult mapBuildIndex(Map map) {
+    if (!map) {
+        return MAP_NULL_ARGUMENT;
+    }
+    if (!map->hashKeyElements || map->engine == &map_array_engine) {
+        return MAP_SUCCESS;
+    }
+    return mapHashReady(map) ? MAP_SUCCESS : MAP_OUT_OF_MEMORY;
+}
+
+MapResult mapReserve(Map map, int size) {
+    if (!map) {
+        return MAP_NULL_ARGUMENT;
+    }
+    if (size <= map->size) {
+        return MAP_SUCCESS;
+    }
+    if (!map->engine->reserve(map, size)) {
+        return MAP_OUT_OF_MEMORY;
+    }
+    //an adaptive map may have been promoted, its index is built now instead of on its first lookup
+    if (map->hashKeyElements && map->engine != &map_array_engine &&
+        (!mapHashReady(map) || !mapHashReserve(map, size))) {
+        return MAP_OUT_OF_MEMORY;
+    }
+    int missing = size - map->size;
+    size_t data_size = map->inline_data ? 0 : map->data_size;//inline data takes no blocks
+    //plain keys and data of one size take their blocks from the same class of the pool
+    if (map->key_size && map->key_size == data_size) {
+        return mapPoolReserve(map->pool, map->key_size, 2 * missing) ? MAP_SUCCESS : MAP_OUT_OF_MEMORY;
+    }
+    if ((map->key_size && !mapPoolReserve(map->pool, map->key_size, missing)) ||
+        (data_size && !mapPoolReserve(map->pool, data_size, missing))) {
+        return MAP_OUT_OF_MEMORY;
+    }
+    return MAP_SUCCESS;
 }
 
-static Node mapContainsKey(Map map, MapKeyElement key) {
-    if (!map || !key || map->size<=1) {//if it's map->size==1 then it's only deme 
-                                      
+Map mapCreateFromSorted(copyMapDataElements copyDataElement,
+    copyMapKeyElements copyKeyElement,
+    freeMapDataElements freeDataElement,
+    freeMapKeyElements freeKeyElement,
+    compareMapKeyElements compareKeyElements,
+    const MapOptions* options,
+    MapKeyElement* keyElements,
+    MapDataElement* dataElements,
+    int count) {
+    if (count < 0 || (count > 0 && (!keyElements || !dataElements))) {
         return NULL;
     }
+    Map map = mapCreateWithOptions(copyDataElement, copyKeyElement, freeDataElement, freeKeyElement,
+        compareKeyElements, options);
+    if (!map || count == 0) {
+        return map;
+    }
 
-    Node current_node = map->head->next;
-    while (current_node) {
-        if (map->compareKeyElements(current_node->key, key) == 0) {
-            return current_node;//no need to copy since it's an internal function 
-                           //and we don't return it to the user
-                           //also it's used for getKey function
-                           //where you guys asked to return the key itself and not a copy of it     
+    size_t entries_size = count * sizeof(struct map_entry_t);
+    MapEntry entries = map->allocator.allocate(map->allocator.context, entries_size);
+    if (!entries) {
+        mapDestroy(map);
+        return NULL;
+    }
+    bool sorted = true;
+    for (int i = 0; i < count && sorted; i++) {
+        if (!keyElements[i] || !dataElements[i]) {
+            sorted = false;
+            break;
         }
-        current_node = current_node->next;
+        entries[i].key = mapKeyIn(map, keyElements[i]);
+        entries[i].data = dataElements[i];
+        //a key that is not greater than the previous one is out of order or repeats
+        sorted = i == 0 || mapCompareKeys(map, entries[i - 1].key, entries[i].key) < 0;
+    }
+    MapResult result = sorted ? mapLoadCopies(map, entries, count) : MAP_NULL_ARGUMENT;
+    map->allocator.deallocate(map->allocator.context, entries, entries_size);
+    if (result != MAP_SUCCESS) {
+        mapDestroy(map);
+        return NULL;
     }
-    return NULL; //if we're here then key wasn't not found
+    return map;
+}
 
+int mapGetSize(Map map) {
+    if (!map) {
+        return -1;
+    }
+
+    return map->size;
 }
 
 bool mapContains(Map map, MapKeyElement element) {
-
-    Node node = mapContainsKey(map, element);
-    if (!node) {
-        return 0;
+    if (!map || !element) {
+        return false;
+    }
+    MAP_COUNT(map, lookups, 1);
+    MapKeyElement key = mapKeyIn(map, element);
+    if (mapHashReady(map)) {
+        return mapHashFind(map, key) != NULL;
     }
-    return 1;
+    return map->engine->find(map, key) != NULL;
 }
 
 MapResult mapPut(Map map, MapKeyElement keyElement, MapDataElement dataElement) {
     if (!map || !keyElement || !dataElement) {
         return MAP_NULL_ARGUMENT;
     }
-    int compare_keys;
-    Node current_node = map->head;
-    Node next_node = current_node->next;
-    while (next_node) {
-        compare_keys = map->compareKeyElements(next_node->key, keyElement);
-
-        if (compare_keys == 0) {
-            MapDataElement data_copy = map->copyDataElements(dataElement);
-            if (!data_copy) {
-                return MAP_OUT_OF_MEMORY;
-            }
-            map->freeDataElements(next_node->data);
-            next_node->data = data_copy;
-            return MAP_SUCCESS;
-        }
+    return mapInsert(map, mapKeyIn(map, keyElement), dataElement, false, false);
+}
 
-        else if (compare_keys > 0) {
-            Node new_node = nodeCreate(map, keyElement, dataElement); //data not copied data because in create it copies
-            if (!new_node) {
-                return MAP_OUT_OF_MEMORY;
-            }
-            //insert between current_node and next_node
-            new_node->next = current_node->next;
-            current_node->next = new_node;
-            return MAP_SUCCESS;
+MapResult mapPutTake(Map map, MapKeyElement keyElement, MapDataElement dataElement) {
+    if (!map || !keyElement || !dataElement) {
+        return MAP_NULL_ARGUMENT;
+    }
+    return mapInsert(map, mapKeyIn(map, keyElement), dataElement, true, false);
+}
+
+MapResult mapPutHint(Map map, MapKeyElement keyElement, MapDataElement dataElement) {
+    if (!map || !keyElement || !dataElement) {
+        return MAP_NULL_ARGUMENT;
+    }
+    return mapInsert(map, mapKeyIn(map, keyElement), dataElement, false, true);
+}
+
+MapDataElement mapGetOrInsert(Map map, MapKeyElement keyElement, MapDataElement dataElement, bool* inserted) {
+    if (inserted) {
+        *inserted = false;
+    }
+    if (!map || !keyElement || !dataElement) {
+        return NULL;
+    }
+    MAP_COUNT(map, lookups, 1);
+    MapKeyElement key = mapKeyIn(map, keyElement);
+    //a present key is found without copying the data, by the index, or by the engine
+    //when the data is costlier to copy than plain bytes. Inline data costs nothing to
+    //copy, so the engine's insertion alone finds or adds the key, in one traversal.
+    //A map sharing pairs with a snapshot goes through the insertion too, which gives
+    //the pair found a copy of its own (see mapGetMutable)
+    if (!map->inline_data && !map->shared && (mapHashReady(map) || !map->data_size)) {
+        MapDataElement data = NULL;
+        if (map->hash) {
+            data = mapHashFind(map, key);
+        }
+        else {
+            MapEntry entry = map->engine->find(map, key);
+            data = entry ? mapEntryData(map, entry) : NULL;
+        }
+        if (data) {
+            return data;
         }
-        current_node = next_node;//it's needed in case we need to insert the node not first
-        next_node = next_node->next;
     }
-    //if we're here then for sure a new node is supposed to be inserted last
-    Node new_node = nodeCreate(map, keyElement, dataElement); //not copied data because in nodecreate copies them
-    if (!new_node) {
-        return MAP_OUT_OF_MEMORY;
+
+    if (map->hash && !mapHashReserve(map, map->size + 1)) {
+        return NULL;
     }
-    current_node->next = new_node;  
-    return MAP_SUCCESS;
+    MapDataElement data_copy = NULL;
+    if (!mapCopyData(map, dataElement, &data_copy)) {
+        return NULL;
+    }
+    bool created = false;
+    MapEntry entry = map->engine->insert(map, key, &created);
+    if (!entry || !created) {
+        mapFreeData(map, data_copy);
+        return entry ? mapEntryData(map, entry) : NULL;
+    }
+    entry->data = data_copy;
+    mapStructureChanged(map);
+    map->size++;
+    MAP_COUNT(map, inserts, 1);
+    if (map->hash) {
+        mapHashPut(map, entry->key, data_copy);
+    }
+    if (inserted) {
+        *inserted = true;
+    }
+    return mapEntryData(map, entry);
 }
 
 MapDataElement mapGet(Map map, MapKeyElement keyElement) {
     if (!map || !keyElement) {
         return NULL;
     }
+    MAP_COUNT(map, lookups, 1);
+    MapKeyElement key = mapKeyIn(map, keyElement);
+    if (!map->inline_data && mapHashReady(map)) {
+        return mapHashFind(map, key);
+    }
 
-    Node node_key = mapContainsKey(map, keyElement);
-    if (!node_key) {
+    MapEntry entry = map->engine->find(map, key);
+    if (!entry) {
         return NULL;
     }
-    assert(node_key->data);//data is not supposed to be NULL as it's not allowed in mapPut
-    return node_key->data; // no copy as required
+    //data is not supposed to be NULL as it's not allowed in mapPut, inline data may be 0
+    assert(entry->data || map->inline_data);
+    return mapEntryData(map, entry); // no copy as required
 }
 
-static void nodeDestroy(Map map, Node node) {
-    if (!map || !node) {
-        return;
+MapDataElement mapGetMutable(Map map, MapKeyElement keyElement) {
+    if (!map || !keyElement) {
+        return NULL;
+    }
+    if (!map->shared) {
+        return mapGet(map, keyElement);
+    }
+    MAP_COUNT(map, lookups, 1);
+    MapKeyElement key = mapKeyIn(map, keyElement);
+    if (!map->engine->find(map, key)) {
+        return NULL;
     }
-    map->freeDataElements(node->data);
-    map->freeKeyElements(node->key);
-    free(node);
+    //inserting a present key copies the shared nodes on its way and the pair's data,
+    //exactly as replacing its data would
+    bool created = false;
+    MapEntry entry = map->engine->insert(map, key, &created);
+    assert(!created);
+    return entry ? mapEntryData(map, entry) : NULL;
 }
 
 MapResult mapRemove(Map map, MapKeyElement keyElement) {
-    if (!map|| !keyElement) {
+    if (!map || !keyElement) {
         return MAP_NULL_ARGUMENT;
     }
 
-    Node previous_node = map->head;
-    Node next_node = previous_node->next;
-    while (next_node) {
-        if (map->compareKeyElements(next_node->key, keyElement) == 0) {
-            previous_node->next = next_node->next;//link previous node to next node 
-                                                      //before removing current iterator node
-            nodeDestroy(map, next_node);
-            map->size--;
-            return MAP_SUCCESS;
-        }
-        previous_node = next_node;
-        next_node = next_node->next;
+    struct map_entry_t removed;
+    MapResult result = mapUnlink(map, mapKeyIn(map, keyElement), &removed);
+    if (result != MAP_SUCCESS) {
+        return result;
     }
-    assert(mapContains(map,keyElement)==0);
-    return MAP_ITEM_DOES_NOT_EXIST;
+    mapFreeEntry(map, &removed);
+    return MAP_SUCCESS;
 }
 
 MapKeyElement mapGetFirst(Map map) {
@@ -334,21 +953,72 @@ MapKeyElement mapGetFirst(Map map) {
         return NULL;
     }
 
-    map->iterator = map->head;
-    MapKeyElement copy_key = mapGetNext(map);//next since the first one is deme
-                                                 //assume success as requested
+    MapEntry entry = map->engine->first(map, &map->iterator);
+    map->iterator_valid = entry != NULL;
+    if (!entry) {
+        return NULL;
+    }
+    return mapKeyOut(map, entry->key);//assume success as requested
+}
+
+MapKeyElement mapSeek(Map map, MapKeyElement keyElement) {
+    if (!map || !keyElement) {
+        return NULL;
+    }
 
-    return copy_key;
+    MapEntry entry = map->engine->seek(map, mapKeyIn(map, keyElement), &map->iterator);
+    map->iterator_valid = entry != NULL;
+    if (!entry) {
+        return NULL;
+    }
+    return mapKeyOut(map, entry->key);//assume success as requested
 }
+
 MapKeyElement mapGetNext(Map map) {
-    if (!map || !map->iterator->next) {
+    if (!map || !map->iterator_valid) {
+        return NULL;
+    }
+
+    MapEntry entry = map->engine->next(map, &map->iterator);
+    map->iterator_valid = entry != NULL;
+    if (!entry) {
+        return NULL;
+    }
+    return mapKeyOut(map, entry->key);//assume success as requested
+}
+
+MapResult mapGetPoolStats(Map map, MapPoolStats* stats) {
+    if (!map || !stats) {
+        return MAP_NULL_ARGUMENT;
+    }
+    mapPoolGetStats(map->pool, stats);
+    return MAP_SUCCESS;
+}
+
+const MapAllocator* mapGetAllocator(Map map) {
+    if (!map) {
         return NULL;
     }
-    map->iterator = map->iterator->next;
+    return &map->allocator;
+}
 
-    MapKeyElement copy_key = map->copyKeyElements(map->iterator->key);//assume success as requested                                         //assume success as requested
+MapResult mapGetStats(Map map, MapStats* stats) {
+    if (!map || !stats) {
+        return MAP_NULL_ARGUMENT;
+    }
+    *stats = map->stats;
+    return MAP_SUCCESS;
+}
 
-    return copy_key;
+MapResult mapResetStats(Map map) {
+    if (!map) {
+        return MAP_NULL_ARGUMENT;
+    }
+    memset(&map->stats, 0, sizeof(map->stats));
+#ifdef MAP_STATS
+    map->stats.enabled = true;
+#endif
+    return MAP_SUCCESS;
 }
 
 MapResult mapClear(Map map) {
@@ -356,14 +1026,251 @@ MapResult mapClear(Map map) {
         return MAP_NULL_ARGUMENT;
     }
 
-    Node current_node = map->head;
+    map->engine->clear(map);
+    if (map->hash) {
+        mapHashClear(map);
+    }
+    map->size = 0;
+    mapStructureChanged(map);
+    return MAP_SUCCESS;
+}
 
-    while (map->size>1) { //when it's one, we're left with the deme and we'll release it separately
-        mapRemove(map, current_node->next->key);
+MapResult mapMergeWith(Map map, Map other, mergeMapElements merge, void* context) {
+    if (!map || !other || !merge) {
+        return MAP_NULL_ARGUMENT;
+    }
+    if (map->key_type != other->key_type) {
+        return MAP_ERROR;
+    }
+    //merge may change the data of map in place, which must not reach its snapshots
+    if (!mapUnshare(map)) {
+        return MAP_OUT_OF_MEMORY;
     }
 
-    assert(map->size == 1);//asserting it's 1 as supposed to be in order to remain only with
-                          //the deme node so if the user wants to use mapPut after mapClear would be okay
+    struct map_iterator_t iterator, other_iterator;
+    MapEntry entry = map->engine->first(map, &iterator);
+    MapEntry other_entry = other->engine->first(other, &other_iterator);
+    while (entry || other_entry) {
+        //the smaller key goes alone, equal keys go together
+        int compare_keys = !entry ? 1 : !other_entry ? -1 : mapCompareKeys(map, entry->key, other_entry->key);
+        MapKeyElement key = compare_keys <= 0 ? entry->key : other_entry->key;
+        MapKeyValue key_value;
+        merge(mapKeyView(map, key, &key_value), compare_keys <= 0 ? mapEntryData(map, entry) : NULL,
+              compare_keys >= 0 ? mapEntryData(other, other_entry) : NULL, context);
+        if (compare_keys <= 0) {
+            entry = map->engine->next(map, &iterator);
+        }
+        if (compare_keys >= 0) {
+            other_entry = other->engine->next(other, &other_iterator);
+        }
+    }
     return MAP_SUCCESS;
 }
 
+int mapRemoveIf(Map map, matchMapElements match, void* context) {
+    if (!map || !match) {
+        return -1;
+    }
+
+    int removed = 0;
+    if (map->engine->remove_if) {
+        struct map_match_t map_match = { match, context };
+        removed = map->engine->remove_if(map, mapUnlinkMatch, &map_match);
+        if (removed > 0) {
+            map->size -= removed;
+            MAP_COUNT(map, removes, removed);
+            mapStructureChanged(map);
+        }
+        return removed;
+    }
+    //each removal rebalances, so the walk goes on from the successor of the removed key
+    struct map_iterator_t iterator;
+    MapEntry entry = map->engine->first(map, &iterator);
+    while (entry) {
+        if (!mapMatches(map, entry, match, context)) {
+            entry = map->engine->next(map, &iterator);
+            continue;
+        }
+        struct map_entry_t removed_entry;
+        if (mapUnlink(map, entry->key, &removed_entry) != MAP_SUCCESS) {
+            break;//a node shared with a snapshot couldn't be copied
+        }
+        entry = map->engine->seek(map, removed_entry.key, &iterator);
+        mapFreeEntry(map, &removed_entry);
+        removed++;
+    }
+    return removed;
+}
+
+/**
+ * mapCursorCopyBound: makes a cursor's copy of a bound of its range. Plain keys are copied
+ * with the map's allocator rather than into its pool, so creating a cursor doesn't change
+ * the map (see the thread safety notes in map.h).
+ *
+ * @param map - the map of the cursor.
+ * @param keyElement - the user's key element.
+ * @param bound - pointer to store the copy in, as stored in entries (see mapKeyIn).
+ * @return
+ * false if the copy failed, true otherwise.
+ */
+static bool mapCursorCopyBound(Map map, MapKeyElement keyElement, MapKeyElement* bound) {
+    if (!map->key_size) {
+        return mapCopyKey(map, mapKeyIn(map, keyElement), bound);
+    }
+    *bound = map->allocator.allocate(map->allocator.context, map->key_size);
+    if (!*bound) {
+        return false;
+    }
+    memcpy(*bound, keyElement, map->key_size);
+    return true;
+}
+
+/**
+ * mapCursorFreeBound: frees a bound made by mapCursorCopyBound.
+ *
+ * @param map - the map of the cursor.
+ * @param bound - the bound to free.
+ */
+static void mapCursorFreeBound(Map map, MapKeyElement bound) {
+    if (!map->key_size) {
+        mapFreeKey(map, bound);
+        return;
+    }
+    map->allocator.deallocate(map->allocator.context, bound, map->key_size);
+}
+
+MapCursor mapCursorCreate(Map map) {
+    return mapCursorCreateRange(map, NULL, NULL);
+}
+
+MapCursor mapCursorCreateRange(Map map, MapKeyElement fromKey, MapKeyElement toKey) {
+    if (!map) {
+        return NULL;
+    }
+    MapCursor cursor = map->allocator.allocate(map->allocator.context, sizeof(*cursor));
+    if (!cursor) {
+        return NULL;
+    }
+    cursor->map = map;
+    cursor->entry = NULL;
+    cursor->successor = NULL;
+    cursor->started = false;
+    cursor->removed = false;
+    cursor->version = map->version;
+    cursor->from = NULL;
+    cursor->to = NULL;
+    cursor->has_from = false;
+    cursor->has_to = false;
+    //the bounds are kept as entry keys, so the steps compare them without converting
+    if (fromKey) {
+        cursor->has_from = mapCursorCopyBound(map, fromKey, &cursor->from);
+        if (!cursor->has_from) {
+            mapCursorDestroy(cursor);
+            return NULL;
+        }
+    }
+    if (toKey) {
+        cursor->has_to = mapCursorCopyBound(map, toKey, &cursor->to);
+        if (!cursor->has_to) {
+            mapCursorDestroy(cursor);
+            return NULL;
+        }
+    }
+    return cursor;
+}
+
+void mapCursorDestroy(MapCursor cursor) {
+    if (!cursor) {
+        return;
+    }
+    if (cursor->has_from) {
+        mapCursorFreeBound(cursor->map, cursor->from);
+    }
+    if (cursor->has_to) {
+        mapCursorFreeBound(cursor->map, cursor->to);
+    }
+    MapAllocator* allocator = &cursor->map->allocator;
+    allocator->deallocate(allocator->context, cursor, sizeof(*cursor));
+}
+
+bool mapCursorNext(MapCursor cursor) {
+    if (!cursor) {
+        return false;
+    }
+    Map map = cursor->map;
+    if (cursor->version != map->version) {
+        cursor->entry = NULL;//the pairs moved under the cursor
+        return false;
+    }
+    if (!cursor->started) {
+        cursor->started = true;
+        cursor->entry = cursor->has_from ? map->engine->seek(map, cursor->from, &cursor->iterator)
+                                         : map->engine->first(map, &cursor->iterator);
+    }
+    else if (cursor->removed) {
+        cursor->removed = false;
+        cursor->entry = cursor->successor;
+    }
+    else if (cursor->entry) {
+        cursor->entry = map->engine->next(map, &cursor->iterator);
+    }
+    if (cursor->entry && cursor->has_to && mapCompareKeys(map, cursor->entry->key, cursor->to) > 0) {
+        cursor->entry = NULL;//past the end of the range, the cursor stays there
+    }
+    return cursor->entry != NULL;
+}
+
+MapResult mapCursorSeek(MapCursor cursor, MapKeyElement keyElement) {
+    if (!cursor || !keyElement) {
+        return MAP_NULL_ARGUMENT;
+    }
+    Map map = cursor->map;
+    MapKeyElement key = mapKeyIn(map, keyElement);
+    if (cursor->has_from && mapCompareKeys(map, key, cursor->from) < 0) {
+        key = cursor->from;
+    }
+    //the found pair waits as the successor of a removed one, the next step moves to it
+    cursor->successor = map->engine->seek(map, key, &cursor->iterator);
+    cursor->entry = NULL;
+    cursor->started = true;
+    cursor->removed = true;
+    cursor->version = map->version;
+    return MAP_SUCCESS;
+}
+
+MapKeyElement mapCursorGetKey(MapCursor cursor) {
+    if (!cursor || !cursor->entry) {
+        return NULL;
+    }
+    return mapKeyView(cursor->map, cursor->entry->key, &cursor->key_value);
+}
+
+MapDataElement mapCursorGetData(MapCursor cursor) {
+    if (!cursor || !cursor->entry) {
+        return NULL;
+    }
+    return mapEntryData(cursor->map, cursor->entry);
+}
+
+MapResult mapCursorRemove(MapCursor cursor) {
+    if (!cursor) {
+        return MAP_NULL_ARGUMENT;
+    }
+    Map map = cursor->map;
+    if (cursor->version != map->version || !cursor->entry) {
+        return MAP_ITEM_DOES_NOT_EXIST;
+    }
+    struct map_entry_t removed;
+    MapResult result = mapUnlink(map, cursor->entry->key, &removed);
+    assert(result != MAP_ITEM_DOES_NOT_EXIST);
+    if (result != MAP_SUCCESS) {
+        return result;
+    }
+    //the key is freed only after the successor was found with it
+    cursor->successor = map->engine->seek(map, removed.key, &cursor->iterator);
+    mapFreeEntry(map, &removed);
+    cursor->entry = NULL;
+    cursor->removed = true;
+    cursor->version = map->version;
+    return MAP_SUCCESS;
+}
@@ -2,27 +2,71 @@
 #define MAP_H_
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include "map_types.h"
 
 /**
 * Generic Map Container
 *
 * Implements a map container type.
+* The map keeps its keys sorted, in a sorted array while it holds a few tens of
+* keys and in a balanced (AVL) tree past that, so mapContains, mapPut, mapGet and
+* mapRemove take O(log n) key comparisons, and iterating with
+* mapGetFirst/mapGetNext visits the keys in ascending order.
+* A map created with a hash function (see mapCreateWithOptions) also keeps a
+* hash index next to the tree, which makes mapGet and mapContains expected O(1),
+* and may keep its pairs in another structure (a list or a B+tree) instead of the tree.
+* Each map allocates its nodes from a memory pool of its own, which is released
+* at once when the map is destroyed.
 * The map has an internal iterator for external use. For all functions
 * where the state of the iterator after calling that function is not stated,
 * it is undefined. That is you cannot assume anything about it.
 *
+* A map is not synchronized. Any number of threads may read one map at once,
+* through mapGetSize, mapContains, mapGet and cursors of their own, as long as no
+* thread changes the map meanwhile and its allocator is safe to call from several
+* threads (malloc is, an arena is not). Readers don't use the internal iterator,
+* which is shared. A snapshot, or an adaptive map that outgrew its array, builds its
+* hash index on its first lookup, so call mapBuildIndex before sharing it.
+* In builds made with -DMAP_STATS every read also bumps the map's counters (see
+* mapGetStats), which are not atomic, so a map of such a build must be used by one
+* thread at a time, reads included.
+* No engine of the map is safe to change from several threads at once: a map that
+* threads write concurrently must be guarded by a lock of its user's. To fill maps
+* from several threads, fill one map per thread and combine them with mapMergeWith.
+*
 * The following functions are available:
 *   mapCreate		- Creates a new empty map
+*   mapCreateWithOptions - Creates a new empty map with optional settings
+*   				  (e.g. a hash index for point lookups, another engine,
+*   				  or int keys stored by value)
+*   mapCreateWithAllocator - Creates a new empty map taking its memory from
+*   				  a given allocator
 *   mapDestroy		- Deletes an existing map and frees all resources
+*   mapCreateFromSorted - Creates a map from pairs given in key order, in
+*   				  linear time
 *   mapCopy		- Copies an existing map
+*   mapCopyWithAllocator - Copies an existing map into a given allocator
+*   mapSnapshot	- Copies an existing map in O(1), sharing its structure
+*   				  until one of them changes
+*   mapBuildIndex	- Builds the hash index of a map now instead of on its
+*   				  first lookup
+*   mapReserve		- Makes room for a number of keys ahead of adding them
 *   mapGetSize		- Returns the size of a given map
 *   mapContains	- returns weather or not a key exists inside the map.
 *   				  This resets the internal iterator.
 *   mapPut		    - Gives a specific key a given value.
 *   				  If the key exists, the value is overridden.
 *   				  This resets the internal iterator.
+*   mapPutTake	    - mapPut handing the elements over to the map instead of copying them.
+*   mapPutHint	    - mapPut for a key expected right after the last inserted one.
 *   mapGet  	    - Returns the data paired to a key which matches the given key.
 *					  Iterator status unchanged
+*   mapGetMutable	- mapGet for data about to be changed in place, which a map
+*   				  sharing it with a snapshot copies first.
+*   mapGetOrInsert - Returns the data of a key, inserting the key with given data
+*   				  if it is missing, in a single lookup.
 *   mapRemove		- Removes a pair of (key,data) elements for which the key
 *                    matches a given element (by the key compare function).
 *   				  This resets the internal iterator.
@@ -30,8 +74,33 @@
 *   				  map, and returns a copy of it.
 *   mapGetNext		- Advances the internal iterator to the next key and
 *   				  returns a copy it.
+*   mapSeek		- Sets the internal iterator to the smallest key not smaller
+*   				  than a given key, and returns a copy of it.
 *	 mapClear		- Clears the contents of the map. Frees all the elements of
 *	 				  the map using the free function.
+*	 mapMergeWith	- Walks two maps together in key order, pairing equal keys.
+*	 mapRemoveIf	- Removes all the pairs matching a predicate in one pass.
+*	 mapSerialize	- Writes the pairs of a map into a buffer, in key order.
+*	 mapDeserialize	- Fills an empty map from a buffer written by mapSerialize.
+*	 mapSerializeToFile - Writes the pairs of a map into a file.
+*	 mapDeserializeFromFile - Fills an empty map from a file.
+*	 mapGetPoolStats - Returns the occupancy of the map's memory pool.
+*	 mapGetAllocator - Returns the allocator a map takes its memory from.
+*	 mapGetStats	- Returns the operation and cost counters of a map.
+*	 mapResetStats	- Sets the counters of a map back to 0.
+*	 mapArenaCreate	- Creates an arena, a bump allocator for short lived maps.
+*	 mapArenaDestroy - Frees an arena and everything allocated from it.
+*	 mapArenaAllocator - Returns an allocator taking memory from an arena.
+*	 mapCursorCreate - Creates an external cursor over the map. Any number of
+*	 				  cursors may walk a map independently of each other and of
+*	 				  the internal iterator.
+*	 mapCursorDestroy - Deletes a cursor.
+*	 mapCursorCreateRange - Creates a cursor over the keys between two bounds.
+*	 mapCursorNext	- Advances a cursor to the next (key,data) pair.
+*	 mapCursorSeek	- Moves a cursor to the smallest key not smaller than a given key.
+*	 mapCursorGetKey - Returns the key of the cursor's pair, without copying it.
+*	 mapCursorGetData - Returns the data of the cursor's pair, without copying it.
+*	 mapCursorRemove - Removes the cursor's pair, the cursor keeps going from there.
 * 	 MAP_FOREACH	- A macro for iterating over the map's elements, iterator needs to be deallocated (freed)
 *                     each iteration.
 */
@@ -39,6 +108,9 @@
 /** Type for defining the map */
 typedef struct Map_t *Map;
 
+/** Type for defining an external cursor over a map */
+typedef struct MapCursor_t *MapCursor;
+
 /** Type used for returning error codes from map functions */
 typedef enum MapResult_t {
     MAP_SUCCESS,
@@ -77,6 +149,148 @@ typedef void(*freeMapKeyElements)(MapKeyElement);
 */
 typedef int(*compareMapKeyElements)(MapKeyElement, MapKeyElement);
 
+/**
+* Type of function used by the map to hash key elements for its hash index.
+* Key elements that are equal by the compare function must have the same hash.
+* The map scrambles the returned value itself, so returning e.g. an integer key
+* as is gives a good distribution.
+*/
+typedef unsigned int(*hashMapKeyElements)(MapKeyElement);
+
+/**
+* Type of function called by mapMergeWith for every key of the two maps, with the
+* key's data in each map (NULL in the map that lacks the key) and a user context.
+*/
+typedef void(*mergeMapElements)(MapKeyElement, MapDataElement, MapDataElement, void*);
+
+/**
+* Type of function used by mapSerialize to encode a key or data element as bytes.
+* It returns the length of the encoding, and writes the encoding into the buffer
+* only if it takes at most the given size. The buffer is NULL when the size is 0.
+*/
+typedef size_t(*encodeMapElements)(void*, unsigned char*, size_t);
+
+/**
+* Type of function used by mapDeserialize to make a new element from the bytes
+* given by the encode function, their length, and the allocator of the map being
+* filled (see MapAllocator), which the element may take its memory from. Returns
+* NULL if the bytes are not a valid encoding or an allocation failed. The map
+* takes over the element.
+*/
+struct MapAllocator_t;
+typedef void*(*decodeMapElements)(const unsigned char*, size_t, const struct MapAllocator_t*);
+
+/**
+* Type of function called by mapRemoveIf with a pair's key and data and a user
+* context. Returns true if the pair should be removed.
+*/
+typedef bool(*matchMapElements)(MapKeyElement, MapDataElement, void*);
+
+/**
+* Structure a map keeps its pairs in, chosen when the map is created.
+* All engines keep the keys sorted and behave the same, they differ in speed only.
+*/
+typedef enum MapEngine_t {
+    /** MAP_ENGINE_ADAPTIVE, or the list in builds made with -DMAP_LIST_ENGINE */
+    MAP_ENGINE_DEFAULT,
+    /** Sorted linked list, O(n) point operations. Cheap for a handful of keys */
+    MAP_ENGINE_LIST,
+    /** AVL tree, O(log n) point operations */
+    MAP_ENGINE_TREE,
+    /** B+tree whose leaves are arrays sized to cache lines and linked in key order,
+     *  O(log n) point operations and the cheapest full iterations */
+    MAP_ENGINE_BPTREE,
+    /** Sorted array while the map holds a few tens of keys, turning into the AVL tree
+     *  when it grows past them. No hash index is kept before that */
+    MAP_ENGINE_ADAPTIVE
+} MapEngine;
+
+/**
+* How a map stores its keys, chosen when the map is created.
+*/
+typedef enum MapKeyType_t {
+    /** Keys are copied with the copy function and compared with the compare function */
+    MAP_KEY_POINTER,
+    /** Key elements are pointers to int. The map stores the int values themselves,
+     *  so adding a key allocates nothing, and orders them as ints without calling
+     *  the compare function, which may be NULL. The copy and free functions are
+     *  still used for the keys returned by mapGetFirst and mapGetNext.
+     *  This is a mode of the one generic Map rather than a map generated per key
+     *  type: keys still cross the API as void*. The engines' search loops are
+     *  compiled once per key type and pick theirs once per operation, so their
+     *  comparisons don't branch on the type. Int keyed maps share the engines, the
+     *  hash index, cursors, snapshots and serialization with every other map */
+    MAP_KEY_INT,
+    /** Key elements are pointers to uint64_t, e.g. two 32 bit ids packed into one key.
+     *  Where pointers are 64 bits wide the map stores the values themselves in its
+     *  entries, as for MAP_KEY_INT, elsewhere it copies them into its pool, as for a
+     *  keySize. It orders them as integers without calling the compare function,
+     *  which may be NULL */
+    MAP_KEY_UINT64
+} MapKeyType;
+
+/**
+* Optional settings of a map, used by mapCreateWithOptions.
+* Zero initialize the struct and set only the wanted fields, a field left as
+* 0 or NULL keeps the behaviour of mapCreate.
+*/
+typedef struct MapOptions_t {
+    /** If not NULL the map keeps a hash index built with this function,
+     *  making mapGet and mapContains expected O(1). A MAP_ENGINE_ADAPTIVE map
+     *  builds it once it outgrows its array */
+    hashMapKeyElements hashKeyElement;
+    /** The structure holding the pairs */
+    MapEngine engine;
+    /** How keys are stored */
+    MapKeyType keyType;
+    /** If not 0, key elements are plain bytes of this size, holding no pointers to
+     *  memory of their own. The map copies them into its pool with memcpy instead of
+     *  calling the copy function, and releases them without calling the free function.
+     *  Ignored for MAP_KEY_INT and MAP_KEY_UINT64 */
+    size_t keySize;
+    /** The same for data elements. copyDataElement and freeDataElement may then be NULL */
+    size_t dataSize;
+    /** If true, data elements of a dataSize of at most sizeof(MapDataElement) are kept
+     *  in the map's entries, next to their keys, instead of in blocks of their own.
+     *  The data pointers the map returns then point into its entries and are valid
+     *  only until the next key is added or removed. They point at the bytes of a
+     *  MapDataElement field, so copy the data in and out through them with memcpy
+     *  rather than through a pointer to the data's own type. The hash index, if any,
+     *  then only serves mapContains, mapGet goes to the engine */
+    bool inlineData;
+    /** The codec of the key elements, used by mapSerialize and mapDeserialize.
+     *  Not needed for MAP_KEY_INT and MAP_KEY_UINT64 keys and keys with a keySize,
+     *  stored as they are */
+    encodeMapElements encodeKeyElement;
+    decodeMapElements decodeKeyElement;
+    /** The codec of the data elements. Not needed for data with a dataSize */
+    encodeMapElements encodeDataElement;
+    decodeMapElements decodeDataElement;
+    /** If not 0, the number of keys the map is expected to hold. The map is created
+     *  with room for them, see mapReserve */
+    int capacity;
+} MapOptions;
+
+/**
+* Occupancy of the memory pool of a map, see mapGetPoolStats.
+* The pool holds the map's nodes, its hash index and its plain elements.
+*/
+typedef struct MapPoolStats_t {
+    /** Bytes the pool obtained from malloc, its own bookkeeping included */
+    size_t reservedBytes;
+    /** Bytes of the blocks currently handed out */
+    size_t usedBytes;
+    /** Blocks currently handed out */
+    int usedBlocks;
+    /** Released blocks waiting on the pool's free lists to be reused */
+    int freeBlocks;
+    /** Slabs the small blocks are carved from */
+    int slabs;
+} MapPoolStats;
+
+/** Type for defining an arena, see mapArenaCreate */
+typedef struct MapArena_t *MapArena;
+
 /**
 * mapCreate: Allocates a new empty map.
 *
@@ -100,6 +314,47 @@ Map mapCreate(copyMapDataElements copyDataElement,
               freeMapKeyElements freeKeyElement,
               compareMapKeyElements compareKeyElements);
 
+/**
+* mapCreateWithOptions: Allocates a new empty map with optional settings.
+*
+* @param copyDataElement, copyKeyElement, freeDataElement, freeKeyElement,
+*       compareKeyElements - Same as in mapCreate.
+* @param options - Optional settings of the map. NULL is the same as calling mapCreate.
+*       The options are read during the call only.
+* @return
+* 	NULL - if one of the function parameters is NULL (compareKeyElements may be NULL
+* 		for MAP_KEY_INT and MAP_KEY_UINT64), options hold an unknown engine or key type, a negative
+* 		capacity or inline data of no dataSize or of a larger one, or allocations failed.
+* 	A new Map in case of success.
+*/
+Map mapCreateWithOptions(copyMapDataElements copyDataElement,
+                         copyMapKeyElements copyKeyElement,
+                         freeMapDataElements freeDataElement,
+                         freeMapKeyElements freeKeyElement,
+                         compareMapKeyElements compareKeyElements,
+                         const MapOptions* options);
+
+/**
+* mapCreateWithAllocator: Allocates a new empty map with optional settings, taking
+* all its memory from an allocator instead of malloc.
+*
+* @param copyDataElement, copyKeyElement, freeDataElement, freeKeyElement,
+*       compareKeyElements, options - Same as in mapCreateWithOptions.
+* @param allocator - The allocator, copied into the map. NULL for malloc and free.
+*       Its context must outlive the map and its copies and cursors.
+* @return
+* 	NULL - if mapCreateWithOptions would fail, a function of allocator is NULL,
+* 		or allocations failed.
+* 	A new Map in case of success.
+*/
+Map mapCreateWithAllocator(copyMapDataElements copyDataElement,
+                           copyMapKeyElements copyKeyElement,
+                           freeMapDataElements freeDataElement,
+                           freeMapKeyElements freeKeyElement,
+                           compareMapKeyElements compareKeyElements,
+                           const MapOptions* options,
+                           const MapAllocator* allocator);
+
 /**
 * mapDestroy: Deallocates an existing map. Clears all elements by using the
 * stored free functions.
@@ -110,7 +365,8 @@ Map mapCreate(copyMapDataElements copyDataElement,
 void mapDestroy(Map map);
 
 /**
-* mapCopy: Creates a copy of target map.
+* mapCopy: Creates a copy of target map, with the same options.
+* The pairs are copied in key order and appended, so copying takes linear time.
 * Iterator values for both maps is undefined after this operation.
 *
 * @param map - Target map.
@@ -120,6 +376,97 @@ void mapDestroy(Map map);
 */
 Map mapCopy(Map map);
 
+/**
+* mapCopyWithAllocator: Same as mapCopy, the copy taking its memory from another
+* allocator, e.g. an arena for a short lived copy.
+*
+* @param map - Target map.
+* @param allocator - The copy's allocator, as in mapCreateWithAllocator.
+* @return
+* 	NULL if map is NULL, a function of allocator is NULL or a memory allocation failed.
+* 	A Map containing the same elements as map otherwise.
+*/
+Map mapCopyWithAllocator(Map map, const MapAllocator* allocator);
+
+/**
+* mapSnapshot: Creates a copy of target map in O(1), which shares the map's
+* structure instead of copying it. Only the nodes a later mapPut or mapRemove
+* on either map goes through are copied, with their elements, so both maps
+* behave as independent copies while the memory is paid for once.
+* The data elements of shared pairs are shared as well: changing one in place
+* through the pointer mapGet or mapCursorGetData returns changes it in both maps.
+* Data to change in place is taken with mapGetMutable or mapGetOrInsert, which
+* copy a shared pair first, and mapMergeWith copies all of them first.
+* A mapPut or mapGetMutable that copies shared pairs invalidates the map's cursors
+* and internal iterator, as adding a key does.
+* The copy's hash index, if any, is built by its first mapGet or mapContains.
+* Maps whose engine can't share its structure (MAP_ENGINE_LIST, MAP_ENGINE_BPTREE,
+* and MAP_ENGINE_ADAPTIVE while the map is small) are copied with mapCopy.
+*
+* @param map - Target map.
+* @return
+* 	NULL if a NULL was sent or a memory allocation failed.
+* 	A Map containing the same elements as map otherwise.
+*/
+Map mapSnapshot(Map map);
+
+/**
+* mapBuildIndex: Builds the hash index of a map that has a hash function but no index
+* yet, as a snapshot has until its first mapGet or mapContains. Done before threads
+* start reading a map, it keeps these lookups from changing the map.
+*
+* @param map - Target map.
+* @return
+* 	MAP_NULL_ARGUMENT if a NULL was sent as map.
+* 	MAP_OUT_OF_MEMORY if an allocation failed, lookups then build the index.
+* 	MAP_SUCCESS otherwise, also if the map has no index to build.
+*/
+MapResult mapBuildIndex(Map map);
+
+/**
+* mapReserve: Makes room in a map for a number of keys, so that adding keys up to it
+* neither grows the hash index nor takes memory for nodes or plain elements beyond
+* the pool reserved here. Key and data elements copied with the copy functions are
+* still allocated one by one. An adaptive map reserving room for more keys than its
+* array holds turns into a tree at once.
+*
+* @param map - Target map.
+* @param size - The number of keys, counting those already in the map. Not more keys
+*       than the map holds is a no-op.
+* @return
+* 	MAP_NULL_ARGUMENT if a NULL was sent as map.
+* 	MAP_OUT_OF_MEMORY if an allocation failed, the map then holds its pairs as before,
+* 		possibly with part of the room.
+* 	MAP_SUCCESS otherwise.
+*/
+MapResult mapReserve(Map map, int size);
+
+/**
+* mapCreateFromSorted: Allocates a new map holding copies of pairs given in key order.
+* The map is built in linear time, without searching for the place of each key,
+* which makes it the fast way to load a map from an already sorted source.
+*
+* @param copyDataElement, copyKeyElement, freeDataElement, freeKeyElement,
+*       compareKeyElements, options - Same as in mapCreateWithOptions.
+* @param keyElements - Array of count key elements, in strictly increasing order
+*       according to compareKeyElements (by value for MAP_KEY_INT and MAP_KEY_UINT64).
+* @param dataElements - Array of count data elements, dataElements[i] goes with keyElements[i].
+* @param count - The number of pairs, may be 0.
+* @return
+* 	NULL - if mapCreateWithOptions would fail, count is negative, an array or an element
+* 		is NULL, the keys are not in strictly increasing order, or allocations failed.
+* 	A new Map holding the pairs in case of success.
+*/
+Map mapCreateFromSorted(copyMapDataElements copyDataElement,
+                        copyMapKeyElements copyKeyElement,
+                        freeMapDataElements freeDataElement,
+                        freeMapKeyElements freeKeyElement,
+                        compareMapKeyElements compareKeyElements,
+                        const MapOptions* options,
+                        MapKeyElement* keyElements,
+                        MapDataElement* dataElements,
+                        int count);
+
 /**
 * mapGetSize: Returns the number of elements in a map
 * @param map - The map which size is requested
@@ -161,6 +508,67 @@ bool mapContains(Map map, MapKeyElement element);
 */
 MapResult mapPut(Map map, MapKeyElement keyElement, MapDataElement dataElement);
 
+/**
+*	mapPutTake: Gives a specific key a given value, as mapPut does, but hands the
+*	elements over to the map instead of copying them. The map frees them with the
+*	free functions given at initialization, as it frees its own copies.
+*	Elements the map stores by value (MAP_KEY_INT and MAP_KEY_UINT64 keys, and
+*	keys or data with a size in MapOptions) are copied as by mapPut and stay the caller's.
+*	If the key is already in the map, the given key element is freed and the map
+*	keeps its own. This resets the internal iterator.
+*
+* @param map - The map for which to reassign value.
+* @param keyElement - The key element which need to be reassigned.
+* @param dataElement - The new data element to associate with the given key.
+* @return
+* 	MAP_NULL_ARGUMENT if a NULL was sent as map, keyElement or dataElement.
+* 	MAP_OUT_OF_MEMORY if an allocation failed, the elements are then still the caller's.
+* 	MAP_SUCCESS the paired elements had been inserted successfully.
+*/
+MapResult mapPutTake(Map map, MapKeyElement keyElement, MapDataElement dataElement);
+
+/**
+*	mapPutHint: Gives a specific key a given value, as mapPut does, hinting that the
+*	key follows the last key inserted into the map, as happens when keys arrive in
+*	ascending order. The list engine then looks for the key's place from the last
+*	insertion instead of from the smallest key, and the B+tree and adaptive engines
+*	append a key greater than all of theirs to their last leaf or to the array, so a
+*	run of ascending keys is put with one comparison each instead of a full search.
+*	A wrong hint costs one comparison. The tree engine ignores the hint. This resets the
+*	internal iterator.
+*
+* @param map - The map for which to reassign value.
+* @param keyElement - The key element which need to be reassigned.
+* @param dataElement - The new data element to associate with the given key.
+* @return
+* 	MAP_NULL_ARGUMENT if a NULL was sent as map, keyElement or dataElement.
+* 	MAP_OUT_OF_MEMORY if an allocation failed (Meaning the function for copying
+* 	an element failed)
+* 	MAP_SUCCESS the paired elements had been inserted successfully.
+*/
+MapResult mapPutHint(Map map, MapKeyElement keyElement, MapDataElement dataElement);
+
+/**
+*	mapGetOrInsert: Returns the data paired with a key, pairing the key with a copy
+*	of a given data element first if it is not in the map yet. The key is looked up
+*	once, instead of once by mapContains and once more by mapPut.
+*	The data is copied only if the key is inserted, except in a map without a hash
+*	function whose data has a size in MapOptions, or sharing its pairs with a snapshot,
+*	where a copy is made first and freed if the key is found. Resets the internal
+*	iterator if the key is inserted or a shared pair is copied.
+*
+* @param map - The map to look in.
+* @param keyElement - The key element to find, copied if it is inserted.
+* @param dataElement - The data element the key is paired with if it is inserted.
+* @param inserted - Pointer to set to true if the key was inserted, false otherwise.
+* 		May be NULL.
+* @return
+* 	NULL if a NULL pointer was sent (other than inserted) or an allocation failed,
+* 	the map is then unchanged.
+* 	The map's data paired with the key otherwise, as returned by mapGetMutable.
+*/
+MapDataElement mapGetOrInsert(Map map, MapKeyElement keyElement, MapDataElement dataElement, bool* inserted);
+
 /**
 *	mapGet: Returns the data associated with a specific key in the map.
 *			Iterator status unchanged
@@ -174,6 +582,22 @@ we want to get.
 */
 MapDataElement mapGet(Map map, MapKeyElement keyElement);
 
+/**
+*	mapGetMutable: Returns the data associated with a specific key in the map, for
+*	changing it in place. In a map sharing its pairs with a snapshot (see mapSnapshot)
+*	the pair is copied first, with the nodes on its way, so the change doesn't reach
+*	the snapshot. Any other map returns what mapGet does, at the same cost.
+*	Iterator status unchanged, unless a pair is copied (see mapSnapshot).
+*
+* @param map - The map for which to get the data element from.
+* @param keyElement - The key element whose data is to be changed.
+* @return
+*  NULL if a NULL pointer was sent, if the map does not contain the requested key, or
+*  if copying a shared pair failed, the map is then unchanged.
+* 	The data element associated with the key otherwise, which only this map holds.
+*/
+MapDataElement mapGetMutable(Map map, MapKeyElement keyElement);
+
 /**
 * 	mapRemove: Removes a pair of key and data elements from the map. The elements
 *  are found using the comparison function given at initialization. Once found,
@@ -190,6 +614,8 @@ MapDataElement mapGet(Map map, MapKeyElement keyElement);
 * @return
 * 	MAP_NULL_ARGUMENT if a NULL was sent to the function
 *  MAP_ITEM_DOES_NOT_EXIST if an equal key item does not already exists in the map
+* 	MAP_OUT_OF_MEMORY if the map shares the pair with a snapshot and copying it failed,
+* 		the map is then unchanged
 * 	MAP_SUCCESS the paired elements had been removed successfully
 */
 MapResult mapRemove(Map map, MapKeyElement keyElement);
@@ -221,6 +647,20 @@ MapKeyElement mapGetFirst(Map map);
 */
 MapKeyElement mapGetNext(Map map);
 
+/**
+*	mapSeek: Sets the internal iterator to the smallest key element in the map
+*	which is not smaller than the given one (by the key compare function), and
+*	returns a copy of it. The key doesn't need to be in the map. Costs O(log n)
+*	on the tree engines, use mapGetNext to continue from there.
+* @param map - The map for which to set the iterator.
+* @param keyElement - The key element to search from.
+* @return
+* 	NULL if a NULL pointer was sent, no key is greater or equal to keyElement
+* 	or allocation fails
+* 	The found key element otherwise
+*/
+MapKeyElement mapSeek(Map map, MapKeyElement keyElement);
+
 
 /**
 * mapClear: Removes all key and data elements from target map.
@@ -233,6 +673,278 @@ MapKeyElement mapGetNext(Map map);
 */
 MapResult mapClear(Map map);
 
+/**
+* mapMergeWith: Walks two maps with the same keys type and order together, in
+* ascending key order, and calls a function once for every key found in either
+* of them. Equal keys are paired, so the walk costs O(n + m) instead of a lookup
+* in one map for every key of the other.
+* The function must not add or remove keys of the two maps, it may change the
+* data it is given in place. A first map sharing its pairs with a snapshot is given
+* copies of its own of all of them first. The internal iterators are unchanged,
+* unless the first map's pairs are copied (see mapSnapshot).
+* @param map - The first map, its data is the second argument of merge.
+* @param other - The second map, its data is the third argument of merge.
+* @param merge - The function to call, with the key (which must not be modified
+* 		or kept) and the data of the key in map and in other.
+* @param context - Passed as is to merge.
+* @return
+* 	MAP_NULL_ARGUMENT - if map, other or merge is NULL.
+* 	MAP_ERROR - if the maps have different key types.
+* 	MAP_OUT_OF_MEMORY - if copying the pairs of map failed, nothing is merged then.
+* 	MAP_SUCCESS - Otherwise.
+*/
+MapResult mapMergeWith(Map map, Map other, mergeMapElements merge, void* context);
+
+/**
+* mapRemoveIf: Removes every pair for which a predicate returns true, freeing its
+* elements with the stored free functions, in a single walk over the map. This
+* costs O(n) on the list engine and O(n + k log n) for k removed pairs on the
+* tree engines, instead of a search from the top for every key.
+* The predicate is called once for every pair in ascending key order, it must not
+* change the map. This resets the internal iterator, as mapRemove.
+* @param map - The map to remove from.
+* @param match - The predicate, called with the key and data of a pair (which must
+* 		not be kept) and the context.
+* @param context - Passed as is to match.
+* @return
+* 	-1 if a NULL pointer was sent.
+* 	The number of removed pairs otherwise. The walk stops early if a pair shared
+* 	with a snapshot couldn't be copied (see mapRemove).
+*/
+int mapRemoveIf(Map map, matchMapElements match, void* context);
+
+/**
+* mapSerialize: Writes the pairs of a map into a buffer, in ascending key order, as
+* length prefixed records: the number of pairs, then for every pair the length and bytes
+* of its key, then of its data. Keys and data are encoded by the codec given in the
+* options, plain ones (MAP_KEY_INT and MAP_KEY_UINT64 keys, keys and data with a size
+* in the options) are
+* written as they are, in the byte order of the machine.
+* As snprintf, the length of the whole encoding is returned even if it does not fit:
+* call with a size of 0 to learn the length to allocate. The internal iterator is unchanged.
+*
+* @param map - The map to write.
+* @param buffer - Where to write, may be NULL if size is 0.
+* @param size - The size of the buffer in bytes.
+* @param length - Where the length of the encoding is stored.
+* @return
+* 	MAP_NULL_ARGUMENT if a NULL was sent as map or length, or as buffer with a size.
+* 	MAP_ERROR if the map lacks the encode function of its keys or data.
+* 	MAP_SUCCESS otherwise. The buffer holds the encoding only if *length <= size.
+*/
+MapResult mapSerialize(Map map, unsigned char* buffer, size_t size, size_t* length);
+
+/**
+* mapDeserialize: Fills an empty map with the pairs written by mapSerialize from a map
+* with the same options, in linear time.
+*
+* @param map - The empty map to fill.
+* @param buffer - The encoding.
+* @param size - The size of the buffer, which may go on past the encoding.
+* @param length - Where the number of bytes read is stored, may be NULL.
+* @return
+* 	MAP_NULL_ARGUMENT if a NULL was sent as map or buffer.
+* 	MAP_ERROR if the map is not empty, lacks the decode function of its keys or data,
+* 	or the buffer does not hold a valid encoding.
+* 	MAP_OUT_OF_MEMORY if an allocation failed.
+* 	MAP_SUCCESS otherwise. On failure the map is left empty.
+*/
+MapResult mapDeserialize(Map map, const unsigned char* buffer, size_t size, size_t* length);
+
+/**
+* mapSerializeToFile: Writes the pairs of a map into a file as mapSerialize does,
+* a record at a time.
+*
+* @param map - The map to write.
+* @param stream - An open, writable stream, left after the encoding.
+* @return
+* 	MAP_NULL_ARGUMENT if a NULL was sent.
+* 	MAP_ERROR if the map lacks the encode function of its keys or data, or writing failed.
+* 	MAP_OUT_OF_MEMORY if an allocation failed.
+* 	MAP_SUCCESS otherwise.
+*/
+MapResult mapSerializeToFile(Map map, FILE* stream);
+
+/**
+* mapDeserializeFromFile: Fills an empty map with the pairs written by mapSerializeToFile,
+* as mapDeserialize does.
+*
+* @param map - The empty map to fill.
+* @param stream - An open, readable stream, left after the encoding.
+* @return
+* 	MAP_NULL_ARGUMENT if a NULL was sent.
+* 	MAP_ERROR if the map is not empty, lacks the decode function of its keys or data,
+* 	or the stream does not hold a valid encoding.
+* 	MAP_OUT_OF_MEMORY if an allocation failed.
+* 	MAP_SUCCESS otherwise. On failure the map is left empty.
+*/
+MapResult mapDeserializeFromFile(Map map, FILE* stream);
+
+/**
+* mapGetPoolStats: Reads the occupancy of the memory pool of a map.
+* Every map allocates its nodes (and its plain elements, see MapOptions) from a
+* pool of its own. Released memory stays in the pool for reuse until the map is
+* destroyed, so the pool is as large as the map ever was.
+* @param map - The map whose pool is read.
+* @param stats - Pointer to the statistics to fill.
+* @return
+* 	MAP_NULL_ARGUMENT - if a NULL pointer was sent.
+* 	MAP_SUCCESS - Otherwise.
+*/
+MapResult mapGetPoolStats(Map map, MapPoolStats* stats);
+
+/**
+* mapGetAllocator: Returns the allocator a map takes its memory from, so that
+* memory belonging with the map can be taken from it too.
+* @param map - The map.
+* @return
+* 	NULL if a NULL pointer was sent, the map's allocator otherwise. It belongs to
+* 	the map and is valid as long as the map.
+*/
+const MapAllocator* mapGetAllocator(Map map);
+
+/**
+* mapGetStats: Reads the operation and cost counters of a map, counted since the
+* map was created or since the last mapResetStats. A copy or snapshot of a map
+* starts with counters of its own.
+* @param map - The map whose counters are read.
+* @param stats - Pointer to the counters to fill.
+* @return
+* 	MAP_NULL_ARGUMENT - if a NULL pointer was sent.
+* 	MAP_SUCCESS - Otherwise, stats->enabled tells whether the counters are kept.
+*/
+MapResult mapGetStats(Map map, MapStats* stats);
+
+/**
+* mapResetStats: Sets the counters of a map back to 0.
+* @param map - The map whose counters are reset.
+* @return
+* 	MAP_NULL_ARGUMENT - if a NULL pointer was sent.
+* 	MAP_SUCCESS - Otherwise.
+*/
+MapResult mapResetStats(Map map);
+
+/**
+* mapArenaCreate: Allocates an arena, an allocator handing out blocks carved in order
+* from large chunks. Releasing a block only gives it back if it was the last one handed
+* out, the rest is freed at once by mapArenaDestroy. This suits maps that are built,
+* used and destroyed together, as temporary copies.
+* @param chunkSize - The size of the chunks the arena takes from malloc, 0 for a default.
+* 		Larger blocks get a chunk of their own.
+* @return
+* 	NULL if allocation failed, a new arena otherwise.
+*/
+MapArena mapArenaCreate(size_t chunkSize);
+
+/**
+* mapArenaDestroy: Frees an arena and all the blocks it handed out. The maps using it
+* must have been destroyed before.
+* @param arena - The arena. NULL is ignored.
+*/
+void mapArenaDestroy(MapArena arena);
+
+/**
+* mapArenaAllocator: Returns an allocator taking its memory from an arena, to be
+* given to mapCreateWithAllocator or mapCopyWithAllocator.
+* @param arena - The arena, which must outlive the maps using it.
+* @return
+* 	The allocator.
+*/
+MapAllocator mapArenaAllocator(MapArena arena);
+
+/**
+* mapCursorCreate: Allocates a cursor over a map, positioned before its first
+* (smallest) key, so the first call to mapCursorNext moves it to the first pair.
+* Each step costs O(1) amortized and allocates nothing, the cursor hands out the
+* map's own key and data instead of copies.
+* Adding or removing keys invalidates every cursor of the map: mapCursorNext then
+* returns false. The one exception is the cursor that removed a pair with
+* mapCursorRemove. Changing the data of an existing key (with mapPut or through
+* mapCursorGetData) is allowed.
+* @param map - The map to walk.
+* @return
+* 	NULL - if a NULL pointer was sent or allocation failed.
+* 	A new cursor in case of success. The map must outlive it.
+*/
+MapCursor mapCursorCreate(Map map);
+
+/**
+* mapCursorCreateRange: Allocates a cursor over the pairs whose keys are between
+* fromKey and toKey, both included, positioned before the first of them.
+* Reaching the first pair costs O(log n) on the tree engines, the cursor then
+* behaves as one made by mapCursorCreate and stops after the last key of the range.
+* @param map - The map to walk.
+* @param fromKey - The smallest key of the range, copied. NULL for no lower bound.
+* @param toKey - The largest key of the range, copied. NULL for no upper bound.
+* @return
+* 	NULL - if map is NULL or allocation failed.
+* 	A new cursor in case of success. The map must outlive it.
+*/
+MapCursor mapCursorCreateRange(Map map, MapKeyElement fromKey, MapKeyElement toKey);
+
+/**
+* mapCursorDestroy: Deallocates a cursor. The map is not affected.
+* @param cursor - The cursor to deallocate. NULL is ignored.
+*/
+void mapCursorDestroy(MapCursor cursor);
+
+/**
+* mapCursorNext: Advances a cursor to the next pair in ascending key order.
+* @param cursor - The cursor to advance.
+* @return
+* 	false - if a NULL pointer was sent, there are no more pairs or the map's keys
+* 	changed since the cursor was created.
+* 	true - if the cursor is on a pair.
+*/
+bool mapCursorNext(MapCursor cursor);
+
+/**
+* mapCursorGetKey: Returns the key of the pair a cursor is on.
+* The key belongs to the map (for MAP_KEY_INT maps, and MAP_KEY_UINT64 maps holding
+* the keys in their entries, to the cursor): it must not
+* be modified or freed, and is valid until the cursor moves.
+* @param cursor - The cursor.
+* @return
+* 	NULL if a NULL pointer was sent or the cursor is not on a pair, the key otherwise.
+*/
+MapKeyElement mapCursorGetKey(MapCursor cursor);
+
+/**
+* mapCursorSeek: Moves a cursor so that the next call to mapCursorNext moves it to
+* the smallest key not smaller than the given one, staying within the cursor's range.
+* This also makes a cursor invalidated by a change of the map's keys usable again.
+* @param cursor - The cursor to move.
+* @param keyElement - The key element to search from, it doesn't need to be in the map.
+* @return
+* 	MAP_NULL_ARGUMENT - if a NULL pointer was sent.
+* 	MAP_SUCCESS - Otherwise.
+*/
+MapResult mapCursorSeek(MapCursor cursor, MapKeyElement keyElement);
+
+/**
+* mapCursorGetData: Returns the data of the pair a cursor is on.
+* The data belongs to the map, as the one returned by mapGet, and may be shared
+* with a snapshot: see mapGetMutable before changing it in place.
+* @param cursor - The cursor.
+* @return
+* 	NULL if a NULL pointer was sent or the cursor is not on a pair, the data otherwise.
+*/
+MapDataElement mapCursorGetData(MapCursor cursor);
+
+/**
+* mapCursorRemove: Removes the pair a cursor is on, freeing its elements with the
+* stored free functions. The cursor is then on no pair until mapCursorNext moves
+* it to the pair that followed the removed one. Other cursors of the map are
+* invalidated, as by mapRemove.
+* @param cursor - The cursor whose pair is removed.
+* @return
+* 	MAP_NULL_ARGUMENT - if a NULL pointer was sent.
+* 	MAP_ITEM_DOES_NOT_EXIST - if the cursor is not on a pair or is invalid.
+* 	MAP_OUT_OF_MEMORY - as for mapRemove, the cursor then stays on the pair.
+* 	MAP_SUCCESS - Otherwise.
+*/
+MapResult mapCursorRemove(MapCursor cursor);
+
 /*!
 * Macro for iterating over a map.
 * Declares a new iterator for the loop.
@@ -0,0 +1,135 @@
+#include "map.h"
+#include <assert.h>
+#include <stdlib.h>
+
+/**
+* Arena allocator for maps.
+*
+* Blocks are carved in order from chunks taken from malloc. Releasing the last
+* block handed out moves the top of the chunk back, any other release is only
+* reclaimed when the arena is destroyed. This makes building and tearing down a
+* short lived map (and its pool, whose slabs are released with it) a handful of
+* malloc calls.
+*/
+
+/* Blocks are aligned to ARENA_ALIGNMENT, as the pool's blocks */
+#define ARENA_ALIGNMENT 16
+#define ARENA_DEFAULT_CHUNK 65536
+
+/* Rounds a size up to a multiple of ARENA_ALIGNMENT */
+#define ARENA_ROUND(size) (((size) + ARENA_ALIGNMENT - 1) / ARENA_ALIGNMENT * ARENA_ALIGNMENT)
+
+/* Header of a chunk, followed by its blocks */
+typedef struct arena_chunk_t {
+    struct arena_chunk_t* next;
+    size_t size; // bytes for blocks, header excluded
+    size_t used; // bytes handed out from the start of the chunk
+}*ArenaChunk;
+
+#define ARENA_CHUNK_HEADER ARENA_ROUND(sizeof(struct arena_chunk_t))
+
+struct MapArena_t {
+    ArenaChunk chunks; // the newest chunk first, blocks are carved from it
+    size_t chunk_size;
+};
+
+/* declaring functions */
+static void* arenaAllocate(void* context, size_t size);
+static void arenaDeallocate(void* context, void* pointer, size_t size);
+static ArenaChunk arenaAddChunk(MapArena arena, size_t size);
+
+
+/**
+ * arenaAddChunk: takes a new chunk from malloc.
+ *
+ * @param arena - the arena.
+ * @param size - bytes for blocks in the chunk.
+ * @return
+ * NULL if malloc failed, the new chunk otherwise.
+ */
+static ArenaChunk arenaAddChunk(MapArena arena, size_t size) {
+    ArenaChunk chunk = malloc(ARENA_CHUNK_HEADER + size);
+    if (!chunk) {
+        return NULL;
+    }
+    chunk->size = size;
+    chunk->used = 0;
+    if (size > arena->chunk_size && arena->chunks) {
+        //an oversized block gets a chunk of its own, the current chunk stays in use
+        chunk->next = arena->chunks->next;
+        arena->chunks->next = chunk;
+        return chunk;
+    }
+    chunk->next = arena->chunks;
+    arena->chunks = chunk;
+    return chunk;
+}
+
+/**
+ * arenaAllocate: the allocate function of an arena's MapAllocator.
+ *
+ * @param context - the arena.
+ * @param size - size of the block in bytes.
+ * @return
+ * NULL if a new chunk was needed and malloc failed, the block otherwise.
+ */
+static void* arenaAllocate(void* context, size_t size) {
+    MapArena arena = context;
+    size = ARENA_ROUND(size > 0 ? size : 1);
+    ArenaChunk chunk = arena->chunks;
+    if (!chunk || chunk->size - chunk->used < size) {
+        chunk = arenaAddChunk(arena, size > arena->chunk_size ? size : arena->chunk_size);
+        if (!chunk) {
+            return NULL;
+        }
+    }
+    void* block = (char*)chunk + ARENA_CHUNK_HEADER + chunk->used;
+    chunk->used += size;
+    return block;
+}
+
+/**
+ * arenaDeallocate: the deallocate function of an arena's MapAllocator. Only the last
+ * block of the current chunk is given back, the others wait for mapArenaDestroy.
+ *
+ * @param context - the arena.
+ * @param pointer - the block.
+ * @param size - the size given to arenaAllocate.
+ */
+static void arenaDeallocate(void* context, void* pointer, size_t size) {
+    MapArena arena = context;
+    ArenaChunk chunk = arena->chunks;
+    size = ARENA_ROUND(size > 0 ? size : 1);
+    if (chunk && chunk->used >= size &&
+        (char*)pointer == (char*)chunk + ARENA_CHUNK_HEADER + chunk->used - size) {
+        chunk->used -= size;
+    }
+}
+
+MapArena mapArenaCreate(size_t chunkSize) {
+    MapArena arena = malloc(sizeof(*arena));
+    if (!arena) {
+        return NULL;
+    }
+    arena->chunks = NULL;
+    arena->chunk_size = ARENA_ROUND(chunkSize > 0 ? chunkSize : ARENA_DEFAULT_CHUNK);
+    return arena;
+}
+
+void mapArenaDestroy(MapArena arena) {
+    if (!arena) {
+        return;
+    }
+    while (arena->chunks) {
+        ArenaChunk next = arena->chunks->next;
+        free(arena->chunks);
+        arena->chunks = next;
+    }
+    free(arena);
+}
+
+MapAllocator mapArenaAllocator(MapArena arena) {
+    assert(arena);
+    MapAllocator allocator = { arenaAllocate, arenaDeallocate, arena };
+    return allocator;
+}
@@ -0,0 +1,338 @@
+#include "map_engine.h"
+#include <assert.h>
+#include <string.h>
+
+/**
+* Adaptive engine.
+*
+* A small map keeps its (key,data) pairs in one sorted array, searched by binary
+* search over a few cache lines with no pointer to chase per element. The array
+* grows by doubling up to ARRAY_MAX_ENTRIES entries. Inserting past that, or reserving
+* room for more (see mapReserve), promotes the map to the AVL tree engine in O(n):
+* the pairs are handed over to the tree as they are, and from then on map->engine
+* is the tree's, so the map scales like a tree. A promoted map stays a tree, also
+* once emptied.
+*
+* A map held in an array has no hash index, its binary search is cheaper than
+* hashing. A promoted map builds its index on its first point lookup.
+*/
+
+/* Entries of the first array, and of the largest one before promoting to a tree */
+#define ARRAY_MIN_ENTRIES 4
+#define ARRAY_MAX_ENTRIES 32
+
+typedef struct map_array_t {
+    int count;
+    int capacity;
+    MapEntry entries; // sorted by strictly increasing key
+}*MapArray;
+
+/* declaring functions */
+static inline int arrayLowerBoundAs(Map map, MapKeyType key_type, MapArray array, MapKeyElement key);
+static int arrayLowerBound(Map map, MapArray array, MapKeyElement key);
+static bool arrayGrow(Map map, MapArray array, int capacity);
+static void arrayRelease(Map map, MapArray array);
+static bool arrayPromote(Map map, MapEntry entries, int count);
+static MapEntry arrayInsertAt(Map map, MapArray array, int position, MapKeyElement key, bool* created);
+
+static bool arrayCreate(Map map);
+static void arrayDestroy(Map map);
+static void arrayClear(Map map);
+static MapEntry arrayFind(Map map, MapKeyElement key);
+static MapEntry arrayInsert(Map map, MapKeyElement key, bool* created);
+static MapEntry arrayInsertHint(Map map, MapKeyElement key, bool* created);
+static MapResult arrayRemove(Map map, MapKeyElement key, MapEntry removed);
+static MapEntry arrayFirst(Map map, MapIterator iterator);
+static MapEntry arrayNext(Map map, MapIterator iterator);
+static MapEntry arraySeek(Map map, MapKeyElement key, MapIterator iterator);
+static bool arrayLoad(Map map, MapEntry entries, int count);
+static int arrayRemoveIf(Map map, bool (*unlink)(Map map, MapEntry entry, void* context), void* context);
+static bool arrayReserve(Map map, int size);
+
+
+const MapEngineOps map_array_engine = {
+    arrayCreate,
+    arrayDestroy,
+    arrayClear,
+    arrayFind,
+    arrayInsert,
+    arrayRemove,
+    arrayFirst,
+    arrayNext,
+    arraySeek,
+    arrayLoad,
+    NULL,
+    arrayRemoveIf,
+    arrayInsertHint,
+    arrayReserve
+};
+
+/**
+ * arrayLowerBoundAs: arrayLowerBound for the keys of a given type, see mapCompareKeysAs.
+ */
+static inline int arrayLowerBoundAs(Map map, MapKeyType key_type, MapArray array, MapKeyElement key) {
+    MAP_COUNT(map, nodesVisited, 1);
+    int low = 0;
+    int high = array->count;
+    while (low < high) {
+        int middle = (low + high) / 2;
+        if (mapCompareKeysAs(map, key_type, array->entries[middle].key, key) < 0) {
+            low = middle + 1;
+        }
+        else {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+/**
+ * arrayLowerBound: binary search for the first entry whose key is not smaller than key.
+ *
+ * @param map - the map the array belongs to.
+ * @param array - the array to search in.
+ * @param key - the key to look for.
+ * @return
+ * The position of that entry, array->count if all the keys are smaller.
+ */
+static int arrayLowerBound(Map map, MapArray array, MapKeyElement key) {
+    MAP_KEY_TYPE_SWITCH(map, arrayLowerBoundAs, array, key)
+}
+
+/**
+ * arrayGrow: makes room for capacity entries, moving the entries to a larger block if needed.
+ *
+ * @param map - the map the array belongs to.
+ * @param array - the array to grow.
+ * @param capacity - the number of entries to make room for.
+ * @return
+ * false if allocation failed, the array is then unchanged. true otherwise.
+ */
+static bool arrayGrow(Map map, MapArray array, int capacity) {
+    if (capacity <= array->capacity) {
+        return true;
+    }
+    int new_capacity = array->capacity > 0 ? array->capacity : ARRAY_MIN_ENTRIES;
+    while (new_capacity < capacity) {
+        new_capacity *= 2;
+    }
+    MapEntry entries = mapAllocate(map, new_capacity * sizeof(*entries));
+    if (!entries) {
+        return false;
+    }
+    if (array->count > 0) {
+        memcpy(entries, array->entries, array->count * sizeof(*entries));
+        //cursors may hold the old entries
+        mapStructureChanged(map);
+    }
+    mapDeallocate(map, array->entries, array->capacity * sizeof(*entries));
+    array->entries = entries;
+    array->capacity = new_capacity;
+    return true;
+}
+
+/**
+ * arrayRelease: releases an array without touching the elements it refers to.
+ *
+ * @param map - the map the array belongs to.
+ * @param array - the array to release.
+ */
+static void arrayRelease(Map map, MapArray array) {
+    mapDeallocate(map, array->entries, array->capacity * sizeof(*array->entries));
+    mapDeallocate(map, array, sizeof(*array));
+}
+
+/**
+ * arrayPromote: replaces the array of a map by a tree holding given entries, and the array
+ * engine by the tree engine.
+ *
+ * @param map - the map to promote.
+ * @param entries - the entries the tree is loaded with, sorted by strictly increasing key.
+ *      The tree takes over their elements.
+ * @param count - the number of entries.
+ * @return
+ * false if allocation failed, the map then still has its array. true otherwise.
+ */
+static bool arrayPromote(Map map, MapEntry entries, int count) {
+    MapArray array = map->engine_data;
+    map->engine_data = NULL;
+    if (!map_tree_engine.create(map)) {
+        map->engine_data = array;
+        return false;
+    }
+    if (!map_tree_engine.load(map, entries, count)) {
+        map_tree_engine.destroy(map);//still empty, only the tree's own structure is freed
+        map->engine_data = array;
+        return false;
+    }
+    map->engine = &map_tree_engine;
+    arrayRelease(map, array);
+    mapStructureChanged(map);
+    return true;
+}
+
+/**
+ * arrayInsertAt: inserts a new key at a given position of the array, promoting the map to
+ * the tree engine if the array is full.
+ *
+ * @param map - the map the array belongs to.
+ * @param array - the array to insert into.
+ * @param position - the position of the key, all the keys before it are smaller and all
+ *      the keys from it on are greater.
+ * @param key - the key to insert, not in the map.
+ * @param created - set to true if the key was inserted.
+ * @return
+ * The new entry, NULL if allocation or the key copy failed.
+ */
+static MapEntry arrayInsertAt(Map map, MapArray array, int position, MapKeyElement key, bool* created) {
+    if (array->count == ARRAY_MAX_ENTRIES) {
+        if (!arrayPromote(map, array->entries, array->count)) {
+            return NULL;
+        }
+        return map->engine->insert(map, key, created);
+    }
+    if (!arrayGrow(map, array, array->count + 1)) {
+        return NULL;
+    }
+    MapEntry entry = &array->entries[position];
+    if (!mapEntryKey(map, key, &entry[array->count - position].key)) {
+        return NULL;
+    }
+    //the new key was made in the free slot at the end, it is moved to its place
+    MapKeyElement entry_key = entry[array->count - position].key;
+    memmove(entry + 1, entry, (array->count - position) * sizeof(*entry));
+    entry->key = entry_key;
+    entry->data = NULL;
+    array->count++;
+    *created = true;
+    return entry;
+}
+
+static bool arrayCreate(Map map) {
+    MapArray array = mapAllocate(map, sizeof(*array));
+    if (!array) {
+        return false;
+    }
+    array->count = 0;
+    array->capacity = 0;
+    array->entries = NULL;
+    map->engine_data = array;
+    return true;
+}
+
+static void arrayDestroy(Map map) {
+    arrayClear(map);
+    arrayRelease(map, map->engine_data);
+    map->engine_data = NULL;
+}
+
+static void arrayClear(Map map) {
+    MapArray array = map->engine_data;
+    for (int i = 0; i < array->count; i++) {
+        mapFreeEntry(map, &array->entries[i]);
+    }
+    array->count = 0;
+}
+
+static MapEntry arrayFind(Map map, MapKeyElement key) {
+    MapArray array = map->engine_data;
+    int position = arrayLowerBound(map, array, key);
+    if (position < array->count && mapCompareKeys(map, array->entries[position].key, key) == 0) {
+        return &array->entries[position];
+    }
+    return NULL;
+}
+
+static MapEntry arrayInsert(Map map, MapKeyElement key, bool* created) {
+    MapArray array = map->engine_data;
+    int position = arrayLowerBound(map, array, key);
+    *created = false;
+    if (position < array->count && mapCompareKeys(map, array->entries[position].key, key) == 0) {
+        return &array->entries[position];
+    }
+    return arrayInsertAt(map, array, position, key, created);
+}
+
+static MapEntry arrayInsertHint(Map map, MapKeyElement key, bool* created) {
+    MapArray array = map->engine_data;
+    //a key after the last one goes to the end without a search
+    if (array->count == 0 || mapCompareKeys(map, array->entries[array->count - 1].key, key) >= 0) {
+        return arrayInsert(map, key, created);
+    }
+    *created = false;
+    return arrayInsertAt(map, array, array->count, key, created);
+}
+
+static MapResult arrayRemove(Map map, MapKeyElement key, MapEntry removed) {
+    MapArray array = map->engine_data;
+    int position = arrayLowerBound(map, array, key);
+    if (position == array->count || mapCompareKeys(map, array->entries[position].key, key) != 0) {
+        return MAP_ITEM_DOES_NOT_EXIST;
+    }
+    *removed = array->entries[position];
+    array->count--;
+    memmove(&array->entries[position], &array->entries[position + 1],
+            (array->count - position) * sizeof(*array->entries));
+    return MAP_SUCCESS;
+}
+
+static MapEntry arrayFirst(Map map, MapIterator iterator) {
+    iterator->depth = 0;
+    iterator->position = -1;
+    return arrayNext(map, iterator);
+}
+
+static MapEntry arrayNext(Map map, MapIterator iterator) {
+    MapArray array = map->engine_data;
+    if (iterator->position >= array->count) {
+        return NULL;
+    }
+    iterator->position++;
+    return iterator->position < array->count ? &array->entries[iterator->position] : NULL;
+}
+
+static MapEntry arraySeek(Map map, MapKeyElement key, MapIterator iterator) {
+    iterator->depth = 0;
+    iterator->position = arrayLowerBound(map, map->engine_data, key) - 1;
+    return arrayNext(map, iterator);
+}
+
+static bool arrayLoad(Map map, MapEntry entries, int count) {
+    MapArray array = map->engine_data;
+    assert(array->count == 0);
+    if (count > ARRAY_MAX_ENTRIES) {
+        return arrayPromote(map, entries, count);
+    }
+    if (!arrayGrow(map, array, count)) {
+        return false;
+    }
+    if (count > 0) {
+        memcpy(array->entries, entries, count * sizeof(*entries));
+    }
+    array->count = count;
+    return true;
+}
+
+static int arrayRemoveIf(Map map, bool (*unlink)(Map map, MapEntry entry, void* context), void* context) {
+    //one pass moving every kept entry down over the unlinked ones before it
+    MapArray array = map->engine_data;
+    int kept = 0;
+    for (int i = 0; i < array->count; i++) {
+        if (unlink(map, &array->entries[i], context)) {
+            continue;
+        }
+        array->entries[kept++] = array->entries[i];
+    }
+    int removed = array->count - kept;
+    array->count = kept;
+    return removed;
+}
+
+static bool arrayReserve(Map map, int size) {
+    if (size <= ARRAY_MAX_ENTRIES) {
+        return arrayGrow(map, map->engine_data, size);
+    }
+    //a map expected to outgrow its array is promoted right away
+    MapArray array = map->engine_data;
+    return arrayPromote(map, array->entries, array->count) && map->engine->reserve(map, size);
+}
@@ -0,0 +1,827 @@
+#include "map_engine.h"
+#include <assert.h>
+#include <string.h>
+
+/**
+* B+tree engine.
+*
+* All the (key,data) pairs are stored in leaves, in arrays, and the leaves are
+* linked in key order so a full scan walks contiguous memory instead of chasing
+* a pointer per element. Inner nodes hold separator keys which are pointers to
+* keys stored in the leaves, so they cost no allocation. When a key is removed
+* every separator still pointing at it is redirected before the key is freed.
+*
+* Nodes are sized to a whole number of 64 byte cache lines.
+*/
+
+/* Size in bytes of every node, four cache lines */
+#define BPTREE_LINE_SIZE 64
+#define BPTREE_NODE_SIZE (4 * BPTREE_LINE_SIZE)
+
+/* Header shared by leaves and inner nodes */
+typedef struct bptree_node_t {
+    int count; // entries in a leaf, separator keys in an inner node
+    bool is_leaf;
+}*BPNode;
+
+#define BPTREE_LEAF_CAPACITY \
+    ((BPTREE_NODE_SIZE - sizeof(struct bptree_node_t) - sizeof(void*)) / sizeof(struct map_entry_t))
+#define BPTREE_INNER_CAPACITY \
+    ((BPTREE_NODE_SIZE - sizeof(struct bptree_node_t) + sizeof(void*)) / (2 * sizeof(void*)))
+#define BPTREE_LEAF_MIN (BPTREE_LEAF_CAPACITY / 2)
+#define BPTREE_INNER_MIN ((BPTREE_INNER_CAPACITY - 1) / 2)
+
+typedef struct bptree_leaf_t {
+    struct bptree_node_t node;
+    struct bptree_leaf_t* next;
+    struct map_entry_t entries[BPTREE_LEAF_CAPACITY];
+}*BPLeaf;
+
+/* children[i] holds the keys smaller than keys[i], children[count] the rest */
+typedef struct bptree_inner_t {
+    struct bptree_node_t node;
+    MapKeyElement keys[BPTREE_INNER_CAPACITY - 1];
+    BPNode children[BPTREE_INNER_CAPACITY];
+}*BPInner;
+
+typedef struct map_bptree_t {
+    BPNode root;
+}*MapBPTree;
+
+/* Nodes met on the way from the root to a leaf, and the child taken at each of them */
+typedef struct bptree_path_t {
+    BPInner nodes[MAP_MAX_DEPTH];
+    int children[MAP_MAX_DEPTH];
+    int depth;
+} BPPath;
+
+/* declaring functions */
+static BPLeaf leafCreate(Map map);
+static BPInner innerCreate(Map map);
+static void nodeRelease(Map map, BPNode node);
+static inline int leafLowerBoundAs(Map map, MapKeyType key_type, BPLeaf leaf, MapKeyElement key);
+static int leafLowerBound(Map map, BPLeaf leaf, MapKeyElement key);
+static inline int innerChildIndexAs(Map map, MapKeyType key_type, BPInner inner, MapKeyElement key);
+static int innerChildIndex(Map map, BPInner inner, MapKeyElement key);
+static inline BPLeaf bptreeDescendAs(Map map, MapKeyType key_type, MapKeyElement key, BPPath* path);
+static BPLeaf bptreeDescend(Map map, MapKeyElement key, BPPath* path);
+static BPLeaf bptreeDescendLast(Map map, BPPath* path);
+static BPLeaf leftmostLeaf(BPNode node);
+static MapEntry leafSplitInsert(Map map, BPPath* path, BPLeaf leaf, int position, MapKeyElement key,
+                                BPNode* spares);
+static MapEntry bptreeInsertAt(Map map, BPPath* path, BPLeaf leaf, int position, MapKeyElement key,
+                               bool* created);
+static void innerInsert(Map map, BPPath* path, int level, MapKeyElement key, BPNode child, BPNode* spares);
+static void bptreeRebalance(Map map, BPPath* path, BPNode node);
+static void bptreeRedirectSeparators(Map map, MapKeyElement key);
+static void bptreeDestroyNodes(Map map, BPNode node);
+static void bptreeReleaseNodes(Map map, BPNode node);
+static void levelRelease(Map map, BPNode* level, int filled, int size);
+
+static bool bptreeCreate(Map map);
+static void bptreeDestroy(Map map);
+static void bptreeClear(Map map);
+static MapEntry bptreeFind(Map map, MapKeyElement key);
+static MapEntry bptreeInsert(Map map, MapKeyElement key, bool* created);
+static MapEntry bptreeInsertHint(Map map, MapKeyElement key, bool* created);
+static MapResult bptreeRemove(Map map, MapKeyElement key, MapEntry removed);
+static MapEntry bptreeFirst(Map map, MapIterator iterator);
+static MapEntry bptreeNext(Map map, MapIterator iterator);
+static MapEntry bptreeSeek(Map map, MapKeyElement key, MapIterator iterator);
+static bool bptreeLoad(Map map, MapEntry entries, int count);
+static bool bptreeReserve(Map map, int size);
+
+
+const MapEngineOps map_bptree_engine = {
+    bptreeCreate,
+    bptreeDestroy,
+    bptreeClear,
+    bptreeFind,
+    bptreeInsert,
+    bptreeRemove,
+    bptreeFirst,
+    bptreeNext,
+    bptreeSeek,
+    bptreeLoad,
+    NULL,
+    NULL,
+    bptreeInsertHint,
+    bptreeReserve
+};
+
+/**
+ * leafCreate: allocates a new empty leaf.
+ *
+ * @param map - the map the leaf belongs to.
+ * @return
+ * NULL if allocation failed, the new leaf otherwise.
+ */
+static BPLeaf leafCreate(Map map) {
+    BPLeaf leaf = mapAllocate(map, sizeof(*leaf));
+    if (!leaf) {
+        return NULL;
+    }
+    leaf->node.count = 0;
+    leaf->node.is_leaf = true;
+    leaf->next = NULL;
+    return leaf;
+}
+
+/**
+ * innerCreate: allocates a new empty inner node.
+ *
+ * @param map - the map the node belongs to.
+ * @return
+ * NULL if allocation failed, the new node otherwise.
+ */
+static BPInner innerCreate(Map map) {
+    BPInner inner = mapAllocate(map, sizeof(*inner));
+    if (!inner) {
+        return NULL;
+    }
+    inner->node.count = 0;
+    inner->node.is_leaf = false;
+    return inner;
+}
+
+/**
+ * nodeRelease: releases a node without touching the elements it refers to.
+ *
+ * @param map - the map the node belongs to.
+ * @param node - the node to release, NULL is ignored.
+ */
+static void nodeRelease(Map map, BPNode node) {
+    if (!node) {
+        return;
+    }
+    if (node->is_leaf) {
+        mapDeallocate(map, node, sizeof(struct bptree_leaf_t));
+    }
+    else {
+        mapDeallocate(map, node, sizeof(struct bptree_inner_t));
+    }
+}
+
+/**
+ * leafLowerBoundAs: leafLowerBound for the keys of a given type, see mapCompareKeysAs.
+ */
+static inline int leafLowerBoundAs(Map map, MapKeyType key_type, BPLeaf leaf, MapKeyElement key) {
+    MAP_COUNT(map, nodesVisited, 1);
+    int low = 0;
+    int high = leaf->node.count;
+    while (low < high) {
+        int middle = (low + high) / 2;
+        if (mapCompareKeysAs(map, key_type, leaf->entries[middle].key, key) < 0) {
+            low = middle + 1;
+        }
+        else {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+/**
+ * leafLowerBound: binary search for the first entry of a leaf whose key is not smaller than key.
+ *
+ * @param map - the map the leaf belongs to.
+ * @param leaf - the leaf to search in.
+ * @param key - the key to look for.
+ * @return
+ * The position of that entry, leaf->node.count if all the keys are smaller.
+ */
+static int leafLowerBound(Map map, BPLeaf leaf, MapKeyElement key) {
+    MAP_KEY_TYPE_SWITCH(map, leafLowerBoundAs, leaf, key)
+}
+
+/**
+ * innerChildIndexAs: innerChildIndex for the keys of a given type, see mapCompareKeysAs.
+ */
+static inline int innerChildIndexAs(Map map, MapKeyType key_type, BPInner inner, MapKeyElement key) {
+    MAP_COUNT(map, nodesVisited, 1);
+    int low = 0;
+    int high = inner->node.count;
+    while (low < high) {
+        int middle = (low + high) / 2;
+        if (mapCompareKeysAs(map, key_type, inner->keys[middle], key) <= 0) {
+            low = middle + 1;
+        }
+        else {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+/**
+ * innerChildIndex: finds the child of an inner node whose subtree may hold key.
+ *
+ * @param map - the map the node belongs to.
+ * @param inner - the node to search in.
+ * @param key - the key to look for.
+ * @return
+ * The number of separators not greater than key.
+ */
+static int innerChildIndex(Map map, BPInner inner, MapKeyElement key) {
+    MAP_KEY_TYPE_SWITCH(map, innerChildIndexAs, inner, key)
+}
+
+/**
+ * bptreeDescendAs: bptreeDescend for the keys of a given type, see mapCompareKeysAs.
+ */
+static inline BPLeaf bptreeDescendAs(Map map, MapKeyType key_type, MapKeyElement key, BPPath* path) {
+    BPNode node = ((MapBPTree)map->engine_data)->root;
+    if (path) {
+        path->depth = 0;
+    }
+    while (!node->is_leaf) {
+        BPInner inner = (BPInner)node;
+        int child = innerChildIndexAs(map, key_type, inner, key);
+        if (path) {
+            assert(path->depth < MAP_MAX_DEPTH);
+            path->nodes[path->depth] = inner;
+            path->children[path->depth] = child;
+            path->depth++;
+        }
+        node = inner->children[child];
+    }
+    return (BPLeaf)node;
+}
+
+/**
+ * bptreeDescend: walks from the root to the leaf which holds (or should hold) key.
+ *
+ * @param map - the map to search in.
+ * @param key - the key to look for.
+ * @param path - if not NULL, filled with the inner nodes met and the child taken at each.
+ * @return
+ * The leaf.
+ */
+static BPLeaf bptreeDescend(Map map, MapKeyElement key, BPPath* path) {
+    MAP_KEY_TYPE_SWITCH(map, bptreeDescendAs, key, path)
+}
+
+/**
+ * bptreeDescendLast: walks from the root to the leaf holding the largest keys, taking the
+ * last child of every inner node without comparing keys.
+ *
+ * @param map - the map to search in.
+ * @param path - filled with the inner nodes met and the child taken at each.
+ * @return
+ * The last leaf.
+ */
+static BPLeaf bptreeDescendLast(Map map, BPPath* path) {
+    BPNode node = ((MapBPTree)map->engine_data)->root;
+    path->depth = 0;
+    while (!node->is_leaf) {
+        BPInner inner = (BPInner)node;
+        assert(path->depth < MAP_MAX_DEPTH);
+        path->nodes[path->depth] = inner;
+        path->children[path->depth] = inner->node.count;
+        path->depth++;
+        node = inner->children[inner->node.count];
+    }
+    return (BPLeaf)node;
+}
+
+/**
+ * leftmostLeaf: returns the leaf holding the smallest keys of a subtree.
+ *
+ * @param node - root of the subtree.
+ * @return
+ * The leftmost leaf of the subtree.
+ */
+static BPLeaf leftmostLeaf(BPNode node) {
+    while (!node->is_leaf) {
+        node = ((BPInner)node)->children[0];
+    }
+    return (BPLeaf)node;
+}
+
+/**
+ * leafSplitInsert: inserts an entry into a full leaf by splitting it in two,
+ * then links the new leaf into the parent. An entry after all the keys of the last leaf
+ * goes alone into the new leaf, which leaves the full one as it is, so that keys coming
+ * in ascending order fill the leaves as bptreeLoad does instead of leaving them half full.
+ *
+ * @param map - the map the tree belongs to.
+ * @param path - the path from the root to leaf.
+ * @param leaf - the full leaf.
+ * @param position - where the new entry belongs in leaf.
+ * @param key - the key of the new entry, already owned by the map.
+ * @param spares - preallocated nodes, enough for every split the insertion causes.
+ * @return
+ * The new entry.
+ */
+static MapEntry leafSplitInsert(Map map, BPPath* path, BPLeaf leaf, int position, MapKeyElement key,
+                                BPNode* spares) {
+    BPLeaf right = (BPLeaf)*spares++;
+    right->node.count = 0;
+    right->node.is_leaf = true;
+
+    struct map_entry_t new_entry = { key, NULL };
+    int total = leaf->node.count + 1;
+    bool append = position == leaf->node.count && !leaf->next;
+    int left_count = append ? leaf->node.count : (total + 1) / 2;
+    MapEntry result = NULL;
+    //distribute the old entries and the new one between the two leaves, from the end
+    for (int target = total - 1, source = leaf->node.count - 1; target >= 0; target--) {
+        struct map_entry_t entry;
+        bool is_new = target == position;
+        entry = is_new ? new_entry : leaf->entries[source--];
+        MapEntry slot = target >= left_count ? &right->entries[target - left_count] : &leaf->entries[target];
+        *slot = entry;
+        if (is_new) {
+            result = slot;
+        }
+    }
+    leaf->node.count = left_count;
+    right->node.count = total - left_count;
+    right->next = leaf->next;
+    leaf->next = right;
+
+    innerInsert(map, path, path->depth - 1, right->entries[0].key, &right->node, spares);
+    return result;
+}
+
+/**
+ * innerInsert: links a new child into an inner node, right after the child the path went
+ * through, splitting the node (and its ancestors) when it is full.
+ *
+ * @param map - the map the tree belongs to.
+ * @param path - the path from the root.
+ * @param level - level in path of the node to insert into, -1 if a new root is needed.
+ * @param key - the separator between the old child and the new one.
+ * @param child - the new child.
+ * @param spares - preallocated nodes, enough for every split the insertion causes.
+ */
+static void innerInsert(Map map, BPPath* path, int level, MapKeyElement key, BPNode child, BPNode* spares) {
+    MapBPTree tree = map->engine_data;
+    if (level < 0) {
+        BPInner root = (BPInner)*spares;
+        root->node.count = 1;
+        root->node.is_leaf = false;
+        root->keys[0] = key;
+        root->children[0] = tree->root;
+        root->children[1] = child;
+        tree->root = &root->node;
+        return;
+    }
+
+    BPInner inner = path->nodes[level];
+    int position = path->children[level];
+    if (inner->node.count < (int)BPTREE_INNER_CAPACITY - 1) {
+        memmove(&inner->keys[position + 1], &inner->keys[position],
+                (inner->node.count - position) * sizeof(inner->keys[0]));
+        memmove(&inner->children[position + 2], &inner->children[position + 1],
+                (inner->node.count - position) * sizeof(inner->children[0]));
+        inner->keys[position] = key;
+        inner->children[position + 1] = child;
+        inner->node.count++;
+        return;
+    }
+
+    //gather the node's separators and children with the new ones, then split them around the middle key
+    MapKeyElement keys[BPTREE_INNER_CAPACITY];
+    BPNode children[BPTREE_INNER_CAPACITY + 1];
+    int count = inner->node.count;
+    memcpy(keys, inner->keys, position * sizeof(keys[0]));
+    keys[position] = key;
+    memcpy(&keys[position + 1], &inner->keys[position], (count - position) * sizeof(keys[0]));
+    memcpy(children, inner->children, (position + 1) * sizeof(children[0]));
+    children[position + 1] = child;
+    memcpy(&children[position + 2], &inner->children[position + 1], (count - position) * sizeof(children[0]));
+    count++;
+
+    BPInner right = (BPInner)*spares++;
+    right->node.is_leaf = false;
+    int left_count = count / 2;
+    inner->node.count = left_count;
+    memcpy(inner->keys, keys, left_count * sizeof(keys[0]));
+    memcpy(inner->children, children, (left_count + 1) * sizeof(children[0]));
+    right->node.count = count - left_count - 1;
+    memcpy(right->keys, &keys[left_count + 1], right->node.count * sizeof(keys[0]));
+    memcpy(right->children, &children[left_count + 1], (right->node.count + 1) * sizeof(children[0]));
+
+    innerInsert(map, path, level - 1, keys[left_count], &right->node, spares);
+}
+
+/**
+ * bptreeRebalance: restores the minimal fill of a node after an entry was removed below it,
+ * by borrowing from a sibling or merging with it, and continues up the path.
+ *
+ * @param map - the map the tree belongs to.
+ * @param path - the path from the root to node.
+ * @param node - the node that lost an entry or a child.
+ */
+static void bptreeRebalance(Map map, BPPath* path, BPNode node) {
+    MapBPTree tree = map->engine_data;
+    while (path->depth > 0) {
+        int minimum = node->is_leaf ? (int)BPTREE_LEAF_MIN : (int)BPTREE_INNER_MIN;
+        if (node->count >= minimum) {
+            return;
+        }
+        BPInner parent = path->nodes[path->depth - 1];
+        int index = path->children[path->depth - 1];
+        BPNode left = index > 0 ? parent->children[index - 1] : NULL;
+        BPNode right = index < parent->node.count ? parent->children[index + 1] : NULL;
+
+        if (node->is_leaf) {
+            BPLeaf leaf = (BPLeaf)node;
+            if (left && left->count > minimum) {
+                BPLeaf sibling = (BPLeaf)left;
+                memmove(&leaf->entries[1], &leaf->entries[0], leaf->node.count * sizeof(leaf->entries[0]));
+                leaf->entries[0] = sibling->entries[--sibling->node.count];
+                leaf->node.count++;
+                parent->keys[index - 1] = leaf->entries[0].key;
+                return;
+            }
+            if (right && right->count > minimum) {
+                BPLeaf sibling = (BPLeaf)right;
+                leaf->entries[leaf->node.count++] = sibling->entries[0];
+                sibling->node.count--;
+                memmove(&sibling->entries[0], &sibling->entries[1], sibling->node.count * sizeof(leaf->entries[0]));
+                parent->keys[index] = sibling->entries[0].key;
+                return;
+            }
+            //merge with a sibling, the right one of the pair goes away
+            if (!left) {
+                left = node;
+                index++;
+            }
+            BPLeaf into = (BPLeaf)left;
+            BPLeaf from = (BPLeaf)parent->children[index];
+            memcpy(&into->entries[into->node.count], from->entries, from->node.count * sizeof(from->entries[0]));
+            into->node.count += from->node.count;
+            into->next = from->next;
+        }
+        else {
+            BPInner inner = (BPInner)node;
+            if (left && left->count > minimum) {
+                BPInner sibling = (BPInner)left;
+                memmove(&inner->keys[1], &inner->keys[0], inner->node.count * sizeof(inner->keys[0]));
+                memmove(&inner->children[1], &inner->children[0], (inner->node.count + 1) * sizeof(inner->children[0]));
+                inner->keys[0] = parent->keys[index - 1];
+                inner->children[0] = sibling->children[sibling->node.count];
+                parent->keys[index - 1] = sibling->keys[sibling->node.count - 1];
+                sibling->node.count--;
+                inner->node.count++;
+                return;
+            }
+            if (right && right->count > minimum) {
+                BPInner sibling = (BPInner)right;
+                inner->keys[inner->node.count] = parent->keys[index];
+                inner->children[inner->node.count + 1] = sibling->children[0];
+                inner->node.count++;
+                parent->keys[index] = sibling->keys[0];
+                memmove(&sibling->keys[0], &sibling->keys[1], (sibling->node.count - 1) * sizeof(sibling->keys[0]));
+                memmove(&sibling->children[0], &sibling->children[1], sibling->node.count * sizeof(sibling->children[0]));
+                sibling->node.count--;
+                return;
+            }
+            if (!left) {
+                left = node;
+                index++;
+            }
+            BPInner into = (BPInner)left;
+            BPInner from = (BPInner)parent->children[index];
+            into->keys[into->node.count] = parent->keys[index - 1];
+            memcpy(&into->keys[into->node.count + 1], from->keys, from->node.count * sizeof(from->keys[0]));
+            memcpy(&into->children[into->node.count + 1], from->children, (from->node.count + 1) * sizeof(from->children[0]));
+            into->node.count += from->node.count + 1;
+        }
+        //the right node of the merged pair is unlinked from the parent
+        nodeRelease(map, parent->children[index]);
+        memmove(&parent->keys[index - 1], &parent->keys[index], (parent->node.count - index) * sizeof(parent->keys[0]));
+        memmove(&parent->children[index], &parent->children[index + 1], (parent->node.count - index) * sizeof(parent->children[0]));
+        parent->node.count--;
+
+        node = &parent->node;
+        path->depth--;
+    }
+
+    //an inner root left with a single child hands the root over to it
+    if (!node->is_leaf && node->count == 0) {
+        tree->root = ((BPInner)node)->children[0];
+        nodeRelease(map, node);
+    }
+}
+
+/**
+ * bptreeRedirectSeparators: points every separator that refers to a key about to be freed
+ * at the smallest key of the subtree on its right, which is a valid separator as well.
+ * All such separators lie on the search path of the key.
+ *
+ * @param map - the map the tree belongs to.
+ * @param key - the removed key, still allocated.
+ */
+static void bptreeRedirectSeparators(Map map, MapKeyElement key) {
+    BPNode node = ((MapBPTree)map->engine_data)->root;
+    while (!node->is_leaf) {
+        BPInner inner = (BPInner)node;
+        for (int i = 0; i < inner->node.count; i++) {
+            if (inner->keys[i] == key) {
+                inner->keys[i] = leftmostLeaf(inner->children[i + 1])->entries[0].key;
+            }
+        }
+        node = inner->children[innerChildIndex(map, inner, key)];
+    }
+}
+
+/**
+ * bptreeDestroyNodes: frees all the nodes of a subtree and the elements in its leaves.
+ *
+ * @param map - the map the tree belongs to.
+ * @param node - root of the subtree.
+ */
+static void bptreeDestroyNodes(Map map, BPNode node) {
+    if (node->is_leaf) {
+        BPLeaf leaf = (BPLeaf)node;
+        for (int i = 0; i < leaf->node.count; i++) {
+            mapFreeEntry(map, &leaf->entries[i]);
+        }
+    }
+    else {
+        BPInner inner = (BPInner)node;
+        for (int i = 0; i <= inner->node.count; i++) {
+            bptreeDestroyNodes(map, inner->children[i]);
+        }
+    }
+    nodeRelease(map, node);
+}
+
+/**
+ * bptreeReleaseNodes: releases all the nodes of a subtree without touching the elements in its leaves.
+ *
+ * @param map - the map the tree belongs to.
+ * @param node - root of the subtree.
+ */
+static void bptreeReleaseNodes(Map map, BPNode node) {
+    if (!node->is_leaf) {
+        BPInner inner = (BPInner)node;
+        for (int i = 0; i <= inner->node.count; i++) {
+            bptreeReleaseNodes(map, inner->children[i]);
+        }
+    }
+    nodeRelease(map, node);
+}
+
+/**
+ * levelRelease: releases the subtrees of a level built by bptreeLoad, and the level's array.
+ *
+ * @param map - the map the tree belongs to.
+ * @param level - the array of the level's nodes.
+ * @param filled - the number of nodes built so far.
+ * @param size - the size of the array.
+ */
+static void levelRelease(Map map, BPNode* level, int filled, int size) {
+    for (int i = 0; i < filled; i++) {
+        bptreeReleaseNodes(map, level[i]);
+    }
+    mapDeallocate(map, level, size * sizeof(*level));
+}
+
+/**
+ * bptreeInsertAt: inserts a new key at a given position of a leaf, splitting the leaf
+ * (and its ancestors) when it is full.
+ *
+ * @param map - the map the tree belongs to.
+ * @param path - the path from the root to leaf.
+ * @param leaf - the leaf the key belongs in.
+ * @param position - the position of the key in leaf, all the keys before it are smaller
+ *      and all the keys from it on are greater.
+ * @param key - the key to insert, not in the map.
+ * @param created - set to true if the key was inserted.
+ * @return
+ * The new entry, NULL if allocation or the key copy failed, the tree is then untouched.
+ */
+static MapEntry bptreeInsertAt(Map map, BPPath* path, BPLeaf leaf, int position, MapKeyElement key,
+                               bool* created) {
+    //allocate everything the insertion may need up front, so a failure leaves the tree untouched
+    //the nodes are cast rather than taking &->node, as node is the first member and NULL stays NULL
+    BPNode spares[MAP_MAX_DEPTH + 1] = { NULL };
+    int needed = 0;
+    if (leaf->node.count == (int)BPTREE_LEAF_CAPACITY) {
+        spares[needed++] = (BPNode)leafCreate(map);
+        int level = path->depth - 1;
+        while (level >= 0 && path->nodes[level]->node.count == (int)BPTREE_INNER_CAPACITY - 1) {
+            spares[needed++] = (BPNode)innerCreate(map);
+            level--;
+        }
+        if (level < 0) {
+            spares[needed++] = (BPNode)innerCreate(map);//a new root
+        }
+    }
+    bool failed = false;
+    for (int i = 0; i < needed; i++) {
+        failed = failed || !spares[i];
+    }
+    MapKeyElement key_copy = NULL;
+    if (failed || !mapEntryKey(map, key, &key_copy)) {
+        for (int i = 0; i < needed; i++) {
+            nodeRelease(map, spares[i]);
+        }
+        return NULL;
+    }
+
+    *created = true;
+    if (needed > 0) {
+        return leafSplitInsert(map, path, leaf, position, key_copy, spares);
+    }
+    memmove(&leaf->entries[position + 1], &leaf->entries[position],
+            (leaf->node.count - position) * sizeof(leaf->entries[0]));
+    leaf->entries[position].key = key_copy;
+    leaf->entries[position].data = NULL;
+    leaf->node.count++;
+    return &leaf->entries[position];
+}
+
+static bool bptreeCreate(Map map) {
+    MapBPTree tree = mapAllocate(map, sizeof(*tree));
+    if (!tree) {
+        return false;
+    }
+    BPLeaf root = leafCreate(map);
+    if (!root) {
+        mapDeallocate(map, tree, sizeof(*tree));
+        return false;
+    }
+    tree->root = &root->node;
+    map->engine_data = tree;
+    return true;
+}
+
+static void bptreeDestroy(Map map) {
+    MapBPTree tree = map->engine_data;
+    bptreeDestroyNodes(map, tree->root);
+    mapDeallocate(map, tree, sizeof(*tree));
+    map->engine_data = NULL;
+}
+
+static void bptreeClear(Map map) {
+    MapBPTree tree = map->engine_data;
+    BPLeaf root = leafCreate(map);
+    if (!root) {
+        //keep the old root as the empty tree, it must not refer to freed elements
+        BPLeaf leaf = leftmostLeaf(tree->root);
+        for (; leaf; leaf = leaf->next) {
+            for (int i = 0; i < leaf->node.count; i++) {
+                mapFreeEntry(map, &leaf->entries[i]);
+            }
+            leaf->node.count = 0;
+        }
+        return;
+    }
+    bptreeDestroyNodes(map, tree->root);
+    tree->root = &root->node;
+}
+
+static MapEntry bptreeFind(Map map, MapKeyElement key) {
+    BPLeaf leaf = bptreeDescend(map, key, NULL);
+    int position = leafLowerBound(map, leaf, key);
+    if (position < leaf->node.count && mapCompareKeys(map, leaf->entries[position].key, key) == 0) {
+        return &leaf->entries[position];
+    }
+    return NULL;
+}
+
+static MapEntry bptreeInsert(Map map, MapKeyElement key, bool* created) {
+    BPPath path;
+    BPLeaf leaf = bptreeDescend(map, key, &path);
+    int position = leafLowerBound(map, leaf, key);
+    *created = false;
+    if (position < leaf->node.count && mapCompareKeys(map, leaf->entries[position].key, key) == 0) {
+        return &leaf->entries[position];
+    }
+    return bptreeInsertAt(map, &path, leaf, position, key, created);
+}
+
+static MapEntry bptreeInsertHint(Map map, MapKeyElement key, bool* created) {
+    BPPath path;
+    BPLeaf leaf = bptreeDescendLast(map, &path);
+    //a key after the largest one is appended to the last leaf, without a search
+    if (leaf->node.count == 0 || mapCompareKeys(map, leaf->entries[leaf->node.count - 1].key, key) >= 0) {
+        return bptreeInsert(map, key, created);
+    }
+    *created = false;
+    return bptreeInsertAt(map, &path, leaf, leaf->node.count, key, created);
+}
+
+static MapResult bptreeRemove(Map map, MapKeyElement key, MapEntry removed) {
+    BPPath path;
+    BPLeaf leaf = bptreeDescend(map, key, &path);
+    int position = leafLowerBound(map, leaf, key);
+    if (position == leaf->node.count || mapCompareKeys(map, leaf->entries[position].key, key) != 0) {
+        return MAP_ITEM_DOES_NOT_EXIST;
+    }
+    *removed = leaf->entries[position];
+    leaf->node.count--;
+    memmove(&leaf->entries[position], &leaf->entries[position + 1],
+            (leaf->node.count - position) * sizeof(leaf->entries[0]));
+    bptreeRebalance(map, &path, &leaf->node);
+    bptreeRedirectSeparators(map, removed->key);
+    return MAP_SUCCESS;
+}
+
+static MapEntry bptreeFirst(Map map, MapIterator iterator) {
+    iterator->path[0] = leftmostLeaf(((MapBPTree)map->engine_data)->root);
+    iterator->position = -1;
+    return bptreeNext(map, iterator);
+}
+
+static MapEntry bptreeNext(Map map, MapIterator iterator) {
+    (void)map;
+    BPLeaf leaf = iterator->path[0];
+    iterator->position++;
+    //skip to the next non empty leaf, only an empty root leaf may be empty
+    while (leaf && iterator->position >= leaf->node.count) {
+        leaf = leaf->next;
+        iterator->position = 0;
+    }
+    iterator->path[0] = leaf;
+    return leaf ? &leaf->entries[iterator->position] : NULL;
+}
+
+static MapEntry bptreeSeek(Map map, MapKeyElement key, MapIterator iterator) {
+    BPLeaf leaf = bptreeDescend(map, key, NULL);
+    iterator->path[0] = leaf;
+    iterator->position = leafLowerBound(map, leaf, key) - 1;
+    return bptreeNext(map, iterator);
+}
+
+/* Fills the leaves left to right, then builds every inner level over the one below it. The
+ * nodes of a level share its elements evenly, so none of them falls under its minimum */
+static bool bptreeLoad(Map map, MapEntry entries, int count) {
+    MapBPTree tree = map->engine_data;
+    assert(tree->root->is_leaf && tree->root->count == 0);
+    if (count == 0) {
+        return true;
+    }
+    int nodes = (count + BPTREE_LEAF_CAPACITY - 1) / BPTREE_LEAF_CAPACITY;
+    BPNode* level = mapAllocate(map, nodes * sizeof(*level));
+    if (!level) {
+        return false;
+    }
+    BPLeaf previous = NULL;
+    for (int i = 0, first = 0; i < nodes; i++) {
+        BPLeaf leaf = leafCreate(map);
+        if (!leaf) {
+            levelRelease(map, level, i, nodes);
+            return false;
+        }
+        int last = (int)((long long)count * (i + 1) / nodes);
+        memcpy(leaf->entries, entries + first, (last - first) * sizeof(*entries));
+        leaf->node.count = last - first;
+        first = last;
+        if (previous) {
+            previous->next = leaf;
+        }
+        previous = leaf;
+        level[i] = &leaf->node;
+    }
+    while (nodes > 1) {
+        int parents = (nodes + BPTREE_INNER_CAPACITY - 1) / BPTREE_INNER_CAPACITY;
+        BPNode* upper = mapAllocate(map, parents * sizeof(*upper));
+        if (!upper) {
+            levelRelease(map, level, nodes, nodes);
+            return false;
+        }
+        for (int i = 0, first = 0; i < parents; i++) {
+            BPInner inner = innerCreate(map);
+            if (!inner) {
+                for (int j = 0; j < i; j++) {
+                    nodeRelease(map, upper[j]);
+                }
+                mapDeallocate(map, upper, parents * sizeof(*upper));
+                levelRelease(map, level, nodes, nodes);
+                return false;
+            }
+            int last = (int)((long long)nodes * (i + 1) / parents);
+            for (int j = first; j < last; j++) {
+                if (j > first) {
+                    inner->keys[j - first - 1] = leftmostLeaf(level[j])->entries[0].key;
+                }
+                inner->children[j - first] = level[j];
+            }
+            inner->node.count = last - first - 1;
+            first = last;
+            upper[i] = &inner->node;
+        }
+        mapDeallocate(map, level, nodes * sizeof(*level));
+        level = upper;
+        nodes = parents;
+    }
+    nodeRelease(map, tree->root);
+    tree->root = level[0];
+    mapDeallocate(map, level, sizeof(*level));
+    return true;
+}
+
+static bool bptreeReserve(Map map, int size) {
+    //a split leaves two half full leaves, so a new leaf comes with every BPTREE_LEAF_MIN new
+    //entries at worst, and a new inner node with every BPTREE_INNER_MIN new children.
+    //Both are sized to BPTREE_NODE_SIZE, their blocks come from the same size class
+    int leaves = (size - map->size) / BPTREE_LEAF_MIN + 1;
+    int inners = leaves / BPTREE_INNER_MIN + 1;
+    return mapPoolReserve(map->pool, sizeof(struct bptree_leaf_t), leaves + inners);
+}
@@ -0,0 +1,561 @@
+#include "map_engine.h"
+#include <assert.h>
+#include <limits.h>
+#include <string.h>
+
+/**
+* Serialization of maps.
+*
+* An encoded map is CODEC_MAGIC, the number of pairs, then for every pair in
+* ascending key order the length of its key, its key, the length of its data and
+* its data. Numbers take CODEC_NUMBER_SIZE bytes, least significant first.
+* Elements are encoded by the codec of the map, plain elements are their own
+* bytes (an int key is the bytes of the int).
+*
+* Writing to a buffer encodes every element in place, right after the room for
+* its length. Writing to a stream encodes every element into a scratch buffer
+* taken from the map's allocator, which grows to the largest element.
+* Reading collects the decoded pairs and hands them to mapLoadEntries, so a map is
+* rebuilt in linear time. A map whose engine appends a key after its largest one in
+* O(1) and as compactly as it loads (the list and the B+tree) takes every pair as it
+* is read instead, through mapAppendEntry, without the room for all of them.
+*/
+
+#define CODEC_MAGIC "MAPS"
+#define CODEC_MAGIC_SIZE 4
+#define CODEC_NUMBER_SIZE 4
+#define CODEC_NUMBER_MAX 0xFFFFFFFFul
+/* Pairs the reader makes room for at first, the room doubles whenever it runs out */
+#define CODEC_FIRST_ENTRIES 16
+
+typedef struct codec_writer_t {
+    unsigned char* buffer; // NULL when writing to a stream
+    size_t size;
+    size_t length; // bytes written so far, also counting those that didn't fit in the buffer
+    FILE* stream; // NULL when writing to a buffer
+    unsigned char* scratch;
+    size_t scratch_size;
+    MapResult result;
+}*CodecWriter;
+
+typedef struct codec_reader_t {
+    const unsigned char* buffer; // NULL when reading from a stream
+    size_t size;
+    size_t position; // bytes read so far
+    FILE* stream; // NULL when reading from a buffer
+    unsigned char* scratch;
+    size_t scratch_size;
+}*CodecReader;
+
+/* declaring functions */
+static bool codecCanEncode(Map map);
+static bool codecCanDecode(Map map);
+static size_t codecKeyValueSize(Map map);
+static bool codecReserveScratch(Map map, unsigned char** scratch, size_t* scratch_size, size_t size);
+static void writerWrite(CodecWriter writer, const void* bytes, size_t size);
+static void writerWriteNumber(CodecWriter writer, size_t number);
+static void writerWriteElement(Map map, CodecWriter writer, void* element, encodeMapElements encode,
+                               size_t plain_size);
+static void writerWriteMap(Map map, CodecWriter writer);
+static MapResult readerRead(Map map, CodecReader reader, size_t size, const unsigned char** bytes);
+static MapResult readerReadNumber(Map map, CodecReader reader, size_t* number);
+static MapResult readerReadKey(Map map, CodecReader reader, MapKeyElement* key);
+static MapResult readerReadData(Map map, CodecReader reader, MapDataElement* data);
+static MapResult readerReadPair(Map map, CodecReader reader, MapEntry entry, MapKeyElement previous_key);
+static MapResult readerLoadPairs(Map map, CodecReader reader, size_t count);
+static MapResult readerAppendPairs(Map map, CodecReader reader, size_t count);
+static MapResult readerReadMap(Map map, CodecReader reader);
+
+
+/**
+ * codecCanEncode: checks whether the keys and data of a map can be encoded.
+ *
+ * @param map - the map to check.
+ * @return
+ * true if every element is plain or has an encode function, false otherwise.
+ */
+static bool codecCanEncode(Map map) {
+    return (mapKeysByValue(map) || map->key_size || map->encodeKeyElements) &&
+           (map->data_size || map->encodeDataElements);
+}
+
+/**
+ * codecCanDecode: checks whether the keys and data of a map can be decoded.
+ *
+ * @param map - the map to check.
+ * @return
+ * true if every element is plain or has a decode function, false otherwise.
+ */
+static bool codecCanDecode(Map map) {
+    return (mapKeysByValue(map) || map->key_size || map->decodeKeyElements) &&
+           (map->data_size || map->decodeDataElements);
+}
+
+/**
+ * codecKeyValueSize: returns the size of the encoding of a key held by value.
+ *
+ * @param map - a map holding its keys by value (see mapKeysByValue).
+ * @return
+ * The size of the key's value, which is encoded as it is.
+ */
+static size_t codecKeyValueSize(Map map) {
+    return map->key_type == MAP_KEY_INT ? sizeof(int) : sizeof(uint64_t);
+}
+
+/**
+ * codecReserveScratch: grows a scratch buffer taken from the map's allocator to hold size bytes.
+ *
+ * @param map - the map whose allocator is used.
+ * @param scratch - the buffer, NULL at first.
+ * @param scratch_size - its size, 0 at first.
+ * @param size - the number of bytes it must hold.
+ * @return
+ * false if allocation failed, the buffer is then unchanged. true otherwise.
+ */
+static bool codecReserveScratch(Map map, unsigned char** scratch, size_t* scratch_size, size_t size) {
+    if (size <= *scratch_size) {
+        return true;
+    }
+    unsigned char* new_scratch = map->allocator.allocate(map->allocator.context, size);
+    if (!new_scratch) {
+        return false;
+    }
+    if (*scratch) {
+        map->allocator.deallocate(map->allocator.context, *scratch, *scratch_size);
+    }
+    *scratch = new_scratch;
+    *scratch_size = size;
+    return true;
+}
+
+/**
+ * writerWrite: writes bytes to the stream, or to the buffer if they fit in it.
+ *
+ * @param writer - where to write.
+ * @param bytes - the bytes.
+ * @param size - the number of bytes.
+ */
+static void writerWrite(CodecWriter writer, const void* bytes, size_t size) {
+    if (writer->result != MAP_SUCCESS || size == 0) {
+        return;
+    }
+    if (writer->stream) {
+        if (fwrite(bytes, 1, size, writer->stream) != size) {
+            writer->result = MAP_ERROR;
+        }
+    }
+    else if (writer->length <= writer->size && size <= writer->size - writer->length) {
+        memcpy(writer->buffer + writer->length, bytes, size);
+    }
+    writer->length += size;
+}
+
+/**
+ * writerWriteNumber: writes a number as CODEC_NUMBER_SIZE bytes, least significant first.
+ *
+ * @param writer - where to write.
+ * @param number - the number, at most CODEC_NUMBER_MAX.
+ */
+static void writerWriteNumber(CodecWriter writer, size_t number) {
+    assert(number <= CODEC_NUMBER_MAX);
+    unsigned char bytes[CODEC_NUMBER_SIZE];
+    for (int i = 0; i < CODEC_NUMBER_SIZE; i++) {
+        bytes[i] = (unsigned char)(number >> (8 * i));
+    }
+    writerWrite(writer, bytes, sizeof(bytes));
+}
+
+/**
+ * writerWriteElement: writes the length and the encoding of a key or data element.
+ *
+ * @param map - the map the element belongs to.
+ * @param writer - where to write.
+ * @param element - the element, as the user gave it.
+ * @param encode - the encode function of the element, NULL for a plain element.
+ * @param plain_size - the size of a plain element.
+ */
+static void writerWriteElement(Map map, CodecWriter writer, void* element, encodeMapElements encode,
+                               size_t plain_size) {
+    if (writer->result != MAP_SUCCESS) {
+        return;
+    }
+    if (!encode) {
+        writerWriteNumber(writer, plain_size);
+        writerWrite(writer, element, plain_size);
+        return;
+    }
+    size_t length = 0;
+    if (writer->stream) {
+        length = encode(element, writer->scratch, writer->scratch_size);
+        if (length > writer->scratch_size) {
+            if (!codecReserveScratch(map, &writer->scratch, &writer->scratch_size, length)) {
+                writer->result = MAP_OUT_OF_MEMORY;
+                return;
+            }
+            length = encode(element, writer->scratch, writer->scratch_size);
+        }
+    }
+    else {
+        //the element is encoded in place, after the room for its length
+        size_t start = writer->length + CODEC_NUMBER_SIZE;
+        size_t room = start <= writer->size ? writer->size - start : 0;
+        length = encode(element, room > 0 ? writer->buffer + start : NULL, room);
+    }
+    if (length > CODEC_NUMBER_MAX) {
+        writer->result = MAP_ERROR;
+        return;
+    }
+    writerWriteNumber(writer, length);
+    if (writer->stream) {
+        writerWrite(writer, writer->scratch, length);
+    }
+    else {
+        writer->length += length;
+    }
+}
+
+/**
+ * writerWriteMap: writes the pairs of a map.
+ *
+ * @param map - the map to write, whose elements can be encoded.
+ * @param writer - where to write.
+ */
+static void writerWriteMap(Map map, CodecWriter writer) {
+    writerWrite(writer, CODEC_MAGIC, CODEC_MAGIC_SIZE);
+    writerWriteNumber(writer, (size_t)map->size);
+    struct map_iterator_t iterator;
+    for (MapEntry entry = map->engine->first(map, &iterator); entry && writer->result == MAP_SUCCESS;
+         entry = map->engine->next(map, &iterator)) {
+        if (mapKeysByValue(map)) {
+            MapKeyValue key_value;
+            writerWriteElement(map, writer, mapKeyView(map, entry->key, &key_value), NULL, codecKeyValueSize(map));
+        }
+        else {
+            writerWriteElement(map, writer, entry->key, map->encodeKeyElements, map->key_size);
+        }
+        writerWriteElement(map, writer, mapEntryData(map, entry), map->encodeDataElements, map->data_size);
+    }
+}
+
+/**
+ * readerRead: reads bytes.
+ *
+ * @param map - the map being filled, whose allocator holds the scratch buffer.
+ * @param reader - where to read from.
+ * @param size - the number of bytes.
+ * @param bytes - where the address of the bytes is stored. They stay valid until the next read.
+ * @return
+ * MAP_ERROR if there are fewer bytes left, MAP_OUT_OF_MEMORY if the scratch buffer
+ * couldn't grow, MAP_SUCCESS otherwise.
+ */
+static MapResult readerRead(Map map, CodecReader reader, size_t size, const unsigned char** bytes) {
+    if (!reader->stream) {
+        if (size > reader->size - reader->position) {
+            return MAP_ERROR;
+        }
+        *bytes = reader->buffer + reader->position;
+        reader->position += size;
+        return MAP_SUCCESS;
+    }
+    if (!codecReserveScratch(map, &reader->scratch, &reader->scratch_size, size)) {
+        return MAP_OUT_OF_MEMORY;
+    }
+    if (size > 0 && fread(reader->scratch, 1, size, reader->stream) != size) {
+        return MAP_ERROR;
+    }
+    *bytes = reader->scratch;
+    reader->position += size;
+    return MAP_SUCCESS;
+}
+
+/**
+ * readerReadNumber: reads a number written by writerWriteNumber.
+ *
+ * @param map - the map being filled.
+ * @param reader - where to read from.
+ * @param number - where the number is stored.
+ * @return
+ * As readerRead.
+ */
+static MapResult readerReadNumber(Map map, CodecReader reader, size_t* number) {
+    const unsigned char* bytes = NULL;
+    MapResult result = readerRead(map, reader, CODEC_NUMBER_SIZE, &bytes);
+    if (result != MAP_SUCCESS) {
+        return result;
+    }
+    *number = 0;
+    for (int i = CODEC_NUMBER_SIZE - 1; i >= 0; i--) {
+        *number = (*number << 8) | bytes[i];
+    }
+    return MAP_SUCCESS;
+}
+
+/**
+ * readerReadKey: reads a key and makes the map's key out of it.
+ *
+ * @param map - the map being filled.
+ * @param reader - where to read from.
+ * @param key - where the key is stored, as stored in entries.
+ * @return
+ * MAP_ERROR if the bytes are not a valid key, MAP_OUT_OF_MEMORY if an allocation
+ * failed, MAP_SUCCESS otherwise.
+ */
+static MapResult readerReadKey(Map map, CodecReader reader, MapKeyElement* key) {
+    size_t length = 0;
+    const unsigned char* bytes = NULL;
+    MapResult result = readerReadNumber(map, reader, &length);
+    if (result == MAP_SUCCESS) {
+        result = readerRead(map, reader, length, &bytes);
+    }
+    if (result != MAP_SUCCESS) {
+        return result;
+    }
+    if (mapKeysByValue(map)) {
+        if (length != codecKeyValueSize(map)) {
+            return MAP_ERROR;
+        }
+        MapKeyValue key_value;
+        memcpy(&key_value, bytes, length);
+        *key = map->key_type == MAP_KEY_INT ? MAP_INT_TO_KEY(key_value.int_key) :
+               MAP_UINT64_TO_KEY(key_value.uint64_key);
+        return MAP_SUCCESS;
+    }
+    if (map->key_size) {
+        if (length != map->key_size) {
+            return MAP_ERROR;
+        }
+        return mapCopyKey(map, (MapKeyElement)bytes, key) ? MAP_SUCCESS : MAP_OUT_OF_MEMORY;
+    }
+    *key = map->decodeKeyElements(bytes, length, &map->allocator);
+    return *key ? MAP_SUCCESS : MAP_ERROR;
+}
+
+/**
+ * readerReadData: reads a data element and makes the map's data out of it.
+ *
+ * @param map - the map being filled.
+ * @param reader - where to read from.
+ * @param data - where the data is stored.
+ * @return
+ * As readerReadKey.
+ */
+static MapResult readerReadData(Map map, CodecReader reader, MapDataElement* data) {
+    size_t length = 0;
+    const unsigned char* bytes = NULL;
+    MapResult result = readerReadNumber(map, reader, &length);
+    if (result == MAP_SUCCESS) {
+        result = readerRead(map, reader, length, &bytes);
+    }
+    if (result != MAP_SUCCESS) {
+        return result;
+    }
+    if (map->data_size) {
+        if (length != map->data_size) {
+            return MAP_ERROR;
+        }
+        return mapCopyData(map, (MapDataElement)bytes, data) ? MAP_SUCCESS : MAP_OUT_OF_MEMORY;
+    }
+    *data = map->decodeDataElements(bytes, length, &map->allocator);
+    return *data ? MAP_SUCCESS : MAP_ERROR;
+}
+
+/**
+ * readerReadPair: reads a pair and makes the map's key and data out of it.
+ *
+ * @param map - the map being filled.
+ * @param reader - where to read from.
+ * @param entry - where the key and the data are stored.
+ * @param previous_key - the key of the pair read before, as stored in entries, NULL for
+ *      the first pair. The keys must be strictly increasing.
+ * @return
+ * As readerReadKey, the pair is freed on failure.
+ */
+static MapResult readerReadPair(Map map, CodecReader reader, MapEntry entry, MapKeyElement previous_key) {
+    entry->data = NULL;
+    MapResult result = readerReadKey(map, reader, &entry->key);
+    if (result != MAP_SUCCESS) {
+        return result;
+    }
+    result = readerReadData(map, reader, &entry->data);
+    if (result == MAP_SUCCESS && previous_key && mapCompareKeys(map, previous_key, entry->key) >= 0) {
+        result = MAP_ERROR;//the keys must be strictly increasing
+    }
+    if (result != MAP_SUCCESS) {
+        mapFreeEntry(map, entry);
+    }
+    return result;
+}
+
+/**
+ * readerLoadPairs: collects the pairs of an encoded map and loads them into the map at once.
+ *
+ * @param map - the empty map to fill.
+ * @param reader - where to read from, right after the number of pairs.
+ * @param count - the number of pairs, not 0.
+ * @return
+ * As readerReadMap, the map is still empty on failure.
+ */
+static MapResult readerLoadPairs(Map map, CodecReader reader, size_t count) {
+    MapResult result = MAP_SUCCESS;
+    MapEntry entries = NULL;
+    size_t capacity = 0;
+    size_t decoded = 0;
+    while (decoded < count && result == MAP_SUCCESS) {
+        if (decoded == capacity) {
+            //the room grows with the pairs actually read, whatever count claims
+            size_t new_capacity = capacity > 0 ? 2 * capacity : CODEC_FIRST_ENTRIES;
+            new_capacity = new_capacity < count ? new_capacity : count;
+            MapEntry new_entries = map->allocator.allocate(map->allocator.context,
+                                                           new_capacity * sizeof(*entries));
+            if (!new_entries) {
+                result = MAP_OUT_OF_MEMORY;
+                break;
+            }
+            if (entries) {
+                memcpy(new_entries, entries, decoded * sizeof(*entries));
+                map->allocator.deallocate(map->allocator.context, entries, capacity * sizeof(*entries));
+            }
+            entries = new_entries;
+            capacity = new_capacity;
+        }
+        result = readerReadPair(map, reader, &entries[decoded], decoded > 0 ? entries[decoded - 1].key : NULL);
+        if (result == MAP_SUCCESS) {
+            decoded++;
+        }
+    }
+    if (result == MAP_SUCCESS) {
+        result = mapLoadEntries(map, entries, (int)count);
+    }
+    if (result != MAP_SUCCESS) {
+        for (size_t i = 0; i < decoded; i++) {
+            mapFreeEntry(map, &entries[i]);
+        }
+    }
+    if (entries) {
+        map->allocator.deallocate(map->allocator.context, entries, capacity * sizeof(*entries));
+    }
+    return result;
+}
+
+/**
+ * readerAppendPairs: reads the pairs of an encoded map and appends each one to the map
+ * as soon as it is read.
+ *
+ * @param map - the empty map to fill, whose engine appends in O(1).
+ * @param reader - where to read from, right after the number of pairs.
+ * @param count - the number of pairs, not 0.
+ * @return
+ * As readerReadMap, the map is emptied again on failure.
+ */
+static MapResult readerAppendPairs(Map map, CodecReader reader, size_t count) {
+    MapResult result = MAP_SUCCESS;
+    MapKeyElement previous_key = NULL;
+    for (size_t appended = 0; appended < count && result == MAP_SUCCESS; appended++) {
+        struct map_entry_t entry;
+        result = readerReadPair(map, reader, &entry, previous_key);
+        if (result != MAP_SUCCESS) {
+            break;
+        }
+        result = mapAppendEntry(map, &entry);
+        if (result != MAP_SUCCESS) {
+            mapFreeEntry(map, &entry);
+        }
+        previous_key = entry.key;
+    }
+    if (result != MAP_SUCCESS) {
+        mapClear(map);
+    }
+    return result;
+}
+
+/**
+ * readerReadMap: fills an empty map with the pairs written by writerWriteMap.
+ *
+ * @param map - the map to fill.
+ * @param reader - where to read from.
+ * @return
+ * MAP_ERROR if the map is not empty or can't be decoded, or the bytes are not a valid
+ * encoding, MAP_OUT_OF_MEMORY if an allocation failed, MAP_SUCCESS otherwise.
+ */
+static MapResult readerReadMap(Map map, CodecReader reader) {
+    if (map->size != 0 || !codecCanDecode(map)) {
+        return MAP_ERROR;
+    }
+    const unsigned char* magic = NULL;
+    MapResult result = readerRead(map, reader, CODEC_MAGIC_SIZE, &magic);
+    if (result != MAP_SUCCESS) {
+        return result;
+    }
+    if (memcmp(magic, CODEC_MAGIC, CODEC_MAGIC_SIZE) != 0) {
+        return MAP_ERROR;
+    }
+    size_t count = 0;
+    result = readerReadNumber(map, reader, &count);
+    if (result != MAP_SUCCESS) {
+        return result;
+    }
+    if (count > INT_MAX) {
+        return MAP_ERROR;
+    }
+    if (count == 0) {
+        return MAP_SUCCESS;
+    }
+
+    //engines appending in O(1) take the pairs one by one, the others are loaded at once
+    if (map->engine == &map_bptree_engine || map->engine == &map_list_engine) {
+        return readerAppendPairs(map, reader, count);
+    }
+    return readerLoadPairs(map, reader, count);
+}
+
+MapResult mapSerialize(Map map, unsigned char* buffer, size_t size, size_t* length) {
+    if (!map || !length || (!buffer && size > 0)) {
+        return MAP_NULL_ARGUMENT;
+    }
+    if (!codecCanEncode(map)) {
+        return MAP_ERROR;
+    }
+    struct codec_writer_t writer = { buffer, size, 0, NULL, NULL, 0, MAP_SUCCESS };
+    writerWriteMap(map, &writer);
+    *length = writer.length;
+    return writer.result;
+}
+
+MapResult mapDeserialize(Map map, const unsigned char* buffer, size_t size, size_t* length) {
+    if (!map || !buffer) {
+        return MAP_NULL_ARGUMENT;
+    }
+    struct codec_reader_t reader = { buffer, size, 0, NULL, NULL, 0 };
+    MapResult result = readerReadMap(map, &reader);
+    if (length) {
+        *length = reader.position;
+    }
+    return result;
+}
+
+MapResult mapSerializeToFile(Map map, FILE* stream) {
+    if (!map || !stream) {
+        return MAP_NULL_ARGUMENT;
+    }
+    if (!codecCanEncode(map)) {
+        return MAP_ERROR;
+    }
+    struct codec_writer_t writer = { NULL, 0, 0, stream, NULL, 0, MAP_SUCCESS };
+    writerWriteMap(map, &writer);
+    if (writer.scratch) {
+        map->allocator.deallocate(map->allocator.context, writer.scratch, writer.scratch_size);
+    }
+    return writer.result;
+}
+
+MapResult mapDeserializeFromFile(Map map, FILE* stream) {
+    if (!map || !stream) {
+        return MAP_NULL_ARGUMENT;
+    }
+    struct codec_reader_t reader = { NULL, 0, 0, stream, NULL, 0 };
+    MapResult result = readerReadMap(map, &reader);
+    if (reader.scratch) {
+        map->allocator.deallocate(map->allocator.context, reader.scratch, reader.scratch_size);
+    }
+    return result;
+}
@@ -0,0 +1,549 @@
+#ifndef MAP_ENGINE_H_
+#define MAP_ENGINE_H_
+
+#include "map.h"
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+* Map engine interface - internal to the map implementation.
+*
+* A Map is a front end (map.c) which owns the element callbacks, the size and
+* the internal iterator, and an engine which owns the ordered structure
+* holding the (key,data) pairs. Engines never call the element callbacks
+* directly, they go through mapEntryKey, mapCopyKey, mapFreeKey and mapFreeEntry, and
+* allocate their nodes through mapAllocate/mapDeallocate.
+*
+* Every map owns a memory pool (map_pool.c) which serves mapAllocate. All the
+* memory of an engine must come from it: a map whose elements need no freeing
+* is destroyed by releasing the pool, without calling the engine's destroy.
+* A snapshot (see mapSnapshot) shares its map's pool, and the pool is then only
+* released with the last of them.
+*
+* The following engines are available:
+*   map_list_engine	- Sorted singly linked list with a dummy head node.
+*   				  O(n) point operations, O(1) ascending mapPutHint.
+*   map_tree_engine	- AVL tree. O(log n) point operations.
+*   map_bptree_engine	- B+tree with linked leaves and cache line sized nodes.
+*   				  O(log n) point operations, scans walk contiguous leaves,
+*   				  one key comparison per ascending mapPutHint.
+*   map_array_engine	- Sorted array for small maps, which replaces itself by
+*   				  map_tree_engine when the map grows (MAP_ENGINE_ADAPTIVE).
+*   				  An engine may thus change map->engine. O(1) ascending
+*   				  mapPutHint while the array has room.
+*
+* A map created with a hash function also keeps a hash index (map_hash.c)
+* mirroring the engine's pairs, which answers mapGet and mapContains, unless
+* it is held by map_array_engine.
+*/
+
+/** Maximal depth of an engine path. An AVL tree holding 2^31 keys is at most 45 levels deep */
+#define MAP_MAX_DEPTH 48
+
+/**
+* A (key,data) pair as stored inside an engine node. The key is the map's own copy
+* of the user's key, or the key's value itself in an int keyed map (see MAP_KEY_INT)
+* and in a uint64_t keyed map where pointers are 64 bits wide (see mapKeysByValue).
+*/
+typedef struct map_entry_t {
+    MapKeyElement key;
+    MapDataElement data;
+} *MapEntry;
+
+/** Position of an iteration over an engine, private to the engine that filled it */
+typedef struct map_iterator_t {
+    void* path[MAP_MAX_DEPTH];
+    int depth;
+    int position; // index inside the node at the top of the path, for engines with multi-entry nodes
+} *MapIterator;
+
+/** Operations every engine provides */
+typedef struct map_engine_t {
+    /** Allocates the engine structure of an empty map, false if allocation failed */
+    bool (*create)(Map map);
+    /** Frees all the entries (using mapFreeEntry) and the engine structure */
+    void (*destroy)(Map map);
+    /** Frees all the entries, leaving an empty structure */
+    void (*clear)(Map map);
+    /** Returns the entry matching key, NULL if there is none */
+    MapEntry (*find)(Map map, MapKeyElement key);
+    /**
+     * Returns the entry matching key. If there is none a new entry is linked in
+     * its place holding the key made by mapEntryKey and a NULL data, and
+     * *created is set to true. The caller must then set the data.
+     * Returns NULL if allocation or the key copy failed, the structure is then unchanged.
+     */
+    MapEntry (*insert)(Map map, MapKeyElement key, bool* created);
+    /**
+     * Unlinks the entry matching key and copies it into removed. The elements are
+     * not freed, that is left to the caller. Returns MAP_ITEM_DOES_NOT_EXIST if there
+     * is no such entry, and MAP_OUT_OF_MEMORY if nodes shared with a snapshot could
+     * not be copied, the structure then still holds the entry.
+     */
+    MapResult (*remove)(Map map, MapKeyElement key, MapEntry removed);
+    /** Positions iterator on the smallest entry and returns it, NULL if the map is empty */
+    MapEntry (*first)(Map map, MapIterator iterator);
+    /** Advances iterator to the next entry and returns it, NULL at the end */
+    MapEntry (*next)(Map map, MapIterator iterator);
+    /**
+     * Positions iterator on the smallest entry whose key is not smaller than key
+     * and returns it, NULL if there is none. next continues from there.
+     */
+    MapEntry (*seek)(Map map, MapKeyElement key, MapIterator iterator);
+    /**
+     * Links count entries, sorted by strictly increasing key, into an empty structure
+     * in O(count), taking over their elements. Returns false if allocation failed,
+     * the structure is then still empty and the elements are left to the caller.
+     */
+    bool (*load)(Map map, MapEntry entries, int count);
+    /**
+     * Makes the empty structure of snapshot, a map sharing map's pool, share all of
+     * map's nodes in O(1). Either map then copies a shared node before changing it.
+     * Returns false if allocation failed. NULL for engines that can't share nodes,
+     * mapSnapshot then makes a full copy.
+     */
+    bool (*share)(Map map, Map snapshot);
+    /**
+     * Walks the entries in order and unlinks, in the same pass, every entry for which
+     * unlink returns true. unlink takes care of the entry's elements before returning.
+     * Returns the number of unlinked entries. NULL for engines whose removals rebalance
+     * the structure, mapRemoveIf then removes the entries one by one.
+     */
+    int (*remove_if)(Map map, bool (*unlink)(Map map, MapEntry entry, void* context), void* context);
+    /**
+     * As insert, for a key expected to follow the key of the last insertion, or to be
+     * greater than every key, from where the search starts. NULL for engines whose
+     * searches don't depend on where they start, mapPutHint then uses insert.
+     */
+    MapEntry (*insert_hint)(Map map, MapKeyElement key, bool* created);
+    /**
+     * Makes room for size entries, more than the map holds, so that inserting up to
+     * them allocates nothing for the structure. Returns false if allocation failed,
+     * the entries are then unchanged.
+     */
+    bool (*reserve)(Map map, int size);
+} MapEngineOps;
+
+/** Type for defining the map, shared by the front end and the engines */
+struct Map_t {
+    const MapEngineOps* engine;
+    MapEngine engine_kind; // the choice the engine was made from, kept by mapCopy
+    void* engine_data;
+    int size;
+    bool iterator_valid; // false once the structure changed under the internal iterator
+    unsigned int version; // changes whenever a key is added or removed, checked by cursors
+    struct map_iterator_t iterator;
+    copyMapDataElements copyDataElements;
+    copyMapKeyElements copyKeyElements;
+    freeMapDataElements freeDataElements;
+    freeMapKeyElements freeKeyElements;
+    compareMapKeyElements compareKeyElements;
+    hashMapKeyElements hashKeyElements; // NULL if the map has no hash index
+    encodeMapElements encodeKeyElements; // the codec of the keys and of the data, NULL
+    decodeMapElements decodeKeyElements; // for plain elements and for maps that can't
+    encodeMapElements encodeDataElements; // be serialized, see map_codec.c
+    decodeMapElements decodeDataElements;
+    struct map_hash_t* hash; // NULL in a snapshot until its first point lookup builds it
+    bool shared; // the map shared its structure with a snapshot, see mapGetMutable
+    MapKeyType key_type; // MAP_KEY_INT and MAP_KEY_UINT64 entries may hold the values of the
+                         // keys instead of pointers to copies, see mapKeysByValue
+    size_t key_size; // if not 0 keys are copied as plain bytes into the pool
+    size_t data_size; // if not 0 data is copied as plain bytes into the pool
+    bool inline_data; // plain data is copied into the entries' data fields instead, see mapEntryData
+    struct map_pool_t* pool;
+    bool take_key; // set by mapPutTake during an insertion, see mapEntryKey
+    MapAllocator allocator; // where the map, its pool and its cursors take their memory from
+    MapStats stats; // only counted in builds made with -DMAP_STATS, see MAP_COUNT
+};
+
+/** Adds amount to a counter of map's stats in builds made with -DMAP_STATS, does nothing otherwise */
+#ifdef MAP_STATS
+#define MAP_COUNT(map, counter, amount) ((map)->stats.counter += (amount))
+#else
+#define MAP_COUNT(map, counter, amount) ((void)0)
+#endif
+
+/** Converts an int key to the key stored in an entry of an int keyed map, and back */
+#define MAP_INT_TO_KEY(value) ((MapKeyElement)(intptr_t)(value))
+#define MAP_KEY_TO_INT(key) ((int)(intptr_t)(key))
+
+/** Whether an entry's key field can hold a uint64_t key. Where pointers are narrower,
+ * uint64_t keys are copied into the pool as keys of 8 bytes */
+#define MAP_UINT64_KEYS_INLINE (UINTPTR_MAX >= UINT64_MAX)
+
+/** Converts a uint64_t key to the key stored in an entry of a uint64_t keyed map, and back,
+ * where MAP_UINT64_KEYS_INLINE */
+#define MAP_UINT64_TO_KEY(value) ((MapKeyElement)(uintptr_t)(value))
+#define MAP_KEY_TO_UINT64(key) ((uint64_t)(uintptr_t)(key))
+
+/** The value of a key held by value in an entry, copied out to be handed out by address */
+typedef union map_key_value_t {
+    int int_key;
+    uint64_t uint64_key;
+} MapKeyValue;
+
+/**
+* mapKeysByValue: Tells whether the entries of a map hold the values of its keys in
+* their key fields, rather than pointers to copies: int keys, and uint64_t keys where
+* MAP_UINT64_KEYS_INLINE. Adding such a key allocates nothing.
+*
+* @param map - The map.
+*/
+static inline bool mapKeysByValue(Map map) {
+    return map->key_type == MAP_KEY_INT || (map->key_type == MAP_KEY_UINT64 && MAP_UINT64_KEYS_INLINE);
+}
+
+/**
+* mapKeyView: Returns a key stored in an entry as the user's functions see it.
+*
+* @param map - The map the key belongs to.
+* @param key - The key, as stored in an entry.
+* @param value - Where the value of a key held by value is copied.
+* @return
+* 	A pointer to value for a key held by value (see mapKeysByValue), key itself otherwise.
+*/
+static inline MapKeyElement mapKeyView(Map map, MapKeyElement key, MapKeyValue* value) {
+    if (map->key_type == MAP_KEY_INT) {
+        value->int_key = MAP_KEY_TO_INT(key);
+        return &value->int_key;
+    }
+    if (map->key_type == MAP_KEY_UINT64 && MAP_UINT64_KEYS_INLINE) {
+        value->uint64_key = MAP_KEY_TO_UINT64(key);
+        return &value->uint64_key;
+    }
+    return key;
+}
+
+/**
+* mapCompareKeysAs: Compares two keys stored in entries of a map whose keys are of a
+* given type. Int keys are compared in place, uint64_t keys by value, other keys
+* through the compare function given at initialization.
+* A search loop takes the key type as a parameter and is called with each constant
+* type in turn (see MAP_KEY_TYPE_SWITCH), so that once inlined, the loop is compiled
+* once per type and its comparisons don't test the type.
+*
+* @param map - The map the keys belong to.
+* @param key_type - The key type of map.
+* @param key1, key2 - The keys to compare, as stored in entries.
+* @return
+* 	A positive integer if key1 is greater, 0 if they're equal, a negative integer otherwise.
+*/
+static inline int mapCompareKeysAs(Map map, MapKeyType key_type, MapKeyElement key1, MapKeyElement key2) {
+    MAP_COUNT(map, comparisons, 1);
+    if (key_type == MAP_KEY_INT) {
+        int value1 = MAP_KEY_TO_INT(key1);
+        int value2 = MAP_KEY_TO_INT(key2);
+        return (value1 > value2) - (value1 < value2);
+    }
+    if (key_type == MAP_KEY_UINT64) {
+        uint64_t value1 = MAP_UINT64_KEYS_INLINE ? MAP_KEY_TO_UINT64(key1) : *(const uint64_t*)key1;
+        uint64_t value2 = MAP_UINT64_KEYS_INLINE ? MAP_KEY_TO_UINT64(key2) : *(const uint64_t*)key2;
+        return (value1 > value2) - (value1 < value2);
+    }
+    return map->compareKeyElements(key1, key2);
+}
+
+/**
+* mapCompareKeys: Compares two keys stored in entries of a map, as mapCompareKeysAs
+* does for the map's key type. For single comparisons outside search loops.
+*/
+static inline int mapCompareKeys(Map map, MapKeyElement key1, MapKeyElement key2) {
+    return mapCompareKeysAs(map, map->key_type, key1, key2);
+}
+
+/**
+* MAP_KEY_TYPE_SWITCH: Returns search(map, key_type, ...) with key_type the key type of
+* map given as a constant, so that each case inlines search specialized for its type.
+* search is a static inline function taking the map and the key type first.
+*/
+#define MAP_KEY_TYPE_SWITCH(map, search, ...) \
+    switch ((map)->key_type) { \
+        case MAP_KEY_INT: \
+            return search((map), MAP_KEY_INT, __VA_ARGS__); \
+        case MAP_KEY_UINT64: \
+            return search((map), MAP_KEY_UINT64, __VA_ARGS__); \
+        default: \
+            return search((map), MAP_KEY_POINTER, __VA_ARGS__); \
+    }
+
+extern const MapEngineOps map_list_engine;
+extern const MapEngineOps map_tree_engine;
+extern const MapEngineOps map_bptree_engine;
+extern const MapEngineOps map_array_engine;
+
+/**
+* mapAllocate: Allocates memory for an engine node or structure.
+*
+* @param map - The map the memory belongs to.
+* @param size - Size in bytes.
+* @return
+* 	NULL if allocation failed, the allocated memory otherwise.
+*/
+void* mapAllocate(Map map, size_t size);
+
+/**
+* mapDeallocate: Releases memory obtained by mapAllocate.
+*
+* @param map - The map the memory belongs to.
+* @param pointer - The memory to release. NULL is ignored.
+* @param size - The size given to mapAllocate.
+*/
+void mapDeallocate(Map map, void* pointer, size_t size);
+
+/**
+* mapCopyKey: Makes the map's own copy of a key element, using the copy function
+* given at initialization. Keys of an int keyed map are values and are not copied.
+*
+* @param map - The map the copy is made for.
+* @param key - The key to copy, as stored in an entry.
+* @param copy - Pointer to store the copy in.
+* @return
+* 	false if the copy failed, true otherwise.
+*/
+bool mapCopyKey(Map map, MapKeyElement key, MapKeyElement* copy);
+
+/**
+* mapEntryKey: Makes the key of a new entry. That is a copy made by mapCopyKey,
+* except during mapPutTake, which hands the caller's key over to the map.
+* Engines call it as the last step of an insertion that can fail, so a key
+* handed over is never given back.
+*
+* @param map - The map the entry is added to.
+* @param key - The key being inserted, as stored in entries.
+* @param entry_key - Pointer to store the entry's key in.
+* @return
+* 	false if the copy failed, true otherwise.
+*/
+bool mapEntryKey(Map map, MapKeyElement key, MapKeyElement* entry_key);
+
+/**
+* mapFreeKey: Frees a key element made by mapCopyKey, using the free function
+* given at initialization. Keys of an int keyed map are not freed.
+*
+* @param map - The map the key belongs to.
+* @param key - The key to free.
+*/
+void mapFreeKey(Map map, MapKeyElement key);
+
+/**
+* mapCopyData: Makes the map's own copy of a data element, using the copy function
+* given at initialization or, for plain data, the pool. Inline data is copied into
+* the value stored in an entry's data field.
+*
+* @param map - The map the copy is made for.
+* @param data - The data to copy, as the user sees it (see mapEntryData).
+* @param copy - Pointer to store the copy in, it may be data's entry field.
+* @return
+* 	false if the copy failed, true otherwise.
+*/
+bool mapCopyData(Map map, MapDataElement data, MapDataElement* copy);
+
+/**
+* mapEntryData: Returns the data element of an entry as the user sees it: the
+* entry's data field itself for inline data, which then holds the data's bytes,
+* and the data that field points to otherwise.
+*
+* @param map - The map the entry belongs to.
+* @param entry - The entry.
+* @return
+* 	The data element.
+*/
+MapDataElement mapEntryData(Map map, MapEntry entry);
+
+/**
+* mapFreeData: Frees a data element made by mapCopyData.
+*
+* @param map - The map the data belongs to.
+* @param data - The data to free. NULL is ignored.
+*/
+void mapFreeData(Map map, MapDataElement data);
+
+/**
+* mapStructureChanged: Invalidates the internal iterator and the cursors of a map.
+* Called when a key was added or removed, and by engines that moved entries to
+* other nodes.
+*
+* @param map - The map that changed.
+*/
+void mapStructureChanged(Map map);
+
+/**
+* mapFreeEntry: Frees the key and data elements of an entry using the free
+* functions given at initialization. The entry itself is not released.
+* NULL elements are skipped, as are the keys of an int keyed map. Plain elements
+* are given back to the pool.
+*
+* @param map - The map the entry belongs to.
+* @param entry - The entry whose elements are freed.
+*/
+void mapFreeEntry(Map map, MapEntry entry);
+
+/**
+* mapLoadEntries: Fills an empty map with sorted pairs in linear time, taking over
+* their elements, and indexes them.
+*
+* @param map - The empty map to fill.
+* @param entries - The pairs, as stored in entries, sorted by strictly increasing key.
+* @param count - The number of pairs.
+* @return
+* 	MAP_OUT_OF_MEMORY if an allocation failed, the map is then still empty and the
+* 	elements are still the caller's.
+* 	MAP_SUCCESS otherwise.
+*/
+MapResult mapLoadEntries(Map map, MapEntry entries, int count);
+
+/**
+* mapAppendEntry: Adds a pair whose key is greater than every key of the map, taking
+* over its elements, through the engine's insert_hint.
+*
+* @param map - The map to add to, whose engine has an insert_hint.
+* @param entry - The pair, as stored in entries.
+* @return
+* 	MAP_OUT_OF_MEMORY if an allocation failed, the map is then unchanged and the
+* 	elements are still the caller's.
+* 	MAP_SUCCESS otherwise.
+*/
+MapResult mapAppendEntry(Map map, MapEntry entry);
+
+/**
+* mapPoolCreate: Creates an empty memory pool.
+*
+* @param allocator - Where the pool takes its memory from, copied into the pool.
+* @return
+* 	NULL if allocation failed, the new pool otherwise.
+*/
+struct map_pool_t* mapPoolCreate(const MapAllocator* allocator);
+
+/**
+* mapPoolDestroy: Frees a pool and all the memory it handed out, released or not.
+* A pool shared with mapPoolShare is only freed by the last of its maps.
+*
+* @param pool - The pool to free. NULL is ignored.
+*/
+void mapPoolDestroy(struct map_pool_t* pool);
+
+/**
+* mapPoolShare: Adds a map to the maps using a pool.
+*
+* @param pool - The pool.
+*/
+void mapPoolShare(struct map_pool_t* pool);
+
+/**
+* mapPoolIsShared: Checks whether more than one map uses a pool.
+*
+* @param pool - The pool.
+* @return
+* 	true if the pool was shared with mapPoolShare and not all but one of its maps
+* 	destroyed it yet, false otherwise.
+*/
+bool mapPoolIsShared(struct map_pool_t* pool);
+
+/**
+* mapPoolAllocate: Takes a block from a pool.
+*
+* @param pool - The pool to allocate from.
+* @param size - Size in bytes, not 0.
+* @return
+* 	NULL if allocation failed, a block aligned for any of the map's types otherwise.
+*/
+void* mapPoolAllocate(struct map_pool_t* pool, size_t size);
+
+/**
+* mapPoolReserve: Grows a pool so that count blocks of a size can be taken from it
+* without it growing again. Blocks of sizes served by the same size class count
+* together. Blocks above the largest class are never reserved, each of them is
+* allocated when it is taken.
+*
+* @param pool - The pool.
+* @param size - Size in bytes of the blocks, not 0.
+* @param count - The number of blocks.
+* @return
+* 	false if allocation failed, the pool is then unchanged. true otherwise.
+*/
+bool mapPoolReserve(struct map_pool_t* pool, size_t size, int count);
+
+/**
+* mapPoolDeallocate: Gives a block back to its pool.
+*
+* @param pool - The pool the block came from.
+* @param pointer - The block. NULL is ignored.
+* @param size - The size given to mapPoolAllocate.
+*/
+void mapPoolDeallocate(struct map_pool_t* pool, void* pointer, size_t size);
+
+/**
+* mapPoolGetStats: Reads the occupancy of a pool.
+*
+* @param pool - The pool.
+* @param stats - Pointer to the statistics to fill.
+*/
+void mapPoolGetStats(struct map_pool_t* pool, MapPoolStats* stats);
+
+/**
+* mapHashCreate: Creates the hash index of a map using its hash function.
+*
+* @param map - An empty map with a hash function.
+* @return
+* 	false if allocation failed, true otherwise.
+*/
+bool mapHashCreate(Map map);
+
+/**
+* mapHashDestroy: Gives the hash index of a map back to the pool. The map then has no index.
+*
+* @param map - The map whose index is destroyed.
+*/
+void mapHashDestroy(Map map);
+
+/**
+* mapHashClear: Empties the hash index of a map.
+*
+* @param map - The map whose index is emptied.
+*/
+void mapHashClear(Map map);
+
+/**
+* mapHashReserve: Grows the hash index so it can hold size keys without growing again.
+* Called before a key is added to the map, so that adding it to the index can't fail.
+*
+* @param map - The map whose index is grown.
+* @param size - The number of keys the index should be able to hold.
+* @return
+* 	false if allocation failed (the index is unchanged), true otherwise.
+*/
+bool mapHashReserve(Map map, int size);
+
+/**
+* mapHashFind: Looks a key up in the hash index.
+*
+* @param map - The map to search in.
+* @param key - The key to look for.
+* @return
+* 	The data paired with key, NULL if key is not in the map. For a map with inline
+* 	data the index only tells which keys are present, and the data it returns for them
+* 	is not theirs (see mapHashPut).
+*/
+MapDataElement mapHashFind(Map map, MapKeyElement key);
+
+/**
+* mapHashPut: Pairs a key of the map with its data in the hash index.
+* Room for a new key must have been reserved with mapHashReserve. A key already
+* in the index takes the given key pointer too, so it can follow a copied entry.
+* Inline data is not paired with its key, as the entries holding it move.
+*
+* @param map - The map whose index is updated.
+* @param key - The map's own copy of the key.
+* @param data - The map's own copy of the data.
+*/
+void mapHashPut(Map map, MapKeyElement key, MapDataElement data);
+
+/**
+* mapHashRemove: Removes a key from the hash index. Nothing is done if it is not there.
+*
+* @param map - The map whose index is updated.
+* @param key - The key to remove.
+*/
+void mapHashRemove(Map map, MapKeyElement key);
+
+#endif /* MAP_ENGINE_H_ */
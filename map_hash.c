@@ -0,0 +1,199 @@
+#include "map_engine.h"
+#include <assert.h>
+#include <string.h>
+
+/**
+* Hash index of a map (open addressing with linear probing).
+*
+* The index sits next to the engine and mirrors its (key,data) pairs, so that
+* mapGet and mapContains cost an expected O(1) instead of a walk over the engine.
+* It holds the map's own key and data pointers, it never copies or frees elements.
+* Deletion shifts the following slots back instead of leaving tombstones, so
+* lookups never probe past the first empty slot.
+*/
+
+/* Capacity of a new index, a power of 2 */
+#define HASH_INITIAL_CAPACITY 8
+/* The index grows once more than HASH_LOAD_NUMERATOR / HASH_LOAD_DENOMINATOR of it is used */
+#define HASH_LOAD_NUMERATOR 3
+#define HASH_LOAD_DENOMINATOR 4
+
+typedef struct hash_slot_t {
+    unsigned int hash;
+    MapKeyElement key;
+    MapDataElement data; // NULL for an empty slot, a map never holds NULL data
+}*HashSlot;
+
+struct map_hash_t {
+    HashSlot slots;
+    unsigned int capacity; // always a power of 2
+    unsigned int count;
+};
+
+/* declaring functions */
+static unsigned int hashMix(unsigned int hash);
+static unsigned int hashKey(Map map, MapKeyElement key);
+static HashSlot hashLookup(Map map, MapKeyElement key, unsigned int hash);
+static bool hashResize(Map map, unsigned int capacity);
+
+
+/**
+ * hashMix: scrambles a user supplied hash so that its low bits, which pick the
+ * slot, depend on all of its bits. Lets callers return the key itself as its hash.
+ *
+ * @param hash - the hash returned by the user's hash function.
+ * @return
+ * The mixed hash.
+ */
+static unsigned int hashMix(unsigned int hash) {
+    hash ^= hash >> 16;
+    hash *= 0x85ebca6bU;
+    hash ^= hash >> 13;
+    hash *= 0xc2b2ae35U;
+    hash ^= hash >> 16;
+    return hash;
+}
+
+/**
+ * hashKey: hashes a key stored in the map with the user's hash function.
+ * The function is given a pointer to the value of a key held by value, as for any other key.
+ *
+ * @param map - the map the key belongs to.
+ * @param key - the key, as stored in an entry.
+ * @return
+ * The mixed hash of key.
+ */
+static unsigned int hashKey(Map map, MapKeyElement key) {
+    MapKeyValue key_value;
+    return hashMix(map->hashKeyElements(mapKeyView(map, key, &key_value)));
+}
+
+/**
+ * hashLookup: finds the slot holding key, or the empty slot where it would be stored.
+ *
+ * @param map - the map the index belongs to.
+ * @param key - the key to look for.
+ * @param hash - the mixed hash of key.
+ * @return
+ * The slot holding key if it is in the index, otherwise the first empty slot of its probe sequence.
+ */
+static HashSlot hashLookup(Map map, MapKeyElement key, unsigned int hash) {
+    struct map_hash_t* index = map->hash;
+    unsigned int mask = index->capacity - 1;
+    for (unsigned int position = hash & mask; ; position = (position + 1) & mask) {
+        HashSlot slot = &index->slots[position];
+        if (!slot->data || (slot->hash == hash && mapCompareKeys(map, slot->key, key) == 0)) {
+            return slot;
+        }
+    }
+}
+
+/**
+ * hashResize: moves the index into a new table.
+ *
+ * @param map - the map the index belongs to.
+ * @param capacity - capacity of the new table, a power of 2 large enough for all the slots in use.
+ * @return
+ * false - if allocation failed, the index is left unchanged.
+ * true - otherwise.
+ */
+static bool hashResize(Map map, unsigned int capacity) {
+    struct map_hash_t* index = map->hash;
+    HashSlot slots = mapAllocate(map, capacity * sizeof(*slots));
+    if (!slots) {
+        return false;
+    }
+    memset(slots, 0, capacity * sizeof(*slots));
+
+    HashSlot old_slots = index->slots;
+    unsigned int old_capacity = index->capacity;
+    index->slots = slots;
+    index->capacity = capacity;
+    for (unsigned int position = 0; position < old_capacity; position++) {
+        if (old_slots[position].data) {
+            *hashLookup(map, old_slots[position].key, old_slots[position].hash) = old_slots[position];
+        }
+    }
+    mapDeallocate(map, old_slots, old_capacity * sizeof(*old_slots));
+    return true;
+}
+
+bool mapHashCreate(Map map) {
+    assert(map && map->hashKeyElements);
+    struct map_hash_t* index = mapAllocate(map, sizeof(*index));
+    if (!index) {
+        return false;
+    }
+    index->slots = mapAllocate(map, HASH_INITIAL_CAPACITY * sizeof(*index->slots));
+    if (!index->slots) {
+        mapDeallocate(map, index, sizeof(*index));
+        return false;
+    }
+    memset(index->slots, 0, HASH_INITIAL_CAPACITY * sizeof(*index->slots));
+    index->capacity = HASH_INITIAL_CAPACITY;
+    index->count = 0;
+    map->hash = index;
+    return true;
+}
+
+void mapHashDestroy(Map map) {
+    struct map_hash_t* index = map->hash;
+    mapDeallocate(map, index->slots, index->capacity * sizeof(*index->slots));
+    mapDeallocate(map, index, sizeof(*index));
+    map->hash = NULL;
+}
+
+void mapHashClear(Map map) {
+    struct map_hash_t* index = map->hash;
+    memset(index->slots, 0, index->capacity * sizeof(*index->slots));
+    index->count = 0;
+}
+
+bool mapHashReserve(Map map, int size) {
+    struct map_hash_t* index = map->hash;
+    unsigned int capacity = index->capacity;
+    while ((unsigned int)size * HASH_LOAD_DENOMINATOR > capacity * HASH_LOAD_NUMERATOR) {
+        capacity *= 2;
+    }
+    return capacity == index->capacity || hashResize(map, capacity);
+}
+
+MapDataElement mapHashFind(Map map, MapKeyElement key) {
+    return hashLookup(map, key, hashKey(map, key))->data;
+}
+
+void mapHashPut(Map map, MapKeyElement key, MapDataElement data) {
+    struct map_hash_t* index = map->hash;
+    unsigned int hash = hashKey(map, key);
+    HashSlot slot = hashLookup(map, key, hash);
+    if (!slot->data) {
+        //room was reserved by mapHashReserve before the key was added to the map
+        assert((index->count + 1) * HASH_LOAD_DENOMINATOR <= index->capacity * HASH_LOAD_NUMERATOR);
+        slot->hash = hash;
+        index->count++;
+    }
+    slot->key = key;
+    //inline data may be 0 and moves with its entry, the map itself marks its key present
+    slot->data = map->inline_data ? (MapDataElement)map : data;
+}
+
+void mapHashRemove(Map map, MapKeyElement key) {
+    struct map_hash_t* index = map->hash;
+    HashSlot slot = hashLookup(map, key, hashKey(map, key));
+    if (!slot->data) {
+        return;
+    }
+    unsigned int mask = index->capacity - 1;
+    unsigned int hole = (unsigned int)(slot - index->slots);
+    //shift back every following slot of the cluster that may not be probed past the hole
+    for (unsigned int position = (hole + 1) & mask; index->slots[position].data; position = (position + 1) & mask) {
+        unsigned int home = index->slots[position].hash & mask;
+        if (((position - home) & mask) >= ((position - hole) & mask)) {
+            index->slots[hole] = index->slots[position];
+            hole = position;
+        }
+    }
+    index->slots[hole].key = NULL;
+    index->slots[hole].data = NULL;
+    index->count--;
+}
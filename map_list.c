@@ -0,0 +1,313 @@
+#include "map_engine.h"
+#include <assert.h>
+
+/* Type for definning the list */
+typedef struct node {
+    struct map_entry_t entry;
+    struct node* next;
+}*Node;
+
+/* The list engine keeps a dummy (deme) first node so insertion never has to update the head */
+typedef struct map_list_t {
+    Node head;
+    Node finger; // the node of the last insertion, or the deme node, see listInsertHint
+}*MapList;
+
+/* declaring functions */
+static Node nodeAllocate(Map map);
+static void nodeDestroy(Map map, Node node);
+static Node listPrevious(Map map, MapKeyElement key);
+static inline Node listPreviousFromAs(Map map, MapKeyType key_type, Node start, MapKeyElement key);
+static Node listPreviousFrom(Map map, Node start, MapKeyElement key);
+static MapEntry listInsertAfter(Map map, Node current_node, MapKeyElement key, bool* created);
+
+static bool listCreate(Map map);
+static void listDestroy(Map map);
+static void listClear(Map map);
+static MapEntry listFind(Map map, MapKeyElement key);
+static MapEntry listInsert(Map map, MapKeyElement key, bool* created);
+static MapResult listRemove(Map map, MapKeyElement key, MapEntry removed);
+static MapEntry listFirst(Map map, MapIterator iterator);
+static MapEntry listNext(Map map, MapIterator iterator);
+static MapEntry listSeek(Map map, MapKeyElement key, MapIterator iterator);
+static bool listLoad(Map map, MapEntry entries, int count);
+static int listRemoveIf(Map map, bool (*unlink)(Map map, MapEntry entry, void* context), void* context);
+static MapEntry listInsertHint(Map map, MapKeyElement key, bool* created);
+static bool listReserve(Map map, int size);
+
+
+const MapEngineOps map_list_engine = {
+    listCreate,
+    listDestroy,
+    listClear,
+    listFind,
+    listInsert,
+    listRemove,
+    listFirst,
+    listNext,
+    listSeek,
+    listLoad,
+    NULL,
+    listRemoveIf,
+    listInsertHint,
+    listReserve
+};
+
+/**
+ * nodeAllocate: Allocates a new empty node.
+ *
+ * @param map - The map the node belongs to.
+ * @return
+ * NULL - If allocation failed.
+ * node_ptr - Pointer for the new node to be assigned to in case of succsses.
+ */
+static Node nodeAllocate(Map map) {
+    Node node_ptr = mapAllocate(map, sizeof(*node_ptr));
+    if (!node_ptr) {
+        return NULL;
+    }
+
+    node_ptr->entry.key = NULL;
+    node_ptr->entry.data = NULL;
+    node_ptr->next = NULL;
+    return node_ptr;
+}
+
+/**
+ * nodeDestroy: frees the elements held by a node and the node itself.
+ *
+ * @param map - The map the node belongs to.
+ * @param node - The node to destroy, NULL is ignored.
+ */
+static void nodeDestroy(Map map, Node node) {
+    if (!node) {
+        return;
+    }
+    mapFreeEntry(map, &node->entry);
+    mapDeallocate(map, node, sizeof(*node));
+}
+
+/**
+ * listPrevious: finds the last node whose key is smaller than key.
+ * The node matching key, if it exists, is the one following it.
+ *
+ * @param map - The map to search in.
+ * @param key - The key to look for.
+ * @return
+ * The node after which key is (or should be) linked, possibly the deme node.
+ */
+static Node listPrevious(Map map, MapKeyElement key) {
+    return listPreviousFrom(map, ((MapList)map->engine_data)->head, key);
+}
+
+/**
+ * listPreviousFromAs: listPreviousFrom for the keys of a given type, see mapCompareKeysAs.
+ */
+static inline Node listPreviousFromAs(Map map, MapKeyType key_type, Node start, MapKeyElement key) {
+    Node previous_node = start;
+    Node next_node = previous_node->next;
+    while (next_node && mapCompareKeysAs(map, key_type, next_node->entry.key, key) < 0) {
+        MAP_COUNT(map, nodesVisited, 1);
+        previous_node = next_node;
+        next_node = next_node->next;
+    }
+    return previous_node;
+}
+
+/**
+ * listPreviousFrom: finds the last node whose key is smaller than key, walking from start.
+ *
+ * @param map - The map to search in.
+ * @param start - The deme node, or a node whose key is smaller than key.
+ * @param key - The key to look for.
+ * @return
+ * The node after which key is (or should be) linked, possibly start itself.
+ */
+static Node listPreviousFrom(Map map, Node start, MapKeyElement key) {
+    MAP_KEY_TYPE_SWITCH(map, listPreviousFromAs, start, key)
+}
+
+static bool listCreate(Map map) {
+    MapList list = mapAllocate(map, sizeof(*list));
+    if (!list) {
+        return false;
+    }
+    list->head = nodeAllocate(map);//the deme node
+    if (!list->head) {
+        mapDeallocate(map, list, sizeof(*list));
+        return false;
+    }
+    list->finger = list->head;
+    map->engine_data = list;
+    return true;
+}
+
+static void listDestroy(Map map) {
+    MapList list = map->engine_data;
+    listClear(map);
+    mapDeallocate(map, list->head, sizeof(*list->head));//deme holds no elements
+    mapDeallocate(map, list, sizeof(*list));
+    map->engine_data = NULL;
+}
+
+static void listClear(Map map) {
+    MapList list = map->engine_data;
+    Node head = list->head;
+    list->finger = head;
+    Node current_node = head->next;
+    while (current_node) {
+        Node next_node = current_node->next;
+        nodeDestroy(map, current_node);
+        current_node = next_node;
+    }
+    head->next = NULL;
+}
+
+static MapEntry listFind(Map map, MapKeyElement key) {
+    Node next_node = listPrevious(map, key)->next;
+    if (next_node && mapCompareKeys(map, next_node->entry.key, key) == 0) {
+        return &next_node->entry;
+    }
+    return NULL;
+}
+
+static MapEntry listInsert(Map map, MapKeyElement key, bool* created) {
+    return listInsertAfter(map, listPrevious(map, key), key, created);
+}
+
+/**
+ * listInsertAfter: the insert operation, once the place of the key is known.
+ * The inserted or found node becomes the finger.
+ *
+ * @param map - The map to insert into.
+ * @param current_node - The node returned by listPrevious for key.
+ * @param key - The key to insert.
+ * @param created - Set to true if a node was linked in.
+ * @return
+ * NULL if allocation or the key copy failed, the entry of the key otherwise.
+ */
+static MapEntry listInsertAfter(Map map, Node current_node, MapKeyElement key, bool* created) {
+    MapList list = map->engine_data;
+    Node next_node = current_node->next;
+    *created = false;
+    if (next_node && mapCompareKeys(map, next_node->entry.key, key) == 0) {
+        list->finger = next_node;
+        return &next_node->entry;
+    }
+
+    Node new_node = nodeAllocate(map);
+    if (!new_node) {
+        return NULL;
+    }
+    if (!mapEntryKey(map, key, &new_node->entry.key)) {
+        mapDeallocate(map, new_node, sizeof(*new_node));
+        return NULL;
+    }
+    //insert between current_node and next_node
+    new_node->next = next_node;
+    current_node->next = new_node;
+    list->finger = new_node;
+    *created = true;
+    return &new_node->entry;
+}
+
+static MapEntry listInsertHint(Map map, MapKeyElement key, bool* created) {
+    MapList list = map->engine_data;
+    Node start = list->finger;
+    //a key not after the finger is searched for from the head
+    if (start != list->head && mapCompareKeys(map, start->entry.key, key) >= 0) {
+        start = list->head;
+    }
+    return listInsertAfter(map, listPreviousFrom(map, start, key), key, created);
+}
+
+static MapResult listRemove(Map map, MapKeyElement key, MapEntry removed) {
+    Node previous_node = listPrevious(map, key);
+    Node next_node = previous_node->next;
+    if (!next_node || mapCompareKeys(map, next_node->entry.key, key) != 0) {
+        return MAP_ITEM_DOES_NOT_EXIST;
+    }
+    previous_node->next = next_node->next;//link previous node to next node
+                                          //before removing current iterator node
+    MapList list = map->engine_data;
+    if (list->finger == next_node) {
+        list->finger = previous_node;
+    }
+    *removed = next_node->entry;
+    mapDeallocate(map, next_node, sizeof(*next_node));
+    return MAP_SUCCESS;
+}
+
+static MapEntry listFirst(Map map, MapIterator iterator) {
+    iterator->path[0] = ((MapList)map->engine_data)->head;//next since the first one is deme
+    iterator->depth = 1;
+    return listNext(map, iterator);
+}
+
+static MapEntry listNext(Map map, MapIterator iterator) {
+    (void)map;
+    assert(iterator->depth == 1);
+    Node current_node = iterator->path[0];
+    if (!current_node || !current_node->next) {
+        iterator->path[0] = NULL;
+        return NULL;
+    }
+    iterator->path[0] = current_node->next;
+    return &current_node->next->entry;
+}
+
+static MapEntry listSeek(Map map, MapKeyElement key, MapIterator iterator) {
+    iterator->path[0] = listPrevious(map, key);
+    iterator->depth = 1;
+    return listNext(map, iterator);
+}
+
+static bool listLoad(Map map, MapEntry entries, int count) {
+    Node head = ((MapList)map->engine_data)->head;
+    assert(!head->next);
+    Node last_node = head;
+    for (int i = 0; i < count; i++) {
+        Node new_node = nodeAllocate(map);
+        if (!new_node) {
+            //unlink what was linked so far, the elements stay with the caller
+            Node current_node = head->next;
+            while (current_node) {
+                Node next_node = current_node->next;
+                mapDeallocate(map, current_node, sizeof(*current_node));
+                current_node = next_node;
+            }
+            head->next = NULL;
+            return false;
+        }
+        new_node->entry = entries[i];
+        last_node->next = new_node;
+        last_node = new_node;
+    }
+    ((MapList)map->engine_data)->finger = last_node;
+    return true;
+}
+
+static int listRemoveIf(Map map, bool (*unlink)(Map map, MapEntry entry, void* context), void* context) {
+    //one pass keeping the node before the current one, so no removal searches from the head
+    int removed = 0;
+    MapList list = map->engine_data;
+    Node previous_node = list->head;
+    while (previous_node->next) {
+        Node current_node = previous_node->next;
+        if (!unlink(map, &current_node->entry, context)) {
+            previous_node = current_node;
+            continue;
+        }
+        if (list->finger == current_node) {
+            list->finger = previous_node;
+        }
+        previous_node->next = current_node->next;
+        mapDeallocate(map, current_node, sizeof(*current_node));
+        removed++;
+    }
+    return removed;
+}
+
+static bool listReserve(Map map, int size) {
+    return mapPoolReserve(map->pool, sizeof(struct node), size - map->size);
+}
@@ -0,0 +1,289 @@
+#include "map_engine.h"
+#include <assert.h>
+#include <stdlib.h>
+
+/**
+* Memory pool of a map.
+*
+* Small requests are rounded up to a size class and served from slabs, large
+* blocks carved out of one malloc call, through a free list per class. Released
+* blocks go back to their free list and are reused by the next request of the
+* same class, nothing is returned to malloc before the pool is destroyed, which
+* then frees every slab at once. Requests above the largest class get their own
+* malloc call, but are still tracked by the pool and freed with it. All of this
+* memory, the pool's own struct included, comes from the map's allocator, which
+* is malloc unless the map was made by mapCreateWithAllocator.
+*
+* A map and its snapshots share one pool, since their nodes are shared. The pool
+* counts its maps and is freed with the last one.
+*/
+
+/* Block sizes are multiples of POOL_ALIGNMENT, up to POOL_MAX_BLOCK */
+#define POOL_ALIGNMENT 16
+#define POOL_MAX_BLOCK 256
+#define POOL_CLASSES (POOL_MAX_BLOCK / POOL_ALIGNMENT)
+/* The first slab of a class holds POOL_FIRST_SLAB_BLOCKS blocks, each following slab
+ * twice as many, up to POOL_MAX_SLAB_BLOCKS, so small maps stay small */
+#define POOL_FIRST_SLAB_BLOCKS 8
+#define POOL_MAX_SLAB_BLOCKS 256
+
+/* Rounds a size up to a multiple of POOL_ALIGNMENT */
+#define POOL_ROUND(size) (((size) + POOL_ALIGNMENT - 1) / POOL_ALIGNMENT * POOL_ALIGNMENT)
+
+/* A free block, linked through its first bytes */
+typedef struct pool_block_t {
+    struct pool_block_t* next;
+}*PoolBlock;
+
+/* Header of a slab, followed by its blocks */
+typedef struct pool_slab_t {
+    struct pool_slab_t* next;
+    size_t size; // in bytes, header included
+}*PoolSlab;
+
+/* Header of a block larger than POOL_MAX_BLOCK, followed by the block */
+typedef struct pool_large_t {
+    struct pool_large_t* previous;
+    struct pool_large_t* next;
+    size_t size; // in bytes, header included
+}*PoolLarge;
+
+#define POOL_SLAB_HEADER POOL_ROUND(sizeof(struct pool_slab_t))
+#define POOL_LARGE_HEADER POOL_ROUND(sizeof(struct pool_large_t))
+
+typedef struct pool_class_t {
+    PoolBlock free_blocks;
+    int next_slab_blocks;
+    int used_blocks;
+    int free_count;
+}*PoolClass;
+
+struct map_pool_t {
+    struct pool_class_t classes[POOL_CLASSES];
+    PoolSlab slabs;
+    PoolLarge large;
+    int slab_count;
+    int large_count;
+    int maps; // the maps using the pool
+    MapAllocator allocator; // where the slabs, the large blocks and the pool itself come from
+    size_t reserved_bytes;
+    size_t used_bytes;
+};
+
+/* declaring functions */
+static PoolClass poolClass(struct map_pool_t* pool, size_t size);
+static bool poolAddSlab(struct map_pool_t* pool, PoolClass size_class, size_t block_size, int blocks);
+static void* poolAllocateLarge(struct map_pool_t* pool, size_t size);
+static void poolDeallocateLarge(struct map_pool_t* pool, void* pointer);
+
+
+/**
+ * poolClass: returns the size class serving a request.
+ *
+ * @param pool - the pool.
+ * @param size - size of the request in bytes, at most POOL_MAX_BLOCK.
+ * @return
+ * The class of the smallest block size that fits size.
+ */
+static PoolClass poolClass(struct map_pool_t* pool, size_t size) {
+    assert(size > 0 && size <= POOL_MAX_BLOCK);
+    return &pool->classes[(size - 1) / POOL_ALIGNMENT];
+}
+
+/**
+ * poolAddSlab: allocates a new slab for a class and puts all its blocks on the class's free list.
+ *
+ * @param pool - the pool.
+ * @param size_class - the class to grow.
+ * @param block_size - the block size of the class.
+ * @param blocks - the number of blocks of the slab.
+ * @return
+ * false - if allocation failed.
+ * true - otherwise.
+ */
+static bool poolAddSlab(struct map_pool_t* pool, PoolClass size_class, size_t block_size, int blocks) {
+    size_t size = POOL_SLAB_HEADER + blocks * block_size;
+    PoolSlab slab = pool->allocator.allocate(pool->allocator.context, size);
+    if (!slab) {
+        return false;
+    }
+    slab->size = size;
+    slab->next = pool->slabs;
+    pool->slabs = slab;
+    pool->slab_count++;
+    pool->reserved_bytes += size;
+
+    char* block = (char*)slab + POOL_SLAB_HEADER;
+    for (int i = 0; i < blocks; i++, block += block_size) {
+        PoolBlock free_block = (PoolBlock)block;
+        free_block->next = size_class->free_blocks;
+        size_class->free_blocks = free_block;
+    }
+    size_class->free_count += blocks;
+    return true;
+}
+
+/**
+ * poolAllocateLarge: allocates a block above the largest class and links it in the pool.
+ *
+ * @param pool - the pool.
+ * @param size - size of the block in bytes.
+ * @return
+ * NULL if allocation failed, the block otherwise.
+ */
+static void* poolAllocateLarge(struct map_pool_t* pool, size_t size) {
+    PoolLarge large = pool->allocator.allocate(pool->allocator.context, POOL_LARGE_HEADER + size);
+    if (!large) {
+        return NULL;
+    }
+    large->size = POOL_LARGE_HEADER + size;
+    large->previous = NULL;
+    large->next = pool->large;
+    if (pool->large) {
+        pool->large->previous = large;
+    }
+    pool->large = large;
+    pool->large_count++;
+    pool->reserved_bytes += large->size;
+    pool->used_bytes += size;
+    return (char*)large + POOL_LARGE_HEADER;
+}
+
+/**
+ * poolDeallocateLarge: unlinks a block from poolAllocateLarge and frees it.
+ *
+ * @param pool - the pool.
+ * @param pointer - the block.
+ */
+static void poolDeallocateLarge(struct map_pool_t* pool, void* pointer) {
+    PoolLarge large = (PoolLarge)((char*)pointer - POOL_LARGE_HEADER);
+    if (large->previous) {
+        large->previous->next = large->next;
+    }
+    else {
+        pool->large = large->next;
+    }
+    if (large->next) {
+        large->next->previous = large->previous;
+    }
+    pool->large_count--;
+    pool->reserved_bytes -= large->size;
+    pool->used_bytes -= large->size - POOL_LARGE_HEADER;
+    pool->allocator.deallocate(pool->allocator.context, large, large->size);
+}
+
+struct map_pool_t* mapPoolCreate(const MapAllocator* allocator) {
+    assert(allocator);
+    struct map_pool_t* pool = allocator->allocate(allocator->context, sizeof(*pool));
+    if (!pool) {
+        return NULL;
+    }
+    pool->allocator = *allocator;
+    for (int i = 0; i < POOL_CLASSES; i++) {
+        pool->classes[i].free_blocks = NULL;
+        pool->classes[i].next_slab_blocks = POOL_FIRST_SLAB_BLOCKS;
+        pool->classes[i].used_blocks = 0;
+        pool->classes[i].free_count = 0;
+    }
+    pool->slabs = NULL;
+    pool->large = NULL;
+    pool->slab_count = 0;
+    pool->large_count = 0;
+    pool->maps = 1;
+    pool->reserved_bytes = sizeof(*pool);
+    pool->used_bytes = 0;
+    return pool;
+}
+
+void mapPoolDestroy(struct map_pool_t* pool) {
+    if (!pool || --pool->maps > 0) {
+        return;
+    }
+    MapAllocator allocator = pool->allocator;
+    while (pool->slabs) {
+        PoolSlab next = pool->slabs->next;
+        allocator.deallocate(allocator.context, pool->slabs, pool->slabs->size);
+        pool->slabs = next;
+    }
+    while (pool->large) {
+        PoolLarge next = pool->large->next;
+        allocator.deallocate(allocator.context, pool->large, pool->large->size);
+        pool->large = next;
+    }
+    allocator.deallocate(allocator.context, pool, sizeof(*pool));
+}
+
+void mapPoolShare(struct map_pool_t* pool) {
+    assert(pool);
+    pool->maps++;
+}
+
+bool mapPoolIsShared(struct map_pool_t* pool) {
+    assert(pool);
+    return pool->maps > 1;
+}
+
+void* mapPoolAllocate(struct map_pool_t* pool, size_t size) {
+    assert(pool && size > 0);
+    if (size > POOL_MAX_BLOCK) {
+        return poolAllocateLarge(pool, size);
+    }
+    PoolClass size_class = poolClass(pool, size);
+    size_t block_size = POOL_ROUND(size);
+    if (!size_class->free_blocks) {
+        if (!poolAddSlab(pool, size_class, block_size, size_class->next_slab_blocks)) {
+            return NULL;
+        }
+        if (size_class->next_slab_blocks < POOL_MAX_SLAB_BLOCKS) {
+            size_class->next_slab_blocks *= 2;
+        }
+    }
+    PoolBlock block = size_class->free_blocks;
+    size_class->free_blocks = block->next;
+    size_class->free_count--;
+    size_class->used_blocks++;
+    pool->used_bytes += block_size;
+    return block;
+}
+
+bool mapPoolReserve(struct map_pool_t* pool, size_t size, int count) {
+    assert(pool && size > 0);
+    if (size > POOL_MAX_BLOCK) {
+        return true;
+    }
+    //one slab of just the missing blocks, the doubling of the class's slabs is left as it was
+    PoolClass size_class = poolClass(pool, size);
+    int missing = count - size_class->free_count;
+    return missing <= 0 || poolAddSlab(pool, size_class, POOL_ROUND(size), missing);
+}
+
+void mapPoolDeallocate(struct map_pool_t* pool, void* pointer, size_t size) {
+    assert(pool);
+    if (!pointer) {
+        return;
+    }
+    if (size > POOL_MAX_BLOCK) {
+        poolDeallocateLarge(pool, pointer);
+        return;
+    }
+    PoolClass size_class = poolClass(pool, size);
+    PoolBlock block = pointer;
+    block->next = size_class->free_blocks;
+    size_class->free_blocks = block;
+    size_class->free_count++;
+    size_class->used_blocks--;
+    pool->used_bytes -= POOL_ROUND(size);
+}
+
+void mapPoolGetStats(struct map_pool_t* pool, MapPoolStats* stats) {
+    assert(pool && stats);
+    stats->reservedBytes = pool->reserved_bytes;
+    stats->usedBytes = pool->used_bytes;
+    stats->usedBlocks = pool->large_count;
+    stats->freeBlocks = 0;
+    for (int i = 0; i < POOL_CLASSES; i++) {
+        stats->usedBlocks += pool->classes[i].used_blocks;
+        stats->freeBlocks += pool->classes[i].free_count;
+    }
+    stats->slabs = pool->slab_count;
+}
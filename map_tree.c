@@ -0,0 +1,613 @@
+#include "map_engine.h"
+#include <assert.h>
+
+/**
+* AVL tree engine.
+*
+* The tree can share its nodes with snapshots (see mapSnapshot). A node counts
+* the links to it, and a tree only changes a node linked once: any other node
+* on the way of a change is first copied with its elements (path copying), its
+* children then being linked from both copies. Removal also copies the nodes
+* a rebalancing rotation may change before unlinking anything, so running out
+* of memory never leaves a change half done.
+*/
+
+/* Type for defining a node of the AVL tree */
+typedef struct tree_node_t {
+    struct map_entry_t entry;
+    struct tree_node_t* left;
+    struct tree_node_t* right;
+    int height; // height of the subtree rooted at this node, a leaf is 1
+    int references; // links to the node from parents and roots, more than 1 once shared
+}*TreeNode;
+
+typedef struct map_tree_t {
+    TreeNode root;
+    bool shared; // the tree was shared with a snapshot, its nodes may be linked from other trees
+}*MapTree;
+
+/* declaring functions */
+static int nodeHeight(TreeNode node);
+static void nodeUpdateHeight(TreeNode node);
+static TreeNode rotateLeft(TreeNode node);
+static TreeNode rotateRight(TreeNode node);
+static TreeNode rebalance(TreeNode node);
+static bool treeOwn(Map map, TreeNode* link);
+static bool treeOwnRotated(Map map, TreeNode node, bool left_shrinks);
+static TreeNode treeInsertNode(Map map, TreeNode node, MapKeyElement key, MapEntry* entry, bool* created);
+static TreeNode treeRemoveNode(Map map, TreeNode node, MapKeyElement key, MapEntry removed, MapResult* result);
+static TreeNode treeRemoveMin(Map map, TreeNode node, TreeNode* min, bool* failed);
+static void treeDestroyNodes(Map map, TreeNode node);
+static void treeReleaseNodes(Map map, TreeNode node);
+static TreeNode treeBuild(Map map, MapEntry entries, int count, bool* failed);
+static void iteratorPushLeft(MapIterator iterator, TreeNode node);
+static inline MapEntry treeFindAs(Map map, MapKeyType key_type, MapKeyElement key);
+static inline MapEntry treeSeekAs(Map map, MapKeyType key_type, MapKeyElement key, MapIterator iterator);
+
+static bool treeCreate(Map map);
+static void treeDestroy(Map map);
+static void treeClear(Map map);
+static MapEntry treeFind(Map map, MapKeyElement key);
+static MapEntry treeInsert(Map map, MapKeyElement key, bool* created);
+static MapResult treeRemove(Map map, MapKeyElement key, MapEntry removed);
+static MapEntry treeFirst(Map map, MapIterator iterator);
+static MapEntry treeNext(Map map, MapIterator iterator);
+static MapEntry treeSeek(Map map, MapKeyElement key, MapIterator iterator);
+static bool treeLoad(Map map, MapEntry entries, int count);
+static bool treeShare(Map map, Map snapshot);
+static bool treeReserve(Map map, int size);
+
+
+const MapEngineOps map_tree_engine = {
+    treeCreate,
+    treeDestroy,
+    treeClear,
+    treeFind,
+    treeInsert,
+    treeRemove,
+    treeFirst,
+    treeNext,
+    treeSeek,
+    treeLoad,
+    treeShare,
+    NULL,
+    NULL,
+    treeReserve
+};
+
+/**
+ * nodeHeight: returns the height of a subtree.
+ *
+ * @param node - root of the subtree, NULL for an empty subtree.
+ * @return
+ * 0 for an empty subtree, the height of node otherwise.
+ */
+static int nodeHeight(TreeNode node) {
+    return node ? node->height : 0;
+}
+
+/**
+ * nodeUpdateHeight: recalculates the height of a node from its children.
+ *
+ * @param node - the node to update, must not be NULL.
+ */
+static void nodeUpdateHeight(TreeNode node) {
+    int left_height = nodeHeight(node->left);
+    int right_height = nodeHeight(node->right);
+    node->height = 1 + (left_height > right_height ? left_height : right_height);
+}
+
+/**
+ * rotateLeft: rotates a subtree left, its right child becomes the root.
+ *
+ * @param node - root of the subtree, must have a right child.
+ * @return
+ * The new root of the subtree.
+ */
+static TreeNode rotateLeft(TreeNode node) {
+    TreeNode new_root = node->right;
+    node->right = new_root->left;
+    new_root->left = node;
+    nodeUpdateHeight(node);
+    nodeUpdateHeight(new_root);
+    return new_root;
+}
+
+/**
+ * rotateRight: rotates a subtree right, its left child becomes the root.
+ *
+ * @param node - root of the subtree, must have a left child.
+ * @return
+ * The new root of the subtree.
+ */
+static TreeNode rotateRight(TreeNode node) {
+    TreeNode new_root = node->left;
+    node->left = new_root->right;
+    new_root->right = node;
+    nodeUpdateHeight(node);
+    nodeUpdateHeight(new_root);
+    return new_root;
+}
+
+/**
+ * rebalance: restores the AVL property of a subtree whose children are balanced
+ * and differ in height by at most 2.
+ *
+ * @param node - root of the subtree.
+ * @return
+ * The new root of the subtree.
+ */
+static TreeNode rebalance(TreeNode node) {
+    nodeUpdateHeight(node);
+    int balance = nodeHeight(node->left) - nodeHeight(node->right);
+    if (balance > 1) {
+        if (nodeHeight(node->left->left) < nodeHeight(node->left->right)) {
+            node->left = rotateLeft(node->left);
+        }
+        return rotateRight(node);
+    }
+    if (balance < -1) {
+        if (nodeHeight(node->right->right) < nodeHeight(node->right->left)) {
+            node->right = rotateRight(node->right);
+        }
+        return rotateLeft(node);
+    }
+    return node;
+}
+
+/**
+ * treeOwn: makes sure a node is linked only once, so it can be changed without
+ * changing it in another tree. A shared node is replaced by a copy of it.
+ *
+ * @param map - the map the tree belongs to.
+ * @param link - pointer to the link to the node, which is not NULL and either a root
+ *      or in a node linked only once. Set to the copy if one was made.
+ * @return
+ * false - if allocation or an element copy failed, the node is then left as it is.
+ * true - otherwise.
+ */
+static bool treeOwn(Map map, TreeNode* link) {
+    TreeNode node = *link;
+    if (node->references == 1) {
+        return true;
+    }
+    TreeNode copy = mapAllocate(map, sizeof(*copy));
+    if (!copy) {
+        return false;
+    }
+    if (!mapCopyData(map, mapEntryData(map, &node->entry), &copy->entry.data)) {
+        mapDeallocate(map, copy, sizeof(*copy));
+        return false;
+    }
+    if (!mapCopyKey(map, node->entry.key, &copy->entry.key)) {
+        mapFreeData(map, copy->entry.data);
+        mapDeallocate(map, copy, sizeof(*copy));
+        return false;
+    }
+    //the children are now linked from both the node and its copy
+    copy->left = node->left;
+    copy->right = node->right;
+    if (copy->left) {
+        copy->left->references++;
+    }
+    if (copy->right) {
+        copy->right->references++;
+    }
+    copy->height = node->height;
+    copy->references = 1;
+    node->references--;
+    if (map->hash) {
+        mapHashPut(map, copy->entry.key, copy->entry.data);
+    }
+    *link = copy;
+    //iterations over the map may hold the node, which the map no longer holds
+    mapStructureChanged(map);
+    return true;
+}
+
+/**
+ * treeOwnRotated: makes sure the nodes a rebalancing rotation at node may change are
+ * linked only once, before one of node's subtrees loses a node. The rotation can only
+ * happen if the other subtree is the taller, and only changes its root, and for a
+ * double rotation the root's child on the side of the shrinking subtree.
+ *
+ * @param map - the map the tree belongs to.
+ * @param node - a node linked only once.
+ * @param left_shrinks - true if the left subtree of node is about to lose a node,
+ *      false if the right one is.
+ * @return
+ * false - if copying a node failed.
+ * true - otherwise.
+ */
+static bool treeOwnRotated(Map map, TreeNode node, bool left_shrinks) {
+    TreeNode* sibling_link = left_shrinks ? &node->right : &node->left;
+    if (nodeHeight(*sibling_link) <= nodeHeight(left_shrinks ? node->left : node->right)) {
+        return true;
+    }
+    if (!treeOwn(map, sibling_link)) {
+        return false;
+    }
+    TreeNode sibling = *sibling_link;
+    TreeNode* inner_link = left_shrinks ? &sibling->left : &sibling->right;
+    TreeNode outer = left_shrinks ? sibling->right : sibling->left;
+    if (nodeHeight(*inner_link) > nodeHeight(outer)) {
+        return treeOwn(map, inner_link);
+    }
+    return true;
+}
+
+/**
+ * treeInsertNode: finds key in a subtree, linking a new node for it if it is missing.
+ *
+ * @param map - the map the tree belongs to.
+ * @param node - root of the subtree.
+ * @param key - the key to look for.
+ * @param entry - pointer to store the entry matching key in, NULL if allocation or the key copy failed.
+ * @param created - set to true if a new node was linked.
+ * @return
+ * The new root of the subtree.
+ */
+static TreeNode treeInsertNode(Map map, TreeNode node, MapKeyElement key, MapEntry* entry, bool* created) {
+    if (!node) {
+        TreeNode new_node = mapAllocate(map, sizeof(*new_node));
+        if (!new_node) {
+            *entry = NULL;
+            return NULL;
+        }
+        if (!mapEntryKey(map, key, &new_node->entry.key)) {
+            mapDeallocate(map, new_node, sizeof(*new_node));
+            *entry = NULL;
+            return NULL;
+        }
+        new_node->entry.data = NULL;
+        new_node->left = NULL;
+        new_node->right = NULL;
+        new_node->height = 1;
+        new_node->references = 1;
+        *entry = &new_node->entry;
+        *created = true;
+        return new_node;
+    }
+
+    //the node changes if a node is linked below it, and its data changes if it matches key
+    if (!treeOwn(map, &node)) {
+        *entry = NULL;
+        return node;
+    }
+    MAP_COUNT(map, nodesVisited, 1);
+    int compare_keys = mapCompareKeys(map, node->entry.key, key);
+    if (compare_keys == 0) {
+        *entry = &node->entry;
+        return node;
+    }
+    if (compare_keys > 0) {
+        node->left = treeInsertNode(map, node->left, key, entry, created);
+    }
+    else {
+        node->right = treeInsertNode(map, node->right, key, entry, created);
+    }
+    //nothing changed below unless a node was linked
+    return *created ? rebalance(node) : node;
+}
+
+/**
+ * treeRemoveMin: unlinks the smallest node of a subtree without freeing it.
+ *
+ * @param map - the map the tree belongs to.
+ * @param node - root of the subtree, must not be NULL.
+ * @param min - pointer to store the unlinked node in.
+ * @param failed - set to true if copying a shared node failed, nothing is unlinked then.
+ * @return
+ * The new root of the subtree.
+ */
+static TreeNode treeRemoveMin(Map map, TreeNode node, TreeNode* min, bool* failed) {
+    if (!treeOwn(map, &node)) {
+        *failed = true;
+        return node;
+    }
+    if (!node->left) {
+        *min = node;
+        return node->right;
+    }
+    if (!treeOwnRotated(map, node, true)) {
+        *failed = true;
+        return node;
+    }
+    node->left = treeRemoveMin(map, node->left, min, failed);
+    return *failed ? node : rebalance(node);
+}
+
+/**
+ * treeRemoveNode: unlinks and releases the node matching key in a subtree.
+ *
+ * @param map - the map the tree belongs to.
+ * @param node - root of the subtree.
+ * @param key - the key to remove.
+ * @param removed - pointer to store the entry of the removed node in.
+ * @param result - set to MAP_SUCCESS if a node was removed, MAP_OUT_OF_MEMORY if copying
+ *      a shared node failed. Left as it is if there is no node matching key.
+ * @return
+ * The new root of the subtree.
+ */
+static TreeNode treeRemoveNode(Map map, TreeNode node, MapKeyElement key, MapEntry removed, MapResult* result) {
+    if (!node) {
+        return NULL;
+    }
+    if (!treeOwn(map, &node)) {
+        *result = MAP_OUT_OF_MEMORY;
+        return node;
+    }
+    MAP_COUNT(map, nodesVisited, 1);
+    int compare_keys = mapCompareKeys(map, node->entry.key, key);
+    if (compare_keys != 0) {
+        if (!treeOwnRotated(map, node, compare_keys > 0)) {
+            *result = MAP_OUT_OF_MEMORY;
+            return node;
+        }
+        if (compare_keys > 0) {
+            node->left = treeRemoveNode(map, node->left, key, removed, result);
+        }
+        else {
+            node->right = treeRemoveNode(map, node->right, key, removed, result);
+        }
+        return *result == MAP_SUCCESS ? rebalance(node) : node;
+    }
+
+    TreeNode replacement = NULL;
+    if (!node->left) {
+        replacement = node->right;
+    }
+    else if (!node->right) {
+        replacement = node->left;
+    }
+    else {
+        //the successor takes the place of the removed node, with the same children
+        bool failed = !treeOwnRotated(map, node, false);
+        TreeNode right = failed ? node->right : treeRemoveMin(map, node->right, &replacement, &failed);
+        if (failed) {
+            node->right = right;
+            *result = MAP_OUT_OF_MEMORY;
+            return node;
+        }
+        replacement->left = node->left;
+        replacement->right = right;
+        replacement = rebalance(replacement);
+    }
+    *removed = node->entry;
+    mapDeallocate(map, node, sizeof(*node));
+    *result = MAP_SUCCESS;
+    return replacement;
+}
+
+/**
+ * treeDestroyNodes: frees all the nodes of a subtree and their elements.
+ *
+ * @param map - the map the tree belongs to.
+ * @param node - root of the subtree, NULL is ignored.
+ */
+static void treeDestroyNodes(Map map, TreeNode node) {
+    //a node still linked from another tree keeps its subtree
+    while (node && --node->references == 0) {
+        //recurse on the smaller side only so the stack depth stays logarithmic
+        treeDestroyNodes(map, node->left);
+        TreeNode right = node->right;
+        mapFreeEntry(map, &node->entry);
+        mapDeallocate(map, node, sizeof(*node));
+        node = right;
+    }
+}
+
+/**
+ * treeReleaseNodes: releases all the nodes of a subtree without touching their elements.
+ *
+ * @param map - the map the tree belongs to.
+ * @param node - root of the subtree, NULL is ignored.
+ */
+static void treeReleaseNodes(Map map, TreeNode node) {
+    while (node) {
+        treeReleaseNodes(map, node->left);
+        TreeNode right = node->right;
+        mapDeallocate(map, node, sizeof(*node));
+        node = right;
+    }
+}
+
+/**
+ * treeBuild: builds a balanced subtree from sorted entries, the middle entry at its root.
+ * The sizes of sibling subtrees differ by at most one, so the result is an AVL tree.
+ *
+ * @param map - the map the tree belongs to.
+ * @param entries - the entries, sorted by strictly increasing key.
+ * @param count - the number of entries.
+ * @param failed - set to true if allocation failed, nothing is built then.
+ * @return
+ * The root of the subtree, NULL if count is 0 or allocation failed.
+ */
+static TreeNode treeBuild(Map map, MapEntry entries, int count, bool* failed) {
+    if (count == 0) {
+        return NULL;
+    }
+    int middle = count / 2;
+    TreeNode left = treeBuild(map, entries, middle, failed);
+    if (*failed) {
+        return NULL;
+    }
+    TreeNode node = mapAllocate(map, sizeof(*node));
+    if (!node) {
+        treeReleaseNodes(map, left);
+        *failed = true;
+        return NULL;
+    }
+    TreeNode right = treeBuild(map, entries + middle + 1, count - middle - 1, failed);
+    if (*failed) {
+        treeReleaseNodes(map, left);
+        mapDeallocate(map, node, sizeof(*node));
+        return NULL;
+    }
+    node->entry = entries[middle];
+    node->left = left;
+    node->right = right;
+    node->references = 1;
+    nodeUpdateHeight(node);
+    return node;
+}
+
+/**
+ * iteratorPushLeft: pushes a node and its chain of left children on the iterator path.
+ *
+ * @param iterator - the iterator to push on.
+ * @param node - the node to start from, NULL is ignored.
+ */
+static void iteratorPushLeft(MapIterator iterator, TreeNode node) {
+    while (node) {
+        assert(iterator->depth < MAP_MAX_DEPTH);
+        iterator->path[iterator->depth++] = node;
+        node = node->left;
+    }
+}
+
+/**
+ * treeFindAs: finds the entry matching key, for the keys of a given type, see mapCompareKeysAs.
+ *
+ * @param map - the map to search in.
+ * @param key_type - the key type of map.
+ * @param key - the key to look for.
+ * @return
+ * The entry, NULL if key is not in the map.
+ */
+static inline MapEntry treeFindAs(Map map, MapKeyType key_type, MapKeyElement key) {
+    TreeNode node = ((MapTree)map->engine_data)->root;
+    while (node) {
+        MAP_COUNT(map, nodesVisited, 1);
+        int compare_keys = mapCompareKeysAs(map, key_type, node->entry.key, key);
+        if (compare_keys == 0) {
+            return &node->entry;
+        }
+        node = compare_keys > 0 ? node->left : node->right;
+    }
+    return NULL;
+}
+
+/**
+ * treeSeekAs: positions an iterator on the first entry whose key is not smaller than key,
+ * for the keys of a given type, see mapCompareKeysAs.
+ *
+ * @param map - the map to search in.
+ * @param key_type - the key type of map.
+ * @param key - the key to look for.
+ * @param iterator - the iterator to position.
+ * @return
+ * That entry, NULL if all the keys are smaller.
+ */
+static inline MapEntry treeSeekAs(Map map, MapKeyType key_type, MapKeyElement key, MapIterator iterator) {
+    //keep the nodes not smaller than key on the way down, as treeFirst keeps the left chain
+    iterator->depth = 0;
+    TreeNode node = ((MapTree)map->engine_data)->root;
+    while (node) {
+        MAP_COUNT(map, nodesVisited, 1);
+        int compare_keys = mapCompareKeysAs(map, key_type, node->entry.key, key);
+        if (compare_keys < 0) {
+            node = node->right;
+            continue;
+        }
+        assert(iterator->depth < MAP_MAX_DEPTH);
+        iterator->path[iterator->depth++] = node;
+        node = compare_keys > 0 ? node->left : NULL;
+    }
+    return treeNext(map, iterator);
+}
+
+static bool treeCreate(Map map) {
+    MapTree tree = mapAllocate(map, sizeof(*tree));
+    if (!tree) {
+        return false;
+    }
+    tree->root = NULL;
+    tree->shared = false;
+    map->engine_data = tree;
+    return true;
+}
+
+static void treeDestroy(Map map) {
+    treeClear(map);
+    mapDeallocate(map, map->engine_data, sizeof(struct map_tree_t));
+    map->engine_data = NULL;
+}
+
+static void treeClear(Map map) {
+    MapTree tree = map->engine_data;
+    treeDestroyNodes(map, tree->root);
+    tree->root = NULL;
+}
+
+static MapEntry treeFind(Map map, MapKeyElement key) {
+    MAP_KEY_TYPE_SWITCH(map, treeFindAs, key)
+}
+
+static MapEntry treeInsert(Map map, MapKeyElement key, bool* created) {
+    MapTree tree = map->engine_data;
+    MapEntry entry = NULL;
+    *created = false;
+    tree->root = treeInsertNode(map, tree->root, key, &entry, created);
+    return entry;
+}
+
+static MapResult treeRemove(Map map, MapKeyElement key, MapEntry removed) {
+    MapTree tree = map->engine_data;
+    //don't copy shared nodes on the way to a key that isn't there
+    if (tree->shared && !treeFind(map, key)) {
+        return MAP_ITEM_DOES_NOT_EXIST;
+    }
+    MapResult result = MAP_ITEM_DOES_NOT_EXIST;
+    tree->root = treeRemoveNode(map, tree->root, key, removed, &result);
+    return result;
+}
+
+static MapEntry treeFirst(Map map, MapIterator iterator) {
+    iterator->depth = 0;
+    iteratorPushLeft(iterator, ((MapTree)map->engine_data)->root);
+    return treeNext(map, iterator);
+}
+
+static MapEntry treeNext(Map map, MapIterator iterator) {
+    (void)map;
+    if (iterator->depth == 0) {
+        return NULL;
+    }
+    //the top of the path is the smallest node not visited yet
+    TreeNode node = iterator->path[--iterator->depth];
+    iteratorPushLeft(iterator, node->right);
+    return &node->entry;
+}
+
+static MapEntry treeSeek(Map map, MapKeyElement key, MapIterator iterator) {
+    MAP_KEY_TYPE_SWITCH(map, treeSeekAs, key, iterator)
+}
+
+static bool treeLoad(Map map, MapEntry entries, int count) {
+    MapTree tree = map->engine_data;
+    assert(!tree->root);
+    bool failed = false;
+    tree->root = treeBuild(map, entries, count, &failed);
+    return !failed;
+}
+
+static bool treeShare(Map map, Map snapshot) {
+    if (!treeCreate(snapshot)) {
+        return false;
+    }
+    MapTree tree = map->engine_data;
+    MapTree snapshot_tree = snapshot->engine_data;
+    snapshot_tree->root = tree->root;
+    if (tree->root) {
+        tree->root->references++;
+    }
+    tree->shared = true;
+    snapshot_tree->shared = true;
+    return true;
+}
+
+static bool treeReserve(Map map, int size) {
+    //nodes copied away from a snapshot are not counted, they come on top of these
+    return mapPoolReserve(map->pool, sizeof(struct tree_node_t), size - map->size);
+}
@@ -0,0 +1,53 @@
+#ifndef MAP_TYPES_H_
+#define MAP_TYPES_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+* Types of the map container that users of modules built on maps see too, such as
+* the chess system's options and counters, without taking in the map's interface.
+* map.h includes this header.
+*/
+
+/**
+* Memory allocator a map takes all its memory from, see mapCreateWithAllocator:
+* its pool's slabs, its own struct, its cursors and its temporary arrays.
+* Elements copied by the user's copy functions are not affected.
+*/
+typedef struct MapAllocator_t {
+    /** Returns a block of size bytes aligned for any type, NULL if allocation failed */
+    void* (*allocate)(void* context, size_t size);
+    /** Releases a block of allocate, size is the size given to it */
+    void (*deallocate)(void* context, void* pointer, size_t size);
+    /** Passed as is to allocate and deallocate */
+    void* context;
+} MapAllocator;
+
+/**
+* Operation and cost counters of a map, see mapGetStats.
+* The counters are only kept in builds made with -DMAP_STATS, so that other builds
+* pay nothing for them. Lookups count too, so such builds read a map from one thread.
+*/
+typedef struct MapStats_t {
+    /** true if the map was built with MAP_STATS, the counters are 0 otherwise */
+    bool enabled;
+    /** Calls to mapContains, mapGet and mapGetOrInsert */
+    unsigned long lookups;
+    /** Keys added to the map */
+    unsigned long inserts;
+    /** Keys removed from the map, mapClear not included */
+    unsigned long removes;
+    /** Key comparisons, by the compare function or by value for MAP_KEY_INT and MAP_KEY_UINT64 */
+    unsigned long comparisons;
+    /** Nodes the engine stepped through while searching */
+    unsigned long nodesVisited;
+    /** Calls to the copy functions of keys and of data */
+    unsigned long keyCopies;
+    unsigned long dataCopies;
+    /** Blocks taken from the map's pool and their total size */
+    unsigned long allocations;
+    unsigned long bytesAllocated;
+} MapStats;
+
+#endif /* MAP_TYPES_H_ */
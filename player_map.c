@@ -10,7 +10,7 @@ struct player_data{
     int num_of_wins; // used to calculate Level
     int num_of_loses; // used to calculate Level
     int num_of_draws; // used to calculate Level
-    int total_play_time; // used to calculate average playtime
+    long long total_play_time; // used to calculate average playtime, wide enough for INT_MAX long games
 };
 
 /********************* static functions *********************/
@@ -20,13 +20,21 @@ static MapDataElement copyPlayerData(MapDataElement data);
 static void freePlayerKey(MapKeyElement player_key);
 static void freePlayerData(MapDataElement data);
 static int comparePlayerKey(MapKeyElement player1_key, MapKeyElement player2_key);
+static unsigned int hashPlayerKey(MapKeyElement player_key);
 
 
 static PlayerKey createPlayerKey(PlayerId id);
 static PlayerData createPlayerData();
+static PlayerData playerGetMutableData(Map player_map, PlayerId player_id, PlayerResult* result);
 
 static bool playerKeyIsValid(PlayerKey player_key);
-static bool playerHasGames(Map player_map, PlayerId player_id, bool remove_if_no_games);
+static double playerDataGetLevel(PlayerData player_data);
+static bool playerDataIsValid(PlayerData player_data);
+static void playerDataUpdateDuel(PlayerData first_player_data, PlayerData second_player_data, int play_time,
+                                 Winner winner, UpdateMode value);
+static bool playerHasNoGames(MapKeyElement player_key, MapDataElement player_data, void* context);
+static void mergePlayerData(MapKeyElement player_key, MapDataElement main_data, MapDataElement update_data,
+                            void* value);
 
 
 /********************************************************************/
@@ -107,6 +115,17 @@ static void freePlayerData(MapDataElement data){
 static int comparePlayerKey(MapKeyElement player1_key, MapKeyElement player2_key){
     return (*(PlayerKey)player1_key - *(PlayerKey)player2_key);
 }
+/**
+    * hashPlayerKey: hashes a key for the map's hash index.
+    *
+    *@param player_key - the key to hash.
+    *
+    * @return-
+    * 		the player id itself, the map mixes it.
+*/
+static unsigned int hashPlayerKey(MapKeyElement player_key){
+    return (unsigned int)*(PlayerKey)player_key;
+}
 /**
 * createPlayerData: Allocates a new empty Player data.
 *
@@ -164,32 +183,124 @@ static bool playerKeyIsValid(PlayerKey player_key){
     return true;
 }
 /**
- * playerHasGames: returns true if a player participates in at least one game
- *
- * @param player_map - pointer to the player map
- * @param player_id  - the player id
- * @param remove_if_no_games - bool value, if true the player will be deleted if the player exist and has no games
- * @return
- *      true - if a player participates in at least one game
- *      false - in one of the following cases: the player map is NULL, the player id is invalid
- *              or data retrieval failed
- */
-static bool playerHasGames(Map player_map, PlayerId player_id, bool remove_if_no_games){
-    if (!player_map){
-        return  false;
+* playerDataGetLevel: calculates the level of a player.
+*
+* @param player_data - the player's data, must not be NULL.
+*
+* @return
+* 	0 - if the player has no games.
+* 	The player's level otherwise.
+*/
+static double playerDataGetLevel(PlayerData player_data){
+    if (player_data->num_of_games == 0){
+        return 0;
     }
-    if (!playerIdIsValid(player_id)){
+    //computed in double, the weighted counts of a player with many games don't fit in an int
+    return (6.0*player_data->num_of_wins - 10.0*player_data->num_of_loses + 2.0*player_data->num_of_draws)/
+           (player_data->num_of_games);
+}
+/**
+* playerDataIsValid: checks the counters of a player read from a save.
+*
+* @param player_data - the player's data, must not be NULL.
+*
+* @return
+* 	false - if a counter is negative, the games are not the wins, losses and draws together,
+* 	        or a player without games has a play time.
+* 	true - otherwise.
+*/
+static bool playerDataIsValid(PlayerData player_data){
+    if (player_data->num_of_wins < 0 || player_data->num_of_loses < 0 || player_data->num_of_draws < 0 ||
+        player_data->total_play_time < 0){
         return false;
     }
-    PlayerData player_data = playerGetData(player_map, player_id);
+    long long results = (long long)player_data->num_of_wins + player_data->num_of_loses + player_data->num_of_draws;
+    return player_data->num_of_games == results && (player_data->num_of_games > 0 || player_data->total_play_time == 0);
+}
+/**
+* playerDataUpdateDuel: updates the results of the two players of a game.
+*
+* @param first_player_data - the first player's data, must not be NULL.
+* @param second_player_data - the second player's data, must not be NULL.
+* @param play_time - time of the game
+* @param winner - the winner of the game
+* @param value - 1 to add the game, -1 to take it out
+*/
+static void playerDataUpdateDuel(PlayerData first_player_data, PlayerData second_player_data, int play_time,
+                                 Winner winner, UpdateMode value){
+    first_player_data->num_of_games += value;
+    first_player_data->total_play_time += (long long)play_time * value;
+    second_player_data->num_of_games += value;
+    second_player_data->total_play_time += (long long)play_time * value;
+    if (winner == FIRST_PLAYER){
+        first_player_data->num_of_wins += value;
+        second_player_data->num_of_loses += value;
+    }
+    else if (winner == SECOND_PLAYER){
+        first_player_data->num_of_loses += value;
+        second_player_data->num_of_wins += value;
+    }
+    else{
+        first_player_data->num_of_draws += value;
+        second_player_data->num_of_draws += value;
+    }
+}
+/**
+* playerGetMutableData: returns the data of a player for changing it in place. A player the
+* map shares with a snapshot is copied first (see mapGetMutable).
+*
+* @param player_map - the player_map to look into.
+* @param player_id - the player_id associated with a player.
+* @param result - set to PLAYER_NOT_EXIST if the player does not exist, to PLAYER_OUT_OF_MEMORY
+*      if copying him failed, and left as it is otherwise.
+* @return
+* 	NULL - if the player does not exist or copying him failed.
+* 	PlayerData - otherwise.
+*/
+static PlayerData playerGetMutableData(Map player_map, PlayerId player_id, PlayerResult* result){
+    PlayerData player_data = mapGetMutable(player_map, &player_id);
     if (!player_data){
-        false;
+        *result = mapContains(player_map, &player_id) ? PLAYER_OUT_OF_MEMORY : PLAYER_NOT_EXIST;
     }
-    if (remove_if_no_games && player_data->num_of_games == 0){
-        playerRemove(player_map, player_id);
-        false;
+    return player_data;
+}
+/**
+* playerHasNoGames: the mapRemoveIf predicate of playerRemoveWithoutGames.
+*
+* @param player_key - the player's key.
+* @param player_data - the player's data.
+* @param context - unused.
+* @return
+* 	true - if the player has no games.
+* 	false - otherwise.
+*/
+static bool playerHasNoGames(MapKeyElement player_key, MapDataElement player_data, void* context){
+    (void)player_key;
+    (void)context;
+    return ((PlayerData)player_data)->num_of_games == 0;
+}
+/**
+* mergePlayerData: adds or undoes the statistics of a player in an update map to the same
+* player in a main map, called by mapMergeWith. Players missing from either map are skipped.
+*
+* @param player_key - the player's key.
+* @param main_data - the player's data in the main map, NULL if he isn't there.
+* @param update_data - the player's data in the update map, NULL if he isn't there.
+* @param value - pointer to the UpdateMode to apply.
+*/
+static void mergePlayerData(MapKeyElement player_key, MapDataElement main_data, MapDataElement update_data,
+                            void* value){
+    (void)player_key;
+    if (!main_data || !update_data){
+        return;
     }
-    return true;
+    PlayerData player_data1 = main_data, player_data2 = update_data;
+    UpdateMode mode = *(UpdateMode*)value;
+    player_data1->num_of_games += mode * player_data2->num_of_games;
+    player_data1->total_play_time += mode * player_data2->total_play_time;
+    player_data1->num_of_wins += mode * player_data2->num_of_wins;
+    player_data1->num_of_loses += mode * player_data2->num_of_loses;
+    player_data1->num_of_draws += mode * player_data2->num_of_draws;
 }
 
 
@@ -211,8 +322,21 @@ bool playerExists(Map player_map, PlayerId player_id){
 }
 
 Map playerCreateMap(){
-    return mapCreate(copyPlayerData, copyPlayerKey, freePlayerData,
-                     freePlayerKey, comparePlayerKey);
+    return playerCreateMapWithAllocator(NULL);
+}
+
+Map playerCreateMapWithAllocator(const MapAllocator* allocator){
+    return playerCreateMapWithCapacity(allocator, 0);
+}
+
+Map playerCreateMapWithCapacity(const MapAllocator* allocator, int capacity){
+    MapOptions options = {0};
+    options.capacity = capacity;
+    options.hashKeyElement = hashPlayerKey;
+    options.keyType = MAP_KEY_INT;
+    options.dataSize = sizeof(struct player_data);//plain numbers, copied into the map's pool and saved as they are
+    return mapCreateWithAllocator(copyPlayerData, copyPlayerKey, freePlayerData,
+                                  freePlayerKey, comparePlayerKey, &options, allocator);
 }
 
 void playerDestroyMap(Map player_map){
@@ -229,6 +353,20 @@ Map playerMapCopy(Map player_map){
     return mapCopy(player_map);
 }
 
+Map playerMapCopyWithAllocator(Map player_map, const MapAllocator* allocator){
+    if (!player_map){
+        return NULL;
+    }
+    return mapCopyWithAllocator(player_map, allocator);
+}
+
+Map playerMapSnapshot(Map player_map){
+    if (!player_map){
+        return NULL;
+    }
+    return mapSnapshot(player_map);
+}
+
 bool playerExceededGames(Map player_map, PlayerId player_id, int num_of_games){
     assert(player_map);
     PlayerData player_data = playerGetData(player_map, player_id);
@@ -238,42 +376,39 @@ bool playerExceededGames(Map player_map, PlayerId player_id, int num_of_games){
     return false;
 }
 
-PlayerResult playerAdd(Map player_map, PlayerId player_id){
+PlayerResult playerAdd(Map player_map, PlayerId player_id, bool* added){
+    if (added){
+        *added = false;
+    }
     if (!player_map){
         return PLAYER_NULL_ARGUMENT;
     }
-    if (playerExists(player_map, player_id)){
-        return PLAYER_SUCCESS;
-    }
-    PlayerKey player_key = createPlayerKey(player_id);
-    if (!player_key){
-        return PLAYER_OUT_OF_MEMORY;
-    }
-    PlayerData player_data = createPlayerData();
-    if (!player_data){
-        freePlayerKey(player_key);
+    if (!playerIdIsValid(player_id)){
         return PLAYER_OUT_OF_MEMORY;
     }
-    
-    if (mapPut(player_map, player_key, player_data) != MAP_SUCCESS){
-        freePlayerKey(player_key);
-        freePlayerData(player_data);
+    //the id is stored by value and the empty data copied into the pool, only for a new player
+    struct player_data empty_data = { 0 };
+    if (!mapGetOrInsert(player_map, &player_id, &empty_data, added)){
         return PLAYER_OUT_OF_MEMORY;
     }
-    freePlayerKey(player_key);
-    freePlayerData(player_data);
     return PLAYER_SUCCESS;
 }
 
 PlayerResult playerRemove(Map player_map, PlayerId player_id){
     assert(player_map);
-    if (mapContains(player_map, &player_id)){
-        mapRemove(player_map, &player_id);
-        return PLAYER_SUCCESS;
+    MapResult result = mapRemove(player_map, &player_id);
+    if (result == MAP_ITEM_DOES_NOT_EXIST){
+        return PLAYER_NOT_EXIST;
     }
-    return PLAYER_NOT_EXIST;
+    //removing from a map sharing players with a snapshot copies them, which may fail
+    return result == MAP_SUCCESS ? PLAYER_SUCCESS : PLAYER_OUT_OF_MEMORY;
 }
 
+int playerGetNumOfGames(Map player_map, PlayerId player_id){
+    assert(player_map);
+    PlayerData player_data = playerGetData(player_map, player_id);
+    return player_data ? player_data->num_of_games : 0;
+}
 PlayerData playerGetData(Map player_map, PlayerId player_id){
     assert(player_map);
     
@@ -283,12 +418,7 @@ PlayerData playerGetData(Map player_map, PlayerId player_id){
 double playerGetLevel(Map player_map, PlayerId player_id){
     assert(player_map);
     
-    PlayerData data = playerGetData(player_map, player_id);
-    if (data->num_of_games == 0){
-        return 0;
-    }
-    return (double)(6*data->num_of_wins - 10*data->num_of_loses + 2*data->num_of_draws)/(data->num_of_games);
-    
+    return playerDataGetLevel(playerGetData(player_map, player_id));
 }
 
 PlayerId playerGetMaxLevelAndId(Map player_map, double* max_level, bool remove){
@@ -298,24 +428,34 @@ PlayerId playerGetMaxLevelAndId(Map player_map, double* max_level, bool remove){
     *max_level = 0;
     bool first_iteration = true;
     
-    MAP_FOREACH(PlayerKey , player_key, player_map){
-        if (!playerHasGames(player_map, *player_key, true)){
-            continue;
+    MapCursor cursor = mapCursorCreate(player_map);
+    if (!cursor){
+        return 0;
+    }
+    while (mapCursorNext(cursor)){
+        PlayerData player_data = mapCursorGetData(cursor);
+        if (player_data->num_of_games == 0){
+            continue;// players without games have no level
         }
-        current_level = playerGetLevel(player_map, *player_key);
+        current_level = playerDataGetLevel(player_data);
         if (current_level > *max_level || first_iteration){
-            max_id = *player_key;
+            max_id = *(PlayerKey)mapCursorGetKey(cursor);
             *max_level = current_level;
             first_iteration = false;
         }
-        freePlayerKey(player_key);
     }
-    if (remove){
-        playerRemove(player_map, max_id);
+    mapCursorDestroy(cursor);
+    if (remove && playerRemove(player_map, max_id) != PLAYER_SUCCESS){
+        return 0;
     }
     return max_id;
 }
 
+int playerRemoveWithoutGames(Map player_map){
+    assert(player_map);
+    return mapRemoveIf(player_map, playerHasNoGames, NULL);
+}
+
 PlayerResult playerUpdateDuelResult(Map player_map, PlayerId first_player, PlayerId second_player, int play_time,
                                     Winner winner, UpdateMode value){
     if (!player_map){
@@ -324,45 +464,78 @@ PlayerResult playerUpdateDuelResult(Map player_map, PlayerId first_player, Playe
     if (!playerIdIsValid(first_player) || !playerIdIsValid(second_player)){
         return PLAYER_INVALID_ID;
     }
-    PlayerData first_player_data = playerGetData(player_map, first_player);
-    PlayerData second_player_data = playerGetData(player_map, second_player);
+    PlayerResult result = PLAYER_SUCCESS;
+    PlayerData first_player_data = playerGetMutableData(player_map, first_player, &result);
+    PlayerData second_player_data = first_player_data ?
+                                     playerGetMutableData(player_map, second_player, &result) : NULL;
     
     if (!first_player_data || !second_player_data){
-        return PLAYER_NOT_EXIST;
+        return result;
     }
     
-    first_player_data->num_of_games += value;
-    first_player_data->total_play_time += play_time*value;
-    second_player_data->num_of_games += value;
-    second_player_data->total_play_time += play_time*value;
-    if (winner == FIRST_PLAYER){
-        first_player_data->num_of_wins += value;
-        second_player_data->num_of_loses += value;
+    playerDataUpdateDuel(first_player_data, second_player_data, play_time, winner, value);
+    return PLAYER_SUCCESS;
+}
+
+PlayerResult playerMapValidate(Map player_map, bool no_results){
+    if (!player_map){
+        return PLAYER_NULL_ARGUMENT;
     }
-    else if (winner == SECOND_PLAYER){
-        first_player_data->num_of_loses += value;
-        second_player_data->num_of_wins += value;
+    MapCursor cursor = mapCursorCreate(player_map);
+    if (!cursor){
+        return PLAYER_OUT_OF_MEMORY;
     }
-    else{
-        first_player_data->num_of_draws += value;
-        second_player_data->num_of_draws += value;
+    bool valid = true;
+    while (valid && mapCursorNext(cursor)){
+        PlayerData player_data = mapCursorGetData(cursor);
+        valid = playerIdIsValid(*(PlayerKey)mapCursorGetKey(cursor)) && playerDataIsValid(player_data) &&
+                (!no_results || (player_data->num_of_games == 0 && player_data->total_play_time == 0));
     }
-    
-    return PLAYER_SUCCESS;
+    mapCursorDestroy(cursor);
+    return valid ? PLAYER_SUCCESS : PLAYER_SAVE_FAILURE;
 }
 
-bool playerUpdateData(PlayerData player_data1, PlayerData player_data2, UpdateMode value){
-    if (!player_data1 || !player_data2){
-        return false;
+PlayerResult playerAddDuelResult(Map player_map, PlayerId first_player, PlayerId second_player, int play_time,
+                                 Winner winner, int max_games, int* new_players){
+    if (!player_map){
+        return PLAYER_NULL_ARGUMENT;
     }
-    
-    player_data1->num_of_games += value * player_data2->num_of_games;
-    player_data1->total_play_time += value * player_data2->total_play_time;
-    player_data1->num_of_wins += value * player_data2->num_of_wins;
-    player_data1->num_of_loses += value * player_data2->num_of_loses;
-    player_data1->num_of_draws += value * player_data2->num_of_draws;
-    
-    return true;
+    if (!playerIdIsValid(first_player) || !playerIdIsValid(second_player)){
+        return PLAYER_INVALID_ID;
+    }
+    //the ids are stored by value and the empty data copied into the pool, only for a new player
+    struct player_data empty_data = { 0 };
+    bool added1 = false, added2 = false;
+    PlayerData first_player_data = mapGetOrInsert(player_map, &first_player, &empty_data, &added1);
+    if (!first_player_data){
+        return PLAYER_OUT_OF_MEMORY;
+    }
+    if (max_games > 0 && first_player_data->num_of_games >= max_games){
+        return PLAYER_EXCEEDED_GAMES;
+    }
+    PlayerData second_player_data = mapGetOrInsert(player_map, &second_player, &empty_data, &added2);
+    PlayerResult result = PLAYER_SUCCESS;
+    if (!second_player_data){
+        result = PLAYER_OUT_OF_MEMORY;
+    }
+    else if (max_games > 0 && second_player_data->num_of_games >= max_games){
+        result = PLAYER_EXCEEDED_GAMES;
+    }
+    if (result != PLAYER_SUCCESS){
+        if (added1){
+            mapRemove(player_map, &first_player);
+        }
+        return result;
+    }
+    //adding a key may move the first player's data within the map's engine
+    if (added2){
+        first_player_data = playerGetData(player_map, first_player);
+    }
+    if (new_players){
+        *new_players += added1 + added2;
+    }
+    playerDataUpdateDuel(first_player_data, second_player_data, play_time, winner, ADD);
+    return PLAYER_SUCCESS;
 }
 
 PlayerResult playerMapUpdateStatistics(Map main_map, Map update_map, bool destroy, UpdateMode value){
@@ -370,24 +543,13 @@ PlayerResult playerMapUpdateStatistics(Map main_map, Map update_map, bool destro
         return PLAYER_NULL_ARGUMENT;
     }
     
-    MAP_FOREACH(PlayerKey, player_key, update_map){
-        PlayerData update_data = playerGetData(update_map, *player_key);
-        assert(update_data);
-        
-        PlayerData player_data = playerGetData(main_map, *player_key);
-        if (!player_data){
-            freePlayerKey(player_key);
-            continue;
-        }
-        
-        playerUpdateData(player_data, update_data, value);
-        freePlayerKey(player_key);
-    }
+    //both maps are sorted by id, so the players are paired in one pass over the two
+    MapResult result = mapMergeWith(main_map, update_map, mergePlayerData, &value);
     
     if (destroy){
         playerDestroyMap(update_map);
     }
-    return PLAYER_SUCCESS;
+    return result == MAP_SUCCESS ? PLAYER_SUCCESS : PLAYER_OUT_OF_MEMORY;
 }
 
 PlayerResult updatePlayerDataAfterOpponentQuit(Map player_map, PlayerId player_id, DuelResult game_result){
@@ -396,9 +558,10 @@ PlayerResult updatePlayerDataAfterOpponentQuit(Map player_map, PlayerId player_i
         return PLAYER_NULL_ARGUMENT;
     }
     
-    PlayerData player_data = playerGetData(player_map, player_id);
+    PlayerResult result = PLAYER_INVALID_ID;
+    PlayerData player_data = playerGetMutableData(player_map, player_id, &result);
     if (!player_data){
-        return PLAYER_INVALID_ID;
+        return result == PLAYER_OUT_OF_MEMORY ? result : PLAYER_INVALID_ID;
     }
     if (game_result == PLAYER_LOST){
         player_data->num_of_loses--;
@@ -423,40 +586,33 @@ PlayerId playerCalculateWinner(Map player_map){
     if (!player_map){
         return 0;
     }
-    PlayerKey winner_key = mapGetFirst(player_map);
-    PlayerData winner_data = playerGetData(player_map, *winner_key);
-    int winner_score = playerCalculateScore(winner_data);
+    MapCursor cursor = mapCursorCreate(player_map);
+    if (!cursor){
+        return 0;
+    }
+    PlayerId winner_id = 0;
+    PlayerData winner_data = NULL;
+    int winner_score = 0;
     
-    MAP_FOREACH(PlayerKey, player_key, player_map){
-        PlayerData player_data = playerGetData(player_map, *player_key);
+    while (mapCursorNext(cursor)){
+        PlayerData player_data = mapCursorGetData(cursor);
         int player_score = playerCalculateScore(player_data);
-        if (player_score >= winner_score){
-            if (player_score == winner_score){
-                if (player_data->num_of_loses > winner_data->num_of_loses){
-                    freePlayerKey(player_key);
-                    continue;
-                }
-                else if (player_data->num_of_loses == winner_data->num_of_loses){
-                    // <= since if they are equal the winner is by smallest id, and winner_id < player_id
-                    // from the implementation of Map
-                    if (player_data->num_of_wins <= winner_data->num_of_wins){
-                        freePlayerKey(player_key);
-                        continue;
-                    }//if (player_data->num_of_wins <= winner_data->num_of_wins)
-                }//else if (player_data->num_of_loses == winner_data->num_of_loses)
-            }//if (player_data->num_of_loses > winner_data->num_of_loses)
-            freePlayerKey(winner_key);
-            winner_key = player_key;
-            winner_data = playerGetData(player_map, *winner_key);
-            winner_score = player_score;
-            continue;
-        }// if (player_score == winner_score)
-        
-        freePlayerKey(player_key);
+        if (winner_data && player_score <= winner_score){
+            if (player_score < winner_score || player_data->num_of_loses > winner_data->num_of_loses){
+                continue;
+            }
+            // <= since if they are equal the winner is by smallest id, and winner_id < player_id
+            // from the implementation of Map
+            if (player_data->num_of_loses == winner_data->num_of_loses &&
+                player_data->num_of_wins <= winner_data->num_of_wins){
+                continue;
+            }
+        }
+        winner_id = *(PlayerKey)mapCursorGetKey(cursor);
+        winner_data = player_data;
+        winner_score = player_score;
     }
-    
-    PlayerId winner_id = *winner_key;
-    freePlayerKey(winner_key);
+    mapCursorDestroy(cursor);
     return winner_id;
 }
 
@@ -480,11 +636,22 @@ PlayerResult playerCalculateAveragePlayTime(Map player_map, PlayerId player_id,
     return PLAYER_SUCCESS;
 }
 
-
-
-
-
-
-
-
+PlayerResult playerForEachInRange(Map player_map, PlayerId from_id, PlayerId to_id, playerVisitFunction visit,
+                                  void* context){
+    if (!player_map || !visit){
+        return PLAYER_NULL_ARGUMENT;
+    }
+    if (from_id > to_id){
+        return PLAYER_SUCCESS;
+    }
+    MapCursor cursor = mapCursorCreateRange(player_map, &from_id, &to_id);
+    if (!cursor){
+        return PLAYER_OUT_OF_MEMORY;
+    }
+    while (mapCursorNext(cursor)){
+        visit(*(PlayerKey)mapCursorGetKey(cursor), mapCursorGetData(cursor), context);
+    }
+    mapCursorDestroy(cursor);
+    return PLAYER_SUCCESS;
+}
 
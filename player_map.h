@@ -58,6 +58,27 @@ typedef enum {
 */
 Map playerCreateMap();
 /**
+* playerCreateMapWithAllocator: Allocates a new empty player map taking its memory from
+* an allocator (see mapCreateWithAllocator).
+*
+* @param allocator - the allocator, NULL for malloc.
+* @return
+* 	NULL - if allocations failed.
+* 	A new Map in case of success.
+*/
+Map playerCreateMapWithAllocator(const MapAllocator* allocator);
+/**
+* playerCreateMapWithCapacity: Allocates a new empty player map taking its memory from
+* an allocator, with room for a number of players (see mapReserve).
+*
+* @param allocator - the allocator, NULL for malloc.
+* @param capacity - the number of players the map is expected to hold, 0 for none.
+* @return
+* 	NULL - if allocations failed.
+* 	A new Map in case of success.
+*/
+Map playerCreateMapWithCapacity(const MapAllocator* allocator, int capacity);
+/**
 * playerDestroyMap: Deallocates an existing player map. Clears all elements by using the
 * stored free functions.
 *
@@ -107,18 +128,29 @@ PlayerData playerGetData(Map player_map, PlayerId player_id);
 *      false - if the player_map does not contain the requested player_id.
 */
 bool playerExceededGames(Map player_map, PlayerId player_id, int num_of_games);
+/**
+* playerGetNumOfGames: Returns the number of games of a player.
+*
+* @param player_map -  the player_map to look into - must not be NULL.
+* @param player_id -  the player_id associated with a player.
+* @return
+*      0 - if the player_map does not contain the requested player_id.
+*      int - the number of games of the player otherwise.
+*/
+int playerGetNumOfGames(Map player_map, PlayerId player_id);
 /**
  *  playerAdd- adds a player to the players map, does nothing if already exists
  *
 * @param player_map -  the player_map to look into.
 * @param player_id -  the player_id associated with a player.
+* @param added -  pointer to set to true if the player was added, false otherwise. May be NULL.
  * @return
  *      PLAYER_NULL_ARGUMENT - if player_map is NULL.
  *      PLAYER_SUCCESS - if the player associated with the player_id already exist in the player_map
  *                       or if he wad addded successfuly.
  *      PLAYER_OUT_OF_MEMORY - if alllocations fail
  */
-PlayerResult playerAdd(Map player_map, PlayerId player_id);
+PlayerResult playerAdd(Map player_map, PlayerId player_id, bool* added);
 /**
 * playerRemove: removes a player from the players map.
 *
@@ -126,6 +158,7 @@ PlayerResult playerAdd(Map player_map, PlayerId player_id);
 * @param player_id -  the player_id associated with a player to be removed.
 * @return
 *      PLAYER_NOT_EXIST - if player doesn't exist in the player_map
+*      PLAYER_OUT_OF_MEMORY - if player_map shares the player with a snapshot and copying it failed.
 *      PLAYER_SUCCESS - removement was successful.
 */
 PlayerResult playerRemove(Map player_map, PlayerId player_id);
@@ -151,16 +184,50 @@ double playerGetLevel(Map player_map, PlayerId player_id);
 */
 Map playerMapCopy(Map player_map);
 /**
+* playerMapCopyWithAllocator: Creates a copy of player_map taking its memory from an
+* allocator, e.g. an arena for a short lived copy (see mapCopyWithAllocator).
+*
+* @param player_map - Target player_map.
+* @param allocator - the copy's allocator.
+* @return
+* 	NULL if a NULL was sent or a memory allocation failed.
+* 	A Map containing the same elements as player_map otherwise.
+*/
+Map playerMapCopyWithAllocator(Map player_map, const MapAllocator* allocator);
+/**
+* playerMapSnapshot: Creates a copy of player_map in O(1), sharing the players with it
+* until one of the maps changes them (see mapSnapshot). The functions of this module
+* copy a shared player before changing his statistics, only the data returned by
+* playerGetData must not be changed in place.
+*
+* @param player_map - Target player_map.
+* @return
+* 	NULL if a NULL was sent or a memory allocation failed.
+* 	A Map containing the same elements as player_map otherwise.
+*/
+Map playerMapSnapshot(Map player_map);
+/**
 * playerGetMaxLevelAndId: Returns highest level of all players and the player's id associated with it.
+* Players without games have no level and are skipped.
 *
 * @param player_map - the player_map to look into - must not be NULL.
 * @param max_level  -  pointer to store the max level in.
 * @param remove     -  a boolean flag that indicates whether should the player be removed or not.
 *
 * @return
+*      0 - if no player has games or a memory allocation failed.
 *      PlayerId - the player's id with the highest level in the players map.
 */
 PlayerId playerGetMaxLevelAndId(Map player_map, double* max_level, bool remove);
+/**
+* playerRemoveWithoutGames: Removes all the players that have no games, in one pass over the map.
+*
+* @param player_map - the player_map to remove from - must not be NULL.
+*
+* @return
+*      The number of removed players.
+*/
+int playerRemoveWithoutGames(Map player_map);
 /**
  *playerUpdateDuelResult - update the results of two players
  *
@@ -175,12 +242,52 @@ PlayerId playerGetMaxLevelAndId(Map player_map, double* max_level, bool remove);
  *      PLAYER_NULL_ARGUMENT - if player_map is NULL.
  *      PLAYER_INVALID_ID - if the first player's id or the second player's id are invalid.
  *      PLAYER_NOT_EXIST - if the one of the player's id does not exist in the players map
+ *      PLAYER_OUT_OF_MEMORY - if copying a player from a snapshot sharing him failed.
  *      PLAYER_SUCCESS   - the update has been successfuly done.
  */
 PlayerResult playerUpdateDuelResult(Map player_map, PlayerId first_player, PlayerId second_player, int play_time,
                                     Winner winner, UpdateMode value);
 /**
- *playerUpdateData - updates statistics map(update_map) with values of the first map (player_map).
+ *playerMapValidate - checks the players of a map read from a save, in one pass over the map.
+ *
+ * @param player_map    - the player_map to check.
+ * @param no_results    - if true, the players must also have no games left, e.g. once the results of
+ *                        all their tournaments were taken out of them.
+ *
+ * @return
+ *      PLAYER_NULL_ARGUMENT - if player_map is NULL.
+ *      PLAYER_OUT_OF_MEMORY - if an allocation failed.
+ *      PLAYER_SAVE_FAILURE - if a player's id is not positive, a counter is negative, the games are not the wins,
+ *                            losses and draws together, or a player without games has a play time.
+ *      PLAYER_SUCCESS   - otherwise.
+ */
+PlayerResult playerMapValidate(Map player_map, bool no_results);
+/**
+ *playerAddDuelResult - adds a game to the results of two players, adding the players that are not in the
+ *                      map yet. Each player is looked up once, its games are checked against max_games and its
+ *                      results updated through the data the lookup returns (a second player added to a map
+ *                      sharing players with a snapshot makes the first player be looked up again).
+ *
+ * @param player_map    - the player_map to update.
+ * @param first_player  - the id of the first player.
+ * @param second_player - the id of the second player.
+ * @param play_time     - time of the game
+ * @param winner        - the winner of the game
+ * @param max_games     - the number of games a player may have played before this one is refused, 0 for no limit.
+ * @param new_players   - pointer to add the number of players that were added to. May be NULL.
+ *
+ * @return
+ *      PLAYER_NULL_ARGUMENT - if player_map is NULL.
+ *      PLAYER_INVALID_ID - if the first player's id or the second player's id are invalid.
+ *      PLAYER_EXCEEDED_GAMES - if one of the players already played max_games, the map is then unchanged.
+ *      PLAYER_OUT_OF_MEMORY - if an allocation failed, the map is then unchanged.
+ *      PLAYER_SUCCESS   - the game has been added.
+ */
+PlayerResult playerAddDuelResult(Map player_map, PlayerId first_player, PlayerId second_player, int play_time,
+                                 Winner winner, int max_games, int* new_players);
+/**
+ *playerMapUpdateStatistics - updates statistics map(update_map) with values of the first map (player_map).
+ *                             The two maps are walked together in one pass (see mapMergeWith).
  *
  * @param main_map        - pointer to player map with statistics values
  * @param update_map      - pointer to second player map.
@@ -188,6 +295,8 @@ PlayerResult playerUpdateDuelResult(Map player_map, PlayerId first_player, Playe
  * @param value           - states whether an update should be made
  * @return
  *      PLAYER_NULL_ARGUMENT - if player_map or update_map is NULL.
+ *      PLAYER_OUT_OF_MEMORY - if copying the players main_map shares with a snapshot failed,
+ *                             nothing is updated then.
  *      PLAYER_SUCCESS   - the update has been successfully done.
  */
 PlayerResult playerMapUpdateStatistics(Map main_map, Map update_map, bool destroy, UpdateMode value);
@@ -201,6 +310,7 @@ PlayerResult playerMapUpdateStatistics(Map main_map, Map update_map, bool destro
  * @return
  *      PLAYER_NULL_ARGUMENT - if player_map is NULL.
  *      PLAYER_INVALID_ID - if the player's id is invalid.
+ *      PLAYER_OUT_OF_MEMORY - if copying the player from a snapshot sharing him failed.
  *      PLAYER_SUCCESS   - the update has been successfuly done.
  */
 PlayerResult updatePlayerDataAfterOpponentQuit(Map player_map, PlayerId player_id, DuelResult game_result);
@@ -227,7 +337,7 @@ int playerCalculateScore(PlayerData player_data);
 * @param player_map - the player_map to search from.
 *
 * @return-
-*       0- if player_map is NULL.
+*       0- if player_map is NULL, empty or a memory allocation failed.
 *       PlayerId - the winner's id otherwise.
  */
 PlayerId playerCalculateWinner(Map player_map);
@@ -247,5 +357,26 @@ PlayerId playerCalculateWinner(Map player_map);
  */
 PlayerResult playerCalculateAveragePlayTime(Map player_map, PlayerId player_id, double* play_time);
 
+/** Type of function called by playerForEachInRange for every player in the range */
+typedef void (*playerVisitFunction)(PlayerId player_id, PlayerData player_data, void* context);
+
+/**
+ * playerForEachInRange: calls a function for every player whose id is between from_id and to_id,
+ * both included, in ascending id order. Costs O(log n + k) for k players in the range.
+ * The function must not add or remove players.
+ *
+ * @param player_map - the player_map to look into.
+ * @param from_id - the smallest id of the range.
+ * @param to_id - the largest id of the range.
+ * @param visit - the function to call with every player's id and data.
+ * @param context - passed as is to visit.
+ * @return
+ *      PLAYER_NULL_ARGUMENT - if player_map or visit is NULL.
+ *      PLAYER_OUT_OF_MEMORY - if an allocation failed, no player was visited.
+ *      PLAYER_SUCCESS - otherwise, also when the range is empty.
+ */
+PlayerResult playerForEachInRange(Map player_map, PlayerId from_id, PlayerId to_id, playerVisitFunction visit,
+                                  void* context);
+
 
 #endif //CHESS_PLAYER_MAP_H
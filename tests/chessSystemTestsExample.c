@@ -1,9 +1,11 @@
 #include <stdlib.h>
+#include <limits.h>
+#include <string.h>
 #include "../chessSystem.h"
 #include "../test_utilities.h"
 
 /*The number of tests*/
-#define NUMBER_TESTS 4
+#define NUMBER_TESTS 11
 
 
 bool testChessAddTournament() {
@@ -33,6 +35,9 @@ bool testChessAddGame(){
     ASSERT_TEST(chessAddGame(chess, 1, 1, 2, FIRST_PLAYER, 2000) == CHESS_TOURNAMENT_NOT_EXIST);
     ASSERT_TEST(chessAddTournament(chess, 1, 4, "London") == CHESS_SUCCESS);
     ASSERT_TEST(chessAddGame(chess, 1, 1, 2, FIRST_PLAYER, 2000) == CHESS_SUCCESS);
+    //any non-negative play time is valid
+    ASSERT_TEST(chessAddGame(chess, 1, 1, 3, DRAW, INT_MAX) == CHESS_SUCCESS);
+    ASSERT_TEST(chessAddGame(chess, 1, 2, 3, DRAW, -1) == CHESS_INVALID_PLAY_TIME);
 
     chessDestroy(chess);
     return true;
@@ -61,6 +66,262 @@ bool testChessPrintLevelsAndTournamentStatistics(){
     return true;
 }
 
+/* Saves a chess system into a new temporary file, rewound, NULL on failure */
+static FILE* saveToTemporaryFile(ChessSystem chess) {
+    FILE* file = tmpfile();
+    if (file && chessSaveSystem(chess, file) != CHESS_SUCCESS) {
+        fclose(file);
+        return NULL;
+    }
+    if (file) {
+        rewind(file);
+    }
+    return file;
+}
+
+/* Reads a whole file into a new buffer, storing its length */
+static unsigned char* readWholeFile(FILE* file, long* length) {
+    fseek(file, 0, SEEK_END);
+    *length = ftell(file);
+    rewind(file);
+    unsigned char* buffer = malloc(*length > 0 ? *length : 1);
+    if (buffer && fread(buffer, 1, *length, file) != (size_t)*length) {
+        free(buffer);
+        return NULL;
+    }
+    return buffer;
+}
+
+/* Loads a chess system from the first length bytes of a buffer */
+static ChessSystem loadFromBuffer(const unsigned char* buffer, long length, ChessResult* result) {
+    FILE* file = tmpfile();
+    if (!file) {
+        *result = CHESS_SAVE_FAILURE;
+        return NULL;
+    }
+    fwrite(buffer, 1, length, file);
+    rewind(file);
+    ChessSystem chess = chessLoadSystem(file, result);
+    fclose(file);
+    return chess;
+}
+
+/* A system with an ended tournament, a removed player and a removed game */
+static ChessSystem createSavedSystem() {
+    ChessSystem chess = chessCreate();
+    GameHandle game;
+    if (chessAddTournament(chess, 1, 4, "London") != CHESS_SUCCESS ||
+        chessAddTournament(chess, 2, 3, "Paris") != CHESS_SUCCESS ||
+        chessAddGame(chess, 1, 1, 2, FIRST_PLAYER, 2000) != CHESS_SUCCESS ||
+        chessAddGame(chess, 1, 3, 2, SECOND_PLAYER, 3000) != CHESS_SUCCESS ||
+        chessAddGame(chess, 1, 3, 4, DRAW, 400) != CHESS_SUCCESS ||
+        chessEndTournament(chess, 1) != CHESS_SUCCESS ||
+        chessAddGame(chess, 2, 1, 3, DRAW, 100) != CHESS_SUCCESS ||
+        chessAddGameEx(chess, 2, 2, 5, SECOND_PLAYER, 700, &game) != CHESS_SUCCESS ||
+        chessAddGame(chess, 2, 4, 5, FIRST_PLAYER, 900) != CHESS_SUCCESS ||
+        chessRemoveGame(chess, game) != CHESS_SUCCESS ||
+        chessRemovePlayer(chess, 4) != CHESS_SUCCESS) {
+        chessDestroy(chess);
+        return NULL;
+    }
+    return chess;
+}
+
+bool testChessSaveLoadSystem() {
+    ChessSystem chess = createSavedSystem();
+    ASSERT_TEST(chess != NULL);
+    FILE* file = saveToTemporaryFile(chess);
+    ASSERT_TEST(file != NULL);
+    long length = 0;
+    unsigned char* saved = readWholeFile(file, &length);
+    ASSERT_TEST(saved != NULL);
+    rewind(file);
+    ChessResult result;
+    ChessSystem loaded = chessLoadSystem(file, &result);
+    fclose(file);
+    ASSERT_TEST(loaded != NULL && result == CHESS_SUCCESS);
+
+    //the loaded system saves the same bytes, and goes on as the saved one
+    file = saveToTemporaryFile(loaded);
+    ASSERT_TEST(file != NULL);
+    long loaded_length = 0;
+    unsigned char* loaded_saved = readWholeFile(file, &loaded_length);
+    fclose(file);
+    ASSERT_TEST(loaded_saved != NULL && loaded_length == length && memcmp(saved, loaded_saved, length) == 0);
+    ASSERT_TEST(chessAddGame(loaded, 1, 1, 3, FIRST_PLAYER, 10) == CHESS_TOURNAMENT_ENDED);
+    ASSERT_TEST(chessAddGame(loaded, 2, 1, 3, FIRST_PLAYER, 10) == CHESS_GAME_ALREADY_EXISTS);
+    ASSERT_TEST(chessAddGame(loaded, 2, 2, 5, FIRST_PLAYER, 10) == CHESS_SUCCESS);
+    ASSERT_TEST(chessAddGame(chess, 2, 2, 5, FIRST_PLAYER, 10) == CHESS_SUCCESS);
+    ASSERT_TEST(chessCalculateAveragePlayTime(loaded, 5, &result) == chessCalculateAveragePlayTime(chess, 5, &result));
+
+    free(saved);
+    free(loaded_saved);
+    chessDestroy(loaded);
+    chessDestroy(chess);
+    return true;
+}
+
+bool testChessLoadCorruptedSystem() {
+    ChessSystem chess = createSavedSystem();
+    ASSERT_TEST(chess != NULL);
+    FILE* file = saveToTemporaryFile(chess);
+    ASSERT_TEST(file != NULL);
+    long length = 0;
+    unsigned char* saved = readWholeFile(file, &length);
+    fclose(file);
+    ASSERT_TEST(saved != NULL && length > 0);
+    chessDestroy(chess);
+
+    ChessResult result;
+    ASSERT_TEST(loadFromBuffer(saved, 0, &result) == NULL && result == CHESS_SAVE_FAILURE);
+    ASSERT_TEST(loadFromBuffer(saved, length - 1, &result) == NULL && result == CHESS_SAVE_FAILURE);
+    //every byte changed in turn: a save that doesn't add up is refused, whatever byte it is
+    unsigned char* corrupted = malloc(length);
+    ASSERT_TEST(corrupted != NULL);
+    int refused = 0;
+    for (long position = 0; position < length; position++) {
+        memcpy(corrupted, saved, length);
+        corrupted[position] ^= 0xff;
+        ChessSystem loaded = loadFromBuffer(corrupted, length, &result);
+        if (loaded) {
+            ASSERT_TEST(result == CHESS_SUCCESS);
+            chessDestroy(loaded);
+        }
+        else {
+            ASSERT_TEST(result == CHESS_SAVE_FAILURE || result == CHESS_OUT_OF_MEMORY);
+            refused++;
+        }
+    }
+    ASSERT_TEST(refused > length / 2);
+
+    free(corrupted);
+    free(saved);
+    return true;
+}
+
+/* Checks that the players levels of a chess system print as expected */
+static bool levelsAre(ChessSystem chess, const char* expected) {
+    FILE* file = tmpfile();
+    if (!file) {
+        return false;
+    }
+    long length = 0;
+    unsigned char* levels = NULL;
+    if (chessSavePlayersLevels(chess, file) == CHESS_SUCCESS) {
+        levels = readWholeFile(file, &length);
+    }
+    fclose(file);
+    bool equal = levels && length == (long)strlen(expected) && memcmp(levels, expected, length) == 0;
+    free(levels);
+    return equal;
+}
+
+bool testChessUpdateGameResult() {
+    ChessSystem chess = chessCreate();
+    GameHandle game;
+    ChessResult result;
+    ASSERT_TEST(chessAddTournament(chess, 1, 4, "London") == CHESS_SUCCESS);
+    ASSERT_TEST(chessAddGameEx(chess, 1, 1, 2, FIRST_PLAYER, 100, &game) == CHESS_SUCCESS);
+    ASSERT_TEST(chessAddGame(chess, 1, 1, 3, DRAW, 300) == CHESS_SUCCESS);
+    ASSERT_TEST(levelsAre(chess, "1 4.00\n3 2.00\n2 -10.00\n"));
+    ASSERT_TEST(chessCalculateAveragePlayTime(chess, 1, &result) == 200 && result == CHESS_SUCCESS);
+
+    ASSERT_TEST(chessUpdateGameResult(chess, game, SECOND_PLAYER, 500) == CHESS_SUCCESS);
+    ASSERT_TEST(levelsAre(chess, "2 6.00\n3 2.00\n1 -4.00\n"));
+    ASSERT_TEST(chessCalculateAveragePlayTime(chess, 1, &result) == 400 && result == CHESS_SUCCESS);
+    ASSERT_TEST(chessCalculateAveragePlayTime(chess, 2, &result) == 500 && result == CHESS_SUCCESS);
+    ASSERT_TEST(chessUpdateGameResult(chess, game, DRAW, -1) == CHESS_INVALID_PLAY_TIME);
+    ASSERT_TEST(levelsAre(chess, "2 6.00\n3 2.00\n1 -4.00\n"));
+    ASSERT_TEST(chessAddGame(chess, 1, 2, 1, DRAW, 10) == CHESS_GAME_ALREADY_EXISTS);
+
+    chessDestroy(chess);
+    return true;
+}
+
+bool testChessRemoveGame() {
+    ChessSystem chess = chessCreate();
+    GameHandle game;
+    ChessResult result;
+    ASSERT_TEST(chessAddTournament(chess, 1, 4, "London") == CHESS_SUCCESS);
+    ASSERT_TEST(chessAddGameEx(chess, 1, 1, 2, FIRST_PLAYER, 100, &game) == CHESS_SUCCESS);
+    ASSERT_TEST(chessAddGame(chess, 1, 1, 3, DRAW, 300) == CHESS_SUCCESS);
+    ASSERT_TEST(chessRemoveGame(chess, game) == CHESS_SUCCESS);
+    ASSERT_TEST(levelsAre(chess, "1 2.00\n3 2.00\n"));
+    ASSERT_TEST(chessCalculateAveragePlayTime(chess, 1, &result) == 300 && result == CHESS_SUCCESS);
+    //the player left with no games stays in the system, but not in the tournament
+    ASSERT_TEST(chessCalculateAveragePlayTime(chess, 2, &result) == 0 && result == CHESS_SUCCESS);
+    ASSERT_TEST(chessEndTournament(chess, 1) == CHESS_SUCCESS);
+    ASSERT_TEST(chessSaveTournamentStatistics(chess, "tournament_statistics_your_output.txt") == CHESS_SUCCESS);
+    FILE* file = fopen("tournament_statistics_your_output.txt", "r");
+    ASSERT_TEST(file != NULL);
+    long length = 0;
+    unsigned char* statistics = readWholeFile(file, &length);
+    fclose(file);
+    const char* expected = "1\n300\n300.00\nLondon\n1\n2\n";
+    ASSERT_TEST(statistics && length == (long)strlen(expected) && memcmp(statistics, expected, length) == 0);
+
+    free(statistics);
+    chessDestroy(chess);
+    return true;
+}
+
+bool testChessGameHandleAfterRemoval() {
+    ChessSystem chess = chessCreate();
+    GameHandle game;
+    ASSERT_TEST(chessAddTournament(chess, 1, 4, "London") == CHESS_SUCCESS);
+    ASSERT_TEST(chessAddGameEx(chess, 1, 1, 2, FIRST_PLAYER, 100, &game) == CHESS_SUCCESS);
+    ASSERT_TEST(chessAddGame(chess, 1, 1, 3, DRAW, 300) == CHESS_SUCCESS);
+    ASSERT_TEST(chessRemoveGame(chess, game) == CHESS_SUCCESS);
+    ASSERT_TEST(chessRemoveGame(chess, game) == CHESS_GAME_NOT_EXIST);
+    ASSERT_TEST(chessUpdateGameResult(chess, game, DRAW, 10) == CHESS_GAME_NOT_EXIST);
+    ASSERT_TEST(levelsAre(chess, "1 2.00\n3 2.00\n"));
+    //the same players can play again, and the old handle names the new game
+    ASSERT_TEST(chessAddGame(chess, 1, 2, 1, DRAW, 10) == CHESS_SUCCESS);
+    ASSERT_TEST(chessUpdateGameResult(chess, game, FIRST_PLAYER, 10) == CHESS_SUCCESS);
+    ASSERT_TEST(levelsAre(chess, "1 4.00\n3 2.00\n2 -10.00\n"));
+    //removing a player removes his games, and with them the game of the handle
+    ASSERT_TEST(chessRemovePlayer(chess, 2) == CHESS_SUCCESS);
+    ASSERT_TEST(chessRemoveGame(chess, game) == CHESS_GAME_NOT_EXIST);
+
+    chessDestroy(chess);
+    return true;
+}
+
+bool testChessGameHandleSwappedPlayers() {
+    ChessSystem chess = chessCreate();
+    GameHandle game;
+    ASSERT_TEST(chessAddTournament(chess, 1, 4, "London") == CHESS_SUCCESS);
+    ASSERT_TEST(chessAddGameEx(chess, 1, 1, 2, FIRST_PLAYER, 100, &game) == CHESS_SUCCESS);
+    GameHandle swapped = { game.tournament_id, game.second_player, game.first_player };
+    //the winner is given as seen by the first player of the handle used
+    ASSERT_TEST(chessUpdateGameResult(chess, swapped, FIRST_PLAYER, 50) == CHESS_SUCCESS);
+    ASSERT_TEST(levelsAre(chess, "2 6.00\n1 -10.00\n"));
+    ASSERT_TEST(chessUpdateGameResult(chess, game, FIRST_PLAYER, 50) == CHESS_SUCCESS);
+    ASSERT_TEST(levelsAre(chess, "1 6.00\n2 -10.00\n"));
+    ASSERT_TEST(chessRemoveGame(chess, swapped) == CHESS_SUCCESS);
+    ASSERT_TEST(chessRemoveGame(chess, game) == CHESS_GAME_NOT_EXIST);
+    GameHandle same_player = { 1, 1, 1 };
+    ASSERT_TEST(chessRemoveGame(chess, same_player) == CHESS_INVALID_ID);
+
+    chessDestroy(chess);
+    return true;
+}
+
+bool testChessGameHandleEndedTournament() {
+    ChessSystem chess = chessCreate();
+    GameHandle game;
+    ASSERT_TEST(chessAddTournament(chess, 1, 4, "London") == CHESS_SUCCESS);
+    ASSERT_TEST(chessAddGameEx(chess, 1, 1, 2, FIRST_PLAYER, 100, &game) == CHESS_SUCCESS);
+    ASSERT_TEST(chessEndTournament(chess, 1) == CHESS_SUCCESS);
+    ASSERT_TEST(chessUpdateGameResult(chess, game, SECOND_PLAYER, 50) == CHESS_TOURNAMENT_ENDED);
+    ASSERT_TEST(chessRemoveGame(chess, game) == CHESS_TOURNAMENT_ENDED);
+    ASSERT_TEST(levelsAre(chess, "1 6.00\n2 -10.00\n"));
+    ASSERT_TEST(chessRemoveTournament(chess, 1) == CHESS_SUCCESS);
+    ASSERT_TEST(chessRemoveGame(chess, game) == CHESS_TOURNAMENT_NOT_EXIST);
+
+    chessDestroy(chess);
+    return true;
+}
 
 
 /*The functions for the tests should be added here*/
@@ -68,8 +329,14 @@ bool (*tests[]) (void) = {
         testChessAddTournament,
         testChessRemoveTournament,
         testChessPrintLevelsAndTournamentStatistics,
-        testChessAddGame
-        
+        testChessAddGame,
+        testChessSaveLoadSystem,
+        testChessLoadCorruptedSystem,
+        testChessUpdateGameResult,
+        testChessRemoveGame,
+        testChessGameHandleAfterRemoval,
+        testChessGameHandleSwappedPlayers,
+        testChessGameHandleEndedTournament
 };
 
 /*The names of the test functions should be added here*/
@@ -78,7 +345,14 @@ const char* testNames[] = {
         "testChessRemoveTournament",
         
         "testChessPrintLevelsAndTournamentStatistics",
-        "testChessAddGame"
+        "testChessAddGame",
+        "testChessSaveLoadSystem",
+        "testChessLoadCorruptedSystem",
+        "testChessUpdateGameResult",
+        "testChessRemoveGame",
+        "testChessGameHandleAfterRemoval",
+        "testChessGameHandleSwappedPlayers",
+        "testChessGameHandleEndedTournament"
 };
 
 
@@ -0,0 +1,742 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "../map.h"
+#include "../game_pairs.h"
+#include "../test_utilities.h"
+
+/*The number of tests*/
+#define NUMBER_TESTS 10
+
+/* Keys of the maps of the tests, enough for a B+tree of three levels */
+#define TEST_KEYS 3000
+/* Keys an adaptive map holds in its array before it is promoted to a tree */
+#define ADAPTIVE_ARRAY_KEYS 32
+/* Players of the smallest tournament a pairing index makes dense */
+#define PAIRS_DENSE_PLAYERS 16
+/* Players of the pairing tests, enough for every player to have a game under the sparse threshold */
+#define PAIRS_TEST_PLAYERS 32
+
+
+static MapKeyElement copyInt(MapKeyElement key) {
+    int* copy = malloc(sizeof(*copy));
+    if (copy) {
+        *copy = *(int*)key;
+    }
+    return copy;
+}
+
+static void freeInt(MapKeyElement key) {
+    free(key);
+}
+
+static unsigned int hashInt(MapKeyElement key) {
+    return (unsigned int)*(int*)key;
+}
+
+static MapKeyElement copyString(MapKeyElement key) {
+    char* copy = malloc(strlen(key) + 1);
+    if (copy) {
+        strcpy(copy, key);
+    }
+    return copy;
+}
+
+static int compareStrings(MapKeyElement key1, MapKeyElement key2) {
+    return strcmp(key1, key2);
+}
+
+/* Encodes a string key as its characters, without the terminating '\0' */
+static size_t encodeString(void* key, unsigned char* buffer, size_t size) {
+    size_t length = strlen(key);
+    if (length > 0 && length <= size) {
+        memcpy(buffer, key, length);
+    }
+    return length;
+}
+
+static void* decodeString(const unsigned char* buffer, size_t size, const MapAllocator* allocator) {
+    char* key = malloc(size + 1);
+    if (key) {
+        memcpy(key, buffer, size);
+        key[size] = '\0';
+    }
+    return key;
+}
+
+static void* mallocAllocate(void* context, size_t size) {
+    return malloc(size);
+}
+
+static void mallocDeallocate(void* context, void* pointer, size_t size) {
+    free(pointer);
+}
+
+/* The mapMergeWith function giving the keys of a map the data they have in another */
+static void copyOtherData(MapKeyElement key, MapDataElement data, MapDataElement other_data, void* context) {
+    if (data && other_data) {
+        *(int*)data = *(int*)other_data;
+    }
+}
+
+/* A map of int keys and int data kept by value, in a given engine */
+static Map createIntMap(MapEngine engine, hashMapKeyElements hash) {
+    MapOptions options = {0};
+    options.engine = engine;
+    options.hashKeyElement = hash;
+    options.keyType = MAP_KEY_INT;
+    options.dataSize = sizeof(int);
+    return mapCreateWithOptions(NULL, copyInt, NULL, freeInt, NULL, &options);
+}
+
+/* Gives key the data 3 * key */
+static bool putKey(Map map, int key) {
+    int data = 3 * key;
+    return mapPut(map, &key, &data) == MAP_SUCCESS;
+}
+
+/* A pseudo random number, the same sequence on every run */
+static unsigned int nextRandom(unsigned int* state) {
+    *state = *state * 1103515245u + 12345u;
+    return *state >> 8;
+}
+
+/* Fills keys with 0 .. size - 1 in a pseudo random order */
+static void shuffleKeys(int* keys, int size, unsigned int seed) {
+    for (int i = 0; i < size; i++) {
+        keys[i] = i;
+    }
+    for (int i = size - 1; i > 0; i--) {
+        int j = (int)(nextRandom(&seed) % (unsigned int)(i + 1));
+        int key = keys[i];
+        keys[i] = keys[j];
+        keys[j] = key;
+    }
+}
+
+/* Checks that a map holds exactly the keys k < size with present[k], in order and with their data */
+static bool mapHoldsKeys(Map map, const bool* present, int size) {
+    MapCursor cursor = mapCursorCreate(map);
+    if (!cursor) {
+        return false;
+    }
+    int count = 0;
+    int previous = -1;
+    bool valid = true;
+    while (valid && mapCursorNext(cursor)) {
+        int key = *(int*)mapCursorGetKey(cursor);
+        valid = key > previous && key < size && present[key] && *(int*)mapCursorGetData(cursor) == 3 * key;
+        previous = key;
+        count++;
+    }
+    mapCursorDestroy(cursor);
+    for (int key = 0; valid && key < size; key++) {
+        int* data = mapGet(map, &key);
+        valid = present[key] ? data && *data == 3 * key : !data && !mapContains(map, &key);
+    }
+    return valid && count == mapGetSize(map);
+}
+
+bool testBPTreeLeafSplit() {
+    bool* present = calloc(TEST_KEYS, sizeof(*present));
+    int* keys = malloc(TEST_KEYS * sizeof(*keys));
+    ASSERT_TEST(present && keys);
+    //ascending keys split the last leaf, descending ones the first, shuffled ones any
+    for (int order = 0; order < 3; order++) {
+        Map map = createIntMap(MAP_ENGINE_BPTREE, NULL);
+        ASSERT_TEST(map != NULL);
+        shuffleKeys(keys, TEST_KEYS, 7);
+        for (int i = 0; i < TEST_KEYS; i++) {
+            int key = order == 0 ? i : order == 1 ? TEST_KEYS - 1 - i : keys[i];
+            ASSERT_TEST(putKey(map, key));
+            present[key] = true;
+            if (i % 97 == 0) {
+                ASSERT_TEST(mapHoldsKeys(map, present, TEST_KEYS));
+            }
+        }
+        ASSERT_TEST(mapHoldsKeys(map, present, TEST_KEYS));
+        //putting a present key replaces its data without splitting
+        int key = TEST_KEYS / 2;
+        int data = 0;
+        ASSERT_TEST(mapPut(map, &key, &data) == MAP_SUCCESS && mapGetSize(map) == TEST_KEYS);
+        ASSERT_TEST(putKey(map, key) && mapHoldsKeys(map, present, TEST_KEYS));
+        mapDestroy(map);
+        for (int i = 0; i < TEST_KEYS; i++) {
+            present[i] = false;
+        }
+    }
+    free(keys);
+    free(present);
+    return true;
+}
+
+bool testBPTreeLeafMerge() {
+    bool* present = calloc(TEST_KEYS, sizeof(*present));
+    int* keys = malloc(TEST_KEYS * sizeof(*keys));
+    ASSERT_TEST(present && keys);
+    Map map = createIntMap(MAP_ENGINE_BPTREE, NULL);
+    ASSERT_TEST(map != NULL);
+    for (int key = 0; key < TEST_KEYS; key++) {
+        ASSERT_TEST(putKey(map, key));
+        present[key] = true;
+    }
+    //removing in a shuffled order underflows leaves, which borrow from a sibling or merge with it
+    shuffleKeys(keys, TEST_KEYS, 11);
+    for (int i = 0; i < TEST_KEYS / 2; i++) {
+        ASSERT_TEST(mapRemove(map, &keys[i]) == MAP_SUCCESS);
+        ASSERT_TEST(mapRemove(map, &keys[i]) == MAP_ITEM_DOES_NOT_EXIST);
+        present[keys[i]] = false;
+        if (i % 97 == 0) {
+            ASSERT_TEST(mapHoldsKeys(map, present, TEST_KEYS));
+        }
+    }
+    ASSERT_TEST(mapHoldsKeys(map, present, TEST_KEYS));
+    //a cursor removing a whole range merges the leaves under it as it goes
+    int from = TEST_KEYS / 4;
+    int to = 3 * TEST_KEYS / 4;
+    MapCursor cursor = mapCursorCreateRange(map, &from, &to);
+    ASSERT_TEST(cursor != NULL);
+    while (mapCursorNext(cursor)) {
+        present[*(int*)mapCursorGetKey(cursor)] = false;
+        ASSERT_TEST(mapCursorRemove(cursor) == MAP_SUCCESS);
+    }
+    mapCursorDestroy(cursor);
+    ASSERT_TEST(mapHoldsKeys(map, present, TEST_KEYS));
+    //the tree empties down to its root, and grows again
+    for (int i = TEST_KEYS / 2; i < TEST_KEYS; i++) {
+        if (present[keys[i]]) {
+            ASSERT_TEST(mapRemove(map, &keys[i]) == MAP_SUCCESS);
+            present[keys[i]] = false;
+        }
+    }
+    ASSERT_TEST(mapGetSize(map) == 0 && mapHoldsKeys(map, present, TEST_KEYS));
+    for (int key = 0; key < TEST_KEYS; key += 2) {
+        ASSERT_TEST(putKey(map, key));
+        present[key] = true;
+    }
+    ASSERT_TEST(mapHoldsKeys(map, present, TEST_KEYS));
+    mapDestroy(map);
+    free(keys);
+    free(present);
+    return true;
+}
+
+bool testSnapshotUnchangedByWrites() {
+    bool* present = calloc(TEST_KEYS, sizeof(*present));
+    bool* snapshot_present = calloc(TEST_KEYS, sizeof(*snapshot_present));
+    ASSERT_TEST(present && snapshot_present);
+    Map map = createIntMap(MAP_ENGINE_TREE, hashInt);
+    ASSERT_TEST(map != NULL);
+    for (int key = 0; key < TEST_KEYS; key += 2) {
+        ASSERT_TEST(putKey(map, key));
+        present[key] = snapshot_present[key] = true;
+    }
+    Map snapshot = mapSnapshot(map);
+    ASSERT_TEST(snapshot != NULL && mapHoldsKeys(snapshot, snapshot_present, TEST_KEYS));
+    //adding, removing and replacing the data of keys of the map copies the nodes it goes through
+    for (int key = 1; key < TEST_KEYS; key += 4) {
+        ASSERT_TEST(putKey(map, key));
+        present[key] = true;
+    }
+    for (int key = 0; key < TEST_KEYS; key += 6) {
+        ASSERT_TEST(mapRemove(map, &key) == MAP_SUCCESS);
+        present[key] = false;
+    }
+    int key = 4;
+    int data = -1;
+    ASSERT_TEST(mapPut(map, &key, &data) == MAP_SUCCESS && *(int*)mapGet(map, &key) == -1);
+    ASSERT_TEST(mapHoldsKeys(snapshot, snapshot_present, TEST_KEYS));
+    ASSERT_TEST(putKey(map, key) && mapHoldsKeys(map, present, TEST_KEYS));
+    //data written in place is copied first, when taken by mapGetMutable or mapGetOrInsert
+    Map before = mapSnapshot(map);
+    ASSERT_TEST(before != NULL);
+    for (key = 2; key < TEST_KEYS; key += 2) {
+        if (key % 6 == 0) {
+            continue;//removed from the map
+        }
+        bool inserted = false;
+        int* mutable_data = key % 6 == 2 ? mapGetMutable(map, &key) : mapGetOrInsert(map, &key, &data, &inserted);
+        ASSERT_TEST(mutable_data != NULL && *mutable_data == 3 * key && !inserted);
+        *mutable_data = -1;
+    }
+    for (key = 2; key < TEST_KEYS; key += 2) {
+        ASSERT_TEST(key % 6 == 0 || *(int*)mapGet(map, &key) == -1);
+    }
+    ASSERT_TEST(mapHoldsKeys(before, present, TEST_KEYS));
+    //and by mapMergeWith, which gives the map back the snapshot's data
+    ASSERT_TEST(mapMergeWith(map, before, copyOtherData, NULL) == MAP_SUCCESS);
+    ASSERT_TEST(mapHoldsKeys(map, present, TEST_KEYS) && mapHoldsKeys(before, present, TEST_KEYS));
+    mapDestroy(before);
+    //and the other way around, through a snapshot of the snapshot
+    Map second = mapSnapshot(snapshot);
+    ASSERT_TEST(second != NULL);
+    ASSERT_TEST(mapClear(snapshot) == MAP_SUCCESS && mapGetSize(snapshot) == 0);
+    ASSERT_TEST(mapHoldsKeys(second, snapshot_present, TEST_KEYS));
+    ASSERT_TEST(mapHoldsKeys(map, present, TEST_KEYS));
+    mapDestroy(map);
+    ASSERT_TEST(mapHoldsKeys(second, snapshot_present, TEST_KEYS));
+    mapDestroy(second);
+    mapDestroy(snapshot);
+    free(snapshot_present);
+    free(present);
+    return true;
+}
+
+bool testAdaptivePromotion() {
+    int keys[2 * ADAPTIVE_ARRAY_KEYS];
+    bool present[2 * ADAPTIVE_ARRAY_KEYS] = {false};
+    //with and without a hash index, which a promoted map builds on its first lookup
+    for (int hashed = 0; hashed < 2; hashed++) {
+        Map map = createIntMap(MAP_ENGINE_ADAPTIVE, hashed ? hashInt : NULL);
+        ASSERT_TEST(map != NULL);
+        shuffleKeys(keys, 2 * ADAPTIVE_ARRAY_KEYS, 3 + hashed);
+        for (int i = 0; i < 2 * ADAPTIVE_ARRAY_KEYS; i++) {
+            ASSERT_TEST(putKey(map, keys[i]));
+            present[keys[i]] = true;
+            ASSERT_TEST(mapHoldsKeys(map, present, 2 * ADAPTIVE_ARRAY_KEYS));
+        }
+        //the internal iterator goes on from the array to the tree
+        int expected = 0;
+        MAP_FOREACH(int*, key, map) {
+            ASSERT_TEST_WITH_FREE(*key == expected, free(key));
+            expected++;
+            free(key);
+        }
+        ASSERT_TEST(expected == 2 * ADAPTIVE_ARRAY_KEYS);
+        //a promoted map stays a tree when it shrinks back under the array's size
+        for (int i = 0; i < 2 * ADAPTIVE_ARRAY_KEYS - 1; i++) {
+            ASSERT_TEST(mapRemove(map, &keys[i]) == MAP_SUCCESS);
+            present[keys[i]] = false;
+            ASSERT_TEST(mapHoldsKeys(map, present, 2 * ADAPTIVE_ARRAY_KEYS));
+        }
+        Map copy = mapCopy(map);
+        ASSERT_TEST(copy != NULL && mapHoldsKeys(copy, present, 2 * ADAPTIVE_ARRAY_KEYS));
+        mapDestroy(copy);
+        mapDestroy(map);
+        present[keys[2 * ADAPTIVE_ARRAY_KEYS - 1]] = false;
+    }
+    //a map reserved past the array is promoted at once
+    Map map = createIntMap(MAP_ENGINE_ADAPTIVE, hashInt);
+    ASSERT_TEST(map != NULL && mapReserve(map, ADAPTIVE_ARRAY_KEYS + 1) == MAP_SUCCESS);
+    for (int key = 0; key < 2 * ADAPTIVE_ARRAY_KEYS; key += 2) {
+        ASSERT_TEST(putKey(map, key));
+        present[key] = true;
+    }
+    ASSERT_TEST(mapHoldsKeys(map, present, 2 * ADAPTIVE_ARRAY_KEYS));
+    mapDestroy(map);
+    return true;
+}
+
+/* Gives key the data 3 * key, hinting that it follows the last key put */
+static bool putKeyHint(Map map, int key) {
+    int data = 3 * key;
+    return mapPutHint(map, &key, &data) == MAP_SUCCESS;
+}
+
+bool testPutHintAscending() {
+    bool* present = calloc(TEST_KEYS, sizeof(*present));
+    ASSERT_TEST(present != NULL);
+    MapEngine engines[] = { MAP_ENGINE_LIST, MAP_ENGINE_TREE, MAP_ENGINE_BPTREE, MAP_ENGINE_ADAPTIVE };
+    for (int i = 0; i < (int)(sizeof(engines) / sizeof(*engines)); i++) {
+        Map map = createIntMap(engines[i], hashInt);
+        ASSERT_TEST(map != NULL);
+        //ascending keys, appended past the array of an adaptive map and over B+tree leaf splits
+        for (int key = 0; key < TEST_KEYS; key += 2) {
+            ASSERT_TEST(putKeyHint(map, key));
+            present[key] = true;
+        }
+        ASSERT_TEST(mapHoldsKeys(map, present, TEST_KEYS));
+        //keys before the last one, for which the hint is wrong, and keys already in the map
+        for (int key = TEST_KEYS - 1; key >= 0; key -= 3) {
+            ASSERT_TEST(putKeyHint(map, key));
+            present[key] = true;
+        }
+        ASSERT_TEST(mapHoldsKeys(map, present, TEST_KEYS));
+        mapDestroy(map);
+        memset(present, 0, TEST_KEYS * sizeof(*present));
+    }
+    free(present);
+    return true;
+}
+
+static MapKeyElement copyUint64(MapKeyElement key) {
+    uint64_t* copy = malloc(sizeof(*copy));
+    if (copy) {
+        *copy = *(uint64_t*)key;
+    }
+    return copy;
+}
+
+/* A key of the uint64_t tests, using the high half so that it doesn't fit in 32 bits */
+static uint64_t uint64TestKey(int i) {
+    return ((uint64_t)(i % 7 + 1) << 32) | (uint64_t)(i * 11 % TEST_KEYS);
+}
+
+/* Serializes a map into a new buffer, storing its length */
+static unsigned char* serializeMap(Map map, size_t* length) {
+    if (mapSerialize(map, NULL, 0, length) != MAP_SUCCESS) {
+        return NULL;
+    }
+    unsigned char* buffer = malloc(*length);
+    size_t written = 0;
+    if (buffer && (mapSerialize(map, buffer, *length, &written) != MAP_SUCCESS || written != *length)) {
+        free(buffer);
+        return NULL;
+    }
+    return buffer;
+}
+
+bool testSerializeRoundTrip() {
+    bool* present = calloc(TEST_KEYS, sizeof(*present));
+    ASSERT_TEST(present != NULL);
+    MapEngine engines[] = { MAP_ENGINE_LIST, MAP_ENGINE_TREE, MAP_ENGINE_BPTREE, MAP_ENGINE_ADAPTIVE };
+    for (int i = 0; i < (int)(sizeof(engines) / sizeof(*engines)); i++) {
+        //an empty map, one small enough for an adaptive map's array and a large one
+        int sizes[] = { 0, ADAPTIVE_ARRAY_KEYS / 2, TEST_KEYS };
+        for (int j = 0; j < (int)(sizeof(sizes) / sizeof(*sizes)); j++) {
+            Map map = createIntMap(engines[i], hashInt);
+            ASSERT_TEST(map != NULL);
+            for (int key = 0; key < TEST_KEYS; key++) {
+                present[key] = key % 3 != 0 && key / 3 * 2 < sizes[j];
+                if (present[key]) {
+                    ASSERT_TEST(putKey(map, key));
+                }
+            }
+            size_t length = 0;
+            unsigned char* buffer = serializeMap(map, &length);
+            ASSERT_TEST(buffer != NULL);
+            //the buffer may go on past the encoding
+            Map loaded = createIntMap(engines[i], hashInt);
+            size_t read = 0;
+            ASSERT_TEST(loaded && mapDeserialize(loaded, buffer, length, &read) == MAP_SUCCESS && read == length);
+            ASSERT_TEST(mapHoldsKeys(loaded, present, TEST_KEYS));
+            size_t loaded_length = 0;
+            unsigned char* loaded_buffer = serializeMap(loaded, &loaded_length);
+            ASSERT_TEST(loaded_buffer && loaded_length == length && memcmp(buffer, loaded_buffer, length) == 0);
+            free(loaded_buffer);
+            //a map that is not empty is not filled
+            ASSERT_TEST(mapGetSize(loaded) == 0 ||
+                        mapDeserialize(loaded, buffer, length, NULL) == MAP_ERROR);
+            ASSERT_TEST(mapHoldsKeys(loaded, present, TEST_KEYS));
+            mapDestroy(loaded);
+            //nor is one from a cut encoding, which leaves it empty
+            Map cut = createIntMap(engines[i], hashInt);
+            ASSERT_TEST(cut && mapDeserialize(cut, buffer, length - 1, NULL) == MAP_ERROR && mapGetSize(cut) == 0);
+            mapDestroy(cut);
+            //and through a file, a record at a time
+            FILE* file = tmpfile();
+            ASSERT_TEST(file && mapSerializeToFile(map, file) == MAP_SUCCESS);
+            rewind(file);
+            loaded = createIntMap(engines[i], hashInt);
+            ASSERT_TEST(loaded && mapDeserializeFromFile(loaded, file) == MAP_SUCCESS);
+            fclose(file);
+            ASSERT_TEST(mapHoldsKeys(loaded, present, TEST_KEYS));
+            mapDestroy(loaded);
+            free(buffer);
+            mapDestroy(map);
+        }
+    }
+    free(present);
+    return true;
+}
+
+bool testUint64Keys() {
+    MapOptions options = {0};
+    options.engine = MAP_ENGINE_BPTREE;
+    options.keyType = MAP_KEY_UINT64;
+    options.dataSize = sizeof(int);
+    Map map = mapCreateWithOptions(NULL, copyUint64, NULL, freeInt, NULL, &options);
+    ASSERT_TEST(map != NULL);
+    for (int i = 0; i < TEST_KEYS; i++) {
+        uint64_t key = uint64TestKey(i);
+        ASSERT_TEST(mapPut(map, &key, &i) == MAP_SUCCESS);
+    }
+    ASSERT_TEST(mapGetSize(map) == TEST_KEYS);
+    size_t length = 0;
+    unsigned char* buffer = serializeMap(map, &length);
+    Map loaded = mapCreateWithOptions(NULL, copyUint64, NULL, freeInt, NULL, &options);
+    ASSERT_TEST(buffer && loaded && mapDeserialize(loaded, buffer, length, NULL) == MAP_SUCCESS);
+    free(buffer);
+    //the keys come back in order with their data, from both maps
+    Map maps[] = { map, loaded };
+    for (int j = 0; j < 2; j++) {
+        for (int i = 0; i < TEST_KEYS; i++) {
+            uint64_t key = uint64TestKey(i);
+            int* data = mapGet(maps[j], &key);
+            ASSERT_TEST(data && *data == i);
+        }
+        MapCursor cursor = mapCursorCreate(maps[j]);
+        ASSERT_TEST(cursor != NULL);
+        uint64_t previous = 0;
+        int count = 0;
+        while (mapCursorNext(cursor)) {
+            uint64_t key = *(uint64_t*)mapCursorGetKey(cursor);
+            ASSERT_TEST_WITH_FREE(key > previous, mapCursorDestroy(cursor));
+            previous = key;
+            count++;
+        }
+        mapCursorDestroy(cursor);
+        ASSERT_TEST(count == TEST_KEYS);
+        uint64_t* first = mapGetFirst(maps[j]);
+        ASSERT_TEST(first && *first == ((uint64_t)1 << 32));
+        free(first);
+    }
+    mapDestroy(loaded);
+    mapDestroy(map);
+    return true;
+}
+
+bool testSerializeWithCodec() {
+    MapOptions options = {0};
+    options.engine = MAP_ENGINE_TREE;
+    options.dataSize = sizeof(int);
+    options.encodeKeyElement = encodeString;
+    options.decodeKeyElement = decodeString;
+    Map map = mapCreateWithOptions(NULL, copyString, NULL, freeInt, compareStrings, &options);
+    ASSERT_TEST(map != NULL);
+    const char* names[] = { "London", "", "Paris", "Tel Aviv", "Haifa" };
+    for (int i = 0; i < (int)(sizeof(names) / sizeof(*names)); i++) {
+        ASSERT_TEST(mapPut(map, (MapKeyElement)names[i], &i) == MAP_SUCCESS);
+    }
+    size_t length = 0;
+    unsigned char* buffer = serializeMap(map, &length);
+    ASSERT_TEST(buffer != NULL);
+    Map loaded = mapCreateWithOptions(NULL, copyString, NULL, freeInt, compareStrings, &options);
+    ASSERT_TEST(loaded && mapDeserialize(loaded, buffer, length, NULL) == MAP_SUCCESS);
+    ASSERT_TEST(mapGetSize(loaded) == mapGetSize(map));
+    for (int i = 0; i < (int)(sizeof(names) / sizeof(*names)); i++) {
+        int* data = mapGet(loaded, (MapKeyElement)names[i]);
+        ASSERT_TEST(data && *data == i);
+    }
+    //a map without the codec can neither write nor read the encoding
+    options.encodeKeyElement = NULL;
+    options.decodeKeyElement = NULL;
+    Map plain = mapCreateWithOptions(NULL, copyString, NULL, freeInt, compareStrings, &options);
+    ASSERT_TEST(plain && mapSerialize(plain, NULL, 0, &length) == MAP_ERROR);
+    ASSERT_TEST(mapDeserialize(plain, buffer, length, NULL) == MAP_ERROR && mapGetSize(plain) == 0);
+    mapDestroy(plain);
+    mapDestroy(loaded);
+    mapDestroy(map);
+    free(buffer);
+    return true;
+}
+
+/* Pairs of the players 1 .. PAIRS_TEST_PLAYERS a test played, as a pairing index should record them */
+typedef struct {
+    bool played[PAIRS_TEST_PLAYERS + 1][PAIRS_TEST_PLAYERS + 1];
+    int games[PAIRS_TEST_PLAYERS + 1];
+    int num_of_games;
+} PlayedPairs;
+
+/* The number of players with games */
+static int countPlayers(const PlayedPairs* played) {
+    int players = 0;
+    for (int player = 1; player <= PAIRS_TEST_PLAYERS; player++) {
+        players += played->games[player] > 0;
+    }
+    return players;
+}
+
+/* The pairs of the players with games */
+static int allPairs(const PlayedPairs* played) {
+    int players = countPlayers(played);
+    return players * (players - 1) / 2;
+}
+
+/* Tells whether an index should switch, by the thresholds of pairsShouldSwitch */
+static bool pairsExpectSwitch(GamePairs pairs, const PlayedPairs* played) {
+    if (pairsIsDense(pairs)) {
+        return played->num_of_games * 16 < allPairs(played);
+    }
+    return countPlayers(played) >= PAIRS_DENSE_PLAYERS && played->num_of_games * 4 >= allPairs(played);
+}
+
+/* Switches an index as a game map does, once pairsShouldSwitch tells so */
+static bool pairsSwitch(GamePairs pairs, const PlayedPairs* played) {
+    if (pairsIsDense(pairs)) {
+        pairsMakeSparse(pairs);
+        return !pairsIsDense(pairs);
+    }
+    if (!pairsMakeDense(pairs)) {
+        return false;
+    }
+    for (int player1 = 1; player1 <= PAIRS_TEST_PLAYERS; player1++) {
+        for (int player2 = player1 + 1; player2 <= PAIRS_TEST_PLAYERS; player2++) {
+            if (played->played[player1][player2]) {
+                pairsSetPlayed(pairs, player1, player2);
+            }
+        }
+    }
+    return pairsIsDense(pairs);
+}
+
+/* Tells whether an index keeps the opponents of a player, in ascending order of id */
+static bool pairsOpponentsMatch(GamePairs pairs, const PlayedPairs* played, int player) {
+    int count = 0;
+    const PlayerId* opponents = pairsGetOpponents(pairs, player, &count);
+    int position = 0;
+    for (int opponent = 1; opponent <= PAIRS_TEST_PLAYERS; opponent++) {
+        if (opponent != player && played->played[player][opponent]) {
+            if (position >= count || opponents[position] != opponent) {
+                return false;
+            }
+            position++;
+        }
+    }
+    return position == count;
+}
+
+/* Records or forgets a game in an index and in played, switching the index when it should */
+static bool pairsPlay(GamePairs pairs, PlayedPairs* played, int player1, int player2, bool add) {
+    if (add && !pairsAdd(pairs, player1, player2)) {
+        return false;
+    }
+    if (!add) {
+        pairsRemove(pairs, player1, player2);
+    }
+    played->played[player1][player2] = played->played[player2][player1] = add;
+    played->games[player1] += add ? 1 : -1;
+    played->games[player2] += add ? 1 : -1;
+    played->num_of_games += add ? 1 : -1;
+    bool should_switch = pairsExpectSwitch(pairs, played);
+    if (pairsShouldSwitch(pairs) != should_switch || (should_switch && !pairsSwitch(pairs, played))) {
+        return false;
+    }
+    //a dense index tells every pair apart, and both keep the opponents of every player
+    for (int player1 = 1; player1 <= PAIRS_TEST_PLAYERS; player1++) {
+        if (pairsGetNumOfGames(pairs, player1) != played->games[player1] ||
+            !pairsOpponentsMatch(pairs, played, player1)) {
+            return false;
+        }
+        for (int player2 = 1; pairsIsDense(pairs) && player2 <= PAIRS_TEST_PLAYERS; player2++) {
+            if (player1 != player2 && pairsContains(pairs, player1, player2) != played->played[player1][player2]) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool testPairsDenseThreshold() {
+    MapAllocator allocator = { mallocAllocate, mallocDeallocate, NULL };
+    GamePairs pairs = pairsCreate(&allocator);
+    PlayedPairs played = {{{false}}};
+    ASSERT_TEST(pairs != NULL);
+    //the players of a tournament one player smaller than the floor all play each other: it stays sparse
+    for (int player1 = 1; player1 < PAIRS_DENSE_PLAYERS; player1++) {
+        for (int player2 = player1 + 1; player2 < PAIRS_DENSE_PLAYERS; player2++) {
+            ASSERT_TEST(pairsPlay(pairs, &played, player1, player2, true));
+            ASSERT_TEST(!pairsIsDense(pairs));
+        }
+    }
+    //one more player reaches the floor, and makes the index dense right away
+    ASSERT_TEST(pairsPlay(pairs, &played, 1, PAIRS_DENSE_PLAYERS, true) && pairsIsDense(pairs));
+    pairsClear(pairs);
+    ASSERT_TEST(!pairsIsDense(pairs) && pairsGetNumOfGames(pairs, 1) == 0);
+
+    //all the players play in a path, then more games until a quarter of their pairs
+    PlayedPairs path = {{{false}}};
+    for (int player = 1; player < PAIRS_TEST_PLAYERS; player++) {
+        ASSERT_TEST(pairsPlay(pairs, &path, player, player + 1, true) && !pairsIsDense(pairs));
+    }
+    int all_pairs = allPairs(&path);
+    for (int player1 = 1; !pairsIsDense(pairs); player1++) {
+        for (int player2 = player1 + 2; player2 <= PAIRS_TEST_PLAYERS && !pairsIsDense(pairs); player2++) {
+            ASSERT_TEST(pairsPlay(pairs, &path, player1, player2, true));
+        }
+    }
+    ASSERT_TEST(path.num_of_games == (all_pairs + 3) / 4);
+    pairsDestroy(pairs);
+    return true;
+}
+
+bool testPairsSparseThreshold() {
+    MapAllocator allocator = { mallocAllocate, mallocDeallocate, NULL };
+    GamePairs pairs = pairsCreate(&allocator);
+    PlayedPairs played = {{{false}}};
+    ASSERT_TEST(pairs != NULL);
+    for (int player1 = 1; player1 <= PAIRS_TEST_PLAYERS; player1++) {
+        for (int player2 = player1 + 1; player2 <= PAIRS_TEST_PLAYERS; player2++) {
+            ASSERT_TEST(pairsPlay(pairs, &played, player1, player2, true));
+        }
+    }
+    ASSERT_TEST(pairsIsDense(pairs));
+    //the games are forgotten down to under a sixteenth of the pairs, every player keeping one
+    int all_pairs = allPairs(&played);
+    for (int player1 = 1; pairsIsDense(pairs); player1++) {
+        for (int player2 = player1 + 1; player2 <= PAIRS_TEST_PLAYERS && pairsIsDense(pairs); player2++) {
+            if (player1 % 2 == 0 || player2 != player1 + 1) {
+                ASSERT_TEST(pairsPlay(pairs, &played, player1, player2, false));
+            }
+        }
+    }
+    ASSERT_TEST(played.num_of_games == (all_pairs - 1) / 16 && allPairs(&played) == all_pairs);
+    //a copy goes back to dense at a quarter of them only, the index stays as it is
+    GamePairs copy = pairsCopy(pairs);
+    ASSERT_TEST(copy != NULL);
+    PlayedPairs copy_played = played;
+    for (int player1 = 1; !pairsIsDense(copy); player1++) {
+        for (int player2 = player1 + 1; player2 <= PAIRS_TEST_PLAYERS && !pairsIsDense(copy); player2++) {
+            if (!copy_played.played[player1][player2]) {
+                ASSERT_TEST(pairsPlay(copy, &copy_played, player1, player2, true));
+            }
+        }
+    }
+    ASSERT_TEST(copy_played.num_of_games == (all_pairs + 3) / 4);
+    ASSERT_TEST(!pairsIsDense(pairs) && pairsGetNumOfGames(pairs, 1) == played.games[1]);
+    pairsDestroy(copy);
+    pairsDestroy(pairs);
+    return true;
+}
+
+
+/*The functions for the tests should be added here*/
+bool (*tests[]) (void) = {
+        testBPTreeLeafSplit,
+        testBPTreeLeafMerge,
+        testSnapshotUnchangedByWrites,
+        testAdaptivePromotion,
+        testPutHintAscending,
+        testSerializeRoundTrip,
+        testUint64Keys,
+        testSerializeWithCodec,
+        testPairsDenseThreshold,
+        testPairsSparseThreshold
+};
+
+/*The names of the test functions should be added here*/
+const char* testNames[] = {
+        "testBPTreeLeafSplit",
+        "testBPTreeLeafMerge",
+        "testSnapshotUnchangedByWrites",
+        "testAdaptivePromotion",
+        "testPutHintAscending",
+        "testSerializeRoundTrip",
+        "testUint64Keys",
+        "testSerializeWithCodec",
+        "testPairsDenseThreshold",
+        "testPairsSparseThreshold"
+};
+
+
+int main(int argc, char *argv[]) {
+    if (argc == 1) {
+        for (int test_idx = 0; test_idx < NUMBER_TESTS; test_idx++) {
+            RUN_TEST(tests[test_idx], testNames[test_idx]);
+        }
+        return 0;
+    }
+    if (argc != 2) {
+        fprintf(stdout, "Usage: mapTests <test index>\n");
+        return 0;
+    }
+
+    int test_idx = strtol(argv[1], NULL, 10);
+    if (test_idx < 1 || test_idx > NUMBER_TESTS) {
+        fprintf(stderr, "Invalid test index %d\n", test_idx);
+        return 0;
+    }
+
+    RUN_TEST(tests[test_idx - 1], testNames[test_idx - 1]);
+    return 0;
+}
@@ -4,6 +4,7 @@
 #include <stdbool.h>
 #include <string.h>
 #include <stdio.h>
+#include <limits.h>
 
 typedef TournamentId* TournamentKey;
 
@@ -11,13 +12,32 @@ struct tournament_data {
     Location location;
     int max_games_per_player;
     bool has_ended;
-    Map game_map;
+    GameMap game_map;
     Map player_map;
     PlayerId winner_id;
     int num_of_games;
-    int total_game_time;
-    int longest_game_time;
+    long long total_game_time; // wide enough for INT_MAX long games
+    int longest_game_time; // -1 while unknown, after the longest game was corrected or removed
     int num_of_players;
+    MapAllocator allocator; // the tournament map's, the data and its maps take their memory from it
+};
+
+/* The numbers of a tournament data, written first by encodeTournamentData */
+#define TOURNAMENT_ENCODED_NUMBERS 7
+
+/* The player maps updated for every game of a removed player, see opponentQuit */
+struct opponent_quit_context_t {
+    Map player_map;
+    Map player_statistics_map;
+};
+
+/* The players of a decoded tournament checked against its games, see playerMatchesGames */
+struct players_games_context_t {
+    GameMap game_map;
+    Map player_map;
+    int max_games;
+    long long games; // the games of the players in the game map, each game counted by both
+    bool valid;
 };
 
 /********************* Tournament functions *********************/
@@ -26,9 +46,20 @@ static void freeTournamentKey(MapKeyElement key);
 static MapDataElement copyTournamentData(MapDataElement data);
 static MapKeyElement copyTournamentKey(MapKeyElement key);
 static int compareTournamentKey(MapKeyElement key1, MapKeyElement key2);
+static unsigned int hashTournamentKey(MapKeyElement key);
+static size_t encodeTournamentData(MapDataElement data, unsigned char* buffer, size_t size);
+static MapDataElement decodeTournamentData(const unsigned char* buffer, size_t size,
+                                           const MapAllocator* allocator);
+static void addMapStats(MapStats* total, const MapStats* stats);
 
-static TournamentKey createTournamentKey();
-static TournamentData createTournamentData(const char* location, int max_games_per_player);
+static TournamentData createTournamentData(const char* location, int max_games_per_player,
+                                           const MapAllocator* allocator, int expected_games,
+                                           int expected_players);
+static void opponentQuit(PlayerId second_player, Winner winner, int play_time, void* context);
+static int tournamentLongestGameTime(TournamentData tournament_data);
+static bool tournamentNumbersAreValid(const long long* numbers, const char* location);
+static void playerMatchesGames(PlayerId player_id, PlayerData player_data, void* context);
+static bool tournamentPlayersMatchGames(TournamentData tournament_data);
 
 
 
@@ -48,7 +79,8 @@ static MapDataElement copyTournamentData(MapDataElement data) {
         return NULL;
     }
     TournamentData data_copy = createTournamentData(((TournamentData)data)->location,
-                                          ((TournamentData)data)->max_games_per_player);
+                                          ((TournamentData)data)->max_games_per_player,
+                                          &((TournamentData)data)->allocator, 0, 0);
     if (!data_copy) {
         return NULL;
     }
@@ -115,10 +147,11 @@ static void freeTournamentData(MapDataElement data) {
         return;
     }
     TournamentData new_data = (TournamentData)data;
+    MapAllocator allocator = new_data->allocator;
     gameDestroyMap(new_data->game_map);
     playerDestroyMap(new_data->player_map);
-    free(new_data->location);
-    free(data);
+    allocator.deallocate(allocator.context, new_data->location, strlen(new_data->location) + 1);
+    allocator.deallocate(allocator.context, new_data, sizeof(*new_data));
 }
 /**
 * freeTournamentKey: Deallocates an existing key. Clears all elements by using the
@@ -148,6 +181,108 @@ static int compareTournamentKey(MapKeyElement key1, MapKeyElement key2) {
     assert(key1 && key2);
     return (*(TournamentKey)key1 - *(TournamentKey)key2);
 }
+/**
+* hashTournamentKey: hashes a key for the map's hash index.
+*
+*@param key - the key to hash.
+*
+* @return-
+* 		the tournament id itself, the map mixes it.
+*/
+static unsigned int hashTournamentKey(MapKeyElement key) {
+    assert(key);
+    return (unsigned int)*(TournamentKey)key;
+}
+/**
+* encodeTournamentData: encodes a tournament data for mapSerialize: its numbers, its location
+* with the terminating null character, then its game map and its player map as mapSerialize
+* writes them.
+*
+* @param data - the data to encode.
+* @param buffer - where to write the encoding, if it fits.
+* @param size - the size of buffer.
+*
+* @return-
+* 		the length of the encoding.
+*/
+static size_t encodeTournamentData(MapDataElement data, unsigned char* buffer, size_t size) {
+    TournamentData tournament_data = data;
+    long long numbers[TOURNAMENT_ENCODED_NUMBERS] = {
+        tournament_data->max_games_per_player, tournament_data->has_ended, tournament_data->winner_id,
+        tournament_data->num_of_games, tournament_data->total_game_time,
+        tournamentLongestGameTime(tournament_data), tournament_data->num_of_players
+    };
+    size_t location_size = strlen(tournament_data->location) + 1;
+    size_t length = sizeof(numbers) + location_size;
+    if (length <= size) {
+        memcpy(buffer, numbers, sizeof(numbers));
+        memcpy(buffer + sizeof(numbers), tournament_data->location, location_size);
+    }
+    for (int i = 0; i < 2; i++) {
+        size_t map_length = 0;
+        bool fits = length < size;
+        unsigned char* map_buffer = fits ? buffer + length : NULL;
+        size_t map_size = fits ? size - length : 0;
+        MapResult result = i == 0 ?
+                gameMapSerialize(tournament_data->game_map, map_buffer, map_size, &map_length) :
+                mapSerialize(tournament_data->player_map, map_buffer, map_size, &map_length);
+        assert(result == MAP_SUCCESS);//plain maps never fail
+        (void)result;
+        length += map_length;
+    }
+    return length;
+}
+/**
+* decodeTournamentData: makes a tournament data out of an encoding by encodeTournamentData.
+*
+* @param buffer - the encoding.
+* @param size - its length.
+* @param allocator - the allocator of the tournament map being filled.
+*
+* @return-
+* 		NULL if the encoding is not valid or an allocation failed, the new data otherwise.
+*/
+static MapDataElement decodeTournamentData(const unsigned char* buffer, size_t size,
+                                           const MapAllocator* allocator) {
+    long long numbers[TOURNAMENT_ENCODED_NUMBERS];
+    if (size < sizeof(numbers)) {
+        return NULL;
+    }
+    memcpy(numbers, buffer, sizeof(numbers));
+    const char* location = (const char*)buffer + sizeof(numbers);
+    const char* location_end = memchr(location, '\0', size - sizeof(numbers));
+    if (!location_end || !tournamentNumbersAreValid(numbers, location)) {
+        return NULL;
+    }
+    TournamentData tournament_data = createTournamentData(location, (int)numbers[0], allocator, 0, 0);
+    if (!tournament_data) {
+        return NULL;
+    }
+    size_t position = (size_t)(location_end + 1 - (const char*)buffer);
+    for (int i = 0; i < 2; i++) {
+        size_t map_length = 0;
+        MapResult result = i == 0 ?
+                gameMapDeserialize(tournament_data->game_map, buffer + position, size - position, &map_length) :
+                mapDeserialize(tournament_data->player_map, buffer + position, size - position, &map_length);
+        if (result != MAP_SUCCESS) {
+            freeTournamentData(tournament_data);
+            return NULL;
+        }
+        position += map_length;
+    }
+    tournament_data->has_ended = numbers[1];
+    tournament_data->winner_id = (int)numbers[2];
+    tournament_data->num_of_games = (int)numbers[3];
+    tournament_data->total_game_time = numbers[4];
+    tournament_data->longest_game_time = (int)numbers[5];
+    tournament_data->num_of_players = (int)numbers[6];
+    if (playerMapValidate(tournament_data->player_map, false) != PLAYER_SUCCESS ||
+        !tournamentPlayersMatchGames(tournament_data)) {
+        freeTournamentData(tournament_data);
+        return NULL;
+    }
+    return tournament_data;
+}
 
 
 
@@ -159,40 +294,46 @@ static int compareTournamentKey(MapKeyElement key1, MapKeyElement key2) {
 *
 * @param const char* - the location to be set in the tournament
 * @param int - the max number of games allowed for each player in tournament
+* @param allocator - where the data, its location and its maps take their memory from
+* @param expected_games - the room made in the game map, 0 for none
+* @param expected_players - the room made in the player map, 0 for none
 *
 * @return
 * 	NULL - if allocations failed.
 * 	A new TournamentData in case of success.
 */
-static TournamentData createTournamentData(const char* location, int max_games_per_player){
-    assert(location);
+static TournamentData createTournamentData(const char* location, int max_games_per_player,
+                                           const MapAllocator* allocator, int expected_games,
+                                           int expected_players){
+    assert(location && allocator);
     
-    TournamentData tournament_data = malloc(sizeof(*tournament_data));
+    TournamentData tournament_data = allocator->allocate(allocator->context, sizeof(*tournament_data));
     if (!tournament_data) {
         return NULL;
     }
+    tournament_data->allocator = *allocator;
     
-    tournament_data->game_map = gameCreateMap();
+    tournament_data->game_map = gameCreateMapWithCapacity(allocator, expected_games);
     if (!tournament_data->game_map) {
-        free(tournament_data);
+        allocator->deallocate(allocator->context, tournament_data, sizeof(*tournament_data));
         return NULL;
     }
     
-    tournament_data->player_map = playerCreateMap();
+    tournament_data->player_map = playerCreateMapWithCapacity(allocator, expected_players);
     if (!tournament_data->player_map) {
         gameDestroyMap(tournament_data->game_map);
-        free(tournament_data);
+        allocator->deallocate(allocator->context, tournament_data, sizeof(*tournament_data));
         return NULL;
     }
     
-    tournament_data->location = malloc(strlen(location) + 1);
-    strcpy(tournament_data->location, location);
+    tournament_data->location = allocator->allocate(allocator->context, strlen(location) + 1);
     if (!tournament_data->location) {
         playerDestroyMap(tournament_data->player_map);
         gameDestroyMap(tournament_data->game_map);
-        free(tournament_data);
+        allocator->deallocate(allocator->context, tournament_data, sizeof(*tournament_data));
         return NULL;
     }
+    strcpy(tournament_data->location, location);
     
     tournament_data->winner_id = 0;
     tournament_data->max_games_per_player = max_games_per_player;
@@ -205,26 +346,113 @@ static TournamentData createTournamentData(const char* location, int max_games_p
     return tournament_data;
 }
 /**
-* createTournamentKey: Allocates a new key as tournament id.
+* opponentQuit: gives a player the win of a game whose opponent was removed from the tournament.
 *
-* @param TournamentId - the Tournament id to be set as the key of the tournament
+* @param second_player - the player who stays.
+* @param winner - the winner of the game, FIRST_PLAYER being the removed player.
+* @param play_time - the play time of the game, unused.
+* @param context - the opponent_quit_context_t holding the maps to update.
+*/
+static void opponentQuit(PlayerId second_player, Winner winner, int play_time, void* context) {
+    (void)play_time;
+    struct opponent_quit_context_t* maps = context;
+    if (winner == FIRST_PLAYER) {
+        updatePlayerDataAfterOpponentQuit(maps->player_map, second_player, PLAYER_LOST);
+        updatePlayerDataAfterOpponentQuit(maps->player_statistics_map, second_player, PLAYER_LOST);
+    }
+    else if (winner == DRAW) {
+        updatePlayerDataAfterOpponentQuit(maps->player_map, second_player, PLAYER_DRAW);
+        updatePlayerDataAfterOpponentQuit(maps->player_statistics_map, second_player, PLAYER_DRAW);
+    }
+}
+/**
+* tournamentNumbersAreValid: checks the numbers and the location of a decoded tournament.
 *
-* @return
-* 	NULL - if allocations failed.
-* 	A new TournamentKey in case of success.
+* @param numbers - the numbers, in the order encodeTournamentData writes them.
+* @param location - the location.
+*
+* @return-
+* 		false if the max games or the location are not valid, the ended flag is neither 0 nor 1,
+* 		the winner is negative or, for a tournament that didn't end, not 0, or a count or a time
+* 		is negative, or a number other than the total play time is not an int. true otherwise.
 */
-static TournamentKey createTournamentKey(TournamentId tournament_id) {
-    if (!(tournamentIdIsValid(tournament_id))) {
-        return NULL;
+static bool tournamentNumbersAreValid(const long long* numbers, const char* location) {
+    for (int i = 0; i < TOURNAMENT_ENCODED_NUMBERS; i++) {
+        //only the total play time, the fifth number, may not fit in an int
+        if (i != 4 && numbers[i] > INT_MAX) {
+            return false;
+        }
     }
-
-    TournamentKey key = malloc(sizeof(*key));
-    if (!key) {
-        return NULL;
+    if (numbers[0] <= 0 || !tournamentLocationIsValid(location) || (numbers[1] != 0 && numbers[1] != 1)) {
+        return false;
     }
-
-    *key = tournament_id;
-    return key;
+    //an ended tournament whose players were all removed has no winner, 0
+    if (numbers[2] < 0 || (!numbers[1] && numbers[2] != 0)) {
+        return false;
+    }
+    for (int i = 3; i < TOURNAMENT_ENCODED_NUMBERS; i++) {
+        if (numbers[i] < 0) {
+            return false;
+        }
+    }
+    return true;
+}
+/**
+* playerMatchesGames: the visit function of tournamentPlayersMatchGames, checks a player
+* of a decoded tournament against its games.
+*
+* @param player_id - the player.
+* @param player_data - its data, unused.
+* @param context - the players_games_context_t of the tournament.
+*/
+static void playerMatchesGames(PlayerId player_id, PlayerData player_data, void* context) {
+    (void)player_data;
+    struct players_games_context_t* players = context;
+    int games = gameGetNumOfGamesOfPlayer(players->game_map, player_id);
+    int player_games = playerGetNumOfGames(players->player_map, player_id);
+    //games of removed opponents stay counted by the player, who got their win
+    if (player_games < games || player_games > players->max_games) {
+        players->valid = false;
+    }
+    players->games += games;
+}
+/**
+* tournamentPlayersMatchGames: checks the players of a decoded tournament against its games:
+* every player of a game is a player of the tournament, with at least the games he has in the
+* game map and at most the games allowed. The players removed from the system are not players
+* of the tournaments that ended, whose games they keep.
+*
+* @param tournament_data - the tournament.
+*
+* @return-
+* 		false if a player doesn't match the games or an allocation failed, true otherwise.
+*/
+static bool tournamentPlayersMatchGames(TournamentData tournament_data) {
+    struct players_games_context_t players = {
+        tournament_data->game_map, tournament_data->player_map, tournament_data->max_games_per_player, 0, true
+    };
+    if (playerForEachInRange(tournament_data->player_map, 1, INT_MAX, playerMatchesGames, &players)
+        != PLAYER_SUCCESS) {
+        return false;
+    }
+    //the players found all the games if they counted each one twice
+    long long games = 2LL * gameGetNumOfGames(tournament_data->game_map);
+    return players.valid && (tournament_data->has_ended ? players.games <= games : players.games == games);
+}
+/**
+* tournamentLongestGameTime: returns the longest play time of a tournament's games, finding it
+* again among the games if it is unknown.
+*
+* @param tournament_data - the tournament.
+*
+* @return-
+* 		The longest play time.
+*/
+static int tournamentLongestGameTime(TournamentData tournament_data) {
+    if (tournament_data->longest_game_time < 0) {
+        tournament_data->longest_game_time = gameGetLongestPlayTime(tournament_data->game_map);
+    }
+    return tournament_data->longest_game_time;
 }
 
 
@@ -232,8 +460,22 @@ static TournamentKey createTournamentKey(TournamentId tournament_id) {
 /********************* Tournament functions *********************/
 
 Map tournamentCreate() {
-    return mapCreate(copyTournamentData, copyTournamentKey, freeTournamentData,
-                    freeTournamentKey, compareTournamentKey);
+    return tournamentCreateWithAllocator(NULL);
+}
+
+Map tournamentCreateWithAllocator(const MapAllocator* allocator) {
+    return tournamentCreateWithCapacity(allocator, 0);
+}
+
+Map tournamentCreateWithCapacity(const MapAllocator* allocator, int capacity) {
+    MapOptions options = {0};
+    options.capacity = capacity;
+    options.hashKeyElement = hashTournamentKey;
+    options.keyType = MAP_KEY_INT;
+    options.encodeDataElement = encodeTournamentData;
+    options.decodeDataElement = decodeTournamentData;
+    return mapCreateWithAllocator(copyTournamentData, copyTournamentKey, freeTournamentData,
+                                  freeTournamentKey, compareTournamentKey, &options, allocator);
 }
 
 void tournamentDestroy(Map tournament_map) {
@@ -281,6 +523,26 @@ TournamentData tournamentGet(Map tournament_map, TournamentId tournament_id) {
     return mapGet(tournament_map, &tournament_id);
 }
 
+bool tournamentDataEnded(TournamentData tournament_data) {
+    assert(tournament_data);
+    return tournament_data->has_ended;
+}
+
+int tournamentDataGetMaxGamesPerPlayer(TournamentData tournament_data) {
+    assert(tournament_data);
+    return tournament_data->max_games_per_player;
+}
+
+Map tournamentDataGetPlayerMap(TournamentData tournament_data) {
+    assert(tournament_data);
+    return tournament_data->player_map;
+}
+
+GameMap tournamentDataGetGameMap(TournamentData tournament_data) {
+    assert(tournament_data);
+    return tournament_data->game_map;
+}
+
 TournamentResult tournamentGetMaxGamesPerPlayer(Map tournament_map, TournamentId tournament_id, int* max_games) {
     if (!tournament_map) {
         return TOURNAMENT_NULL_ARGUMENT;
@@ -319,7 +581,7 @@ Map tournamentGetPlayerMap(Map tournament_map, TournamentId tournament_id) {
     
 }
 
-Map tournamentGetGameMap(Map tournament_map, TournamentId tournament_id) {
+GameMap tournamentGetGameMap(Map tournament_map, TournamentId tournament_id) {
     if (!tournament_map || (!tournamentIdIsValid(tournament_id))) {
         return NULL;//same as before
     }
@@ -359,12 +621,17 @@ static bool noTournamentsEnded(Map tournament_map){
     }
     bool no_tournament_ended = true;
     
-    MAP_FOREACH(TournamentKey, tournament_Key, tournament_map){
-        if (tournamentEnded(tournament_map, *tournament_Key)){
+    MapCursor cursor = mapCursorCreate(tournament_map);
+    if (!cursor){
+        return false;//the caller's own allocation will fail as well and report it
+    }
+    while (no_tournament_ended && mapCursorNext(cursor)){
+        TournamentData tournament_data = mapCursorGetData(cursor);
+        if (tournament_data->has_ended){
             no_tournament_ended = false;
         }
-        freeTournamentKey(tournament_Key);
     }
+    mapCursorDestroy(cursor);
     return no_tournament_ended;
 }
 
@@ -376,13 +643,18 @@ TournamentResult tournamentSaveStatistics(Map tournament_map, char* path_file){
     if (noTournamentsEnded(tournament_map)){
         return TOURNAMENT_NO_TOURNAMENTS_ENDED;
     }
+    MapCursor cursor = mapCursorCreate(tournament_map);
+    if (!cursor){
+        return TOURNAMENT_OUT_OF_MEMORY;
+    }
     FILE* stream = fopen(path_file, "w");
     if (!stream){
+        mapCursorDestroy(cursor);
         return TOURNAMENT_SAVE_FAILURE;
     }
     
-    MAP_FOREACH(TournamentKey, tournament_Key, tournament_map){
-        TournamentData tournament_data = tournamentGet(tournament_map, *tournament_Key);
+    while (mapCursorNext(cursor)){
+        TournamentData tournament_data = mapCursorGetData(cursor);
         assert(tournament_data);
         
         double average_game_time = 0;
@@ -390,58 +662,92 @@ TournamentResult tournamentSaveStatistics(Map tournament_map, char* path_file){
             average_game_time = (double)tournament_data->total_game_time / tournament_data->num_of_games;
         }
         fprintf(stream, "%d\n", tournament_data->winner_id);
-        fprintf(stream, "%d\n", tournament_data->longest_game_time);
+        fprintf(stream, "%d\n", tournamentLongestGameTime(tournament_data));
         fprintf(stream, "%.2f\n", average_game_time);
         fprintf(stream, "%s\n", tournament_data->location);
         fprintf(stream, "%d\n", tournament_data->num_of_games);
         fprintf(stream, "%d\n", tournament_data->num_of_players);
-        
-        freeTournamentKey(tournament_Key);
     }
+    mapCursorDestroy(cursor);
     
     fclose(stream);
     return TOURNAMENT_SUCCESS;
 }
 
-void tournamentPlayerRemove(Map tournament_map, Map player_statistics_map, PlayerId first_player){
+TournamentResult tournamentPlayerRemove(Map tournament_map, Map player_statistics_map, PlayerId first_player){
     assert(tournament_map && player_statistics_map);
     //iterate over all tournaments
-    MAP_FOREACH(TournamentKey, tournament_Key, tournament_map){
+    MapCursor cursor = mapCursorCreate(tournament_map);
+    if (!cursor){
+        return TOURNAMENT_OUT_OF_MEMORY;
+    }
+    while (mapCursorNext(cursor)){
         //get tournament data
-        TournamentData tournament_data = tournamentGet(tournament_map, *tournament_Key);
+        TournamentData tournament_data = mapCursorGetData(cursor);
         assert(tournament_data);
         
         if (tournament_data->has_ended == false){
             Map player_map = tournament_data->player_map;///maybe recover from these errors?
-            Map game_map = tournament_data->game_map;
+            GameMap game_map = tournament_data->game_map;
             assert(game_map);
             assert(player_map);
             if (playerExists(player_map, first_player)){
-                PlayerId second_player;
-                int winner;
-                int play_time;
-                //get all games the player participated in
-                while (gameGetDataByPlayerId(game_map, first_player, &second_player, &winner, &play_time, true)) {
-                    if (winner == FIRST_PLAYER) {
-                        updatePlayerDataAfterOpponentQuit(player_map, second_player, PLAYER_LOST);
-                        updatePlayerDataAfterOpponentQuit(player_statistics_map, second_player, PLAYER_LOST);
-                    }
-                    else if (winner == DRAW) {
-                        updatePlayerDataAfterOpponentQuit(player_map, second_player, PLAYER_DRAW);
-                        updatePlayerDataAfterOpponentQuit(player_statistics_map, second_player, PLAYER_DRAW);
-                    }
-                    gameRemove(game_map, first_player, second_player);
-                }//while
+                //remove all games the player participated in, in one pass over the games
+                struct opponent_quit_context_t maps = { player_map, player_statistics_map };
+                gameRemovePlayerParticipated(game_map, first_player, opponentQuit, &maps);
                 playerRemove(player_map, first_player);// remove the player from the tournament
             }//if (playerExists()
         }
-        freeTournamentKey(tournament_Key);
-    }//MAP_FOREACH
+        else{
+            //the games of an ended tournament stay, but the player's results leave with him, so that
+            //removing the tournament later doesn't take them from a new player of the same id
+            playerRemove(tournament_data->player_map, first_player);
+        }
+    }//while (mapCursorNext())
+    mapCursorDestroy(cursor);
     playerRemove(player_statistics_map, first_player);
+    return TOURNAMENT_SUCCESS;
+}
+
+TournamentResult tournamentValidatePlayerStatistics(Map tournament_map, Map player_statistics_map){
+    if (!tournament_map || !player_statistics_map){
+        return TOURNAMENT_NULL_ARGUMENT;
+    }
+    PlayerResult player_result = playerMapValidate(player_statistics_map, false);
+    if (player_result != PLAYER_SUCCESS){
+        return player_result == PLAYER_OUT_OF_MEMORY ? TOURNAMENT_OUT_OF_MEMORY : TOURNAMENT_SAVE_FAILURE;
+    }
+    //taking the players of every tournament out of a copy of the system's players leaves no results
+    Map remaining = playerMapCopy(player_statistics_map);
+    MapCursor cursor = remaining ? mapCursorCreate(tournament_map) : NULL;
+    if (!cursor){
+        playerDestroyMap(remaining);
+        return TOURNAMENT_OUT_OF_MEMORY;
+    }
+    bool valid = true;
+    while (valid && mapCursorNext(cursor)){
+        TournamentData tournament_data = mapCursorGetData(cursor);
+        valid = tournamentIdIsValid(*(TournamentKey)mapCursorGetKey(cursor));
+        playerMapUpdateStatistics(remaining, tournament_data->player_map, false, UNDO);
+    }
+    mapCursorDestroy(cursor);
+    player_result = valid ? playerMapValidate(remaining, true) : PLAYER_SAVE_FAILURE;
+    playerDestroyMap(remaining);
+    if (player_result != PLAYER_SUCCESS){
+        return player_result == PLAYER_OUT_OF_MEMORY ? TOURNAMENT_OUT_OF_MEMORY : TOURNAMENT_SAVE_FAILURE;
+    }
+    return TOURNAMENT_SUCCESS;
 }
 
 TournamentResult tournamentAdd(Map tournament_map, int tournament_id,
                                     int max_games_per_player, const char* tournament_location){
+    return tournamentAddWithCapacity(tournament_map, tournament_id, max_games_per_player,
+                                     tournament_location, 0, 0);
+}
+
+TournamentResult tournamentAddWithCapacity(Map tournament_map, int tournament_id,
+                                           int max_games_per_player, const char* tournament_location,
+                                           int expected_games, int expected_players){
  
     if (!tournament_map){
         return TOURNAMENT_NULL_ARGUMENT;
@@ -458,22 +764,17 @@ TournamentResult tournamentAdd(Map tournament_map, int tournament_id,
     if (max_games_per_player <= 0){
         return TOURNAMENT_INVALID_MAX_GAMES;
     }
-    TournamentData tournament_data = createTournamentData(tournament_location, max_games_per_player);
+    TournamentData tournament_data = createTournamentData(tournament_location, max_games_per_player,
+                                                          mapGetAllocator(tournament_map),
+                                                          expected_games, expected_players);
     if (!tournament_data){
         return TOURNAMENT_OUT_OF_MEMORY;
     }
-    TournamentKey tournament_key = createTournamentKey(tournament_id);
-    if (!tournament_key){
+    //the map stores the id by value and adopts the new data instead of copying it
+    if (mapPutTake(tournament_map, &tournament_id, tournament_data) != MAP_SUCCESS){
         freeTournamentData(tournament_data);
         return TOURNAMENT_OUT_OF_MEMORY;
     }
-    if (mapPut(tournament_map, tournament_key, tournament_data) != MAP_SUCCESS){
-        freeTournamentKey(tournament_key);
-        freeTournamentData(tournament_data);
-        return TOURNAMENT_OUT_OF_MEMORY;
-    }
-    freeTournamentKey(tournament_key);
-    freeTournamentData(tournament_data);
     return TOURNAMENT_SUCCESS;
 }
 
@@ -535,24 +836,124 @@ TournamentResult tournamentUpdateStatistics(Map tournament_map, TournamentId tou
         return TOURNAMENT_TOURNAMENT_NOT_EXIST;
     }
     
+    tournamentDataUpdateStatistics(tournament_data, play_time, new_players);
+    return TOURNAMENT_SUCCESS;
+}
+
+void tournamentDataUpdateStatistics(TournamentData tournament_data, int play_time, int new_players){
+    assert(tournament_data);
     tournament_data->num_of_games++;
     tournament_data->total_game_time += play_time;
-    if (play_time > tournament_data->longest_game_time){
+    //an unknown longest play time stays unknown, the new game may not be the longest
+    if (tournament_data->longest_game_time >= 0 && play_time > tournament_data->longest_game_time){
         tournament_data->longest_game_time = play_time;
     }
     tournament_data->num_of_players += new_players;
-    return TOURNAMENT_SUCCESS;
 }
 
+TournamentResult tournamentUndoStatistics(Map tournament_map, TournamentId tournament_id,
+                                          int play_time, int removed_players){
+    
+    if (!tournament_map){
+        return TOURNAMENT_NULL_ARGUMENT;
+    }
+    if (!tournamentIdIsValid(tournament_id)){
+        return TOURNAMENT_INVALID_ID;
+    }
+    TournamentData tournament_data = tournamentGet(tournament_map, tournament_id);
+    if (!tournament_data){
+        return TOURNAMENT_TOURNAMENT_NOT_EXIST;
+    }
+    assert(tournament_data->num_of_games > 0);
+    
+    tournament_data->num_of_games--;
+    tournament_data->total_game_time -= play_time;
+    //the longest game is found again only when asked for, so correcting games one by one stays O(1)
+    if (tournament_data->num_of_games == 0){
+        tournament_data->longest_game_time = 0;
+    }
+    else if (play_time >= tournament_data->longest_game_time){
+        tournament_data->longest_game_time = -1;
+    }
+    tournament_data->num_of_players -= removed_players;
+    return TOURNAMENT_SUCCESS;
+}
 
+TournamentResult tournamentForEachInRange(Map tournament_map, TournamentId from_id, TournamentId to_id,
+                                          tournamentVisitFunction visit, void* context){
+    if (!tournament_map || !visit){
+        return TOURNAMENT_NULL_ARGUMENT;
+    }
+    if (from_id > to_id){
+        return TOURNAMENT_SUCCESS;
+    }
+    MapCursor cursor = mapCursorCreateRange(tournament_map, &from_id, &to_id);
+    if (!cursor){
+        return TOURNAMENT_OUT_OF_MEMORY;
+    }
+    while (mapCursorNext(cursor)){
+        visit(*(TournamentId*)mapCursorGetKey(cursor), mapCursorGetData(cursor), context);
+    }
+    mapCursorDestroy(cursor);
+    return TOURNAMENT_SUCCESS;
+}
 
+/**
+ * addMapStats: adds the counters of a map to a sum.
+ *
+ * @param total - the sum.
+ * @param stats - the counters of the map, as given by mapGetStats.
+ */
+static void addMapStats(MapStats* total, const MapStats* stats){
+    total->enabled = stats->enabled;
+    total->lookups += stats->lookups;
+    total->inserts += stats->inserts;
+    total->removes += stats->removes;
+    total->comparisons += stats->comparisons;
+    total->nodesVisited += stats->nodesVisited;
+    total->keyCopies += stats->keyCopies;
+    total->dataCopies += stats->dataCopies;
+    total->allocations += stats->allocations;
+    total->bytesAllocated += stats->bytesAllocated;
+}
 
+TournamentResult tournamentGetMapStats(Map tournament_map, MapStats* game_stats, MapStats* player_stats){
+    if (!tournament_map || !game_stats || !player_stats){
+        return TOURNAMENT_NULL_ARGUMENT;
+    }
+    MapCursor cursor = mapCursorCreate(tournament_map);
+    if (!cursor){
+        return TOURNAMENT_OUT_OF_MEMORY;
+    }
+    memset(game_stats, 0, sizeof(*game_stats));
+    memset(player_stats, 0, sizeof(*player_stats));
+    while (mapCursorNext(cursor)){
+        TournamentData tournament_data = mapCursorGetData(cursor);
+        MapStats stats;
+        if (gameMapGetStats(tournament_data->game_map, &stats) == MAP_SUCCESS){
+            addMapStats(game_stats, &stats);
+        }
+        if (mapGetStats(tournament_data->player_map, &stats) == MAP_SUCCESS){
+            addMapStats(player_stats, &stats);
+        }
+    }
+    mapCursorDestroy(cursor);
+    return TOURNAMENT_SUCCESS;
+}
 
-
-
-
-
-
-
-
-
+TournamentResult tournamentResetMapStats(Map tournament_map){
+    if (!tournament_map){
+        return TOURNAMENT_NULL_ARGUMENT;
+    }
+    MapCursor cursor = mapCursorCreate(tournament_map);
+    if (!cursor){
+        return TOURNAMENT_OUT_OF_MEMORY;
+    }
+    while (mapCursorNext(cursor)){
+        TournamentData tournament_data = mapCursorGetData(cursor);
+        gameMapResetStats(tournament_data->game_map);
+        mapResetStats(tournament_data->player_map);
+    }
+    mapCursorDestroy(cursor);
+    return TOURNAMENT_SUCCESS;
+}
@@ -42,6 +42,28 @@ typedef char* Location;
 */
 Map tournamentCreate();
 /**
+* tournamentCreateWithAllocator: Allocates a new empty tournament map taking its memory from
+* an allocator (see mapCreateWithAllocator). The tournaments added to it, their locations
+* and their game and player maps take their memory from the same allocator.
+*
+* @param allocator - the allocator, NULL for malloc.
+* @return
+* 	NULL - if allocations failed.
+* 	A new Map in case of success.
+*/
+Map tournamentCreateWithAllocator(const MapAllocator* allocator);
+/**
+* tournamentCreateWithCapacity: Allocates a new empty tournament map taking its memory from
+* an allocator, with room for a number of tournaments (see mapReserve).
+*
+* @param allocator - the allocator, NULL for malloc.
+* @param capacity - the number of tournaments the map is expected to hold, 0 for none.
+* @return
+* 	NULL - if allocations failed.
+* 	A new Map in case of success.
+*/
+Map tournamentCreateWithCapacity(const MapAllocator* allocator, int capacity);
+/**
 * tournamentDestroy: Deallocates an existing tournament map. Clears all elements by using the
 * stored free functions.
 *
@@ -72,6 +94,20 @@ void tournamentDestroy(Map tournament);
 TournamentResult tournamentAdd(Map tournament_map, int tournament_id,
                                int max_games_per_player, const char* tournament_location);
 /**
+*  tournamentAddWithCapacity: tournamentAdd making the game and player maps of the new
+*  tournament with room for a number of games and players (see mapReserve).
+*
+* @param tournament_map, tournament_id, max_games_per_player, tournament_location - Same as
+*       in tournamentAdd.
+* @param expected_games - the number of games the tournament is expected to hold, 0 for none.
+* @param expected_players - the number of players expected to play in it, 0 for none.
+* @return
+*   Same as tournamentAdd.
+*/
+TournamentResult tournamentAddWithCapacity(Map tournament_map, int tournament_id,
+                                           int max_games_per_player, const char* tournament_location,
+                                           int expected_games, int expected_players);
+/**
 *  tournamentRemove: Removes a pair of tournament id and data elements from the tournament map. The elements
 *  are found using the comparison function given at initialization. Once found,
 *  the elements are removed and deallocated using the free functions
@@ -113,6 +149,27 @@ we want to get.
 */
 TournamentData tournamentGet(Map tournament_map, TournamentId tournament_id);
 /**
+* tournamentDataEnded, tournamentDataGetMaxGamesPerPlayer, tournamentDataGetPlayerMap,
+* tournamentDataGetGameMap: the same as tournamentEnded, tournamentGetMaxGamesPerPlayer,
+* tournamentGetPlayerMap and tournamentGetGameMap, on the data returned by tournamentGet,
+* so that a tournament is looked up once for all of them.
+*
+* @param tournament_data - the tournament's data, must not be NULL.
+*/
+bool tournamentDataEnded(TournamentData tournament_data);
+int tournamentDataGetMaxGamesPerPlayer(TournamentData tournament_data);
+Map tournamentDataGetPlayerMap(TournamentData tournament_data);
+GameMap tournamentDataGetGameMap(TournamentData tournament_data);
+/**
+* tournamentDataUpdateStatistics: the same as tournamentUpdateStatistics, on the data
+* returned by tournamentGet.
+*
+* @param tournament_data - the tournament's data, must not be NULL.
+* @param play_time - play time of the new game.
+* @param new_players - num of players to add.
+*/
+void tournamentDataUpdateStatistics(TournamentData tournament_data, int play_time, int new_players);
+/**
 * tournamentGetMaxGamesPerPlayer: stores max games allowed per player in tournament_map in a pointer.
 *
 * @param tournament_map - The tournament_map to search in.
@@ -158,9 +215,9 @@ Map tournamentGetPlayerMap(Map tournament_map, TournamentId tournament_id);
 *
 * @return
 * 	NULL - if tournament_map is null, or if the tournament_id was not found.
-* 	Map - if the tournament_id was found in the map.
+* 	GameMap - if the tournament_id was found in the map.
 */
-Map tournamentGetGameMap(Map tournament_map, TournamentId tournament_id);
+GameMap tournamentGetGameMap(Map tournament_map, TournamentId tournament_id);
 /**
 * tournamentIdIsValid: Checks if a tournament id is valid.
 *
@@ -186,14 +243,18 @@ bool tournamentLocationIsValid(const char* location);
      *                         In games where the player has participated and not yet ended,
      *                         the opponent is the winner automatically after removal.
      *                         If both player of a game were removed, the game still exists in the system.
+     *                         The games of tournaments that ended stay, without the player's results.
      *
     *  Iterator's value is undefined after this operation.
     *
     * @param tournament_map - The tournament_map to search in for the tournament to remove the player from.
     * @param tournament_id  - The tournament_id associated with the tournament to find and remove from.
     * @param player_statistics_map - pointer to a player map with the statistics of all players.
+    * @return
+    *   TOURNAMENT_OUT_OF_MEMORY - if an allocation failed, nothing is removed then.
+    *   TOURNAMENT_SUCCESS - otherwise.
 */
-void tournamentPlayerRemove(Map tournament_map, Map player_statistics_map, PlayerId first_player);
+TournamentResult tournamentPlayerRemove(Map tournament_map, Map player_statistics_map, PlayerId first_player);
 /**
 * tournamentNumOfActiveGames: returns the num of games in a given tournament.
 *
@@ -234,6 +295,23 @@ TournamentResult tournamentSaveStatistics(Map tournament_map, char* path_file);
 */
 TournamentResult tournamentUpdateStatistics(Map tournament_map, TournamentId tournament_id,
                                             int play_time,int new_players);
+/*
+* tournamentUndoStatistics: takes a removed game out of the statistics of a given tournament,
+* undoing tournamentUpdateStatistics. If it was the longest game, the longest play time is
+* found again among the games when it is next needed.
+*
+* @param tournament_map - The tournament_map to search in.
+* @param tournament_id - the tournament, to update, associated with tournament_id to update.
+* @param play_time - play time of the removed game.
+* @param removed_players - num of players to take out, who have no games left.
+* @return
+*  TOURNAMENT_NULL_ARGUMENT if tournament_map is NULL.
+*  TOURNAMENT_INVALID_ID if tournament_id is<=0
+*  TOURNAMENT_NOT_EXIST if the tournament associated with tournament_id does not exist in the tournament_map.
+*  TOURNAMENT_SUCCESS- otherwise.
+*/
+TournamentResult tournamentUndoStatistics(Map tournament_map, TournamentId tournament_id,
+                                          int play_time, int removed_players);
 /**
  * tournamentEnded: The function will end the tournament if it has at least one game and
  *                     calculate the id of the winner.
@@ -258,6 +336,69 @@ TournamentResult tournamentUpdateStatistics(Map tournament_map, TournamentId tou
  */
 TournamentResult tournamentEnd(Map tournament_map, TournamentId tournament_id);
 
+/** Type of function called by tournamentForEachInRange for every tournament in the range */
+typedef void (*tournamentVisitFunction)(TournamentId tournament_id, TournamentData tournament_data, void* context);
+
+/**
+ * tournamentForEachInRange: calls a function for every tournament whose id is between from_id
+ * and to_id, both included, in ascending id order. Costs O(log n + k) for k tournaments in the range.
+ * The function must not add or remove tournaments.
+ *
+ * @param tournament_map - the tournament map to look into.
+ * @param from_id - the smallest id of the range.
+ * @param to_id - the largest id of the range.
+ * @param visit - the function to call with every tournament's id and data.
+ * @param context - passed as is to visit.
+ * @return
+ *     TOURNAMENT_NULL_ARGUMENT - if tournament_map or visit is NULL.
+ *     TOURNAMENT_OUT_OF_MEMORY - if an allocation failed, no tournament was visited.
+ *     TOURNAMENT_SUCCESS - otherwise, also when the range is empty.
+ */
+TournamentResult tournamentForEachInRange(Map tournament_map, TournamentId from_id, TournamentId to_id,
+                                          tournamentVisitFunction visit, void* context);
+
+/**
+ * tournamentValidatePlayerStatistics: checks a chess system read from a save, once its tournaments
+ * were checked by their decoding: every tournament id is valid, the counters of the players of the
+ * system are (see playerMapValidate), and the results of every player are the sum of his results
+ * in the tournaments. In O(n) for n players in all the maps.
+ *
+ * @param tournament_map - the tournament map.
+ * @param player_statistics_map - the player map of the whole system.
+ * @return
+ *     TOURNAMENT_NULL_ARGUMENT - if a NULL was sent.
+ *     TOURNAMENT_OUT_OF_MEMORY - if an allocation failed.
+ *     TOURNAMENT_SAVE_FAILURE - if the players are not valid.
+ *     TOURNAMENT_SUCCESS - otherwise.
+ */
+TournamentResult tournamentValidatePlayerStatistics(Map tournament_map, Map player_statistics_map);
+
+/**
+ * tournamentGetMapStats: sums the counters (see mapGetStats) of the game maps and of the player
+ * maps of all the tournaments.
+ *
+ * @param tournament_map - the tournament map to look into.
+ * @param game_stats - where the sum of the game maps' counters is written.
+ * @param player_stats - where the sum of the player maps' counters is written.
+ * @return
+ *     TOURNAMENT_NULL_ARGUMENT - if one of the arguments is NULL.
+ *     TOURNAMENT_OUT_OF_MEMORY - if an allocation failed, the sums are left as they were.
+ *     TOURNAMENT_SUCCESS - otherwise.
+ */
+TournamentResult tournamentGetMapStats(Map tournament_map, MapStats* game_stats, MapStats* player_stats);
+
+/**
+ * tournamentResetMapStats: sets the counters of the game maps and of the player maps of all the
+ * tournaments back to 0.
+ *
+ * @param tournament_map - the tournament map.
+ * @return
+ *     TOURNAMENT_NULL_ARGUMENT - if tournament_map is NULL.
+ *     TOURNAMENT_OUT_OF_MEMORY - if an allocation failed, no counter was reset.
+ *     TOURNAMENT_SUCCESS - otherwise.
+ */
+TournamentResult tournamentResetMapStats(Map tournament_map);
+
 
 
 #endif //TOURNAMENT_MAP_H